@@ -37,6 +37,12 @@ class DyadCtxWrapper(ctypes.Structure):
         ("kvs_namespace", ctypes.c_char_p),
         ("prod_managed_path", ctypes.c_char_p),
         ("cons_managed_path", ctypes.c_char_p),
+        ("mem_tier", ctypes.c_void_p),
+        ("cache_index", ctypes.c_void_p),
+        ("fetch_proxy", ctypes.c_bool),
+        ("stripes", ctypes.c_void_p),
+        ("inline_max", ctypes.c_size_t),
+        ("kvs_inline_max", ctypes.c_size_t),
     ]
 
 
@@ -44,6 +50,9 @@ class DyadMetadataWrapper(ctypes.Structure):
     _fields_ = [
         ("fpath", ctypes.c_char_p),
         ("owner_rank", ctypes.c_uint32),
+        ("size", ctypes.c_int64),
+        ("version", ctypes.c_uint64),
+        ("data", ctypes.c_void_p),
     ]
 
 
@@ -84,6 +93,9 @@ class Dyad:
         self.dyad_produce = None
         self.dyad_consume = None
         self.dyad_consume_w_metadata = None
+        self.dyad_consume_to_buffer = None
+        self.dyad_consume_into_buffer = None
+        self.dyad_release_buffer = None
         self.dyad_finalize = None
         dyad_core_lib_file = None
         self.cons_path = None
@@ -156,6 +168,32 @@ class Dyad:
         ]
         self.dyad_consume_w_metadata.restype = ctypes.c_int
 
+        self.dyad_consume_to_buffer = self.dyad_core_lib.dyad_consume_to_buffer
+        self.dyad_consume_to_buffer.argtypes = [
+            ctypes.POINTER(DyadCtxWrapper),
+            ctypes.c_char_p,
+            ctypes.POINTER(ctypes.c_void_p),
+            ctypes.POINTER(ctypes.c_size_t),
+        ]
+        self.dyad_consume_to_buffer.restype = ctypes.c_int
+
+        self.dyad_consume_into_buffer = self.dyad_core_lib.dyad_consume_into_buffer
+        self.dyad_consume_into_buffer.argtypes = [
+            ctypes.POINTER(DyadCtxWrapper),
+            ctypes.c_char_p,
+            ctypes.c_void_p,
+            ctypes.c_size_t,
+            ctypes.POINTER(ctypes.c_size_t),
+        ]
+        self.dyad_consume_into_buffer.restype = ctypes.c_int
+
+        self.dyad_release_buffer = self.dyad_core_lib.dyad_release_buffer
+        self.dyad_release_buffer.argtypes = [
+            ctypes.POINTER(DyadCtxWrapper),
+            ctypes.POINTER(ctypes.c_void_p),
+        ]
+        self.dyad_release_buffer.restype = ctypes.c_int
+
         self.dyad_finalize = self.dyad_core_lib.dyad_finalize
         self.dyad_finalize.argtypes = [
             ctypes.POINTER(ctypes.POINTER(DyadCtxWrapper)),
@@ -317,6 +355,52 @@ class Dyad:
         if int(res) != 0:
             raise RuntimeError("Cannot consume data with metadata with DYAD!")
 
+    @dlio_log.log
+    def consume_to_buffer(self, fname):
+        if self.dyad_consume_to_buffer is None:
+            warnings.warn(
+                "Trying to consume into memory with DYAD when libdyad_core.so was not found",
+                RuntimeWarning
+            )
+            return None
+        buf = ctypes.c_void_p()
+        buf_len = ctypes.c_size_t(0)
+        res = self.dyad_consume_to_buffer(
+            self.ctx,
+            fname.encode(),
+            ctypes.byref(buf),
+            ctypes.byref(buf_len)
+        )
+        if int(res) != 0:
+            raise RuntimeError("Cannot consume data into memory with DYAD!")
+        try:
+            data = ctypes.string_at(buf, buf_len.value) if buf_len.value > 0 else b""
+        finally:
+            self.dyad_release_buffer(self.ctx, ctypes.byref(buf))
+        return data
+
+    @dlio_log.log
+    def consume_into_buffer(self, fname, buf):
+        if self.dyad_consume_into_buffer is None:
+            warnings.warn(
+                "Trying to consume into memory with DYAD when libdyad_core.so was not found",
+                RuntimeWarning
+            )
+            return 0
+        view = memoryview(buf).cast("B")
+        c_buf = (ctypes.c_char * view.nbytes).from_buffer(view)
+        buf_len = ctypes.c_size_t(0)
+        res = self.dyad_consume_into_buffer(
+            self.ctx,
+            fname.encode(),
+            c_buf,
+            ctypes.c_size_t(view.nbytes),
+            ctypes.byref(buf_len)
+        )
+        if int(res) != 0:
+            raise RuntimeError("Cannot consume data into the provided buffer with DYAD!")
+        return buf_len.value
+
     @dlio_log.log
     def finalize(self):
         if not self.initialized:
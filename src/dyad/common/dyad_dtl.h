@@ -9,7 +9,10 @@
 
 #include <dyad/common/dyad_structures.h>
 #ifdef __cplusplus
+#include <cstdint>
 extern "C" {
+#else
+#include <stdint.h>
 #endif
 
 
@@ -19,9 +22,39 @@ typedef enum dyad_dtl_mode dyad_dtl_mode_t;
 static const char* dyad_dtl_mode_name[DYAD_DTL_END] __attribute__((unused)) = {"UCX", "FLUX_RPC"};
 
 #define DYAD_DTL_RPC_NAME "dyad.fetch"
+#define DYAD_PROXY_RPC_NAME "dyad.proxy"
+#define DYAD_STATS_RPC_NAME "dyad.stats"
+#define DYAD_BATCH_RPC_NAME "dyad.fetch_batch"
+#define DYAD_INLINE_RPC_NAME "dyad.fetch_inline"
+#define DYAD_REGISTER_RPC_NAME "dyad.register"
+// Same as dyad.fetch, from a consumer whose DTL connection the module already
+// knows. The raw payload is the null-terminated path followed by what the DTL
+// needs to find the connection again.
+#define DYAD_FETCH_RAW_RPC_NAME "dyad.fetch_raw"
+#define DYAD_SHM_RPC_NAME "dyad.register_shm"
+// Sent by a consumer once it pulled data the module left for it (see
+// send_ack_id in dyad_dtl_api.h), so that the module releases the buffer
+#define DYAD_RMA_ACK_RPC_NAME "dyad.rma_ack"
+// Time a module keeps a buffer for a consumer to pull it
+#define DYAD_RMA_ACK_TIMEOUT_SECS 60
+// Maximum number of files requested by one dyad.fetch_batch request
+#define DYAD_BATCH_MAX_FILES 64u
+// Error string of the EAGAIN response of a saturated DYAD module
+#define DYAD_RETRY_AFTER_FMT "retry after %u ms"
 
 struct dyad_dtl;
 
+/**
+ * Header of each file sent over the DTL in response to a dyad.fetch_batch
+ * request. Each file is sent as one message made of this header followed by
+ * the contents of the file. Files may arrive in any order.
+ */
+struct dyad_batch_frame {
+    uint32_t index;   // position of the file in the request
+    int32_t errnum;   // error that prevented sending the file (0 if none)
+    uint64_t len;     // number of bytes of the file following the header
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,5 +19,24 @@
 #define DYAD_SYNC_DEBUG_ENV "DYAD_SYNC_DEBUG"
 #define DYAD_SERVICE_MUX_ENV "DYAD_SERVICE_MUX"
 #define DYAD_REINIT_ENV "DYAD_REINIT"
+#define DYAD_MEM_TIER_PATH_ENV "DYAD_MEM_TIER_PATH"
+#define DYAD_MEM_TIER_BUDGET_ENV "DYAD_MEM_TIER_BUDGET"
+#define DYAD_CACHE_INDEX_PATH_ENV "DYAD_CACHE_INDEX_PATH"
+#define DYAD_CACHE_INDEX_SLOTS_ENV "DYAD_CACHE_INDEX_SLOTS"
+#define DYAD_CACHE_CHECKSUM_ENV "DYAD_CACHE_CHECKSUM"
+#define DYAD_FETCH_PROXY_ENV "DYAD_FETCH_PROXY"
+#define DYAD_STRIPE_DIRS_ENV "DYAD_STRIPE_DIRS"
+#define DYAD_STRIPE_POLICY_ENV "DYAD_STRIPE_POLICY"
+#define DYAD_INLINE_MAX_ENV "DYAD_INLINE_MAX"
+#define DYAD_KVS_INLINE_MAX_ENV "DYAD_KVS_INLINE_MAX"
+#define DYAD_PRECONNECT_ENV "DYAD_PRECONNECT"
+#define DYAD_UCX_RMA_ENV "DYAD_UCX_RMA"
+#define DYAD_UCX_SPIN_US_ENV "DYAD_UCX_SPIN_US"
+#define DYAD_UCX_PROGRESS_ENV "DYAD_UCX_PROGRESS"
+#define DYAD_UCX_EP_CACHE_ENV "DYAD_UCX_EP_CACHE"
+#define DYAD_UCX_AM_ENV "DYAD_UCX_AM"
+#define DYAD_UCX_CHUNK_ENV "DYAD_UCX_CHUNK"
+#define DYAD_UCX_PIPELINE_ENV "DYAD_UCX_PIPELINE"
+#define DYAD_UCX_CONNS_ENV "DYAD_UCX_CONNS"
 
 #endif  // DYAD_COMMON_DYAD_ENVS_H
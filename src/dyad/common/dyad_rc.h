@@ -53,6 +53,11 @@ enum dyad_core_return_codes {
     DYAD_RC_BADUNPACK = -2006,         // JSON unpacking failed
     DYAD_RC_RPC_FINISHED = -2007,      // The Flux RPC responded with ENODATA (i.e.,
                                        // end of stream) sooner than expected
+    DYAD_RC_NOSERVICE = -2008,         // The Flux service requested is not available
+    DYAD_RC_BUSY = -2009,              // The DYAD module turned down the request
+                                       // because it is saturated
+    DYAD_RC_NOTCONN = -2010,           // The DYAD module could not serve a compact
+                                       // request, which must be sent in full
 
     //UCX
     DYAD_RC_UCXINIT_FAIL = -3001,     // UCX initialization failed
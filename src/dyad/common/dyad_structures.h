@@ -12,6 +12,10 @@
 extern "C" {
 #endif
 
+struct dyad_mem_tier;
+struct dyad_cache_index;
+struct dyad_stripes;
+
 /**
  * @struct dyad_ctx
  */
@@ -35,6 +39,12 @@ struct dyad_ctx {
     char* kvs_namespace;            // Flux KVS namespace for DYAD
     char* prod_managed_path;        // producer path managed by DYAD
     char* cons_managed_path;        // consumer path managed by DYAD
+    struct dyad_mem_tier* mem_tier; // memory tier of the consumer cache (NULL if disabled)
+    struct dyad_cache_index* cache_index;  // persistent index of the consumer cache (NULL if disabled)
+    bool fetch_proxy;               // if true, fetch remote files through the local DYAD module
+    struct dyad_stripes* stripes;   // directories the consumer cache is striped across (NULL if disabled)
+    size_t inline_max;              // files up to this size are fetched in the RPC response (0 disables)
+    size_t kvs_inline_max;          // files up to this size are published in their KVS entry (0 disables)
 };
 typedef struct dyad_ctx dyad_ctx_t;
 typedef void* ucx_ep_cache_h;
@@ -0,0 +1,503 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif  // _GNU_SOURCE
+#include <dyad/common/dyad_logging.h>
+#include <dyad/common/dyad_profiler.h>
+#include <dyad/core/dyad_cache_index.h>
+#include <dyad/utils/murmur3.h>
+#include <dyad/utils/utils.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+#include <cstring>
+#else
+#include <string.h>
+#endif
+
+struct dyad_cache_index {
+    int fd;                                 // file descriptor of the index file
+    size_t map_len;                         // length of the mapping
+    struct dyad_cache_index_header* hdr;    // start of the mapping
+    struct dyad_cache_index_slot* slots;    // slot table following the header
+    bool checksum;                          // if true, checksum file contents
+};
+
+static void cache_index_key (const char* upath, uint64_t key[2])
+{
+    MurmurHash3_x64_128 (upath, strlen (upath), 57u, key);
+    // Keys with a zero first word mark free slots and tombstones
+    if (key[0] == 0ull)
+        key[0] = 1ull;
+}
+
+static inline bool cache_index_slot_free (const struct dyad_cache_index_slot* slot)
+{
+    return slot->key[0] == 0ull && slot->key[1] == 0ull;
+}
+
+static inline bool cache_index_slot_deleted (const struct dyad_cache_index_slot* slot)
+{
+    return slot->key[0] == 0ull && slot->key[1] == 1ull;
+}
+
+/// Find the slot of a key, or return NULL if the key is absent
+static struct dyad_cache_index_slot* cache_index_find (struct dyad_cache_index* index,
+                                                       const uint64_t key[2])
+{
+    const uint32_t mask = index->hdr->nslots - 1u;
+    uint32_t i = (uint32_t)key[0] & mask;
+    for (uint32_t n = 0u; n < index->hdr->nslots; n++, i = (i + 1u) & mask) {
+        struct dyad_cache_index_slot* slot = &(index->slots[i]);
+        if (slot->key[0] == key[0] && slot->key[1] == key[1])
+            return slot;
+        if (cache_index_slot_free (slot))
+            return NULL;
+    }
+    return NULL;
+}
+
+/// Find the slot of a key. If the key is absent, return the first tombstone or
+/// free slot where it can be inserted, or NULL if the table is full. Must be
+/// called with the index locked.
+static struct dyad_cache_index_slot* cache_index_probe (struct dyad_cache_index* index,
+                                                        const uint64_t key[2])
+{
+    const uint32_t mask = index->hdr->nslots - 1u;
+    uint32_t i = (uint32_t)key[0] & mask;
+    struct dyad_cache_index_slot* tombstone = NULL;
+    for (uint32_t n = 0u; n < index->hdr->nslots; n++, i = (i + 1u) & mask) {
+        struct dyad_cache_index_slot* slot = &(index->slots[i]);
+        if (slot->key[0] == key[0] && slot->key[1] == key[1])
+            return slot;
+        if (cache_index_slot_free (slot))
+            return (tombstone != NULL) ? tombstone : slot;
+        if (tombstone == NULL && cache_index_slot_deleted (slot))
+            tombstone = slot;
+    }
+    return tombstone;
+}
+
+/// Copy a slot updated concurrently by another consumer. The copy is
+/// consistent if the flags and the generation did not change while it was
+/// taken; writers clear the flags before touching anything else.
+static bool cache_index_snapshot (const struct dyad_cache_index_slot* slot,
+                                  struct dyad_cache_index_slot* copy)
+{
+    uint32_t flags = __atomic_load_n (&(slot->flags), __ATOMIC_ACQUIRE);
+    uint64_t generation = __atomic_load_n (&(slot->generation), __ATOMIC_ACQUIRE);
+    memcpy (copy, slot, sizeof (*copy));
+    __atomic_thread_fence (__ATOMIC_ACQUIRE);
+    return flags != 0u && flags == __atomic_load_n (&(slot->flags), __ATOMIC_RELAXED)
+           && generation == __atomic_load_n (&(slot->generation), __ATOMIC_RELAXED);
+}
+
+/// Fill a slot. Must be called with the index locked.
+static void cache_index_fill (struct dyad_cache_index* index,
+                              struct dyad_cache_index_slot* slot,
+                              const struct dyad_cache_index_slot* from)
+{
+    __atomic_store_n (&(slot->flags), 0u, __ATOMIC_RELEASE);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    slot->key[0] = from->key[0];
+    slot->key[1] = from->key[1];
+    slot->size = from->size;
+    slot->version = from->version;
+    slot->checksum = from->checksum;
+    slot->ref = 1u;
+    __atomic_store_n (&(slot->generation), ++(index->hdr->generation), __ATOMIC_RELEASE);
+    __atomic_store_n (&(slot->flags), from->flags, __ATOMIC_RELEASE);
+}
+
+/// Turn a slot into a tombstone. Must be called with the index locked.
+static void cache_index_delete (struct dyad_cache_index* index, struct dyad_cache_index_slot* slot)
+{
+    __atomic_store_n (&(slot->flags), 0u, __ATOMIC_RELEASE);
+    __atomic_thread_fence (__ATOMIC_RELEASE);
+    slot->key[0] = 0ull;
+    slot->key[1] = 1ull;
+    slot->ref = 0u;
+    index->hdr->used--;
+    index->hdr->deleted++;
+}
+
+/// Evict the first slot the clock hand finds not looked up since its last
+/// pass. Must be called with the index locked.
+static void cache_index_evict (struct dyad_cache_index* index)
+{
+    const uint32_t mask = index->hdr->nslots - 1u;
+    // Two turns are enough: the first clears every reference bit
+    for (uint32_t n = 0u; n < 2u * index->hdr->nslots; n++) {
+        struct dyad_cache_index_slot* slot = &(index->slots[index->hdr->hand]);
+        index->hdr->hand = (index->hdr->hand + 1u) & mask;
+        if (cache_index_slot_free (slot) || cache_index_slot_deleted (slot))
+            continue;
+        if (__atomic_exchange_n (&(slot->ref), 0u, __ATOMIC_RELAXED) != 0u)
+            continue;
+        cache_index_delete (index, slot);
+        return;
+    }
+}
+
+/// Rehash the used slots to drop the tombstones, which otherwise lengthen
+/// every probe. Must be called with the index locked.
+static void cache_index_rehash (struct dyad_cache_index* index)
+{
+    const uint32_t nslots = index->hdr->nslots;
+    struct dyad_cache_index_slot* kept = NULL;
+    uint32_t nkept = 0u;
+
+    kept = (struct dyad_cache_index_slot*)malloc ((size_t)index->hdr->used * sizeof (*kept) + 1u);
+    if (kept == NULL)
+        return;
+    for (uint32_t i = 0u; i < nslots; i++) {
+        struct dyad_cache_index_slot* slot = &(index->slots[i]);
+        if (cache_index_slot_free (slot))
+            continue;
+        if (!cache_index_slot_deleted (slot) && nkept < index->hdr->used)
+            kept[nkept++] = *slot;
+        __atomic_store_n (&(slot->flags), 0u, __ATOMIC_RELEASE);
+        __atomic_thread_fence (__ATOMIC_RELEASE);
+        slot->key[0] = 0ull;
+        slot->key[1] = 0ull;
+    }
+    for (uint32_t i = 0u; i < nkept; i++) {
+        struct dyad_cache_index_slot* slot = cache_index_probe (index, kept[i].key);
+        if (slot != NULL)
+            cache_index_fill (index, slot, &kept[i]);
+    }
+    index->hdr->used = nkept;
+    index->hdr->deleted = 0u;
+    msync (index->hdr, index->map_len, MS_ASYNC);
+    free (kept);
+}
+
+static uint32_t cache_index_checksum (const void* data, size_t size)
+{
+    uint32_t checksum = 0u;
+    MurmurHash3_x86_32 (data, (int)size, 57u, &checksum);
+    return checksum;
+}
+
+#ifndef F_OFD_SETLKW
+// Without open file description locks, the record lock of fcntl is owned by
+// the process. It does not exclude the threads of the process from each
+// other, so they are serialized by this mutex first.
+static pthread_mutex_t cache_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/// Lock the index file exclusively. The lock belongs to the open file
+/// description of the index, so the contexts of the threads of a process,
+/// each with its own descriptor, exclude each other, and closing another
+/// descriptor of the file does not drop it.
+static dyad_rc_t cache_index_lock (const dyad_ctx_t* ctx, int fd)
+{
+    struct flock lock;
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+#ifdef F_OFD_SETLKW
+    while (fcntl (fd, F_OFD_SETLKW, &lock) == -1) {
+#else
+    pthread_mutex_lock (&cache_index_mutex);
+    while (fcntl (fd, F_SETLKW, &lock) == -1) {
+#endif
+        if (errno == EINTR)
+            continue;
+        DYAD_LOG_ERROR (ctx, "Cannot lock the cache index on fd %d", fd);
+#ifndef F_OFD_SETLKW
+        pthread_mutex_unlock (&cache_index_mutex);
+#endif
+        return DYAD_RC_BADFIO;
+    }
+    return DYAD_RC_OK;
+}
+
+static void cache_index_unlock (int fd)
+{
+    struct flock lock;
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = F_UNLCK;
+    lock.l_whence = SEEK_SET;
+#ifdef F_OFD_SETLKW
+    fcntl (fd, F_OFD_SETLK, &lock);
+#else
+    fcntl (fd, F_SETLK, &lock);
+    pthread_mutex_unlock (&cache_index_mutex);
+#endif
+}
+
+/// Flush the page(s) holding a slot so that the update survives the process
+static void cache_index_sync_slot (struct dyad_cache_index* index,
+                                   struct dyad_cache_index_slot* slot)
+{
+    const uintptr_t page = (uintptr_t)sysconf (_SC_PAGESIZE);
+    uintptr_t start = ((uintptr_t)slot) & ~(page - 1u);
+    uintptr_t end = ((uintptr_t)(slot + 1) + page - 1u) & ~(page - 1u);
+    msync ((void*)start, end - start, MS_ASYNC);
+    (void)index;
+}
+
+dyad_rc_t dyad_cache_index_open (const dyad_ctx_t* ctx,
+                                 const char* path,
+                                 uint32_t nslots,
+                                 bool checksum,
+                                 struct dyad_cache_index** index)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("path", path);
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct dyad_cache_index_header hdr;
+    struct stat st;
+    bool locked = false;
+    void* map = NULL;
+    int fd = -1;
+
+    if (index == NULL || path == NULL) {
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto index_open_done;
+    }
+    // Round the slot count up to a power of two
+    uint32_t n = 1u;
+    while (n < nslots && n < (1u << 31))
+        n <<= 1;
+    nslots = n;
+
+    fd = open (path, O_RDWR | O_CREAT, 0666);
+    if (fd == -1) {
+        DYAD_LOG_ERROR (ctx, "Cannot open the cache index %s", path);
+        rc = DYAD_RC_BADFIO;
+        goto index_open_done;
+    }
+    // Serialize the creation of the index among the consumers of the node
+    rc = cache_index_lock (ctx, fd);
+    if (DYAD_IS_ERROR (rc)) {
+        goto index_open_done;
+    }
+    locked = true;
+    if (fstat (fd, &st) != 0) {
+        rc = DYAD_RC_BADFIO;
+        goto index_open_done;
+    }
+    if (st.st_size == 0) {
+        memset (&hdr, 0, sizeof (hdr));
+        hdr.magic = DYAD_CACHE_INDEX_MAGIC;
+        hdr.version = DYAD_CACHE_INDEX_VERSION;
+        hdr.nslots = nslots;
+        hdr.generation = 0ull;
+        if (ftruncate (fd, sizeof (hdr) + (size_t)nslots * sizeof (struct dyad_cache_index_slot))
+                != 0
+            || pwrite (fd, &hdr, sizeof (hdr), 0) != (ssize_t)sizeof (hdr)) {
+            DYAD_LOG_ERROR (ctx, "Cannot initialize the cache index %s", path);
+            rc = DYAD_RC_BADFIO;
+            goto index_open_done;
+        }
+    } else if (pread (fd, &hdr, sizeof (hdr), 0) == (ssize_t)sizeof (hdr)
+               && hdr.magic == DYAD_CACHE_INDEX_MAGIC && hdr.version != DYAD_CACHE_INDEX_VERSION) {
+        // Left by an older release: start over, the copies are fetched again
+        DYAD_LOG_INFO (ctx, "Recreating the cache index %s of version %u", path, hdr.version);
+        memset (&hdr, 0, sizeof (hdr));
+        hdr.magic = DYAD_CACHE_INDEX_MAGIC;
+        hdr.version = DYAD_CACHE_INDEX_VERSION;
+        hdr.nslots = nslots;
+        if (ftruncate (fd, 0) != 0
+            || ftruncate (fd, sizeof (hdr) + (size_t)nslots * sizeof (struct dyad_cache_index_slot))
+                   != 0
+            || pwrite (fd, &hdr, sizeof (hdr), 0) != (ssize_t)sizeof (hdr)) {
+            DYAD_LOG_ERROR (ctx, "Cannot initialize the cache index %s", path);
+            rc = DYAD_RC_BADFIO;
+            goto index_open_done;
+        }
+    } else if (hdr.magic != DYAD_CACHE_INDEX_MAGIC || hdr.nslots == 0u || (hdr.nslots & (hdr.nslots - 1u)) != 0u
+               || (size_t)st.st_size
+                      < sizeof (hdr) + (size_t)hdr.nslots * sizeof (struct dyad_cache_index_slot)) {
+        DYAD_LOG_ERROR (ctx, "%s is not a valid DYAD cache index", path);
+        rc = DYAD_RC_BADFIO;
+        goto index_open_done;
+    }
+    const size_t map_len = sizeof (hdr) + (size_t)hdr.nslots * sizeof (struct dyad_cache_index_slot);
+    map = mmap (NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        DYAD_LOG_ERROR (ctx, "Cannot map the cache index %s", path);
+        rc = DYAD_RC_BADFIO;
+        goto index_open_done;
+    }
+    *index = (struct dyad_cache_index*)calloc (1, sizeof (struct dyad_cache_index));
+    if (*index == NULL) {
+        munmap (map, map_len);
+        rc = DYAD_RC_SYSFAIL;
+        goto index_open_done;
+    }
+    (*index)->fd = fd;
+    (*index)->map_len = map_len;
+    (*index)->hdr = (struct dyad_cache_index_header*)map;
+    (*index)->slots = (struct dyad_cache_index_slot*)((char*)map + sizeof (hdr));
+    (*index)->checksum = checksum;
+    DYAD_LOG_INFO (ctx, "Opened the cache index %s with %u slots", path, hdr.nslots);
+    rc = DYAD_RC_OK;
+
+index_open_done:;
+    if (locked)
+        cache_index_unlock (fd);
+    if (DYAD_IS_ERROR (rc) && fd != -1)
+        close (fd);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_cache_index_close (struct dyad_cache_index** index)
+{
+    if (index == NULL || *index == NULL) {
+        return DYAD_RC_OK;
+    }
+    msync ((*index)->hdr, (*index)->map_len, MS_ASYNC);
+    munmap ((*index)->hdr, (*index)->map_len);
+    close ((*index)->fd);
+    free (*index);
+    *index = NULL;
+    return DYAD_RC_OK;
+}
+
+bool dyad_cache_index_is_valid (const dyad_ctx_t* ctx,
+                                struct dyad_cache_index* index,
+                                const char* upath,
+                                const char* fpath,
+                                size_t size,
+                                uint64_t version)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    bool valid = false;
+    uint64_t key[2] = {0ull, 0ull};
+    int fd = -1;
+    void* data = NULL;
+    struct dyad_cache_index_slot* slot = NULL;
+    struct dyad_cache_index_slot copy;
+
+    cache_index_key (upath, key);
+    slot = cache_index_find (index, key);
+    if (slot == NULL || !cache_index_snapshot (slot, &copy) || copy.key[0] != key[0]
+        || copy.key[1] != key[1]) {
+        DYAD_LOG_INFO (ctx, "%s is not in the cache index", upath);
+        goto index_valid_done;
+    }
+    // Keep the slot away from the clock hand
+    if (__atomic_load_n (&(slot->ref), __ATOMIC_RELAXED) == 0u)
+        __atomic_store_n (&(slot->ref), 1u, __ATOMIC_RELAXED);
+    if (!(copy.flags & DYAD_CACHE_INDEX_COMPLETE) || copy.size != (uint64_t)size
+        || (version != 0ull && copy.version != 0ull && copy.version != version)) {
+        DYAD_LOG_INFO (ctx, "Cached copy of %s is incomplete or stale", upath);
+        goto index_valid_done;
+    }
+    if (index->checksum && (copy.flags & DYAD_CACHE_INDEX_CHECKSUM) && size > 0ul) {
+        fd = open (fpath, O_RDONLY);
+        if (fd == -1)
+            goto index_valid_done;
+        data = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+            goto index_valid_done;
+        }
+        if (cache_index_checksum (data, size) != copy.checksum) {
+            DYAD_LOG_INFO (ctx, "Checksum of the cached copy of %s does not match", upath);
+            goto index_valid_done;
+        }
+    }
+    valid = true;
+
+index_valid_done:;
+    if (data != NULL)
+        munmap (data, size);
+    if (fd != -1)
+        close (fd);
+    DYAD_C_FUNCTION_UPDATE_INT ("valid", valid);
+    DYAD_C_FUNCTION_END();
+    return valid;
+}
+
+dyad_rc_t dyad_cache_index_invalidate (const dyad_ctx_t* ctx,
+                                       struct dyad_cache_index* index,
+                                       const char* upath)
+{
+    DYAD_C_FUNCTION_START();
+    uint64_t key[2] = {0ull, 0ull};
+    struct dyad_cache_index_slot* slot = NULL;
+    cache_index_key (upath, key);
+    slot = cache_index_find (index, key);
+    if (slot != NULL) {
+        __atomic_store_n (&(slot->flags), 0u, __ATOMIC_RELEASE);
+        cache_index_sync_slot (index, slot);
+    }
+    DYAD_C_FUNCTION_END();
+    return DYAD_RC_OK;
+}
+
+dyad_rc_t dyad_cache_index_record (const dyad_ctx_t* ctx,
+                                   struct dyad_cache_index* index,
+                                   const char* upath,
+                                   const void* data,
+                                   size_t size,
+                                   uint64_t version,
+                                   uint32_t flags)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct dyad_cache_index_slot entry;
+    struct dyad_cache_index_slot* slot = NULL;
+
+    memset (&entry, 0, sizeof (entry));
+    cache_index_key (upath, entry.key);
+    entry.size = (uint64_t)size;
+    entry.version = version;
+    if (index->checksum && data != NULL) {
+        entry.checksum = cache_index_checksum (data, size);
+        flags |= DYAD_CACHE_INDEX_CHECKSUM;
+    }
+    entry.flags = flags | DYAD_CACHE_INDEX_COMPLETE;
+    // Updates from the consumers of a node, and from the threads of each of
+    // them, are serialized by the file lock. Readers do not lock: they check
+    // that a slot did not change while they read it.
+    rc = cache_index_lock (ctx, index->fd);
+    if (DYAD_IS_ERROR (rc)) {
+        goto index_record_done;
+    }
+    slot = cache_index_find (index, entry.key);
+    if (slot == NULL) {
+        const uint32_t nslots = index->hdr->nslots;
+        if (index->hdr->used >= nslots - nslots / 4u)
+            cache_index_evict (index);
+        if (index->hdr->used + index->hdr->deleted >= nslots - nslots / 8u)
+            cache_index_rehash (index);
+        slot = cache_index_probe (index, entry.key);
+        if (slot == NULL) {
+            DYAD_LOG_ERROR (ctx, "The cache index is full. Cannot record %s", upath);
+            rc = DYAD_RC_SYSFAIL;
+            goto index_record_unlock;
+        }
+        if (cache_index_slot_deleted (slot))
+            index->hdr->deleted--;
+        index->hdr->used++;
+    }
+    cache_index_fill (index, slot, &entry);
+    cache_index_sync_slot (index, slot);
+    DYAD_C_FUNCTION_UPDATE_INT ("generation", slot->generation);
+    rc = DYAD_RC_OK;
+
+index_record_unlock:;
+    cache_index_unlock (index->fd);
+index_record_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
@@ -0,0 +1,146 @@
+#ifndef DYAD_CORE_DYAD_CACHE_INDEX_H
+#define DYAD_CORE_DYAD_CACHE_INDEX_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <dyad/common/dyad_structures.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+/**
+ * Persistent index of the consumer cache.
+ *
+ * The index is a file holding a fixed-size open-addressing table, shared by
+ * all the consumers of a node through mmap. Each slot records, for a path
+ * relative to the consumer-managed directory, the size, checksum and
+ * generation of the copy on node-local storage, the version its producer
+ * published, and whether that copy is complete. A slot is marked incomplete
+ * before a fetched file is written and complete only after the data is
+ * flushed, so a restarted job can tell files left behind by a crash from
+ * files it can reuse.
+ *
+ * Once three quarters of the slots are in use, recording a new file evicts
+ * one that was not looked up recently (clock algorithm). Evicted slots are
+ * left as tombstones, and the table is rehashed once tombstones and used
+ * slots take up seven eighths of it.
+ */
+
+#define DYAD_CACHE_INDEX_MAGIC 0x3158444944415944ull  // "DYADIDX1"
+#define DYAD_CACHE_INDEX_VERSION 2u
+#define DYAD_CACHE_INDEX_DEFAULT_SLOTS (1u << 16)
+
+enum dyad_cache_index_flags {
+    DYAD_CACHE_INDEX_COMPLETE = 0x1,  // the copy on node-local storage is complete
+    DYAD_CACHE_INDEX_CHECKSUM = 0x2,  // the checksum field is valid
+    DYAD_CACHE_INDEX_LOCAL = 0x4,     // the file was produced on this node
+};
+
+struct dyad_cache_index_header {
+    uint64_t magic;       // DYAD_CACHE_INDEX_MAGIC
+    uint32_t version;     // DYAD_CACHE_INDEX_VERSION
+    uint32_t nslots;      // number of slots (power of two)
+    uint64_t generation;  // generation handed to the last update
+    uint32_t used;        // number of slots holding a file
+    uint32_t deleted;     // number of tombstones
+    uint32_t hand;        // next slot looked at by the clock
+    uint32_t pad;
+};
+
+struct dyad_cache_index_slot {
+    uint64_t key[2];      // 128-bit hash of the path ({0, 0} if the slot is free,
+                          // {0, 1} if it is a tombstone)
+    uint64_t size;        // size of the file in bytes
+    uint64_t version;     // version of the file published by its producer (0 if unknown)
+    uint64_t generation;  // generation of the last update of this slot
+    uint32_t checksum;    // 32-bit murmur3 hash of the file contents
+    uint32_t flags;       // dyad_cache_index_flags
+    uint32_t ref;         // set when the slot is looked up, cleared by the clock
+    uint32_t pad;
+};
+
+struct dyad_cache_index;
+
+/**
+ * @brief Open (or create) the index file and map it
+ * @param[in]  ctx       the DYAD context for the operation
+ * @param[in]  path      the path of the index file
+ * @param[in]  nslots    the number of slots used when creating the index
+ * @param[in]  checksum  if true, checksum file contents on update and check
+ *                       them on lookup
+ * @param[out] index     the opened index
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_cache_index_open (const dyad_ctx_t* ctx,
+                                 const char* path,
+                                 uint32_t nslots,
+                                 bool checksum,
+                                 struct dyad_cache_index** index);
+
+dyad_rc_t dyad_cache_index_close (struct dyad_cache_index** index);
+
+/**
+ * @brief Check if the copy of a file on node-local storage is complete and
+ *        matches the index
+ * @param[in] ctx    the DYAD context for the operation
+ * @param[in] index  the index
+ * @param[in] upath  path of the file relative to the consumer-managed directory
+ * @param[in] fpath  path of the copy on node-local storage
+ * @param[in] size     current size of the copy
+ * @param[in] version  version of the file published by its producer, or 0 if
+ *                     it is not known (then only the size is checked)
+ *
+ * @return true if the copy can be used without fetching the file again
+ */
+bool dyad_cache_index_is_valid (const dyad_ctx_t* ctx,
+                                struct dyad_cache_index* index,
+                                const char* upath,
+                                const char* fpath,
+                                size_t size,
+                                uint64_t version);
+
+/**
+ * @brief Mark a file as incomplete before its copy is (re)written
+ */
+dyad_rc_t dyad_cache_index_invalidate (const dyad_ctx_t* ctx,
+                                       struct dyad_cache_index* index,
+                                       const char* upath);
+
+/**
+ * @brief Record a complete copy of a file. Call only once the data is flushed.
+ * @param[in] ctx    the DYAD context for the operation
+ * @param[in] index  the index
+ * @param[in] upath  path of the file relative to the consumer-managed directory
+ * @param[in] data   contents of the file (may be NULL if they are not at hand)
+ * @param[in] size     size of the file in bytes
+ * @param[in] version  version of the file published by its producer (0 if unknown)
+ * @param[in] flags    additional dyad_cache_index_flags
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_cache_index_record (const dyad_ctx_t* ctx,
+                                   struct dyad_cache_index* index,
+                                   const char* upath,
+                                   const void* data,
+                                   size_t size,
+                                   uint64_t version,
+                                   uint32_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_CORE_DYAD_CACHE_INDEX_H */
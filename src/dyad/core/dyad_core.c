@@ -4,16 +4,25 @@
 #error "no config"
 #endif
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif  // _GNU_SOURCE
 #include <dyad/common/dyad_envs.h>
 #include <dyad/common/dyad_logging.h>
+#include <dyad/core/dyad_cache_index.h>
 #include <dyad/core/dyad_core.h>
+#include <dyad/core/dyad_mem_tier.h>
+#include <dyad/core/dyad_stripes.h>
 #include <dyad/dtl/dyad_dtl_api.h>
-#include <dyad/utils/murmur3.h>
+#include <dyad/utils/base64/base64.h>
+#include <dyad/utils/read_all.h>
 #include <dyad/utils/utils.h>
 #include <dyad/common/dyad_profiler.h>
 #include <fcntl.h>
 #include <libgen.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #ifdef __cplusplus
@@ -31,6 +40,13 @@
 #define DYAD_CORE_FUNC_MODS static inline
 #endif
 
+// Retries of a fetch turned down by a saturated module
+#define DYAD_BUSY_MAX_RETRIES 32u
+// Wait before a retry when the module gives no hint, in milliseconds
+#define DYAD_BUSY_DEFAULT_RETRY_MS 100u
+// Files up to this size are fetched in the RPC response by default
+#define DYAD_INLINE_DEFAULT_MAX 65536ul
+
 const struct dyad_ctx dyad_ctx_default = {
     NULL,   // h
     NULL,   // dtl_handle
@@ -48,52 +64,15 @@ const struct dyad_ctx dyad_ctx_default = {
     -1,     // pid
     NULL,   // kvs_namespace
     NULL,   // prod_managed_path
-    NULL    // cons_managed_path
+    NULL,   // cons_managed_path
+    NULL,   // mem_tier
+    NULL,   // cache_index
+    false,  // fetch_proxy
+    NULL,   // stripes
+    0ul,    // inline_max
+    0ul     // kvs_inline_max
 };
 
-static int gen_path_key (const char* str,
-                         char* path_key,
-                         const size_t len,
-                         const uint32_t depth,
-                         const uint32_t width)
-{
-    DYAD_C_FUNCTION_START();
-    static const uint32_t seeds[10] =
-        {104677u, 104681u, 104683u, 104693u, 104701u, 104707u, 104711u, 104717u, 104723u, 104729u};
-
-    uint32_t seed = 57u;
-    uint32_t hash[4] = {0u};  // Output for the hash
-    size_t cx = 0ul;
-    int n = 0;
-
-    if (path_key == NULL || len == 0ul) {
-        DYAD_C_FUNCTION_END();
-        return -1;
-    }
-    path_key[0] = '\0';
-
-    for (uint32_t d = 0u; d < depth; d++) {
-        seed += seeds[d % 10];
-        // TODO add assert that str is not NULL
-        MurmurHash3_x64_128 (str, strlen (str), seed, hash);
-        uint32_t bin = (hash[0] ^ hash[1] ^ hash[2] ^ hash[3]) % width;
-        n = snprintf (path_key + cx, len - cx, "%x.", bin);
-        cx += n;
-        if (cx >= len || n < 0) {
-            DYAD_C_FUNCTION_END();
-            return -1;
-        }
-    }
-    n = snprintf (path_key + cx, len - cx, "%s", str);
-    if (cx + n >= len || n < 0) {
-        DYAD_C_FUNCTION_END();
-        return -1;
-    }
-    DYAD_C_FUNCTION_UPDATE_STR ("path_key", path_key);
-    DYAD_C_FUNCTION_END();
-    return 0;
-}
-
 DYAD_CORE_FUNC_MODS dyad_rc_t dyad_kvs_commit (const dyad_ctx_t* ctx, flux_kvs_txn_t* txn)
 {
     DYAD_C_FUNCTION_START();
@@ -119,8 +98,72 @@ kvs_commit_region_finish:;
     return rc;
 }
 
+/// Read a file of at most ctx->kvs_inline_max bytes and encode its contents
+/// in base64, so that they can be published in its KVS entry. Returns NULL if
+/// the file is too large or cannot be read, in which case it is published
+/// without its contents.
+static char* dyad_kvs_inline_encode (const dyad_ctx_t* restrict ctx,
+                                     const char* restrict fname,
+                                     int64_t* size)
+{
+    void* buf = NULL;
+    char* enc = NULL;
+    ssize_t len = -1;
+    size_t enc_len = 0ul;
+    int fd = -1;
+    if (ctx->kvs_inline_max == 0ul || *size < 0 || (uint64_t)*size > ctx->kvs_inline_max) {
+        return NULL;
+    }
+    if ((fd = open (fname, O_RDONLY)) < 0) {
+        return NULL;
+    }
+    len = read_all (fd, &buf);
+    close (fd);
+    // The file may have changed since it was stat'ed
+    if (len < 0 || (size_t)len > ctx->kvs_inline_max) {
+        free (buf);
+        return NULL;
+    }
+    enc_len = base64_encoded_length ((size_t)len) + 1ul;
+    enc = (char*)malloc (enc_len);
+    if (enc == NULL || base64_encode (enc, enc_len, (const char*)buf, (size_t)len) < 0) {
+        free (enc);
+        enc = NULL;
+    } else {
+        *size = (int64_t)len;
+    }
+    free (buf);
+    return enc;
+}
+
+/// Decode the contents of a file published in its KVS entry into mdata
+static dyad_rc_t dyad_kvs_inline_decode (const dyad_ctx_t* restrict ctx,
+                                         const char* restrict enc,
+                                         dyad_metadata_t* restrict mdata)
+{
+    const size_t enc_len = strlen (enc);
+    const size_t max_len = base64_decoded_length (enc_len);
+    ssize_t len = -1;
+    mdata->data = (char*)malloc (max_len + 1ul);
+    if (mdata->data == NULL) {
+        return DYAD_RC_SYSFAIL;
+    }
+    len = base64_decode (mdata->data, max_len + 1ul, enc, enc_len);
+    if (len < 0 || (mdata->size >= 0 && len != mdata->size)) {
+        DYAD_LOG_ERROR (ctx, "Cannot decode the contents of %s from its KVS entry", mdata->fpath);
+        free (mdata->data);
+        mdata->data = NULL;
+        return DYAD_RC_BADMETADATA;
+    }
+    mdata->size = (int64_t)len;
+    return DYAD_RC_OK;
+}
+
 DYAD_CORE_FUNC_MODS dyad_rc_t publish_via_flux (const dyad_ctx_t* restrict ctx,
-                                                const char* restrict upath)
+                                                const char* restrict upath,
+                                                int64_t size,
+                                                uint64_t version,
+                                                const char* restrict data)
 {
     DYAD_C_FUNCTION_START();
     DYAD_C_FUNCTION_UPDATE_STR ("fname", ctx->fname);
@@ -138,7 +181,8 @@ DYAD_CORE_FUNC_MODS dyad_rc_t publish_via_flux (const dyad_ctx_t* restrict ctx,
     // Crete and pack a Flux KVS transaction.
     // The transaction will contain a single key-value pair
     // with the previously generated key as the key and the
-    // producer's rank as the value
+    // producer's rank, the size and the version of the file as the value,
+    // along with the contents of a tiny file
     DYAD_LOG_INFO (ctx, "Creating KVS transaction under the key %s", topic);
     txn = flux_kvs_txn_create ();
     if (txn == NULL) {
@@ -146,7 +190,15 @@ DYAD_CORE_FUNC_MODS dyad_rc_t publish_via_flux (const dyad_ctx_t* restrict ctx,
         rc = DYAD_RC_FLUXFAIL;
         goto publish_done;
     }
-    if (flux_kvs_txn_pack (txn, 0, topic, "i", ctx->rank) < 0) {
+    if ((data == NULL
+         && flux_kvs_txn_pack (txn, 0, topic, "{s:i, s:I, s:I}", "rank", (int)ctx->rank, "size",
+                               (json_int_t)size, "version", (json_int_t)version)
+                < 0)
+        || (data != NULL
+            && flux_kvs_txn_pack (txn, 0, topic, "{s:i, s:I, s:I, s:s}", "rank", (int)ctx->rank,
+                                  "size", (json_int_t)size, "version", (json_int_t)version,
+                                  "data", data)
+                   < 0)) {
         DYAD_LOG_ERROR (ctx, "Could not pack Flux KVS transaction");
         rc = DYAD_RC_FLUXFAIL;
         goto publish_done;
@@ -167,12 +219,30 @@ publish_done:;
     return rc;
 }
 
+/// Ask the kernel to read a produced file ahead, so that its pages are cached
+/// by the time the DYAD module sends it
+DYAD_CORE_FUNC_MODS void dyad_readahead (const dyad_ctx_t* restrict ctx, const char* restrict fname)
+{
+    int fd = open (fname, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (posix_fadvise (fd, 0, 0, POSIX_FADV_WILLNEED) != 0) {
+        DYAD_LOG_DEBUG (ctx, "Cannot read %s ahead", fname);
+    }
+    close (fd);
+}
+
 DYAD_CORE_FUNC_MODS dyad_rc_t dyad_commit (dyad_ctx_t* restrict ctx, const char* restrict fname)
 {
     DYAD_C_FUNCTION_START();
     DYAD_C_FUNCTION_UPDATE_STR ("fname", ctx->fname);
     dyad_rc_t rc = DYAD_RC_OK;
     char upath[PATH_MAX] = {'\0'};
+    struct stat st;
+    int64_t size = -1;
+    uint64_t version = 0ull;
+    char* data = NULL;
     memset (upath, 0, PATH_MAX);
     // Extract the path to the file specified by fname relative to the
     // producer-managed path
@@ -189,7 +259,18 @@ DYAD_CORE_FUNC_MODS dyad_rc_t dyad_commit (dyad_ctx_t* restrict ctx, const char*
     // Fence this call with reassignments of reenter so that, if intercepting
     // file I/O API calls, we will not get stuck in infinite recursion
     ctx->reenter = false;
-    rc = publish_via_flux (ctx, upath);
+    // Consumers fetch small files in a single round trip if they know the size
+    if (stat (fname, &st) == 0) {
+        size = (int64_t)st.st_size;
+        version = get_file_version (&st);
+    }
+    // Consumers of tiny files need neither an RPC nor the DTL
+    data = dyad_kvs_inline_encode (ctx, fname, &size);
+    rc = publish_via_flux (ctx, upath, size, version, data);
+    if (rc == DYAD_RC_OK && data == NULL && size > 0) {
+        dyad_readahead (ctx, fname);
+    }
+    free (data);
     ctx->reenter = true;
 
 commit_done:;
@@ -211,6 +292,9 @@ static void print_mdata (const dyad_ctx_t* restrict ctx,
         DYAD_LOG_INFO (ctx, "Printing contents of DYAD Metadata object");
         DYAD_LOG_INFO (ctx, "fpath = %s", mdata->fpath);
         DYAD_LOG_INFO (ctx, "owner_rank = %u", mdata->owner_rank);
+        DYAD_LOG_INFO (ctx, "size = %ld", (long)mdata->size);
+        DYAD_LOG_INFO (ctx, "version = %lu", (unsigned long)mdata->version);
+        DYAD_LOG_INFO (ctx, "data in KVS entry = %s", (mdata->data != NULL) ? "yes" : "no");
     }
 }
 
@@ -224,6 +308,9 @@ DYAD_CORE_FUNC_MODS dyad_rc_t dyad_kvs_read (const dyad_ctx_t* restrict ctx,
     DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
     dyad_rc_t rc = DYAD_RC_OK;
     int kvs_lookup_flags = 0;
+    json_int_t size = -1;
+    json_int_t version = 0;
+    const char* data = NULL;
     flux_future_t* f = NULL;
     if (mdata == NULL) {
         DYAD_LOG_ERROR (ctx,
@@ -257,6 +344,7 @@ DYAD_CORE_FUNC_MODS dyad_rc_t dyad_kvs_read (const dyad_ctx_t* restrict ctx,
             goto kvs_read_end;
         }
     }
+    (*mdata)->data = NULL;
     size_t upath_len = strlen (upath);
     (*mdata)->fpath = (char*)malloc (upath_len + 1);
     if ((*mdata)->fpath == NULL) {
@@ -266,7 +354,22 @@ DYAD_CORE_FUNC_MODS dyad_rc_t dyad_kvs_read (const dyad_ctx_t* restrict ctx,
     }
     memset ((*mdata)->fpath, '\0', upath_len + 1);
     strncpy ((*mdata)->fpath, upath, upath_len);
-    rc = flux_kvs_lookup_get_unpack (f, "i", &((*mdata)->owner_rank));
+    (*mdata)->size = -1;
+    (*mdata)->version = 0ull;
+    rc = flux_kvs_lookup_get_unpack (f, "{s:i, s?I, s?I, s?s}", "rank",
+                                     &((*mdata)->owner_rank), "size", &size, "version",
+                                     &version, "data", &data);
+    if (rc == 0) {
+        (*mdata)->size = (int64_t)size;
+        (*mdata)->version = (uint64_t)version;
+        if (data != NULL && DYAD_IS_ERROR (dyad_kvs_inline_decode (ctx, data, *mdata))) {
+            rc = DYAD_RC_BADMETADATA;
+            goto kvs_read_end;
+        }
+    } else {
+        // Entries published by older producers only hold the rank
+        rc = flux_kvs_lookup_get_unpack (f, "i", &((*mdata)->owner_rank));
+    }
     // If the extraction did not work, log an error and return DYAD_BADFETCH
     if (rc < 0) {
         DYAD_LOG_ERROR (ctx, "Could not unpack owner's rank from KVS response\n");
@@ -359,32 +462,147 @@ fetch_done:;
     return rc;
 }
 
-DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_data (const dyad_ctx_t* ctx,
-                                             const dyad_metadata_t* restrict mdata,
-                                             char** file_data,
-                                             size_t* file_len)
+/// Ask the DYAD module of the local broker to fetch a file on our behalf.
+/// The module fetches each file once from its owner and serves all the
+/// processes of the node from its copy. It answers with the size of the file,
+/// then with its contents in one or more messages.
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_data_via_proxy (const dyad_ctx_t* ctx,
+                                                       const dyad_metadata_t* restrict mdata,
+                                                       char** file_data,
+                                                       size_t* file_len)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("fpath", mdata->fpath);
+    dyad_rc_t rc = DYAD_RC_OK;
+    const void* data = NULL;
+    int data_len = 0;
+    json_int_t size = 0;
+    size_t off = 0ul;
+    flux_future_t* f = NULL;
+    DYAD_LOG_INFO (ctx, "Sending proxy request for %s to the local DYAD module", mdata->fpath);
+    // The size and version let the proxy tell its copy of an older version
+    // of the file from the current one
+    f = flux_rpc_pack (ctx->h,
+                       DYAD_PROXY_RPC_NAME,
+                       FLUX_NODEID_ANY,
+                       FLUX_RPC_STREAMING,
+                       "{s:s, s:i, s:I, s:I}",
+                       "upath",
+                       mdata->fpath,
+                       "owner_rank",
+                       (int)mdata->owner_rank,
+                       "size",
+                       (json_int_t)mdata->size,
+                       "version",
+                       (json_int_t)mdata->version);
+    if (f == NULL) {
+        DYAD_LOG_ERROR (ctx, "Cannot send proxy request to the local DYAD module\n");
+        rc = DYAD_RC_BADRPC;
+        goto get_proxy_done;
+    }
+    if (flux_rpc_get_unpack (f, "{s:I}", "size", &size) < 0 || size < 0) {
+        if (errno == ENOSYS) {
+            DYAD_LOG_INFO (ctx, "The local DYAD module does not act as a fetch proxy");
+            rc = DYAD_RC_NOSERVICE;
+        } else {
+            DYAD_LOG_ERROR (ctx, "The fetch proxy failed to get %s (errno = %d)",
+                            mdata->fpath, errno);
+            rc = DYAD_RC_BADRPC;
+        }
+        goto get_proxy_done;
+    }
+    rc = ctx->dtl_handle->get_buffer (ctx, (size_t)size, (void**)file_data);
+    if (DYAD_IS_ERROR (rc)) {
+        goto get_proxy_done;
+    }
+    while (off < (size_t)size) {
+        flux_future_reset (f);
+        if (flux_rpc_get_raw (f, &data, &data_len) < 0 || data_len <= 0
+            || (size_t)data_len > (size_t)size - off) {
+            DYAD_LOG_ERROR (ctx, "The fetch proxy failed to send %s (errno = %d)",
+                            mdata->fpath, errno);
+            rc = DYAD_RC_BADRPC;
+            goto get_proxy_error;
+        }
+        memcpy (*file_data + off, data, (size_t)data_len);
+        off += (size_t)data_len;
+    }
+    *file_len = (size_t)size;
+    flux_future_reset (f);
+    if (!(flux_rpc_get (f, NULL) < 0 && errno == ENODATA)) {
+        DYAD_LOG_ERROR (ctx, "The fetch proxy did not end the stream (errno = %d)", errno);
+        rc = DYAD_RC_BADRPC;
+        goto get_proxy_error;
+    }
+    DYAD_C_FUNCTION_UPDATE_INT ("file_len", *file_len);
+    rc = DYAD_RC_OK;
+    goto get_proxy_done;
+
+get_proxy_error:;
+    ctx->dtl_handle->return_buffer (ctx, (void**)file_data);
+    *file_len = 0ul;
+
+get_proxy_done:;
+    flux_future_destroy (f);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Fetch a file from the DYAD module of its owner. If the module is saturated
+/// and turns the request down, DYAD_RC_BUSY is returned and retry_ms is set to
+/// the time after which the module suggests to retry. A DTL that can name its
+/// connection to a module it already served sends a compact request, and
+/// sends the request again in full if the module turns it down.
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_data_from_owner (const dyad_ctx_t* ctx,
+                                                        const dyad_metadata_t* restrict mdata,
+                                                        char** file_data,
+                                                        size_t* file_len,
+                                                        unsigned int* retry_ms)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
     flux_future_t* f;
     json_t* rpc_payload;
-    DYAD_LOG_INFO (ctx, "Packing payload for RPC to DYAD module");
+    const void* raw_payload = NULL;
+    size_t raw_len = 0ul;
+    bool compact = (ctx->dtl_handle->rpc_pack_raw != NULL);
+    const char* errstr = NULL;
     DYAD_C_FUNCTION_UPDATE_INT ("owner_rank", mdata->owner_rank);
     DYAD_C_FUNCTION_UPDATE_STR ("fpath", mdata->fpath);
-    rc = ctx->dtl_handle->rpc_pack (ctx, mdata->fpath, mdata->owner_rank, &rpc_payload);
-    if (DYAD_IS_ERROR (rc)) {
-        DYAD_LOG_ERROR (ctx,
-                      "Cannot create JSON payload for Flux RPC to DYAD "
-                      "module\n");
-        goto get_done;
+send_request:;
+    if (compact
+        && !DYAD_IS_ERROR (ctx->dtl_handle->rpc_pack_raw (ctx, mdata->fpath, mdata->owner_rank,
+                                                          mdata->size, &raw_payload, &raw_len))) {
+        DYAD_LOG_INFO (ctx, "Sending compact RPC to DYAD module");
+        f = flux_rpc_raw (ctx->h,
+                          DYAD_FETCH_RAW_RPC_NAME,
+                          raw_payload,
+                          (int)raw_len,
+                          mdata->owner_rank,
+                          FLUX_RPC_STREAMING);
+    } else {
+        compact = false;
+        DYAD_LOG_INFO (ctx, "Packing payload for RPC to DYAD module");
+        rc = ctx->dtl_handle->rpc_pack (ctx, mdata->fpath, mdata->owner_rank, &rpc_payload);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx,
+                          "Cannot create JSON payload for Flux RPC to DYAD "
+                          "module\n");
+            goto get_done;
+        }
+        // The module schedules the fetch by this size before it looks at the
+        // file. A module that cannot add it estimates the size instead.
+        if (mdata->size >= 0) {
+            json_object_set_new (rpc_payload, "size", json_integer ((json_int_t)mdata->size));
+        }
+        DYAD_LOG_INFO (ctx, "Sending payload for RPC to DYAD module");
+        f = flux_rpc_pack (ctx->h,
+                           DYAD_DTL_RPC_NAME,
+                           mdata->owner_rank,
+                           FLUX_RPC_STREAMING,
+                           "o",
+                           rpc_payload);
     }
-    DYAD_LOG_INFO (ctx, "Sending payload for RPC to DYAD module");
-    f = flux_rpc_pack (ctx->h,
-                       DYAD_DTL_RPC_NAME,
-                       mdata->owner_rank,
-                       FLUX_RPC_STREAMING,
-                       "o",
-                       rpc_payload);
     if (f == NULL) {
         DYAD_LOG_ERROR (ctx, "Cannot send RPC to producer module\n");
         rc = DYAD_RC_BADRPC;
@@ -392,6 +610,12 @@ DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_data (const dyad_ctx_t* ctx,
     }
     DYAD_LOG_INFO (ctx, "Receive RPC response from DYAD module");
     rc = ctx->dtl_handle->rpc_recv_response (ctx, f);
+    if (rc == DYAD_RC_NOTCONN && compact) {
+        DYAD_LOG_INFO (ctx, "Sending the request to broker %u again in full", mdata->owner_rank);
+        flux_future_destroy (f);
+        compact = false;
+        goto send_request;
+    }
     if (DYAD_IS_ERROR (rc)) {
         DYAD_LOG_ERROR (ctx, "Cannot receive and/or parse the RPC response\n");
         goto get_done;
@@ -422,14 +646,24 @@ get_done:;
     // DTL:
     //  * DYAD_RC_RPC_FINISHED: occurs when an ENODATA error occurs
     //  * DYAD_RC_BADRPC: occurs when a previous RPC operation fails
+    //  * DYAD_RC_BUSY: occurs when the module turns the request down
     // In either of these cases, we do not need to wait for the end of stream
     // because the RPC is already completely messed up. If we do not have either
     // of these cases, we will wait for one more RPC message. If everything went
     // well in the module, this last message will set errno to ENODATA (i.e.,
     // end of stream). Otherwise, something went wrong, so we'll return
     // DYAD_RC_BADRPC.
+    // A request turned down by the module is finished too
+    if (rc == DYAD_RC_BUSY) {
+        errstr = flux_future_error_string (f);
+        if (errstr == NULL || sscanf (errstr, DYAD_RETRY_AFTER_FMT, retry_ms) != 1) {
+            *retry_ms = DYAD_BUSY_DEFAULT_RETRY_MS;
+        }
+        DYAD_LOG_INFO (ctx, "The module of broker %u is busy, retrying in %u ms",
+                       mdata->owner_rank, *retry_ms);
+    }
     DYAD_LOG_INFO (ctx, "Wait for end-of-stream message from module (current RC = %d)\n", rc);
-    if (rc != DYAD_RC_RPC_FINISHED && rc != DYAD_RC_BADRPC) {
+    if (rc != DYAD_RC_RPC_FINISHED && rc != DYAD_RC_BADRPC && rc != DYAD_RC_BUSY) {
         if (!(flux_rpc_get (f, NULL) < 0 && errno == ENODATA)) {
             DYAD_LOG_ERROR (ctx,
                           "An error occured at end of getting data! Either the "
@@ -445,6 +679,118 @@ get_done:;
     return rc;
 }
 
+/// Fetch a small file in the response to a single RPC to the DYAD module of
+/// its owner, without a DTL transfer. DYAD_RC_NOSERVICE is returned if the
+/// module does not serve the file that way, in which case it must be fetched
+/// through the DTL. DYAD_RC_BUSY is returned as in dyad_get_data_from_owner.
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_data_inline (const dyad_ctx_t* ctx,
+                                                    const dyad_metadata_t* restrict mdata,
+                                                    char** file_data,
+                                                    size_t* file_len,
+                                                    unsigned int* retry_ms)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_INT ("owner_rank", mdata->owner_rank);
+    DYAD_C_FUNCTION_UPDATE_STR ("fpath", mdata->fpath);
+    dyad_rc_t rc = DYAD_RC_OK;
+    flux_future_t* f = NULL;
+    const void* data = NULL;
+    int data_len = 0;
+    const char* errstr = NULL;
+    f = flux_rpc_pack (ctx->h, DYAD_INLINE_RPC_NAME, mdata->owner_rank, 0, "{s:s}", "upath",
+                       mdata->fpath);
+    if (f == NULL) {
+        DYAD_LOG_ERROR (ctx, "Cannot send inline fetch request to producer module\n");
+        rc = DYAD_RC_BADRPC;
+        goto get_inline_done;
+    }
+    if (flux_rpc_get_raw (f, &data, &data_len) < 0) {
+        if (errno == ENOSYS || errno == EFBIG) {
+            // An older module, or a module with a lower threshold
+            DYAD_LOG_INFO (ctx, "The module of broker %u does not send %s inline",
+                           mdata->owner_rank, mdata->fpath);
+            rc = DYAD_RC_NOSERVICE;
+        } else if (errno == EAGAIN) {
+            errstr = flux_future_error_string (f);
+            if (errstr == NULL || sscanf (errstr, DYAD_RETRY_AFTER_FMT, retry_ms) != 1) {
+                *retry_ms = DYAD_BUSY_DEFAULT_RETRY_MS;
+            }
+            rc = DYAD_RC_BUSY;
+        } else {
+            DYAD_LOG_ERROR (ctx, "Inline fetch of %s failed (errno = %d)", mdata->fpath, errno);
+            rc = DYAD_RC_BADRPC;
+        }
+        goto get_inline_done;
+    }
+    rc = ctx->dtl_handle->get_buffer (ctx, (size_t)data_len, (void**)file_data);
+    if (DYAD_IS_ERROR (rc)) {
+        goto get_inline_done;
+    }
+    if (data_len > 0)
+        memcpy (*file_data, data, (size_t)data_len);
+    *file_len = (size_t)data_len;
+    DYAD_C_FUNCTION_UPDATE_INT ("file_len", *file_len);
+    rc = DYAD_RC_OK;
+
+get_inline_done:;
+    flux_future_destroy (f);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_data (const dyad_ctx_t* ctx,
+                                             const dyad_metadata_t* restrict mdata,
+                                             char** file_data,
+                                             size_t* file_len)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    unsigned int retry_ms = 0u;
+    unsigned int attempt = 0u;
+    bool fetch_inline = (mdata->size >= 0 && (uint64_t)mdata->size <= (uint64_t)ctx->inline_max
+                         && ctx->inline_max > 0ul);
+    // The contents of a tiny file came with its KVS entry
+    if (mdata->data != NULL) {
+        rc = ctx->dtl_handle->get_buffer (ctx, (size_t)mdata->size, (void**)file_data);
+        if (!DYAD_IS_ERROR (rc)) {
+            memcpy (*file_data, mdata->data, (size_t)mdata->size);
+            *file_len = (size_t)mdata->size;
+        }
+        DYAD_C_FUNCTION_END();
+        return rc;
+    }
+    if (ctx->fetch_proxy) {
+        rc = dyad_get_data_via_proxy (ctx, mdata, file_data, file_len);
+        if (!DYAD_IS_ERROR (rc)) {
+            DYAD_C_FUNCTION_END();
+            return rc;
+        }
+        // Without a working proxy on the local broker, fetch from the owner
+        // directly
+        if (rc != DYAD_RC_NOSERVICE) {
+            DYAD_LOG_INFO (ctx, "Fetching %s from its owner after the proxy failed", mdata->fpath);
+        }
+    }
+    // Honor the retry-after hints of a saturated module, a bounded number of
+    // times
+    for (attempt = 0u;; attempt++) {
+        if (fetch_inline) {
+            rc = dyad_get_data_inline (ctx, mdata, file_data, file_len, &retry_ms);
+            fetch_inline = (rc != DYAD_RC_NOSERVICE);
+        }
+        if (!fetch_inline) {
+            rc = dyad_get_data_from_owner (ctx, mdata, file_data, file_len, &retry_ms);
+        }
+        if (rc != DYAD_RC_BUSY || attempt >= DYAD_BUSY_MAX_RETRIES) {
+            break;
+        }
+        usleep ((useconds_t)retry_ms * 1000u);
+    }
+    DYAD_C_FUNCTION_UPDATE_INT ("attempts", attempt + 1u);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
 DYAD_CORE_FUNC_MODS dyad_rc_t dyad_cons_store (const dyad_ctx_t* restrict ctx,
                                                const dyad_metadata_t* restrict mdata,
                                                int fd, const size_t data_len,
@@ -500,6 +846,424 @@ pull_done:;
     return rc;
 }
 
+/// Check whether the copy of fname at fpath on node-local storage can be used
+/// without fetching the file again. Without a cache index, any non-empty copy
+/// is trusted. The version published by the producer is compared with the one
+/// recorded for the copy unless it is 0 (not known yet).
+DYAD_CORE_FUNC_MODS bool dyad_cached_copy_is_valid (const dyad_ctx_t* restrict ctx,
+                                                    const char* restrict fname,
+                                                    const char* restrict fpath,
+                                                    ssize_t file_size,
+                                                    uint64_t version)
+{
+    char upath[PATH_MAX] = {'\0'};
+    if (file_size <= 0)
+        return false;
+    if (ctx->cache_index == NULL
+        || !cmp_canonical_path_prefix (ctx->cons_managed_path, fname, upath, PATH_MAX))
+        return true;
+    return dyad_cache_index_is_valid (ctx, ctx->cache_index, upath, fpath, (size_t)file_size,
+                                      version);
+}
+
+/// Mark the copy of fname as incomplete in the cache index before rewriting it
+DYAD_CORE_FUNC_MODS void dyad_cached_copy_invalidate (const dyad_ctx_t* restrict ctx,
+                                                      const char* restrict fname)
+{
+    char upath[PATH_MAX] = {'\0'};
+    if (ctx->cache_index != NULL
+        && cmp_canonical_path_prefix (ctx->cons_managed_path, fname, upath, PATH_MAX))
+        dyad_cache_index_invalidate (ctx, ctx->cache_index, upath);
+}
+
+/// Record a complete and flushed copy of fname in the cache index
+DYAD_CORE_FUNC_MODS void dyad_cached_copy_record (const dyad_ctx_t* restrict ctx,
+                                                  const char* restrict fname,
+                                                  const void* data,
+                                                  size_t data_len,
+                                                  uint64_t version,
+                                                  uint32_t flags)
+{
+    char upath[PATH_MAX] = {'\0'};
+    if (ctx->cache_index != NULL
+        && cmp_canonical_path_prefix (ctx->cons_managed_path, fname, upath, PATH_MAX))
+        dyad_cache_index_record (ctx, ctx->cache_index, upath, data, data_len, version, flags);
+}
+
+/// Make fname a link to target. The link is created under a temporary name
+/// and renamed into place, so fname never disappears for concurrent readers.
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_link_into_place (const dyad_ctx_t* restrict ctx,
+                                                    const char* restrict target,
+                                                    const char* restrict fname)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char link_tmp[PATH_MAX + 1] = {'\0'};
+    if (snprintf (link_tmp, PATH_MAX, "%s.dyad_link.%d", fname, ctx->pid) >= PATH_MAX) {
+        rc = DYAD_RC_BADFIO;
+        goto link_done;
+    }
+    unlink (link_tmp);
+    if (symlink (target, link_tmp) != 0 || rename (link_tmp, fname) != 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot link %s to %s", fname, target);
+        unlink (link_tmp);
+        rc = DYAD_RC_BADFIO;
+        goto link_done;
+    }
+    rc = DYAD_RC_OK;
+link_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Store data that does not fit in the memory tier directly at fname on the
+/// consumer-managed path
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_store_into_place (const dyad_ctx_t* restrict ctx,
+                                                     const dyad_metadata_t* restrict mdata,
+                                                     const char* restrict fname,
+                                                     const size_t data_len,
+                                                     char* restrict file_data)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char store_tmp[PATH_MAX + 1] = {'\0'};
+    int fd = -1;
+    if (snprintf (store_tmp, PATH_MAX, "%s.dyad_store.%d", fname, ctx->pid) >= PATH_MAX) {
+        rc = DYAD_RC_BADFIO;
+        goto store_done;
+    }
+    fd = open (store_tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        rc = DYAD_RC_BADFIO;
+        goto store_done;
+    }
+    rc = dyad_cons_store (ctx, mdata, fd, data_len, file_data);
+    if (DYAD_IS_ERROR (rc) || fsync (fd) != 0 || rename (store_tmp, fname) != 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot store %s on the consumer-managed path", fname);
+        unlink (store_tmp);
+        rc = DYAD_RC_BADFIO;
+        goto store_done;
+    }
+    rc = DYAD_RC_OK;
+store_done:;
+    if (fd != -1)
+        close (fd);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Build the path of the copy that a link at the consumer-managed path points
+/// to: in the memory tier if there is one, in one of the stripe directories
+/// otherwise
+DYAD_CORE_FUNC_MODS bool dyad_backing_path (const dyad_ctx_t* restrict ctx,
+                                            const char* restrict upath,
+                                            char* restrict path,
+                                            size_t len)
+{
+    if (ctx->mem_tier != NULL)
+        return dyad_mem_tier_path (ctx->mem_tier, upath, path, len);
+    return dyad_stripes_path (ctx->stripes, upath, path, len);
+}
+
+/// Store data that does not fit in the memory tier in its stripe directory and
+/// link fname to it, or directly at fname if the cache is not striped
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_store_bypassing_mem_tier (const dyad_ctx_t* restrict ctx,
+                                                             const dyad_metadata_t* restrict mdata,
+                                                             const char* restrict fname,
+                                                             const size_t data_len,
+                                                             char* restrict file_data)
+{
+    dyad_rc_t rc = DYAD_RC_OK;
+    char stripe_path[PATH_MAX + 1] = {'\0'};
+    char stripe_dir[PATH_MAX + 1] = {'\0'};
+    mode_t m = (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH | S_ISGID);
+    if (ctx->stripes == NULL) {
+        return dyad_store_into_place (ctx, mdata, fname, data_len, file_data);
+    }
+    if (!dyad_stripes_path (ctx->stripes, mdata->fpath, stripe_path, PATH_MAX)) {
+        return DYAD_RC_BADFIO;
+    }
+    strncpy (stripe_dir, stripe_path, PATH_MAX);
+    if (mkdir_as_needed (dirname (stripe_dir), m) < 0) {
+        return DYAD_RC_BADFIO;
+    }
+    rc = dyad_store_into_place (ctx, mdata, stripe_path, data_len, file_data);
+    if (DYAD_IS_ERROR (rc)) {
+        return rc;
+    }
+    return dyad_link_into_place (ctx, stripe_path, fname);
+}
+
+/// Consume fname through a copy outside the consumer-managed path, in the
+/// memory tier of the consumer cache or in a stripe directory. The fetched
+/// data is written into that copy and fname becomes a link to it.
+/// If mdata is NULL, the metadata is looked up as in dyad_consume.
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_consume_via_link (dyad_ctx_t* restrict ctx,
+                                                     const char* restrict fname,
+                                                     const dyad_metadata_t* restrict in_mdata)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("fname", fname);
+    dyad_rc_t rc = DYAD_RC_OK;
+    int fd = -1;
+    ssize_t file_size = -1;
+    char* file_data = NULL;
+    size_t data_len = 0ul;
+    dyad_metadata_t* mdata = NULL;
+    const dyad_metadata_t* used_mdata = in_mdata;
+    const uint64_t version = (in_mdata != NULL) ? in_mdata->version : 0ull;
+    char upath[PATH_MAX] = {'\0'};
+    char backing_path[PATH_MAX + 1] = {'\0'};
+    char backing_dir[PATH_MAX + 1] = {'\0'};
+    struct stat st;
+    struct flock exclusive_lock;
+    mode_t m = (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH | S_ISGID);
+
+    if (!cmp_canonical_path_prefix (ctx->cons_managed_path, fname, upath, PATH_MAX)) {
+        DYAD_LOG_INFO (ctx, "%s is not in the Consumer's managed path\n", fname);
+        rc = DYAD_RC_OK;
+        goto link_consume_done;
+    }
+    // A regular file means the data has been stored on, or demoted to, the
+    // consumer-managed path. A link means it is in the memory tier or in a
+    // stripe directory.
+    if (lstat (fname, &st) == 0) {
+        if (S_ISREG (st.st_mode)
+            && dyad_cached_copy_is_valid (ctx, fname, fname, st.st_size, version)) {
+            rc = DYAD_RC_OK;
+            goto link_consume_done;
+        }
+        if (S_ISLNK (st.st_mode) && stat (fname, &st) == 0
+            && dyad_cached_copy_is_valid (ctx, fname, fname, st.st_size, version)) {
+            if (ctx->mem_tier != NULL)
+                dyad_mem_tier_touch (ctx->mem_tier, upath);
+            rc = DYAD_RC_OK;
+            goto link_consume_done;
+        }
+    }
+    if (!dyad_backing_path (ctx, upath, backing_path, PATH_MAX)) {
+        DYAD_LOG_ERROR (ctx, "Backing path of %s is too long", upath);
+        rc = DYAD_RC_BADFIO;
+        goto link_consume_done;
+    }
+    strncpy (backing_dir, backing_path, PATH_MAX);
+    if (mkdir_as_needed (dirname (backing_dir), m) < 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot create backing directories for %s", backing_path);
+        rc = DYAD_RC_BADFIO;
+        goto link_consume_done;
+    }
+    fd = open (backing_path, O_RDWR | O_CREAT, 0666);
+    if (fd == -1) {
+        DYAD_LOG_ERROR (ctx, "Cannot create the backing file (%s)!\n", backing_path);
+        rc = DYAD_RC_BADFIO;
+        goto link_consume_done;
+    }
+    rc = dyad_excl_flock (ctx, fd, &exclusive_lock);
+    if (DYAD_IS_ERROR (rc)) {
+        goto link_consume_unlock;
+    }
+    file_size = get_file_size (fd);
+    if (dyad_cached_copy_is_valid (ctx, fname, backing_path, file_size, version)) {
+        // Another process on this node fetched the file while we waited
+        if (lstat (fname, &st) != 0 || !S_ISLNK (st.st_mode))
+            rc = dyad_link_into_place (ctx, backing_path, fname);
+        goto link_consume_unlock;
+    }
+    if (lstat (fname, &st) == 0 && S_ISREG (st.st_mode)
+        && dyad_cached_copy_is_valid (ctx, fname, fname, st.st_size, version)) {
+        // The file was demoted while we waited, so drop the empty copy
+        unlink (backing_path);
+        rc = DYAD_RC_OK;
+        goto link_consume_unlock;
+    }
+    if (used_mdata == NULL) {
+        rc = dyad_fetch (ctx, fname, &mdata);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "dyad_fetch failed!\n");
+            goto link_consume_unlock;
+        }
+        if (mdata == NULL) {
+            DYAD_LOG_INFO (ctx, "File '%s' is local!\n", fname);
+            unlink (backing_path);
+            rc = DYAD_RC_OK;
+            goto link_consume_unlock;
+        }
+        used_mdata = mdata;
+    }
+    rc = dyad_get_data (ctx, used_mdata, &file_data, &data_len);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "dyad_get_data failed!\n");
+        goto link_consume_unlock;
+    }
+    DYAD_C_FUNCTION_UPDATE_INT ("data_len", data_len);
+    dyad_cached_copy_invalidate (ctx, fname);
+    if (ctx->mem_tier != NULL && !dyad_mem_tier_fits (ctx->mem_tier, data_len)) {
+        DYAD_LOG_INFO (ctx, "%s (%zu bytes) bypasses the memory tier", fname, data_len);
+        rc = dyad_store_bypassing_mem_tier (ctx, used_mdata, fname, data_len, file_data);
+        unlink (backing_path);
+        if (!DYAD_IS_ERROR (rc))
+            dyad_cached_copy_record (ctx, fname, file_data, data_len, used_mdata->version, 0u);
+        goto link_consume_unlock;
+    }
+    // Drop whatever an interrupted consume left in the backing file
+    if (file_size > 0 && ftruncate (fd, 0) != 0) {
+        rc = DYAD_RC_BADFIO;
+        goto link_consume_unlock;
+    }
+    rc = dyad_cons_store (ctx, used_mdata, fd, data_len, file_data);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "dyad_cons_store failed!\n");
+        goto link_consume_unlock;
+    }
+    rc = dyad_link_into_place (ctx, backing_path, fname);
+    if (DYAD_IS_ERROR (rc)) {
+        goto link_consume_unlock;
+    }
+    dyad_cached_copy_record (ctx, fname, file_data, data_len, used_mdata->version, 0u);
+    if (ctx->mem_tier != NULL)
+        rc = dyad_mem_tier_admit (ctx, ctx->mem_tier, upath, data_len);
+
+link_consume_unlock:;
+    dyad_release_flock (ctx, fd, &exclusive_lock);
+link_consume_done:;
+    if (fd != -1)
+        close (fd);
+    if (mdata != NULL)
+        dyad_free_metadata (&mdata);
+    if (file_data != NULL)
+        ctx->dtl_handle->return_buffer (ctx, (void**)&file_data);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_init_mem_tier (dyad_ctx_t* ctx)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char* e = NULL;
+    const char* mem_tier_path = NULL;
+    size_t mem_tier_budget = DYAD_MEM_TIER_DEFAULT_BUDGET;
+
+    if ((e = getenv (DYAD_MEM_TIER_PATH_ENV))) {
+        mem_tier_path = e;
+    } else {
+        rc = DYAD_RC_OK;
+        goto init_mem_tier_done;
+    }
+    if ((e = getenv (DYAD_MEM_TIER_BUDGET_ENV))) {
+        mem_tier_budget = strtoull (e, NULL, 10);
+    } else {
+        mem_tier_budget = DYAD_MEM_TIER_DEFAULT_BUDGET;
+    }
+    rc = dyad_mem_tier_init (ctx, mem_tier_path, mem_tier_budget, &(ctx->mem_tier));
+
+init_mem_tier_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_init_cache_index (dyad_ctx_t* ctx)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char* e = NULL;
+    const char* index_path = NULL;
+    uint32_t index_slots = DYAD_CACHE_INDEX_DEFAULT_SLOTS;
+    bool index_checksum = false;
+
+    if ((e = getenv (DYAD_CACHE_INDEX_PATH_ENV))) {
+        index_path = e;
+    } else {
+        rc = DYAD_RC_OK;
+        goto init_cache_index_done;
+    }
+    if ((e = getenv (DYAD_CACHE_INDEX_SLOTS_ENV))) {
+        index_slots = (uint32_t)strtoul (e, NULL, 10);
+    } else {
+        index_slots = DYAD_CACHE_INDEX_DEFAULT_SLOTS;
+    }
+    if ((e = getenv (DYAD_CACHE_CHECKSUM_ENV))) {
+        index_checksum = true;
+    } else {
+        index_checksum = false;
+    }
+    rc = dyad_cache_index_open (ctx, index_path, index_slots, index_checksum, &(ctx->cache_index));
+
+init_cache_index_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_init_stripes (dyad_ctx_t* ctx)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char* e = NULL;
+    const char* stripe_dirs = NULL;
+    enum dyad_stripe_policy stripe_policy = DYAD_STRIPE_HASH;
+
+    if ((e = getenv (DYAD_STRIPE_DIRS_ENV))) {
+        stripe_dirs = e;
+    } else {
+        rc = DYAD_RC_OK;
+        goto init_stripes_done;
+    }
+    if ((e = getenv (DYAD_STRIPE_POLICY_ENV)) && strcmp (e, "capacity") == 0) {
+        stripe_policy = DYAD_STRIPE_CAPACITY;
+    } else {
+        stripe_policy = DYAD_STRIPE_HASH;
+    }
+    rc = dyad_stripes_init (ctx, stripe_dirs, stripe_policy, &(ctx->stripes));
+
+init_stripes_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Register with the modules listed in DYAD_PRECONNECT: either "all" or a
+/// comma-separated list of broker ranks
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_init_preconnect (dyad_ctx_t* ctx)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char* e = NULL;
+    char* list = NULL;
+    char* saveptr = NULL;
+    char* tok = NULL;
+    uint32_t* ranks = NULL;
+    size_t nranks = 1ul;
+    size_t i = 0ul;
+
+    if ((e = getenv (DYAD_PRECONNECT_ENV)) == NULL || strlen (e) == 0) {
+        rc = DYAD_RC_OK;
+        goto init_preconnect_done;
+    }
+    if (strcmp (e, "all") == 0) {
+        rc = dyad_preconnect (ctx, NULL, 0ul);
+        goto init_preconnect_done;
+    }
+    for (i = 0ul; e[i] != '\0'; i++) {
+        if (e[i] == ',')
+            nranks++;
+    }
+    list = strdup (e);
+    ranks = (uint32_t*)calloc (nranks, sizeof (uint32_t));
+    if (list == NULL || ranks == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto init_preconnect_done;
+    }
+    nranks = 0ul;
+    for (tok = strtok_r (list, ",", &saveptr); tok != NULL; tok = strtok_r (NULL, ",", &saveptr))
+        ranks[nranks++] = (uint32_t)strtoul (tok, NULL, 10);
+    rc = dyad_preconnect (ctx, ranks, nranks);
+
+init_preconnect_done:;
+    free (ranks);
+    free (list);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
 dyad_rc_t dyad_init (bool debug,
                      bool check,
                      bool shared_storage,
@@ -523,6 +1287,7 @@ dyad_rc_t dyad_init (bool debug,
 #endif
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
+    char* e = NULL;
     // If ctx is NULL, we won't be able to return a dyad_ctx_t
     // to the user. In that case, print an error and return
     // immediately with DYAD_NOCTX.
@@ -575,6 +1340,17 @@ dyad_rc_t dyad_init (bool debug,
     (*ctx)->shared_storage = shared_storage;
     (*ctx)->key_depth = key_depth;
     (*ctx)->key_bins = key_bins;
+    (*ctx)->fetch_proxy = (getenv (DYAD_FETCH_PROXY_ENV) != NULL);
+    if ((e = getenv (DYAD_INLINE_MAX_ENV))) {
+        (*ctx)->inline_max = (size_t)strtoull (e, NULL, 10);
+    } else {
+        (*ctx)->inline_max = DYAD_INLINE_DEFAULT_MAX;
+    }
+    if ((e = getenv (DYAD_KVS_INLINE_MAX_ENV))) {
+        (*ctx)->kvs_inline_max = (size_t)strtoull (e, NULL, 10);
+    } else {
+        (*ctx)->kvs_inline_max = 0ul;
+    }
     // Open a Flux handle and store it in the dyad_ctx_t
     // object. If the open operation failed, return DYAD_FLUXFAIL
     (*ctx)->h = flux_open (NULL, 0);
@@ -664,6 +1440,27 @@ dyad_rc_t dyad_init (bool debug,
 
     DYAD_C_FUNCTION_UPDATE_STR ("prod_managed_path", (*ctx)->prod_managed_path);
     DYAD_C_FUNCTION_UPDATE_STR ("cons_managed_path", (*ctx)->cons_managed_path);
+    // If a memory tier is requested for the consumer cache, set it up.
+    // Without it, consumed files are written to the consumer-managed path
+    // directly, so failing here is not fatal.
+    if ((*ctx)->cons_managed_path != NULL) {
+        rc = dyad_init_mem_tier (*ctx);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR ((*ctx), "Cannot set up the memory tier. Continuing without it");
+        }
+        rc = dyad_init_cache_index (*ctx);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR ((*ctx), "Cannot open the cache index. Continuing without it");
+        }
+        rc = dyad_init_stripes (*ctx);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR ((*ctx), "Cannot set up the stripe directories. Continuing without them");
+        }
+        rc = dyad_init_preconnect (*ctx);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR ((*ctx), "Cannot pre-connect to every DYAD module. Continuing");
+        }
+    }
     // Initialization is now complete!
     // Set reenter and initialized to indicate this.
     (*ctx)->reenter = true;
@@ -830,6 +1627,92 @@ produce_done:;
     return rc;
 }
 
+/// Hand a copy of the contents of a produced file to the local DYAD module in
+/// a sealed memory file, so that the module serves fetches from memory.
+/// Failing to do so is not an error, as the module then reads the file.
+DYAD_CORE_FUNC_MODS void dyad_handoff_contents (const dyad_ctx_t* restrict ctx,
+                                                const char* restrict upath,
+                                                const void* restrict buf,
+                                                size_t len)
+{
+    const int seals = F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW;
+    flux_future_t* f = NULL;
+    int mfd = memfd_create ("dyad", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (mfd < 0) {
+        DYAD_LOG_DEBUG (ctx, "Cannot create a memory file for %s", upath);
+        return;
+    }
+    if (write_all (mfd, buf, len) < 0 || fcntl (mfd, F_ADD_SEALS, seals) < 0) {
+        DYAD_LOG_DEBUG (ctx, "Cannot fill the memory file for %s", upath);
+        goto handoff_done;
+    }
+    // The module opens the memory file through /proc, so it has to stay open
+    // until the module responds
+    f = flux_rpc_pack (ctx->h,
+                       DYAD_SHM_RPC_NAME,
+                       ctx->rank,
+                       0,
+                       "{s:s, s:i, s:i}",
+                       "upath",
+                       upath,
+                       "pid",
+                       (int)getpid (),
+                       "fd",
+                       mfd);
+    if (f == NULL) {
+        DYAD_LOG_DEBUG (ctx, "Cannot send %s to the module", DYAD_SHM_RPC_NAME);
+        goto handoff_done;
+    }
+    if (flux_rpc_get (f, NULL) < 0 && errno != ENOSYS) {
+        DYAD_LOG_INFO (ctx, "The module did not take over the contents of %s", upath);
+    }
+    flux_future_destroy (f);
+
+handoff_done:;
+    close (mfd);
+}
+
+dyad_rc_t dyad_produce_buffer (dyad_ctx_t* ctx, const char* fname, const void* buf, size_t len)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("fname", fname);
+    dyad_rc_t rc = DYAD_RC_OK;
+    char upath[PATH_MAX] = {'\0'};
+    int fd = -1;
+    if (!ctx || !ctx->h) {
+        DYAD_LOG_ERROR (ctx, "No CTX found in dyad_produce_buffer")
+        rc = DYAD_RC_NOCTX;
+        goto produce_buffer_done;
+    }
+    if (ctx->prod_managed_path == NULL || strlen (ctx->prod_managed_path) == 0) {
+        DYAD_LOG_ERROR (ctx, "No or empty producer managed path was found")
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto produce_buffer_done;
+    }
+    ctx->fname = fname;
+    // Do not intercept our own file I/O
+    ctx->reenter = false;
+    fd = open (fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0 || write_all (fd, buf, len) < 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot write %s", fname);
+        if (fd >= 0)
+            close (fd);
+        ctx->reenter = true;
+        rc = DYAD_RC_BADFIO;
+        goto produce_buffer_done;
+    }
+    close (fd);
+    if (len > 0 && cmp_canonical_path_prefix (ctx->prod_managed_path, fname, upath, PATH_MAX)) {
+        dyad_handoff_contents (ctx, upath, buf, len);
+    }
+    ctx->reenter = true;
+    rc = dyad_commit (ctx, fname);
+
+produce_buffer_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
 // DYAD_CORE_FUNC_MODS dyad_rc_t dyad_kvs_lookup (const dyad_ctx_t* ctx,
 //                                                const char* restrict kvs_topic,
 //                                                uint32_t* owner_rank,
@@ -846,6 +1729,7 @@ dyad_rc_t dyad_get_metadata (dyad_ctx_t* ctx,
     // check if file exist locally, if so skip kvs
     int fd = open (fname, O_RDONLY);
     if (fd != -1) {
+        const ssize_t local_size = get_file_size (fd);
         close (fd);
         if (mdata == NULL) {
             DYAD_LOG_ERROR (ctx,
@@ -874,6 +1758,9 @@ dyad_rc_t dyad_get_metadata (dyad_ctx_t* ctx,
         memset ((*mdata)->fpath, '\0', fname_len + 1);
         strncpy ((*mdata)->fpath, fname, fname_len);
         (*mdata)->owner_rank = ctx->rank;
+        (*mdata)->size = (int64_t)local_size;
+        (*mdata)->version = 0ull;
+        (*mdata)->data = NULL;
         rc = DYAD_RC_OK;
         goto get_metadata_done;
     }
@@ -919,6 +1806,7 @@ dyad_rc_t dyad_free_metadata (dyad_metadata_t** mdata)
     }
     if ((*mdata)->fpath != NULL)
         free ((*mdata)->fpath);
+    free ((*mdata)->data);
     free (*mdata);
     *mdata = NULL;
     DYAD_C_FUNCTION_END();
@@ -935,6 +1823,7 @@ dyad_rc_t dyad_consume (dyad_ctx_t* ctx, const char* fname)
     char* file_data = NULL;
     size_t data_len = 0ul;
     dyad_metadata_t* mdata = NULL;
+    uint64_t version = 0ull;
     struct flock exclusive_lock;
     // If the context is not defined, then it is not valid.
     // So, return DYAD_NOCTX
@@ -951,6 +1840,12 @@ dyad_rc_t dyad_consume (dyad_ctx_t* ctx, const char* fname)
     // Set reenter to false to avoid recursively performing
     // DYAD operations
     ctx->reenter = false;
+    // With a memory tier or stripe directories, the data lands there and
+    // fname links to it
+    if (ctx->mem_tier != NULL || ctx->stripes != NULL) {
+        rc = dyad_consume_via_link (ctx, fname, NULL);
+        goto consume_close;
+    }
     fd = open (fname, O_RDWR | O_CREAT, 0666);
     DYAD_C_FUNCTION_UPDATE_INT ("fd", fd);
     if (fd == -1) {
@@ -963,7 +1858,8 @@ dyad_rc_t dyad_consume (dyad_ctx_t* ctx, const char* fname)
         dyad_release_flock (ctx, fd, &exclusive_lock);
         goto consume_close;
     }
-    if ((file_size = get_file_size (fd)) <= 0) {
+    file_size = get_file_size (fd);
+    if (!dyad_cached_copy_is_valid (ctx, fname, fname, file_size, 0ull)) {
         DYAD_LOG_INFO (ctx, "[node %u rank %u pid %d] File (%s with fd %d) is not fetched yet", \
                        ctx->node_idx, ctx->rank, ctx->pid, fname, fd);
         // Call dyad_fetch to get (and possibly wait on)
@@ -982,6 +1878,9 @@ dyad_rc_t dyad_consume (dyad_ctx_t* ctx, const char* fname)
         // is enabled
         if (mdata == NULL) {
             DYAD_LOG_INFO (ctx, "File '%s' is local!\n", fname);
+            if (file_size > 0)
+                dyad_cached_copy_record (ctx, fname, NULL, (size_t)file_size, 0ull,
+                                         DYAD_CACHE_INDEX_LOCAL);
             rc = DYAD_RC_OK;
             dyad_release_flock (ctx, fd, &exclusive_lock);
             goto consume_close;
@@ -996,10 +1895,18 @@ dyad_rc_t dyad_consume (dyad_ctx_t* ctx, const char* fname)
             goto consume_done;
         }
         DYAD_C_FUNCTION_UPDATE_INT ("data_len", data_len);
+        // Drop whatever an interrupted consume left behind
+        dyad_cached_copy_invalidate (ctx, fname);
+        if (file_size > 0 && ftruncate (fd, 0) != 0) {
+            rc = DYAD_RC_BADFIO;
+            dyad_release_flock (ctx, fd, &exclusive_lock);
+            goto consume_done;
+        }
 
         // Call dyad_pull to fetch the data from the producer's
         // Flux broker
         rc = dyad_cons_store (ctx, mdata, fd, data_len, file_data);
+        version = mdata->version;
         // Regardless if there was an error in dyad_pull,
         // free the KVS response object
         if (mdata != NULL) {
@@ -1013,6 +1920,7 @@ dyad_rc_t dyad_consume (dyad_ctx_t* ctx, const char* fname)
             goto consume_done;
         };
         fsync (fd);
+        dyad_cached_copy_record (ctx, fname, file_data, data_len, version, 0u);
     }
     dyad_release_flock (ctx, fd, &exclusive_lock);
     DYAD_C_FUNCTION_UPDATE_INT ("file_size", file_size);
@@ -1068,6 +1976,10 @@ dyad_rc_t dyad_consume_w_metadata (dyad_ctx_t* ctx, const char* fname,
     // Set reenter to false to avoid recursively performing
     // DYAD operations
     ctx->reenter = false;
+    if (ctx->mem_tier != NULL || ctx->stripes != NULL) {
+        rc = dyad_consume_via_link (ctx, fname, mdata);
+        goto consume_close;
+    }
     fd = open (fname, O_RDWR | O_CREAT, 0666);
     DYAD_C_FUNCTION_UPDATE_INT ("fd", fd);
     if (fd == -1) {
@@ -1080,7 +1992,8 @@ dyad_rc_t dyad_consume_w_metadata (dyad_ctx_t* ctx, const char* fname,
         dyad_release_flock (ctx, fd, &exclusive_lock);
         goto consume_close;
     }
-    if ((file_size = get_file_size (fd)) <= 0) {
+    file_size = get_file_size (fd);
+    if (!dyad_cached_copy_is_valid (ctx, fname, fname, file_size, mdata->version)) {
         DYAD_LOG_INFO (ctx, "[node %u rank %u pid %d] File (%s with fd %d) is not fetched yet", \
                        ctx->node_idx, ctx->rank, ctx->pid, fname, fd);
 
@@ -1093,6 +2006,13 @@ dyad_rc_t dyad_consume_w_metadata (dyad_ctx_t* ctx, const char* fname,
             goto consume_done;
         }
         DYAD_C_FUNCTION_UPDATE_INT ("data_len", data_len);
+        // Drop whatever an interrupted consume left behind
+        dyad_cached_copy_invalidate (ctx, fname);
+        if (file_size > 0 && ftruncate (fd, 0) != 0) {
+            rc = DYAD_RC_BADFIO;
+            dyad_release_flock (ctx, fd, &exclusive_lock);
+            goto consume_done;
+        }
 
         // Call dyad_pull to fetch the data from the producer's
         // Flux broker
@@ -1105,6 +2025,7 @@ dyad_rc_t dyad_consume_w_metadata (dyad_ctx_t* ctx, const char* fname,
             goto consume_done;
         };
         fsync (fd);
+        dyad_cached_copy_record (ctx, fname, file_data, data_len, mdata->version, 0u);
     }
     dyad_release_flock (ctx, fd, &exclusive_lock);
     DYAD_C_FUNCTION_UPDATE_INT ("file_size", file_size);
@@ -1125,6 +2046,595 @@ consume_close:;
     return rc;
 }
 
+/// A file consumed by dyad_consume_batch
+struct dyad_batch_item {
+    const char* fname;        // file being consumed
+    int fd;                   // its copy under the consumer-managed path
+    struct flock lock;        // exclusive lock on fd
+    ssize_t file_size;        // size of the copy when it was locked
+    dyad_metadata_t* mdata;   // metadata of the file, if it must be fetched
+    bool pending;             // waiting for the contents of the file
+    bool requested;           // part of a dyad.fetch_batch request already
+    dyad_rc_t rc;             // outcome of the consume
+};
+
+static int dyad_batch_item_cmp (const void* a, const void* b)
+{
+    return strcmp (((const struct dyad_batch_item*)a)->fname,
+                   ((const struct dyad_batch_item*)b)->fname);
+}
+
+/// Write the contents of a file received in a batch to its copy
+DYAD_CORE_FUNC_MODS void dyad_batch_store (const dyad_ctx_t* restrict ctx,
+                                           struct dyad_batch_item* item,
+                                           char* data,
+                                           size_t data_len)
+{
+    item->pending = false;
+    // Drop whatever an interrupted consume left behind
+    dyad_cached_copy_invalidate (ctx, item->fname);
+    if (item->file_size > 0 && ftruncate (item->fd, 0) != 0) {
+        item->rc = DYAD_RC_BADFIO;
+        return;
+    }
+    item->rc = dyad_cons_store (ctx, item->mdata, item->fd, data_len, data);
+    if (DYAD_IS_ERROR (item->rc)) {
+        DYAD_LOG_ERROR (ctx, "dyad_cons_store failed for %s!\n", item->fname);
+        return;
+    }
+    fsync (item->fd);
+    dyad_cached_copy_record (ctx, item->fname, data, data_len, item->mdata->version, 0u);
+}
+
+/// Fetch several files from the DYAD module of their owner with one
+/// dyad.fetch_batch request, and store each of them as it arrives. The files
+/// that did not arrive are left pending. If the module is saturated and turns
+/// the request down, DYAD_RC_BUSY is returned and retry_ms is set to the time
+/// after which the module suggests to retry.
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_get_batch_from_owner (const dyad_ctx_t* ctx,
+                                                         struct dyad_batch_item** items,
+                                                         unsigned int nitems,
+                                                         uint32_t owner_rank,
+                                                         unsigned int* retry_ms)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_INT ("owner_rank", owner_rank);
+    DYAD_C_FUNCTION_UPDATE_INT ("nitems", nitems);
+    dyad_rc_t rc = DYAD_RC_OK;
+    flux_future_t* f = NULL;
+    json_t* rpc_payload = NULL;
+    json_t* upaths = NULL;
+    const char* errstr = NULL;
+    const struct dyad_batch_frame* frame = NULL;
+    char* buf = NULL;
+    size_t buflen = 0ul;
+    json_int_t bytes = 0;
+    unsigned int i = 0u;
+    unsigned int received = 0u;
+
+    // The DTL packs the first file along with what it needs to send the data
+    rc = ctx->dtl_handle->rpc_pack (ctx, items[0]->mdata->fpath, owner_rank, &rpc_payload);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Cannot create JSON payload for Flux RPC to DYAD module\n");
+        goto get_batch_done;
+    }
+    if ((upaths = json_array ()) == NULL) {
+        json_decref (rpc_payload);
+        rc = DYAD_RC_BADPACK;
+        goto get_batch_done;
+    }
+    for (i = 0u; i < nitems; i++) {
+        if (json_array_append_new (upaths, json_string (items[i]->mdata->fpath)) < 0)
+            break;
+        if (items[i]->mdata->size > 0)
+            bytes += (json_int_t)items[i]->mdata->size;
+    }
+    // The module schedules the batch by its size without looking at the files
+    if (i < nitems || json_object_set_new (rpc_payload, "upaths", upaths) < 0
+        || json_object_set_new (rpc_payload, "bytes", json_integer (bytes)) < 0) {
+        json_decref (rpc_payload);
+        rc = DYAD_RC_BADPACK;
+        goto get_batch_done;
+    }
+    DYAD_LOG_INFO (ctx, "Sending batch of %u files to the DYAD module of broker %u", nitems,
+                   owner_rank);
+    f = flux_rpc_pack (ctx->h, DYAD_BATCH_RPC_NAME, owner_rank, FLUX_RPC_STREAMING, "o",
+                       rpc_payload);
+    if (f == NULL) {
+        DYAD_LOG_ERROR (ctx, "Cannot send RPC to producer module\n");
+        rc = DYAD_RC_BADRPC;
+        goto get_batch_done;
+    }
+    rc = ctx->dtl_handle->rpc_recv_response (ctx, f);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Cannot receive and/or parse the RPC response\n");
+        goto get_batch_done;
+    }
+    rc = ctx->dtl_handle->establish_connection (ctx);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Cannot establish connection with DYAD module on broker %u\n",
+                        owner_rank);
+        goto get_batch_done;
+    }
+    // The module sends one frame per file
+    for (received = 0u; received < nitems; received++) {
+        rc = ctx->dtl_handle->recv (ctx, (void**)&buf, &buflen);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "Cannot receive data from producer module\n");
+            break;
+        }
+        frame = (const struct dyad_batch_frame*)buf;
+        if (buflen < sizeof (*frame) || frame->index >= nitems
+            || frame->len != buflen - sizeof (*frame) || !items[frame->index]->pending) {
+            DYAD_LOG_ERROR (ctx, "Received a malformed frame from producer module\n");
+            ctx->dtl_handle->return_buffer (ctx, (void**)&buf);
+            rc = DYAD_RC_BADRPC;
+            break;
+        }
+        if (frame->errnum != 0) {
+            DYAD_LOG_ERROR (ctx, "The producer module cannot send %s (errno = %d)",
+                            items[frame->index]->fname, (int)frame->errnum);
+            items[frame->index]->pending = false;
+            items[frame->index]->rc = DYAD_RC_BADRPC;
+        } else {
+            dyad_batch_store (ctx, items[frame->index], buf + sizeof (*frame),
+                              (size_t)frame->len);
+        }
+        ctx->dtl_handle->return_buffer (ctx, (void**)&buf);
+        buf = NULL;
+    }
+    ctx->dtl_handle->close_connection (ctx);
+
+get_batch_done:;
+    // As in dyad_get_data_from_owner, the end of the stream only needs to be
+    // waited for if the module did not end it already
+    if (rc == DYAD_RC_BUSY) {
+        errstr = flux_future_error_string (f);
+        if (errstr == NULL || sscanf (errstr, DYAD_RETRY_AFTER_FMT, retry_ms) != 1) {
+            *retry_ms = DYAD_BUSY_DEFAULT_RETRY_MS;
+        }
+        DYAD_LOG_INFO (ctx, "The module of broker %u is busy, retrying in %u ms", owner_rank,
+                       *retry_ms);
+    }
+    if (f != NULL && rc != DYAD_RC_RPC_FINISHED && rc != DYAD_RC_BADRPC && rc != DYAD_RC_BUSY) {
+        if (!(flux_rpc_get (f, NULL) < 0 && errno == ENODATA)) {
+            DYAD_LOG_ERROR (ctx, "The module did not end the batch stream (errno = %d)\n",
+                            errno);
+            rc = DYAD_RC_BADRPC;
+        }
+    }
+    flux_future_destroy (f);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Fetch the pending files of a batch that have the same owner as items[first]
+/// and come after it, DYAD_BATCH_MAX_FILES at a time
+DYAD_CORE_FUNC_MODS void dyad_get_batch (const dyad_ctx_t* ctx,
+                                         struct dyad_batch_item* items,
+                                         size_t nitems,
+                                         size_t first)
+{
+    struct dyad_batch_item* group[DYAD_BATCH_MAX_FILES];
+    const uint32_t owner_rank = items[first].mdata->owner_rank;
+    unsigned int ngroup = 0u;
+    unsigned int retry_ms = 0u;
+    unsigned int attempt = 0u;
+    dyad_rc_t rc = DYAD_RC_OK;
+    size_t i = first;
+
+    while (i < nitems) {
+        for (ngroup = 0u; i < nitems && ngroup < DYAD_BATCH_MAX_FILES; i++) {
+            if (items[i].pending && !items[i].requested
+                && items[i].mdata->owner_rank == owner_rank) {
+                items[i].requested = true;
+                group[ngroup++] = &items[i];
+            }
+        }
+        if (ngroup == 0u) {
+            break;
+        }
+        for (attempt = 0u;; attempt++) {
+            rc = dyad_get_batch_from_owner (ctx, group, ngroup, owner_rank, &retry_ms);
+            if (rc != DYAD_RC_BUSY || attempt >= DYAD_BUSY_MAX_RETRIES) {
+                break;
+            }
+            usleep ((useconds_t)retry_ms * 1000u);
+        }
+    }
+}
+
+dyad_rc_t dyad_consume_batch (dyad_ctx_t* ctx, const char** fnames, size_t nfiles)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_INT ("nfiles", nfiles);
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct dyad_batch_item* items = NULL;
+    struct dyad_batch_item* item = NULL;
+    char* file_data = NULL;
+    size_t data_len = 0ul;
+    size_t i = 0ul;
+
+    if (!ctx || !ctx->h) {
+        rc = DYAD_RC_NOCTX;
+        goto consume_batch_done;
+    }
+    if (ctx->cons_managed_path == NULL || strlen (ctx->cons_managed_path) == 0) {
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto consume_batch_done;
+    }
+    // Files stored outside the consumer-managed path or fetched through the
+    // local proxy are consumed one at a time
+    if (ctx->mem_tier != NULL || ctx->stripes != NULL || ctx->fetch_proxy) {
+        for (i = 0ul; i < nfiles; i++) {
+            dyad_rc_t file_rc = dyad_consume (ctx, fnames[i]);
+            if (DYAD_IS_ERROR (file_rc) && !DYAD_IS_ERROR (rc))
+                rc = file_rc;
+        }
+        goto consume_batch_done;
+    }
+    items = (struct dyad_batch_item*)calloc (nfiles, sizeof (*items));
+    if (items == NULL && nfiles > 0ul) {
+        rc = DYAD_RC_SYSFAIL;
+        goto consume_batch_done;
+    }
+    ctx->reenter = false;
+    // Lock the files in a global order, so that processes consuming
+    // overlapping batches cannot deadlock
+    for (i = 0ul; i < nfiles; i++) {
+        items[i].fname = fnames[i];
+        items[i].fd = -1;
+    }
+    qsort (items, nfiles, sizeof (*items), dyad_batch_item_cmp);
+    for (i = 0ul; i < nfiles; i++) {
+        item = &items[i];
+        item->fd = open (item->fname, O_RDWR | O_CREAT, 0666);
+        if (item->fd == -1) {
+            DYAD_LOG_ERROR (ctx, "Cannot create file (%s) for dyad_consume_batch!\n", item->fname);
+            item->rc = DYAD_RC_BADFIO;
+            continue;
+        }
+        item->rc = dyad_excl_flock (ctx, item->fd, &item->lock);
+        if (DYAD_IS_ERROR (item->rc)) {
+            close (item->fd);
+            item->fd = -1;
+            continue;
+        }
+        item->file_size = get_file_size (item->fd);
+        if (dyad_cached_copy_is_valid (ctx, item->fname, item->fname, item->file_size, 0ull)) {
+            continue;
+        }
+        item->rc = dyad_fetch (ctx, item->fname, &item->mdata);
+        if (DYAD_IS_ERROR (item->rc)) {
+            DYAD_LOG_ERROR (ctx, "dyad_fetch failed for %s!\n", item->fname);
+            continue;
+        }
+        if (item->mdata == NULL) {
+            if (item->file_size > 0)
+                dyad_cached_copy_record (ctx, item->fname, NULL, (size_t)item->file_size, 0ull,
+                                         DYAD_CACHE_INDEX_LOCAL);
+            continue;
+        }
+        item->pending = true;
+        // A tiny file published with its contents needs no request
+        item->requested = (item->mdata->data != NULL);
+        item->rc = DYAD_RC_BADRPC;
+    }
+    // One request per owner (and per DYAD_BATCH_MAX_FILES files)
+    for (i = 0ul; i < nfiles; i++) {
+        if (items[i].pending && !items[i].requested)
+            dyad_get_batch (ctx, items, nfiles, i);
+    }
+    for (i = 0ul; i < nfiles; i++) {
+        item = &items[i];
+        // Files that did not come with the batch (e.g., from a module that
+        // does not serve batches) are fetched on their own
+        if (item->pending) {
+            item->rc = dyad_get_data (ctx, item->mdata, &file_data, &data_len);
+            if (!DYAD_IS_ERROR (item->rc))
+                dyad_batch_store (ctx, item, file_data, data_len);
+            if (file_data != NULL)
+                ctx->dtl_handle->return_buffer (ctx, (void**)&file_data);
+            file_data = NULL;
+        }
+        if (item->fd != -1) {
+            dyad_release_flock (ctx, item->fd, &item->lock);
+            if (close (item->fd) != 0 && !DYAD_IS_ERROR (item->rc))
+                item->rc = DYAD_RC_BADFIO;
+        }
+        dyad_free_metadata (&item->mdata);
+        if (DYAD_IS_ERROR (item->rc) && !DYAD_IS_ERROR (rc))
+            rc = item->rc;
+    }
+    ctx->reenter = true;
+
+consume_batch_done:;
+    free (items);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Read a file that is available on node-local storage into a DTL buffer
+DYAD_CORE_FUNC_MODS dyad_rc_t dyad_read_local (const dyad_ctx_t* restrict ctx,
+                                               const char* restrict fname,
+                                               void** buf,
+                                               size_t* len)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("fname", fname);
+    dyad_rc_t rc = DYAD_RC_OK;
+    int fd = -1;
+    ssize_t file_size = -1;
+    struct flock shared_lock;
+    fd = open (fname, O_RDONLY);
+    if (fd == -1) {
+        DYAD_LOG_ERROR (ctx, "Cannot open local file (%s)", fname);
+        rc = DYAD_RC_BADFIO;
+        goto read_local_done;
+    }
+    rc = dyad_shared_flock (ctx, fd, &shared_lock);
+    if (DYAD_IS_ERROR (rc)) {
+        goto read_local_unlock;
+    }
+    file_size = get_file_size (fd);
+    if (file_size < 0) {
+        rc = DYAD_RC_BADFIO;
+        goto read_local_unlock;
+    }
+    rc = ctx->dtl_handle->get_buffer (ctx, (size_t)file_size, buf);
+    if (DYAD_IS_ERROR (rc)) {
+        goto read_local_unlock;
+    }
+    if (file_size > 0 && read (fd, *buf, (size_t)file_size) != file_size) {
+        DYAD_LOG_ERROR (ctx, "Cannot read local file (%s)", fname);
+        ctx->dtl_handle->return_buffer (ctx, buf);
+        rc = DYAD_RC_BADFIO;
+        goto read_local_unlock;
+    }
+    *len = (size_t)file_size;
+    rc = DYAD_RC_OK;
+read_local_unlock:;
+    dyad_release_flock (ctx, fd, &shared_lock);
+read_local_done:;
+    if (fd != -1)
+        close (fd);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/// Consume a file into a DTL buffer, unless it is larger than capacity bytes,
+/// in which case len is set to its size and DYAD_RC_BADBUF is returned before
+/// any data moves
+static dyad_rc_t dyad_consume_to_buffer_capped (dyad_ctx_t* ctx,
+                                                const char* fname,
+                                                void** buf,
+                                                size_t* len,
+                                                size_t capacity)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("fname", fname);
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_metadata_t* mdata = NULL;
+    struct stat st;
+    if (!ctx || !ctx->h) {
+        rc = DYAD_RC_NOCTX;
+        goto consume_buf_close;
+    }
+    if (buf == NULL || len == NULL) {
+        rc = DYAD_RC_BADBUF;
+        goto consume_buf_close;
+    }
+    *buf = NULL;
+    *len = 0ul;
+    if (ctx->cons_managed_path == NULL || strlen (ctx->cons_managed_path) == 0) {
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto consume_buf_close;
+    }
+    ctx->reenter = false;
+    // A previous dyad_consume of this file already brought it to this node
+    if (stat (fname, &st) == 0 && S_ISREG (st.st_mode)
+        && dyad_cached_copy_is_valid (ctx, fname, fname, st.st_size, 0ull)) {
+        if ((size_t)st.st_size > capacity) {
+            *len = (size_t)st.st_size;
+            rc = DYAD_RC_BADBUF;
+            goto consume_buf_close;
+        }
+        rc = dyad_read_local (ctx, fname, buf, len);
+        goto consume_buf_close;
+    }
+    rc = dyad_fetch (ctx, fname, &mdata);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "dyad_fetch failed!\n");
+        goto consume_buf_close;
+    }
+    if (mdata == NULL) {
+        DYAD_LOG_INFO (ctx, "File '%s' is local!\n", fname);
+        if (stat (fname, &st) == 0 && (size_t)st.st_size > capacity) {
+            *len = (size_t)st.st_size;
+            rc = DYAD_RC_BADBUF;
+            goto consume_buf_close;
+        }
+        rc = dyad_read_local (ctx, fname, buf, len);
+        goto consume_buf_close;
+    }
+    if (mdata->size >= 0 && (uint64_t)mdata->size > (uint64_t)capacity) {
+        *len = (size_t)mdata->size;
+        rc = DYAD_RC_BADBUF;
+        goto consume_buf_close;
+    }
+    rc = dyad_get_data (ctx, mdata, (char**)buf, len);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "dyad_get_data failed!\n");
+        if (*buf != NULL)
+            ctx->dtl_handle->return_buffer (ctx, buf);
+        *len = 0ul;
+        goto consume_buf_close;
+    }
+    DYAD_C_FUNCTION_UPDATE_INT ("data_len", *len);
+    rc = DYAD_RC_OK;
+
+consume_buf_close:;
+    if (mdata != NULL)
+        dyad_free_metadata (&mdata);
+    if (ctx != NULL)
+        ctx->reenter = true;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_consume_to_buffer (dyad_ctx_t* ctx, const char* fname, void** buf, size_t* len)
+{
+    return dyad_consume_to_buffer_capped (ctx, fname, buf, len, SIZE_MAX);
+}
+
+dyad_rc_t dyad_consume_into_buffer (dyad_ctx_t* ctx,
+                                    const char* fname,
+                                    void* buf,
+                                    size_t capacity,
+                                    size_t* len)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("fname", fname);
+    dyad_rc_t rc = DYAD_RC_OK;
+    void* dtl_buf = NULL;
+    size_t dtl_len = 0ul;
+    if (!ctx || !ctx->dtl_handle) {
+        rc = DYAD_RC_NOCTX;
+        goto consume_into_done;
+    }
+    if (buf == NULL || len == NULL) {
+        rc = DYAD_RC_BADBUF;
+        goto consume_into_done;
+    }
+    // The DTL receives the data straight into the buffer of the caller
+    ctx->dtl_handle->user_buf = buf;
+    ctx->dtl_handle->user_buf_cap = capacity;
+    ctx->dtl_handle->user_buf_lent = false;
+    rc = dyad_consume_to_buffer_capped (ctx, fname, &dtl_buf, &dtl_len, capacity);
+    ctx->dtl_handle->user_buf = NULL;
+    ctx->dtl_handle->user_buf_lent = false;
+    *len = dtl_len;
+    if (rc == DYAD_RC_BADBUF) {
+        DYAD_LOG_ERROR (ctx, "File %s (%zu bytes) does not fit in a buffer of %zu bytes",
+                        fname, dtl_len, capacity);
+        goto consume_into_done;
+    }
+    if (DYAD_IS_ERROR (rc)) {
+        goto consume_into_done;
+    }
+    if (dtl_len > capacity) {
+        rc = DYAD_RC_BADBUF;
+        goto consume_into_done;
+    }
+    // Only data the DTL could not receive into the buffer of the caller is
+    // copied
+    if (dtl_buf != buf && dtl_len > 0ul)
+        memcpy (buf, dtl_buf, dtl_len);
+    if (dtl_buf == buf)
+        dtl_buf = NULL;
+    rc = DYAD_RC_OK;
+
+consume_into_done:;
+    if (dtl_buf != NULL)
+        dyad_release_buffer (ctx, &dtl_buf);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_release_buffer (dyad_ctx_t* ctx, void** buf)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    if (!ctx || !ctx->dtl_handle) {
+        rc = DYAD_RC_NOCTX;
+        goto release_buf_done;
+    }
+    if (buf == NULL || *buf == NULL) {
+        rc = DYAD_RC_OK;
+        goto release_buf_done;
+    }
+    rc = ctx->dtl_handle->return_buffer (ctx, buf);
+release_buf_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_preconnect (dyad_ctx_t* ctx, const uint32_t* ranks, size_t nranks)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_rc_t pack_rc = DYAD_RC_OK;
+    flux_future_t** futures = NULL;
+    json_t* rpc_payload = NULL;
+    uint32_t size = 0u;
+    size_t i = 0ul;
+
+    if (!ctx || !ctx->h || !ctx->dtl_handle) {
+        rc = DYAD_RC_NOCTX;
+        goto preconnect_done;
+    }
+    // Only the UCX DTL has connections to set up. Through the fetch proxy,
+    // the local module is the one connecting to the owners.
+    if (ctx->dtl_handle->mode != DYAD_DTL_UCX || ctx->fetch_proxy) {
+        rc = DYAD_RC_OK;
+        goto preconnect_done;
+    }
+    if (ranks == NULL) {
+        if (flux_get_size (ctx->h, &size) < 0) {
+            rc = DYAD_RC_FLUXFAIL;
+            goto preconnect_done;
+        }
+        nranks = size;
+    }
+    DYAD_C_FUNCTION_UPDATE_INT ("nranks", nranks);
+    futures = (flux_future_t**)calloc (nranks, sizeof (flux_future_t*));
+    if (futures == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto preconnect_done;
+    }
+    // Send all the requests before waiting for any reply. The first error
+    // is the one returned.
+    rc = DYAD_RC_OK;
+    for (i = 0ul; i < nranks; i++) {
+        const uint32_t rank = (ranks == NULL) ? (uint32_t)i : ranks[i];
+        pack_rc = ctx->dtl_handle->rpc_pack (ctx, "", rank, &rpc_payload);
+        if (DYAD_IS_ERROR (pack_rc)) {
+            DYAD_LOG_ERROR (ctx, "Cannot pack the registration with broker %u", rank);
+            rc = pack_rc;
+            goto preconnect_done;
+        }
+        futures[i] = flux_rpc_pack (ctx->h, DYAD_REGISTER_RPC_NAME, rank, 0, "o", rpc_payload);
+        if (futures[i] == NULL) {
+            DYAD_LOG_ERROR (ctx, "Cannot send the registration to broker %u", rank);
+            if (!DYAD_IS_ERROR (rc))
+                rc = DYAD_RC_BADRPC;
+        }
+    }
+    for (i = 0ul; i < nranks; i++) {
+        if (futures[i] == NULL)
+            continue;
+        if (flux_rpc_get (futures[i], NULL) < 0) {
+            // Brokers without the module answer ENOSYS
+            if (errno != ENOSYS) {
+                DYAD_LOG_ERROR (ctx, "Cannot register with broker %u: %s",
+                                (ranks == NULL) ? (uint32_t)i : ranks[i],
+                                flux_future_error_string (futures[i]));
+                if (!DYAD_IS_ERROR (rc))
+                    rc = DYAD_RC_BADRPC;
+            }
+        }
+    }
+
+preconnect_done:;
+    if (futures != NULL) {
+        for (i = 0ul; i < nranks; i++)
+            flux_future_destroy (futures[i]);
+        free (futures);
+    }
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
 dyad_rc_t dyad_finalize (dyad_ctx_t** ctx)
 {
     DYAD_C_FUNCTION_START();
@@ -1134,6 +2644,9 @@ dyad_rc_t dyad_finalize (dyad_ctx_t** ctx)
         goto finalize_region_finish;
     }
     dyad_dtl_finalize (*ctx);
+    dyad_mem_tier_finalize (&((*ctx)->mem_tier));
+    dyad_cache_index_close (&((*ctx)->cache_index));
+    dyad_stripes_finalize (&((*ctx)->stripes));
     if ((*ctx)->h != NULL) {
         flux_close ((*ctx)->h);
         (*ctx)->h = NULL;
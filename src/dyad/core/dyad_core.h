@@ -41,6 +41,10 @@ DYAD_DLL_EXPORTED extern const struct dyad_ctx dyad_ctx_default;
 struct dyad_metadata {
     char* fpath;
     uint32_t owner_rank;
+    int64_t size;      // size of the file when it was produced, -1 if unknown
+    uint64_t version;  // version of the file when it was produced (see get_file_version), 0 if
+                       // unknown
+    char* data;        // contents of the file if published in the KVS entry (size bytes), or NULL
 };
 typedef struct dyad_metadata dyad_metadata_t;
 
@@ -112,6 +116,20 @@ DYAD_DLL_EXPORTED dyad_rc_t dyad_init_env (dyad_ctx_t** ctx);
  */
 DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t dyad_produce (dyad_ctx_t* ctx, const char* fname);
 
+/**
+ * @brief Write a file from a buffer and produce it. The contents are also
+ *        handed to the local DYAD module in memory, so that the module does
+ *        not read the file back to serve it.
+ * @param[in] ctx    the DYAD context for the operation
+ * @param[in] fname  the name of the file being "produced"
+ * @param[in] buf    the contents of the file
+ * @param[in] len    the size of the contents in bytes
+ *
+ * @return An error code from dyad_rc.h
+ */
+DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t
+dyad_produce_buffer (dyad_ctx_t* ctx, const char* fname, const void* buf, size_t len);
+
 /**
  * @brief Obtain DYAD metadata for a file in the consumer-managed directory
  * @param[in]  ctx         the DYAD context for the operation
@@ -151,6 +169,88 @@ DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t dyad_consume (dyad_ctx_t* ctx, con
 DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t dyad_consume_w_metadata (dyad_ctx_t* ctx, const char* fname,
                                                                        const dyad_metadata_t* mdata);
 
+/**
+ * @brief Consume several files at once. The files that must be fetched are
+ *        grouped by owner, and the files of an owner are fetched with a single
+ *        request whose data is streamed over one DTL connection, instead of
+ *        one request per file.
+ * @param[in] ctx     the DYAD context for the operation
+ * @param[in] fnames  the names of the files being "consumed"
+ * @param[in] nfiles  the number of files
+ *
+ * @return An error code from dyad_rc.h: the first error met, if any. The
+ *         files that could be consumed are consumed regardless.
+ */
+DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t dyad_consume_batch (dyad_ctx_t* ctx,
+                                                                  const char** fnames,
+                                                                  size_t nfiles);
+
+/**
+ * @brief Consume a file into memory instead of the consumer-managed path.
+ *        The KVS lookup, RPC and data receipt are the same as in
+ *        dyad_consume, but the data is handed back in the DTL buffer and
+ *        nothing is written to disk. If the file is already available on
+ *        node-local storage, it is read from there.
+ * @param[in]  ctx    the DYAD context for the operation
+ * @param[in]  fname  the name of the file being "consumed"
+ * @param[out] buf    the buffer holding the file contents. It must be released
+ *                    with dyad_release_buffer. Several buffers can be held at
+ *                    once.
+ * @param[out] len    the size of the file contents in bytes
+ *
+ * @return An error code from dyad_rc.h
+ */
+DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t dyad_consume_to_buffer (dyad_ctx_t* ctx,
+                                                                      const char* fname,
+                                                                      void** buf,
+                                                                      size_t* len);
+
+/**
+ * @brief Consume a file into a caller-allocated buffer
+ *        The size of the file is checked against capacity before it is
+ *        fetched, and the DTL receives the data directly into buf.
+ * @param[in]  ctx       the DYAD context for the operation
+ * @param[in]  fname     the name of the file being "consumed"
+ * @param[out] buf       the caller-allocated buffer receiving the file contents
+ * @param[in]  capacity  the size of buf in bytes
+ * @param[out] len       the size of the file contents in bytes. If the file does
+ *                       not fit, this is set to the size needed and
+ *                       DYAD_RC_BADBUF is returned.
+ *
+ * @return An error code from dyad_rc.h
+ */
+DYAD_PFA_ANNOTATE DYAD_DLL_EXPORTED dyad_rc_t dyad_consume_into_buffer (dyad_ctx_t* ctx,
+                                                                        const char* fname,
+                                                                        void* buf,
+                                                                        size_t capacity,
+                                                                        size_t* len);
+
+/**
+ * @brief Release a buffer obtained from dyad_consume_to_buffer
+ * @param[in]     ctx  the DYAD context for the operation
+ * @param[in,out] buf  the buffer to release. Set to NULL on return.
+ *
+ * @return An error code from dyad_rc.h
+ */
+DYAD_DLL_EXPORTED dyad_rc_t dyad_release_buffer (dyad_ctx_t* ctx, void** buf);
+
+/**
+ * @brief Register with the DYAD modules of several brokers ahead of the first
+ *        fetch, so that they connect to this process over the DTL right
+ *        away instead of on its first request. This only has an effect
+ *        with the UCX DTL.
+ * @param[in] ctx     the DYAD context for the operation
+ * @param[in] ranks   the ranks of the brokers, or NULL for every broker
+ * @param[in] nranks  the number of ranks (ignored if ranks is NULL)
+ *
+ * @return An error code from dyad_rc.h: the first error met, if any. The
+ *         brokers that could not be registered with are connected on the
+ *         first fetch as usual.
+ */
+DYAD_DLL_EXPORTED dyad_rc_t dyad_preconnect (dyad_ctx_t* ctx,
+                                             const uint32_t* ranks,
+                                             size_t nranks);
+
 /**
  * @brief Finalizes the DYAD instance and deallocates the context
  * @param[in] ctx  the DYAD context being finalized
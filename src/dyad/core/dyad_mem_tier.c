@@ -0,0 +1,315 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_logging.h>
+#include <dyad/common/dyad_profiler.h>
+#include <dyad/core/dyad_mem_tier.h>
+#include <dyad/utils/murmur3.h>
+#include <dyad/utils/read_all.h>
+#include <dyad/utils/utils.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+#include <climits>
+#include <cstring>
+#else
+#include <limits.h>
+#include <linux/limits.h>
+#include <string.h>
+#endif
+
+#define DYAD_MEM_TIER_NBUCKETS 4096ul
+#define DYAD_MEM_TIER_COPY_CHUNK (1ul << 20)
+
+struct dyad_mem_tier_entry {
+    struct dyad_mem_tier_entry* prev;   // more recently used neighbor
+    struct dyad_mem_tier_entry* next;   // less recently used neighbor
+    struct dyad_mem_tier_entry* hnext;  // next entry in the hash bucket
+    uint32_t hash;                      // hash of upath
+    size_t size;                        // bytes occupied in the tier
+    char upath[];                       // path relative to the managed directory
+};
+
+struct dyad_mem_tier {
+    char* path;                                // directory backing the tier
+    size_t budget;                             // bytes this process may keep in the tier
+    size_t used;                               // bytes this process currently keeps in the tier
+    struct dyad_mem_tier_entry** buckets;      // lookup by upath
+    struct dyad_mem_tier_entry* head;          // most recently used
+    struct dyad_mem_tier_entry* tail;          // least recently used
+};
+
+static uint32_t mem_tier_hash (const char* upath)
+{
+    uint32_t hash = 0u;
+    MurmurHash3_x86_32 (upath, strlen (upath), 57u, &hash);
+    return hash;
+}
+
+static struct dyad_mem_tier_entry* mem_tier_find (const struct dyad_mem_tier* tier,
+                                                  const char* upath,
+                                                  uint32_t hash)
+{
+    struct dyad_mem_tier_entry* e = tier->buckets[hash % DYAD_MEM_TIER_NBUCKETS];
+    for (; e != NULL; e = e->hnext) {
+        if (e->hash == hash && strcmp (e->upath, upath) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void mem_tier_lru_unlink (struct dyad_mem_tier* tier, struct dyad_mem_tier_entry* e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        tier->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        tier->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void mem_tier_lru_push (struct dyad_mem_tier* tier, struct dyad_mem_tier_entry* e)
+{
+    e->prev = NULL;
+    e->next = tier->head;
+    if (tier->head != NULL)
+        tier->head->prev = e;
+    tier->head = e;
+    if (tier->tail == NULL)
+        tier->tail = e;
+}
+
+static void mem_tier_remove (struct dyad_mem_tier* tier, struct dyad_mem_tier_entry* e)
+{
+    struct dyad_mem_tier_entry** pp = &(tier->buckets[e->hash % DYAD_MEM_TIER_NBUCKETS]);
+    while (*pp != NULL && *pp != e)
+        pp = &((*pp)->hnext);
+    if (*pp == e)
+        *pp = e->hnext;
+    mem_tier_lru_unlink (tier, e);
+    tier->used -= (tier->used < e->size) ? tier->used : e->size;
+    free (e);
+}
+
+/// Copy the memory-tier file of e to the consumer-managed path, atomically
+/// replacing the link there, and drop the memory-tier copy.
+static dyad_rc_t mem_tier_demote (const dyad_ctx_t* ctx,
+                                  struct dyad_mem_tier* tier,
+                                  struct dyad_mem_tier_entry* e)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", e->upath);
+    dyad_rc_t rc = DYAD_RC_OK;
+    char src[PATH_MAX + 1] = {'\0'};
+    char dst[PATH_MAX + 1] = {'\0'};
+    char tmp[PATH_MAX + 1] = {'\0'};
+    char* chunk = NULL;
+    int src_fd = -1;
+    int dst_fd = -1;
+    ssize_t n = 0;
+    struct flock shared_lock;
+
+    if (!dyad_mem_tier_path (tier, e->upath, src, PATH_MAX)) {
+        rc = DYAD_RC_BADFIO;
+        goto demote_done;
+    }
+    strncpy (dst, ctx->cons_managed_path, PATH_MAX - 1);
+    concat_str (dst, e->upath, "/", PATH_MAX);
+    if (snprintf (tmp, PATH_MAX, "%s.dyad_demote.%d", dst, ctx->pid) >= PATH_MAX) {
+        rc = DYAD_RC_BADFIO;
+        goto demote_done;
+    }
+    DYAD_LOG_INFO (ctx, "Demoting %s from the memory tier to %s", src, dst);
+    src_fd = open (src, O_RDONLY);
+    if (src_fd < 0) {
+        // Somebody else demoted or removed the file already
+        DYAD_LOG_INFO (ctx, "Memory-tier file %s is already gone", src);
+        rc = DYAD_RC_OK;
+        goto demote_done;
+    }
+    rc = dyad_shared_flock (ctx, src_fd, &shared_lock);
+    if (DYAD_IS_ERROR (rc)) {
+        goto demote_done;
+    }
+    dst_fd = open (tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    chunk = (char*)malloc (DYAD_MEM_TIER_COPY_CHUNK);
+    if (dst_fd < 0 || chunk == NULL) {
+        DYAD_LOG_ERROR (ctx, "Cannot prepare the demotion of %s", src);
+        rc = DYAD_RC_BADFIO;
+        goto demote_unlock;
+    }
+    while ((n = read (src_fd, chunk, DYAD_MEM_TIER_COPY_CHUNK)) > 0) {
+        if (write_all (dst_fd, chunk, (size_t)n) != n) {
+            n = -1;
+            break;
+        }
+    }
+    if (n < 0 || fsync (dst_fd) != 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot copy %s into %s", src, tmp);
+        rc = DYAD_RC_BADFIO;
+        goto demote_unlock;
+    }
+    close (dst_fd);
+    dst_fd = -1;
+    // rename() replaces the link under the consumer-managed path atomically,
+    // so the path always resolves to a complete copy of the file
+    if (rename (tmp, dst) != 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot move %s into place", tmp);
+        rc = DYAD_RC_BADFIO;
+        goto demote_unlock;
+    }
+    unlink (src);
+    rc = DYAD_RC_OK;
+
+demote_unlock:;
+    dyad_release_flock (ctx, src_fd, &shared_lock);
+demote_done:;
+    if (dst_fd >= 0) {
+        close (dst_fd);
+        unlink (tmp);
+    }
+    if (src_fd >= 0)
+        close (src_fd);
+    free (chunk);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_mem_tier_init (const dyad_ctx_t* ctx,
+                              const char* path,
+                              size_t budget,
+                              struct dyad_mem_tier** tier)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    mode_t m = (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH | S_ISGID);
+    if (tier == NULL || path == NULL || strlen (path) == 0) {
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto mem_tier_init_done;
+    }
+    if (mkdir_as_needed (path, m) < 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot create the memory tier directory %s", path);
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto mem_tier_init_done;
+    }
+    *tier = (struct dyad_mem_tier*)calloc (1, sizeof (struct dyad_mem_tier));
+    if (*tier == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto mem_tier_init_done;
+    }
+    (*tier)->buckets = (struct dyad_mem_tier_entry**)calloc (DYAD_MEM_TIER_NBUCKETS,
+                                                             sizeof (struct dyad_mem_tier_entry*));
+    (*tier)->path = strdup (path);
+    if ((*tier)->buckets == NULL || (*tier)->path == NULL) {
+        dyad_mem_tier_finalize (tier);
+        rc = DYAD_RC_SYSFAIL;
+        goto mem_tier_init_done;
+    }
+    (*tier)->budget = budget;
+    DYAD_LOG_INFO (ctx, "Memory tier at %s with a budget of %zu bytes", path, budget);
+    rc = DYAD_RC_OK;
+
+mem_tier_init_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_mem_tier_finalize (struct dyad_mem_tier** tier)
+{
+    if (tier == NULL || *tier == NULL) {
+        return DYAD_RC_OK;
+    }
+    struct dyad_mem_tier_entry* e = (*tier)->head;
+    while (e != NULL) {
+        struct dyad_mem_tier_entry* next = e->next;
+        free (e);
+        e = next;
+    }
+    free ((*tier)->buckets);
+    free ((*tier)->path);
+    free (*tier);
+    *tier = NULL;
+    return DYAD_RC_OK;
+}
+
+bool dyad_mem_tier_path (const struct dyad_mem_tier* tier,
+                         const char* upath,
+                         char* path,
+                         size_t len)
+{
+    int n = snprintf (path, len, "%s" DYAD_PATH_DELIM "%s", tier->path, upath);
+    return (n >= 0 && (size_t)n < len);
+}
+
+bool dyad_mem_tier_fits (const struct dyad_mem_tier* tier, size_t size)
+{
+    return (tier != NULL && size <= tier->budget);
+}
+
+void dyad_mem_tier_touch (struct dyad_mem_tier* tier, const char* upath)
+{
+    struct dyad_mem_tier_entry* e = mem_tier_find (tier, upath, mem_tier_hash (upath));
+    if (e != NULL && e != tier->head) {
+        mem_tier_lru_unlink (tier, e);
+        mem_tier_lru_push (tier, e);
+    }
+}
+
+dyad_rc_t dyad_mem_tier_admit (const dyad_ctx_t* ctx,
+                               struct dyad_mem_tier* tier,
+                               const char* upath,
+                               size_t size)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    DYAD_C_FUNCTION_UPDATE_INT ("size", size);
+    dyad_rc_t rc = DYAD_RC_OK;
+    const uint32_t hash = mem_tier_hash (upath);
+    struct dyad_mem_tier_entry* e = mem_tier_find (tier, upath, hash);
+    if (e != NULL) {
+        tier->used -= e->size;
+        mem_tier_lru_unlink (tier, e);
+    } else {
+        const size_t upath_len = strlen (upath);
+        e = (struct dyad_mem_tier_entry*)calloc (1, sizeof (*e) + upath_len + 1);
+        if (e == NULL) {
+            rc = DYAD_RC_SYSFAIL;
+            goto admit_done;
+        }
+        memcpy (e->upath, upath, upath_len + 1);
+        e->hash = hash;
+        e->hnext = tier->buckets[hash % DYAD_MEM_TIER_NBUCKETS];
+        tier->buckets[hash % DYAD_MEM_TIER_NBUCKETS] = e;
+    }
+    e->size = size;
+    tier->used += size;
+    mem_tier_lru_push (tier, e);
+
+    // Spill the coldest files to the consumer-managed path until the
+    // tier fits in its budget again. The file just admitted is never a victim.
+    while (tier->used > tier->budget && tier->tail != NULL && tier->tail != e) {
+        struct dyad_mem_tier_entry* victim = tier->tail;
+        rc = mem_tier_demote (ctx, tier, victim);
+        if (DYAD_IS_ERROR (rc)) {
+            // Keep serving from memory rather than failing the consume
+            DYAD_LOG_ERROR (ctx, "Cannot demote %s from the memory tier", victim->upath);
+            break;
+        }
+        mem_tier_remove (tier, victim);
+    }
+    rc = DYAD_RC_OK;
+
+admit_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
@@ -0,0 +1,103 @@
+#ifndef DYAD_CORE_DYAD_MEM_TIER_H
+#define DYAD_CORE_DYAD_MEM_TIER_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <dyad/common/dyad_structures.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+/**
+ * The memory tier of the consumer cache.
+ *
+ * Fetched files are first written into a directory on a memory-backed
+ * file system (e.g., /dev/shm), and the corresponding entry under the
+ * consumer-managed path becomes a symbolic link to that copy. Reads through
+ * the consumer-managed path are therefore served from memory. When the bytes
+ * this process placed in the tier exceed the budget, the least recently used
+ * files are demoted: copied to the consumer-managed path, which atomically
+ * replaces the link, and removed from the memory tier.
+ */
+struct dyad_mem_tier;
+
+#define DYAD_MEM_TIER_DEFAULT_BUDGET (1ul << 30)
+
+/**
+ * @brief Create the memory tier state
+ * @param[in]  ctx     the DYAD context for the operation
+ * @param[in]  path    directory on a memory-backed file system
+ * @param[in]  budget  maximum number of bytes this process keeps in the tier
+ * @param[out] tier    the newly created memory tier
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mem_tier_init (const dyad_ctx_t* ctx,
+                              const char* path,
+                              size_t budget,
+                              struct dyad_mem_tier** tier);
+
+/**
+ * @brief Release the memory tier state. Files already placed in the tier are
+ *        left in place so that the links under the consumer-managed path
+ *        stay valid for other processes on the node.
+ * @param[in,out] tier  the memory tier to release
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mem_tier_finalize (struct dyad_mem_tier** tier);
+
+/**
+ * @brief Build the path of the memory-tier copy of a file
+ * @param[in]  tier  the memory tier
+ * @param[in]  upath path of the file relative to the managed directory
+ * @param[out] path  buffer receiving the memory-tier path
+ * @param[in]  len   capacity of path
+ *
+ * @return true if the path fits in the buffer
+ */
+bool dyad_mem_tier_path (const struct dyad_mem_tier* tier,
+                         const char* upath,
+                         char* path,
+                         size_t len);
+
+/**
+ * @brief Check whether a file of the given size may be placed in the tier
+ */
+bool dyad_mem_tier_fits (const struct dyad_mem_tier* tier, size_t size);
+
+/**
+ * @brief Mark a file tracked by this process as recently used
+ */
+void dyad_mem_tier_touch (struct dyad_mem_tier* tier, const char* upath);
+
+/**
+ * @brief Account for a file just placed in the tier, and demote the least
+ *        recently used files until the tier is within its budget again
+ * @param[in] ctx    the DYAD context for the operation
+ * @param[in] tier   the memory tier
+ * @param[in] upath  path of the file relative to the managed directory
+ * @param[in] size   size of the file in bytes
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mem_tier_admit (const dyad_ctx_t* ctx,
+                               struct dyad_mem_tier* tier,
+                               const char* upath,
+                               size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_CORE_DYAD_MEM_TIER_H */
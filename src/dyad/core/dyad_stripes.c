@@ -0,0 +1,186 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_logging.h>
+#include <dyad/common/dyad_profiler.h>
+#include <dyad/core/dyad_stripes.h>
+#include <dyad/utils/murmur3.h>
+#include <dyad/utils/utils.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+
+#ifdef __cplusplus
+#include <cstring>
+#else
+#include <string.h>
+#endif
+
+// Number of entries of the placement table. Each directory gets a share of
+// the entries proportional to its weight.
+#define DYAD_STRIPES_NSLOTS 1024u
+
+struct dyad_stripes {
+    unsigned int ndirs;                      // number of backing directories
+    char** dirs;                             // the backing directories
+    uint16_t slots[DYAD_STRIPES_NSLOTS];     // placement table: slot -> directory
+};
+
+static uint32_t stripes_hash (const char* upath)
+{
+    uint32_t hash = 0u;
+    MurmurHash3_x86_32_legacy (upath, strlen (upath), 57u, &hash);
+    return hash;
+}
+
+/// Fill the placement table so that directory i owns a share of the slots
+/// proportional to weights[i], using the largest remainder method
+static void stripes_fill_slots (struct dyad_stripes* stripes, const uint64_t* weights)
+{
+    uint64_t total = 0ull;
+    unsigned int i = 0u;
+    unsigned int s = 0u;
+    unsigned int assigned = 0u;
+    unsigned int* counts = (unsigned int*)calloc (stripes->ndirs, sizeof (unsigned int));
+    uint64_t* remainders = (uint64_t*)calloc (stripes->ndirs, sizeof (uint64_t));
+
+    for (i = 0u; i < stripes->ndirs; i++)
+        total += weights[i];
+    if (counts == NULL || remainders == NULL || total == 0ull) {
+        // Fall back to an even spread
+        for (s = 0u; s < DYAD_STRIPES_NSLOTS; s++)
+            stripes->slots[s] = (uint16_t)(s % stripes->ndirs);
+        goto fill_done;
+    }
+    for (i = 0u; i < stripes->ndirs; i++) {
+        // Scale down the weights first so that the product cannot overflow
+        const uint64_t w = weights[i] / ((total >> 32) + 1ull);
+        const uint64_t t = total / ((total >> 32) + 1ull);
+        counts[i] = (unsigned int)((w * DYAD_STRIPES_NSLOTS) / t);
+        remainders[i] = (w * DYAD_STRIPES_NSLOTS) % t;
+        assigned += counts[i];
+    }
+    while (assigned < DYAD_STRIPES_NSLOTS) {
+        unsigned int best = 0u;
+        for (i = 1u; i < stripes->ndirs; i++) {
+            if (remainders[i] > remainders[best])
+                best = i;
+        }
+        counts[best]++;
+        remainders[best] = 0ull;
+        assigned++;
+    }
+    // Interleave the directories over the table
+    for (s = 0u, i = 0u; s < DYAD_STRIPES_NSLOTS; i = (i + 1u) % stripes->ndirs) {
+        if (counts[i] > 0u) {
+            counts[i]--;
+            stripes->slots[s++] = (uint16_t)i;
+        }
+    }
+
+fill_done:;
+    free (counts);
+    free (remainders);
+}
+
+dyad_rc_t dyad_stripes_init (const dyad_ctx_t* ctx,
+                             const char* dirs,
+                             enum dyad_stripe_policy policy,
+                             struct dyad_stripes** stripes)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("dirs", dirs);
+    dyad_rc_t rc = DYAD_RC_OK;
+    mode_t m = (S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH | S_ISGID);
+    char* list = NULL;
+    char* saveptr = NULL;
+    char* dir = NULL;
+    uint64_t* weights = NULL;
+    struct statvfs vfs;
+    unsigned int i = 0u;
+    unsigned int ndirs = 1u;
+
+    if (stripes == NULL || dirs == NULL || strlen (dirs) == 0) {
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto stripes_init_done;
+    }
+    for (i = 0u; dirs[i] != '\0'; i++) {
+        if (dirs[i] == ':')
+            ndirs++;
+    }
+    *stripes = (struct dyad_stripes*)calloc (1, sizeof (struct dyad_stripes));
+    list = strdup (dirs);
+    weights = (uint64_t*)calloc (ndirs, sizeof (uint64_t));
+    if (*stripes == NULL || list == NULL || weights == NULL
+        || ((*stripes)->dirs = (char**)calloc (ndirs, sizeof (char*))) == NULL) {
+        dyad_stripes_finalize (stripes);
+        rc = DYAD_RC_SYSFAIL;
+        goto stripes_init_done;
+    }
+    for (dir = strtok_r (list, ":", &saveptr); dir != NULL; dir = strtok_r (NULL, ":", &saveptr)) {
+        if (mkdir_as_needed (dir, m) < 0) {
+            DYAD_LOG_ERROR (ctx, "Cannot create the stripe directory %s", dir);
+            dyad_stripes_finalize (stripes);
+            rc = DYAD_RC_BADMANAGEDPATH;
+            goto stripes_init_done;
+        }
+        i = (*stripes)->ndirs;
+        if (((*stripes)->dirs[i] = strdup (dir)) == NULL) {
+            dyad_stripes_finalize (stripes);
+            rc = DYAD_RC_SYSFAIL;
+            goto stripes_init_done;
+        }
+        // The total size of a file system does not change while the job
+        // runs, unlike the free space, so all the processes agree on it
+        if (policy == DYAD_STRIPE_CAPACITY && statvfs (dir, &vfs) == 0)
+            weights[i] = (uint64_t)vfs.f_blocks * (uint64_t)vfs.f_frsize;
+        else
+            weights[i] = 1ull;
+        DYAD_LOG_INFO (ctx, "Stripe directory %u: %s (weight %lu)", i, dir,
+                       (unsigned long)weights[i]);
+        (*stripes)->ndirs++;
+    }
+    if ((*stripes)->ndirs == 0u) {
+        dyad_stripes_finalize (stripes);
+        rc = DYAD_RC_BADMANAGEDPATH;
+        goto stripes_init_done;
+    }
+    stripes_fill_slots (*stripes, weights);
+    rc = DYAD_RC_OK;
+
+stripes_init_done:;
+    free (weights);
+    free (list);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_stripes_finalize (struct dyad_stripes** stripes)
+{
+    unsigned int i = 0u;
+    if (stripes == NULL || *stripes == NULL) {
+        return DYAD_RC_OK;
+    }
+    if ((*stripes)->dirs != NULL) {
+        for (i = 0u; i < (*stripes)->ndirs; i++)
+            free ((*stripes)->dirs[i]);
+        free ((*stripes)->dirs);
+    }
+    free (*stripes);
+    *stripes = NULL;
+    return DYAD_RC_OK;
+}
+
+bool dyad_stripes_path (const struct dyad_stripes* stripes,
+                        const char* upath,
+                        char* path,
+                        size_t len)
+{
+    const uint16_t d = stripes->slots[stripes_hash (upath) % DYAD_STRIPES_NSLOTS];
+    int n = snprintf (path, len, "%s" DYAD_PATH_DELIM "%s", stripes->dirs[d], upath);
+    return (n >= 0 && (size_t)n < len);
+}
@@ -0,0 +1,77 @@
+#ifndef DYAD_CORE_DYAD_STRIPES_H
+#define DYAD_CORE_DYAD_STRIPES_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <dyad/common/dyad_structures.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+/**
+ * Striping of the consumer cache across several node-local directories
+ * (typically one per local device).
+ *
+ * Each consumed file is stored in one of the backing directories, under the
+ * same path relative to the directory as under the consumer-managed path,
+ * and the entry under the consumer-managed path becomes a symbolic link to
+ * that copy. The directory of a file only depends on its path and on the
+ * list of directories, so every process of the node picks the same one.
+ */
+struct dyad_stripes;
+
+enum dyad_stripe_policy {
+    DYAD_STRIPE_HASH = 0,      // spread files evenly across the directories
+    DYAD_STRIPE_CAPACITY = 1,  // spread files in proportion to the size of the
+                               // file system of each directory
+};
+
+/**
+ * @brief Set up the backing directories
+ * @param[in]  ctx      the DYAD context for the operation
+ * @param[in]  dirs     colon-separated list of directories
+ * @param[in]  policy   how files are placed across the directories
+ * @param[out] stripes  the newly created stripe set
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_stripes_init (const dyad_ctx_t* ctx,
+                             const char* dirs,
+                             enum dyad_stripe_policy policy,
+                             struct dyad_stripes** stripes);
+
+/**
+ * @brief Release the stripe set. Files stored in the directories are left in
+ *        place.
+ */
+dyad_rc_t dyad_stripes_finalize (struct dyad_stripes** stripes);
+
+/**
+ * @brief Build the path of the backing copy of a file
+ * @param[in]  stripes  the stripe set
+ * @param[in]  upath    path of the file relative to the consumer-managed path
+ * @param[out] path     buffer receiving the path of the backing copy
+ * @param[in]  len      capacity of path
+ *
+ * @return true if the path fits in the buffer
+ */
+bool dyad_stripes_path (const struct dyad_stripes* stripes,
+                        const char* upath,
+                        char* path,
+                        size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_CORE_DYAD_STRIPES_H */
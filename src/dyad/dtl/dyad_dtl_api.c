@@ -27,6 +27,11 @@ dyad_rc_t dyad_dtl_init (dyad_ctx_t* ctx,
         goto dtl_init_done;
     }
     ctx->dtl_handle->mode = mode;
+    ctx->dtl_handle->user_buf = NULL;
+    ctx->dtl_handle->user_buf_cap = 0ul;
+    ctx->dtl_handle->user_buf_lent = false;
+    ctx->dtl_handle->send_ack_id = 0u;
+    ctx->dtl_handle->send_deferred = false;
 #if DYAD_ENABLE_UCX_DTL
     if (mode == DYAD_DTL_UCX) {
         rc = dyad_dtl_ucx_init (ctx, mode, comm_mode, debug);
@@ -48,18 +48,66 @@ struct dyad_dtl {
                            const char*  upath,
                            uint32_t producer_rank,
                            json_t**  packed_obj);
+    // Optional. Compact payload of a DYAD_FETCH_RAW_RPC_NAME request, valid
+    // until the next call. size is that of the file as published (-1 if
+    // unknown). DYAD_RC_NOTFOUND means the request must be sent in full with
+    // rpc_pack.
+    dyad_rc_t (*rpc_pack_raw) (const dyad_ctx_t* ctx,
+                               const char* upath,
+                               uint32_t producer_rank,
+                               int64_t size,
+                               const void** payload,
+                               size_t* payload_len);
     dyad_rc_t (*rpc_unpack) (const dyad_ctx_t* ctx, const flux_msg_t* packed_obj, char** upath);
+    // Optional. Size of the file named by a compact request, as its consumer
+    // knows it. DYAD_RC_NOTFOUND if the consumer does not know it.
+    dyad_rc_t (*rpc_unpack_size) (const dyad_ctx_t* ctx, const flux_msg_t* packed_obj, size_t* size);
     dyad_rc_t (*rpc_respond) (const dyad_ctx_t* ctx, const flux_msg_t* orig_msg);
     dyad_rc_t (*rpc_recv_response) (const dyad_ctx_t* ctx, flux_future_t* f);
     dyad_rc_t (*get_buffer) (const dyad_ctx_t* ctx, size_t data_size, void** data_buf);
     dyad_rc_t (*return_buffer) (const dyad_ctx_t* ctx, void** data_buf);
     dyad_rc_t (*establish_connection) (const dyad_ctx_t* ctx);
     dyad_rc_t (*send) (const dyad_ctx_t* ctx, void* buf, size_t buflen);
+    // Optional. The DTL may keep a buffer passed to send registered, so that
+    // sending it again costs no registration. The caller passes such a
+    // buffer to unregister_buffer before releasing it.
+    void (*unregister_buffer) (const dyad_ctx_t* ctx, void* buf);
+    // Set by the caller of send to let the consumer pull the data once send
+    // returns. The DTL then sets send_deferred if it did so, in which case the
+    // buffer stays valid until the consumer sends a DYAD_RMA_ACK_RPC_NAME
+    // request with send_ack_id, or until DYAD_RMA_ACK_TIMEOUT_SECS.
+    uint64_t send_ack_id;
+    bool send_deferred;
     dyad_rc_t (*recv) (const dyad_ctx_t* ctx, void** buf, size_t* buflen);
     dyad_rc_t (*close_connection) (const dyad_ctx_t* ctx);
+    // Buffer of the caller of dyad_consume_into_buffer. get_buffer hands it
+    // out once, instead of a buffer of the DTL, if the data fits in it.
+    void* user_buf;
+    size_t user_buf_cap;
+    bool user_buf_lent;
 };
 typedef struct dyad_dtl dyad_dtl_t;
 
+// Hand out the buffer of the caller for data_size bytes, if it is set and fits
+static inline bool dyad_dtl_lend_user_buf (dyad_dtl_t* dtl, size_t data_size, void** data_buf)
+{
+    if (dtl->user_buf == NULL || dtl->user_buf_lent || data_size > dtl->user_buf_cap)
+        return false;
+    dtl->user_buf_lent = true;
+    *data_buf = dtl->user_buf;
+    return true;
+}
+
+// Take back the buffer of the caller, which the DTL must not release
+static inline bool dyad_dtl_return_user_buf (dyad_dtl_t* dtl, void** data_buf)
+{
+    if (dtl->user_buf == NULL || *data_buf != dtl->user_buf)
+        return false;
+    dtl->user_buf_lent = false;
+    *data_buf = NULL;
+    return true;
+}
+
 dyad_rc_t dyad_dtl_init (dyad_ctx_t* ctx,
                          dyad_dtl_mode_t mode,
                          dyad_dtl_comm_mode_t comm_mode,
@@ -28,6 +28,8 @@ dyad_rc_t dyad_dtl_flux_init (const dyad_ctx_t* ctx,
     ctx->dtl_handle->private_dtl.flux_dtl_handle->msg = NULL;
 
     ctx->dtl_handle->rpc_pack = dyad_dtl_flux_rpc_pack;
+    ctx->dtl_handle->rpc_pack_raw = NULL;
+    ctx->dtl_handle->rpc_unpack_size = NULL;
     ctx->dtl_handle->rpc_unpack = dyad_dtl_flux_rpc_unpack;
     ctx->dtl_handle->rpc_respond = dyad_dtl_flux_rpc_respond;
     ctx->dtl_handle->rpc_recv_response = dyad_dtl_flux_rpc_recv_response;
@@ -35,6 +37,7 @@ dyad_rc_t dyad_dtl_flux_init (const dyad_ctx_t* ctx,
     ctx->dtl_handle->return_buffer = dyad_dtl_flux_return_buffer;
     ctx->dtl_handle->establish_connection = dyad_dtl_flux_establish_connection;
     ctx->dtl_handle->send = dyad_dtl_flux_send;
+    ctx->dtl_handle->unregister_buffer = NULL;
     ctx->dtl_handle->recv = dyad_dtl_flux_recv;
     ctx->dtl_handle->close_connection = dyad_dtl_flux_close_connection;
 
@@ -107,6 +110,10 @@ dyad_rc_t dyad_dtl_flux_get_buffer (const dyad_ctx_t* ctx, size_t data_size, voi
         rc = DYAD_RC_BADBUF;
         goto flux_get_buf_done;
     }
+    if (dyad_dtl_lend_user_buf (ctx->dtl_handle, data_size, data_buf)) {
+        rc = DYAD_RC_OK;
+        goto flux_get_buf_done;
+    }
     *data_buf = malloc (data_size);
     if (*data_buf == NULL) {
         rc = DYAD_RC_SYSFAIL;
@@ -127,6 +134,10 @@ dyad_rc_t dyad_dtl_flux_return_buffer (const dyad_ctx_t* ctx, void** data_buf)
         rc = DYAD_RC_BADBUF;
         goto flux_ret_buf_done;
     }
+    if (dyad_dtl_return_user_buf (ctx->dtl_handle, data_buf)) {
+        rc = DYAD_RC_OK;
+        goto flux_ret_buf_done;
+    }
     free (*data_buf);
     rc = DYAD_RC_OK;
 
@@ -192,6 +203,8 @@ dyad_rc_t dyad_dtl_flux_recv (const dyad_ctx_t* ctx, void** buf, size_t* buflen)
         DYAD_LOG_ERROR (ctx, "Could not get file data from Flux RPC");
         if (errno == ENODATA)
             dyad_rc = DYAD_RC_RPC_FINISHED;
+        else if (errno == EAGAIN)
+            dyad_rc = DYAD_RC_BUSY;
         else
             dyad_rc = DYAD_RC_BADRPC;
         goto finish_recv;
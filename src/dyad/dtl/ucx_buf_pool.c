@@ -0,0 +1,269 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/dtl/ucx_buf_pool.h>
+
+#include <dyad/common/dyad_logging.h>
+#include <dyad/common/dyad_profiler.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Smallest size class is 4 KiB, i.e., a page
+#define UCX_POOL_MIN_SHIFT 12u
+// Size classes up to 2^63 bytes
+#define UCX_POOL_NCLASSES (64u - UCX_POOL_MIN_SHIFT)
+// Returned buffers unused for this long are unmapped
+#define UCX_POOL_IDLE_SECS 10
+// Returned buffers are unmapped once more bytes than this sit unused
+#define UCX_POOL_IDLE_MAX_BYTES (256ul * 1024ul * 1024ul)
+
+struct ucx_buf {
+    struct ucx_buf* next;
+    void* addr;
+    ucp_mem_h memh;
+    unsigned int cls;
+    time_t idle_since;
+};
+
+struct ucx_buf_pool {
+    ucp_context_h ucp_ctx;
+    dyad_dtl_comm_mode_t comm_mode;
+    // Returned buffers of each size class, most recently used first
+    struct ucx_buf* idle[UCX_POOL_NCLASSES];
+    // Buffers handed out and not yet returned
+    struct ucx_buf* busy;
+    size_t idle_bytes;
+    time_t last_trim;
+};
+
+static inline size_t ucx_pool_class_size (unsigned int cls)
+{
+    return (size_t)1u << (cls + UCX_POOL_MIN_SHIFT);
+}
+
+// Smallest size class holding size bytes
+static inline unsigned int ucx_pool_class (size_t size)
+{
+    unsigned int cls = 0u;
+    while (cls < UCX_POOL_NCLASSES - 1u && ucx_pool_class_size (cls) < size)
+        cls++;
+    return cls;
+}
+
+static void ucx_pool_unmap (ucx_buf_pool_h pool, struct ucx_buf* b)
+{
+    ucp_mem_unmap (pool->ucp_ctx, b->memh);
+    free (b);
+}
+
+static dyad_rc_t ucx_pool_map (const dyad_ctx_t* ctx,
+                               ucx_buf_pool_h pool,
+                               unsigned int cls,
+                               struct ucx_buf** buf)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    ucs_status_t status;
+    ucp_mem_map_params_t mmap_params;
+    ucp_mem_attr_t attr;
+    struct ucx_buf* b = (struct ucx_buf*)calloc (1, sizeof (*b));
+    if (b == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto ucx_pool_map_done;
+    }
+    DYAD_LOG_DEBUG (ctx, "Mapping a UCX buffer of %zu bytes", ucx_pool_class_size (cls));
+    mmap_params.field_mask = UCP_MEM_MAP_PARAM_FIELD_ADDRESS | UCP_MEM_MAP_PARAM_FIELD_LENGTH
+                             | UCP_MEM_MAP_PARAM_FIELD_FLAGS | UCP_MEM_MAP_PARAM_FIELD_MEMORY_TYPE
+                             | UCP_MEM_MAP_PARAM_FIELD_PROT;
+    mmap_params.address = NULL;
+    mmap_params.memory_type = UCS_MEMORY_TYPE_HOST;
+    mmap_params.length = ucx_pool_class_size (cls);
+    mmap_params.flags = UCP_MEM_MAP_ALLOCATE;
+    if (pool->comm_mode == DYAD_COMM_SEND) {
+        mmap_params.prot = UCP_MEM_MAP_PROT_LOCAL_READ;
+    } else {
+        mmap_params.prot = UCP_MEM_MAP_PROT_REMOTE_WRITE;
+    }
+    status = ucp_mem_map (pool->ucp_ctx, &mmap_params, &b->memh);
+    if (status != UCS_OK) {
+        DYAD_LOG_ERROR (ctx, "ucp_mem_map failed (status = %d)", (int)status);
+        free (b);
+        rc = DYAD_RC_UCXMMAP_FAIL;
+        goto ucx_pool_map_done;
+    }
+    attr.field_mask = UCP_MEM_ATTR_FIELD_ADDRESS;
+    status = ucp_mem_query (b->memh, &attr);
+    if (status != UCS_OK) {
+        DYAD_LOG_ERROR (ctx, "Failed to get address to UCX allocated buffer");
+        ucx_pool_unmap (pool, b);
+        rc = DYAD_RC_UCXMMAP_FAIL;
+        goto ucx_pool_map_done;
+    }
+    b->addr = attr.address;
+    b->cls = cls;
+    *buf = b;
+    rc = DYAD_RC_OK;
+
+ucx_pool_map_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+// Unmap the returned buffers that have not been used for a while
+static void ucx_pool_trim (ucx_buf_pool_h pool, time_t now)
+{
+    unsigned int cls = 0u;
+    struct ucx_buf** prev = NULL;
+    struct ucx_buf* b = NULL;
+    if (now - pool->last_trim < UCX_POOL_IDLE_SECS)
+        return;
+    pool->last_trim = now;
+    for (cls = 0u; cls < UCX_POOL_NCLASSES; cls++) {
+        prev = &pool->idle[cls];
+        while ((b = *prev) != NULL) {
+            if (now - b->idle_since >= UCX_POOL_IDLE_SECS) {
+                *prev = b->next;
+                pool->idle_bytes -= ucx_pool_class_size (cls);
+                ucx_pool_unmap (pool, b);
+            } else {
+                prev = &b->next;
+            }
+        }
+    }
+}
+
+dyad_rc_t dyad_ucx_buf_pool_init (const dyad_ctx_t* ctx,
+                                  ucp_context_h ucp_ctx,
+                                  dyad_dtl_comm_mode_t comm_mode,
+                                  ucx_buf_pool_h* pool)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    if (ucp_ctx == NULL) {
+        DYAD_LOG_ERROR (ctx, "No UCX context provided");
+        rc = DYAD_RC_NOCTX;
+        goto ucx_pool_init_done;
+    }
+    if (comm_mode == DYAD_COMM_NONE) {
+        rc = DYAD_RC_BAD_COMM_MODE;
+        goto ucx_pool_init_done;
+    }
+    *pool = (ucx_buf_pool_h)calloc (1, sizeof (struct ucx_buf_pool));
+    if (*pool == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto ucx_pool_init_done;
+    }
+    (*pool)->ucp_ctx = ucp_ctx;
+    (*pool)->comm_mode = comm_mode;
+    (*pool)->last_trim = time (NULL);
+    rc = DYAD_RC_OK;
+
+ucx_pool_init_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_ucx_buf_pool_get (const dyad_ctx_t* ctx,
+                                 ucx_buf_pool_h pool,
+                                 size_t size,
+                                 void** buf)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    unsigned int cls = ucx_pool_class (size);
+    struct ucx_buf* b = NULL;
+    if (pool == NULL || buf == NULL) {
+        rc = DYAD_RC_BADBUF;
+        goto ucx_pool_get_done;
+    }
+    if (size > ucx_pool_class_size (cls)) {
+        DYAD_LOG_ERROR (ctx, "Cannot get a UCX buffer of %zu bytes", size);
+        rc = DYAD_RC_BADBUF;
+        goto ucx_pool_get_done;
+    }
+    if ((b = pool->idle[cls]) != NULL) {
+        pool->idle[cls] = b->next;
+        pool->idle_bytes -= ucx_pool_class_size (cls);
+    } else {
+        rc = ucx_pool_map (ctx, pool, cls, &b);
+        if (DYAD_IS_ERROR (rc))
+            goto ucx_pool_get_done;
+    }
+    b->next = pool->busy;
+    pool->busy = b;
+    *buf = b->addr;
+    rc = DYAD_RC_OK;
+
+ucx_pool_get_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_ucx_buf_pool_put (const dyad_ctx_t* ctx, ucx_buf_pool_h pool, void* buf)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct ucx_buf** prev = NULL;
+    struct ucx_buf* b = NULL;
+    time_t now = time (NULL);
+    if (pool == NULL || buf == NULL) {
+        rc = DYAD_RC_BADBUF;
+        goto ucx_pool_put_done;
+    }
+    // Few buffers are in use at once, so a list is enough
+    for (prev = &pool->busy; (b = *prev) != NULL; prev = &b->next) {
+        if (b->addr == buf)
+            break;
+    }
+    if (b == NULL) {
+        DYAD_LOG_ERROR (ctx, "Returned a buffer that is not from the UCX buffer pool");
+        rc = DYAD_RC_BADBUF;
+        goto ucx_pool_put_done;
+    }
+    *prev = b->next;
+    if (pool->idle_bytes + ucx_pool_class_size (b->cls) > UCX_POOL_IDLE_MAX_BYTES) {
+        ucx_pool_unmap (pool, b);
+    } else {
+        b->idle_since = now;
+        b->next = pool->idle[b->cls];
+        pool->idle[b->cls] = b;
+        pool->idle_bytes += ucx_pool_class_size (b->cls);
+    }
+    ucx_pool_trim (pool, now);
+    rc = DYAD_RC_OK;
+
+ucx_pool_put_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+dyad_rc_t dyad_ucx_buf_pool_finalize (const dyad_ctx_t* ctx, ucx_buf_pool_h* pool)
+{
+    DYAD_C_FUNCTION_START();
+    unsigned int cls = 0u;
+    struct ucx_buf* b = NULL;
+    if (pool == NULL || *pool == NULL)
+        goto ucx_pool_finalize_done;
+    if ((*pool)->busy != NULL)
+        DYAD_LOG_INFO (ctx, "Releasing UCX buffers that are still in use");
+    while ((b = (*pool)->busy) != NULL) {
+        (*pool)->busy = b->next;
+        ucx_pool_unmap (*pool, b);
+    }
+    for (cls = 0u; cls < UCX_POOL_NCLASSES; cls++) {
+        while ((b = (*pool)->idle[cls]) != NULL) {
+            (*pool)->idle[cls] = b->next;
+            ucx_pool_unmap (*pool, b);
+        }
+    }
+    free (*pool);
+    *pool = NULL;
+
+ucx_pool_finalize_done:;
+    DYAD_C_FUNCTION_END();
+    return DYAD_RC_OK;
+}
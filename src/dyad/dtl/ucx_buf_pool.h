@@ -0,0 +1,52 @@
+#ifndef DYAD_DTL_UCX_BUF_POOL_H
+#define DYAD_DTL_UCX_BUF_POOL_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <dyad/common/dyad_structures.h>
+#include <dyad/dtl/dyad_dtl_api.h>
+#include <ucp/api/ucp.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+// Pool of buffers registered with UCX (ucp_mem_map), in power-of-two size
+// classes. A buffer is mapped the first time its size class is needed and
+// kept for reuse once returned. Returned buffers are unmapped once they stay
+// unused for a while, or once too many bytes sit unused in the pool.
+// Like the UCP worker it serves, a pool must only be used by one thread
+// at a time.
+typedef struct ucx_buf_pool* ucx_buf_pool_h;
+
+dyad_rc_t dyad_ucx_buf_pool_init (const dyad_ctx_t* ctx,
+                                  ucp_context_h ucp_ctx,
+                                  dyad_dtl_comm_mode_t comm_mode,
+                                  ucx_buf_pool_h* pool);
+
+// Get a registered buffer of at least size bytes
+dyad_rc_t dyad_ucx_buf_pool_get (const dyad_ctx_t* ctx,
+                                 ucx_buf_pool_h pool,
+                                 size_t size,
+                                 void** buf);
+
+// Give back a buffer obtained from dyad_ucx_buf_pool_get
+dyad_rc_t dyad_ucx_buf_pool_put (const dyad_ctx_t* ctx, ucx_buf_pool_h pool, void* buf);
+
+
+// Unmap every buffer. Buffers still in use are unmapped as well.
+dyad_rc_t dyad_ucx_buf_pool_finalize (const dyad_ctx_t* ctx, ucx_buf_pool_h* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_DTL_UCX_BUF_POOL_H */
@@ -6,6 +6,7 @@
 
 #include <dyad/dtl/ucx_dtl.h>
 
+#include <dyad/common/dyad_envs.h>
 #include <dyad/common/dyad_logging.h>
 #include <dyad/common/dyad_profiler.h>
 #include <dyad/utils/base64/base64.h>
@@ -13,7 +14,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <assert.h>
+#include <errno.h>
+#include <poll.h>
 
 extern const base64_maps_t base64_maps_rfc4648;
 
@@ -22,6 +26,107 @@ extern const base64_maps_t base64_maps_rfc4648;
 // Tag mask for UCX Tag send/recv
 #define DYAD_UCX_TAG_MASK UINT64_MAX
 
+// Set in the tags of the messages of the RMA protocol. Tags are otherwise
+// made of two ranks, which never use their highest bit.
+#define DYAD_UCX_RMA_TAG_BIT (1ull << 63)
+
+// Set in the tags of the messages of a file sent in chunks
+#define DYAD_UCX_CHUNK_TAG_BIT (1ull << 62)
+
+// The chunks themselves also carry the sequence number of the file, which
+// is never 0, in the bits below DYAD_UCX_CHUNK_TAG_BIT (so producer ranks
+// stay below 2^22). They never match the probe for a new message, and the
+// chunks of a failed transfer never match the receives of a later one.
+#define DYAD_UCX_CHUNK_SEQ_SHIFT 54
+#define DYAD_UCX_CHUNK_SEQ_MAX 0xffu
+
+// Time a consumer keeps receiving the chunks of a failed transfer, so that
+// the producer is not left with sends that never complete
+#define DYAD_UCX_CHUNK_DRAIN_SECS 10
+
+// Default size of the chunks large files are sent in, and number of chunks
+// in flight at once
+#define DYAD_UCX_CHUNK_DEFAULT (4ul * 1024ul * 1024ul)
+#define DYAD_UCX_PIPELINE_DEFAULT 4u
+#define DYAD_UCX_PIPELINE_MAX 64u
+
+// Time a producer keeps a buffer exposed for a consumer to pull it
+#define DYAD_UCX_RMA_TIMEOUT_SECS 60
+
+// Identifier of the active messages carrying files to consumers
+#define DYAD_UCX_AM_ID 0u
+
+// Default upper bound of the time a wait spins before blocking
+#define DYAD_UCX_SPIN_DEFAULT_US 100u
+
+// Longest a blocked wait sleeps before checking again, in case an event
+// does not wake the worker
+#define DYAD_UCX_POLL_TIMEOUT_MS 100
+
+// Sent by a producer, in place of the data, to a consumer that pulls the data
+// with RMA. The packed remote key and the address of the producer's worker
+// follow it.
+struct ucx_rma_desc {
+    uint64_t id;        // echoed by the consumer once it pulled the data
+    uint64_t addr;      // address of the data in the producer
+    uint64_t len;       // size of the data
+    uint32_t rkey_len;  // size of the packed remote key
+    uint32_t addr_len;  // size of the worker address
+    uint32_t flags;     // DYAD_UCX_RMA_*
+    uint32_t reserved;
+};
+
+// The producer does not wait for the consumer: the consumer echoes the
+// identifier to the module of the producer with a DYAD_RMA_ACK_RPC_NAME
+// request instead of a tagged message
+#define DYAD_UCX_RMA_FLUX_ACK 0x1u
+
+// Sent by a producer before the chunks of a file, which follow it with the
+// same tag, in order
+struct ucx_chunk_hdr {
+    uint64_t len;    // size of the file
+    uint64_t chunk;  // size of every chunk but the last
+    uint64_t seq;    // sequence number in the tags of the chunks
+};
+
+// Header of the active message carrying a file to a consumer that asked for
+// active messages. The path of the file follows it.
+struct ucx_am_hdr {
+    uint64_t id;         // identifier the consumer gave to its request
+    uint64_t len;        // size of the data
+    uint32_t upath_len;  // size of the path, without the terminating null byte
+};
+
+// Follows the path in the payload of a compact request (dyad.fetch_raw). It
+// is in the byte order of the consumer, which the magic number checks.
+struct ucx_raw_req {
+    uint32_t magic;     // DYAD_UCX_RAW_MAGIC
+    uint32_t flags;     // DYAD_UCX_RAW_* options of the consumer
+    uint32_t tag_prod;  // rank of the producer
+    uint32_t tag_cons;  // rank of the consumer
+    uint64_t conn_id;   // connection of the consumer, known to the module
+    uint64_t am_id;     // as in a request in full, 0 without active messages
+    uint64_t size;      // size of the file as published, DYAD_UCX_RAW_NO_SIZE if unknown
+};
+
+#define DYAD_UCX_RAW_MAGIC 0x44594144u
+#define DYAD_UCX_RAW_NO_SIZE UINT64_MAX
+#define DYAD_UCX_RAW_RMA 0x1u
+#define DYAD_UCX_RAW_CHUNKS 0x2u
+
+// What a consumer knows of the module of a rank
+#define DYAD_UCX_RANK_UNKNOWN 0u     // requests are sent in full
+#define DYAD_UCX_RANK_REGISTERED 1u  // the module has the address of the consumer
+#define DYAD_UCX_RANK_FULL 2u        // the module only takes requests in full
+
+// Number of consumer addresses the modules of a process keep by default
+// (DYAD_UCX_CONNS), and number of ways of each set of the table holding them
+#define DYAD_UCX_CONNS_DEFAULT 65536u
+#define DYAD_UCX_CONN_WAYS 8u
+
+// Buckets of the table of the buffers registered for RMA
+#define DYAD_UCX_REG_BUCKETS 1024u
+
 // Define a request struct to be used in handling
 // async UCX operations
 struct ucx_request {
@@ -71,6 +176,55 @@ static void dyad_send_callback (void* req, ucs_status_t status)
     DYAD_C_FUNCTION_END();
 }
 
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+static void dyad_am_recv_data_callback (void* request,
+                                        ucs_status_t status,
+                                        size_t length,
+                                        void* user_data)
+{
+    dyad_ucx_request_t* real_req = (dyad_ucx_request_t*)request;
+    real_req->completed = 1;
+}
+
+// Called while progressing the worker of a consumer when an active message
+// with a file arrives. The data (or, for large files, the descriptor of the
+// rendezvous to receive it with) is kept until dyad_dtl_ucx_recv gets to it.
+static ucs_status_t dyad_am_recv_callback (void* arg,
+                                           const void* header,
+                                           size_t header_length,
+                                           void* data,
+                                           size_t length,
+                                           const ucp_am_recv_param_t* param)
+{
+    dyad_dtl_ucx_t* h = (dyad_dtl_ucx_t*)arg;
+    const struct ucx_am_hdr* hdr = (const struct ucx_am_hdr*)header;
+    // Drop what does not answer the request under way, e.g., the late
+    // answer to a request that failed
+    if (header_length < sizeof (*hdr) || header_length != sizeof (*hdr) + hdr->upath_len
+        || h->am_arrived || hdr->id != h->am_id || hdr->len != length || h->am_upath == NULL
+        || strlen (h->am_upath) != hdr->upath_len
+        || memcmp (hdr + 1, h->am_upath, hdr->upath_len) != 0) {
+        return UCS_OK;
+    }
+    h->am_arrived = true;
+    h->am_len = length;
+    h->am_rndv = (param->recv_attr & UCP_AM_RECV_ATTR_FLAG_RNDV) != 0;
+    h->am_copied = false;
+    if (h->am_rndv || (param->recv_attr & UCP_AM_RECV_ATTR_FLAG_DATA)) {
+        h->am_data = data;
+        return UCS_INPROGRESS;
+    }
+    // The data only lives as long as the callback. It is small, as larger
+    // data comes with a rendezvous.
+    h->am_data = malloc (length > 0 ? length : 1);
+    if (h->am_data != NULL) {
+        memcpy (h->am_data, data, length);
+        h->am_copied = true;
+    }
+    return UCS_OK;
+}
+#endif
+
 static void dyad_ucx_ep_err_handler (void* arg, ucp_ep_h ep, ucs_status_t status)
 {
     DYAD_C_FUNCTION_START();
@@ -80,27 +234,149 @@ static void dyad_ucx_ep_err_handler (void* arg, ucp_ep_h ep, ucs_status_t status
     DYAD_C_FUNCTION_END();
 }
 
+// 64-bit FNV-1a hash, used to key the endpoints to producers by worker
+// address and to name the connections of consumers
+static uint64_t ucx_addr_hash (const void* addr, size_t len)
+{
+    const unsigned char* p = (const unsigned char*)addr;
+    uint64_t h = 14695981039346656037ull;
+    size_t i = 0;
+    for (i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// State of a wait on the worker
+struct ucx_waiter {
+    struct timespec start;
+    bool blocked;  // the wait had to block
+};
+
+static inline unsigned long ucx_elapsed_us (const struct timespec* start)
+{
+    struct timespec now;
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (unsigned long)((now.tv_sec - start->tv_sec) * 1000000L
+                           + (now.tv_nsec - start->tv_nsec) / 1000L);
+}
+
+static inline void ucx_lock (dyad_dtl_ucx_t* h)
+{
+    if (h->progress_thread_on)
+        pthread_mutex_lock (&h->lock);
+}
+
+static inline void ucx_unlock (dyad_dtl_ucx_t* h)
+{
+    if (h->progress_thread_on)
+        pthread_mutex_unlock (&h->lock);
+}
+
+static void ucx_wait_begin (dyad_dtl_ucx_t* h, struct ucx_waiter* w)
+{
+    clock_gettime (CLOCK_MONOTONIC, &w->start);
+    w->blocked = false;
+    // Operations were just posted, which the progress thread may be sleeping
+    // through
+    if (h->progress_thread_on)
+        ucp_worker_signal (h->ucx_worker);
+}
+
+// Let the worker make progress once. A wait spins for up to spin_us, then
+// sleeps on the event fd of the worker until something happens. With a
+// progress thread, a wait sleeps until the thread made progress.
+static void ucx_wait_step (dyad_dtl_ucx_t* h, struct ucx_waiter* w)
+{
+    struct pollfd pfd;
+    struct timespec deadline;
+    ucs_status_t status = UCS_OK;
+    if (h->progress_thread_on) {
+        clock_gettime (CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += DYAD_UCX_POLL_TIMEOUT_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        w->blocked = true;
+        pthread_cond_timedwait (&h->cond, &h->lock, &deadline);
+        return;
+    }
+    if (ucp_worker_progress (h->ucx_worker) > 0 || h->efd < 0
+        || ucx_elapsed_us (&w->start) < h->spin_us) {
+        return;
+    }
+    // Only sleep if no event is pending
+    status = ucp_worker_arm (h->ucx_worker);
+    if (status != UCS_OK) {
+        return;
+    }
+    w->blocked = true;
+    pfd.fd = h->efd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    poll (&pfd, 1, DYAD_UCX_POLL_TIMEOUT_MS);
+}
+
+// Adapt the spinning time to how long waits last: spin longer if a wait
+// blocked shortly before it would have ended, and less if waits are long
+static void ucx_wait_end (dyad_dtl_ucx_t* h, const struct ucx_waiter* w)
+{
+    if (!w->blocked || h->progress_thread_on) {
+        return;
+    }
+    if (ucx_elapsed_us (&w->start) < 2ul * h->spin_max_us) {
+        h->spin_us = (h->spin_us == 0u) ? 1u : 2u * h->spin_us;
+        if (h->spin_us > h->spin_max_us)
+            h->spin_us = h->spin_max_us;
+    } else {
+        h->spin_us /= 2u;
+    }
+}
+
+// Progress the worker on its own, so that waits do not have to
+static void* ucx_progress_thread (void* arg)
+{
+    dyad_dtl_ucx_t* h = (dyad_dtl_ucx_t*)arg;
+    struct pollfd pfd;
+    pfd.fd = h->efd;
+    pfd.events = POLLIN;
+    pthread_mutex_lock (&h->lock);
+    while (!h->progress_stop) {
+        if (ucp_worker_progress (h->ucx_worker) > 0) {
+            pthread_cond_broadcast (&h->cond);
+            // Let the waiting thread in
+            pthread_mutex_unlock (&h->lock);
+            pthread_mutex_lock (&h->lock);
+            continue;
+        }
+        if (ucp_worker_arm (h->ucx_worker) == UCS_ERR_BUSY) {
+            continue;
+        }
+        pthread_mutex_unlock (&h->lock);
+        pfd.revents = 0;
+        poll (&pfd, 1, DYAD_UCX_POLL_TIMEOUT_MS);
+        pthread_mutex_lock (&h->lock);
+    }
+    pthread_mutex_unlock (&h->lock);
+    return NULL;
+}
+
 // Simple function used to wait on the async receive
 static ucs_status_t dyad_ucx_request_wait (const dyad_ctx_t* ctx,
                                            dyad_ucx_request_t* request)
 {
     DYAD_C_FUNCTION_START();
     ucs_status_t final_request_status = UCS_OK;
+    dyad_dtl_ucx_t* h = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    struct ucx_waiter w;
     // If 'request' is actually a request handle, this means the communication
     // operation is scheduled, but not yet completed.
     if (UCS_PTR_IS_PTR (request)) {
-        // Spin lock until the request is completed
-        // The spin lock shouldn't be costly (performance-wise)
-        // because the wait should always come directly after other UCX calls
-        // that minimize the size of the worker's event queue.
-        // In other words, prior UCX calls should mean that this loop only runs
-        // a couple of times at most.
-        do {
-            ucp_worker_progress (ctx->dtl_handle->private_dtl.ucx_dtl_handle->ucx_worker);
-            // usleep(100);
-            // Get the final status of the communication operation
-            final_request_status = ucp_request_check_status (request);
-        } while (final_request_status == UCS_INPROGRESS);
+        ucx_wait_begin (h, &w);
+        while ((final_request_status = ucp_request_check_status (request)) == UCS_INPROGRESS) {
+            ucx_wait_step (h, &w);
+        }
+        ucx_wait_end (h, &w);
         // Free and deallocate the request object
         ucp_request_free (request);
         goto dtl_ucx_request_wait_region_finish;
@@ -121,98 +397,556 @@ dtl_ucx_request_wait_region_finish:;
     return final_request_status;
 }
 
-static dyad_rc_t ucx_allocate_buffer (const dyad_ctx_t *ctx,
-                                      ucp_context_h ucp_ctx,
-                                      size_t buf_size,
-                                      dyad_dtl_comm_mode_t comm_mode,
-                                      ucp_mem_h mem_handle,
-                                      void** buf)
+// Registrations of the buffers exposed with RMA, shared by the DTLs of the
+// process, so that a buffer sent again (e.g., from the hot cache of the
+// module) is only registered once. A buffer stays registered until it is
+// passed to unregister_buffer, which its owner does before releasing it.
+struct ucx_reg {
+    struct ucx_reg* next;   // next registration in the bucket
+    void* buf;
+    size_t len;
+    ucp_context_h ucp_ctx;  // context the buffer is registered with
+    ucp_mem_h memh;
+    void* rkey_buf;         // packed remote key to the buffer
+    size_t rkey_len;
+};
+static pthread_mutex_t ucx_reg_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ucx_reg* ucx_regs[DYAD_UCX_REG_BUCKETS];
+
+static inline unsigned int ucx_reg_bucket (const void* buf)
 {
-    DYAD_C_FUNCTION_START();
-    dyad_rc_t rc = DYAD_RC_BADBUF;
-    ucs_status_t status;
+    return (unsigned int)(((uintptr_t)buf >> 4) % DYAD_UCX_REG_BUCKETS);
+}
+
+static void ucx_reg_free (struct ucx_reg* r)
+{
+    if (r->rkey_buf != NULL)
+        ucp_rkey_buffer_release (r->rkey_buf);
+    if (r->memh != NULL)
+        ucp_mem_unmap (r->ucp_ctx, r->memh);
+    free (r);
+}
+
+// Registration of at least buflen bytes at buf, made on the first call
+static dyad_rc_t ucx_reg_get (const dyad_ctx_t* ctx,
+                              void* buf,
+                              size_t buflen,
+                              const struct ucx_reg** reg)
+{
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    const unsigned int b = ucx_reg_bucket (buf);
     ucp_mem_map_params_t mmap_params;
-    ucp_mem_attr_t attr;
-    if (ucp_ctx == NULL) {
-        rc = DYAD_RC_NOCTX;
-        DYAD_LOG_ERROR (ctx, "No UCX context provided");
-        goto ucx_allocate_done;
-    }
-    if (buf == NULL) {
-        rc = DYAD_RC_BADBUF;
-        DYAD_LOG_ERROR (ctx, "Bad data buffer pointer provided");
-        goto ucx_allocate_done;
+    struct ucx_reg* r = NULL;
+    struct ucx_reg* found = NULL;
+    ucs_status_t status = UCS_OK;
+
+    pthread_mutex_lock (&ucx_reg_lock);
+    for (found = ucx_regs[b]; found != NULL; found = found->next) {
+        if (found->buf == buf && found->len >= buflen)
+            break;
     }
-    if (comm_mode == DYAD_COMM_NONE) {
-        rc = DYAD_RC_BAD_COMM_MODE;
-        goto ucx_allocate_done;
+    pthread_mutex_unlock (&ucx_reg_lock);
+    if (found != NULL) {
+        *reg = found;
+        return DYAD_RC_OK;
     }
-    DYAD_LOG_INFO (ctx, "Allocating memory with UCX");
+    if ((r = (struct ucx_reg*)calloc (1, sizeof (*r))) == NULL)
+        return DYAD_RC_SYSFAIL;
+    r->buf = buf;
+    r->len = buflen;
+    r->ucp_ctx = dtl_handle->ucx_ctx;
     mmap_params.field_mask = UCP_MEM_MAP_PARAM_FIELD_ADDRESS | UCP_MEM_MAP_PARAM_FIELD_LENGTH
-                             | UCP_MEM_MAP_PARAM_FIELD_FLAGS | UCP_MEM_MAP_PARAM_FIELD_MEMORY_TYPE
                              | UCP_MEM_MAP_PARAM_FIELD_PROT;
-    mmap_params.address = NULL;
-    mmap_params.memory_type = UCS_MEMORY_TYPE_HOST;
-    mmap_params.length = buf_size;
-    mmap_params.flags = UCP_MEM_MAP_ALLOCATE;
-    if (comm_mode == DYAD_COMM_SEND) {
-        mmap_params.prot = UCP_MEM_MAP_PROT_LOCAL_READ;
-    } else {
-        mmap_params.prot = UCP_MEM_MAP_PROT_REMOTE_WRITE;
+    mmap_params.address = buf;
+    mmap_params.length = buflen;
+    mmap_params.prot = UCP_MEM_MAP_PROT_LOCAL_READ | UCP_MEM_MAP_PROT_REMOTE_READ;
+    status = ucp_mem_map (dtl_handle->ucx_ctx, &mmap_params, &r->memh);
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_ERROR (ctx, "Cannot register the buffer to send (status = %d)", (int)status);
+        r->memh = NULL;
+        ucx_reg_free (r);
+        return DYAD_RC_UCXMMAP_FAIL;
     }
-    status = ucp_mem_map (ucp_ctx, &mmap_params, &mem_handle);
+    status = ucp_rkey_pack (dtl_handle->ucx_ctx, r->memh, &r->rkey_buf, &r->rkey_len);
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_ERROR (ctx, "Cannot pack the remote key (status = %d)", (int)status);
+        r->rkey_buf = NULL;
+        ucx_reg_free (r);
+        return DYAD_RC_UCXMMAP_FAIL;
+    }
+    // Another thread sending the same buffer may have registered it first,
+    // in which case both registrations last until the buffer is unregistered
+    pthread_mutex_lock (&ucx_reg_lock);
+    r->next = ucx_regs[b];
+    ucx_regs[b] = r;
+    pthread_mutex_unlock (&ucx_reg_lock);
+    *reg = r;
+    return DYAD_RC_OK;
+}
+
+// Drop every registration left, before the UCX context is cleaned up
+static void ucx_reg_clear (void)
+{
+    struct ucx_reg* r = NULL;
+    unsigned int b = 0u;
+    pthread_mutex_lock (&ucx_reg_lock);
+    for (b = 0u; b < DYAD_UCX_REG_BUCKETS; b++) {
+        while ((r = ucx_regs[b]) != NULL) {
+            ucx_regs[b] = r->next;
+            ucx_reg_free (r);
+        }
+    }
+    pthread_mutex_unlock (&ucx_reg_lock);
+}
+
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+// Same as dyad_ucx_request_wait, but the request is canceled if it is not
+// completed by the deadline
+static ucs_status_t dyad_ucx_request_wait_until (const dyad_ctx_t* ctx,
+                                                 dyad_ucx_request_t* request,
+                                                 time_t deadline)
+{
+    dyad_dtl_ucx_t* h = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    ucs_status_t status = UCS_OK;
+    struct ucx_waiter w;
+    if (!UCS_PTR_IS_PTR (request)) {
+        return UCS_PTR_STATUS (request);
+    }
+    ucx_wait_begin (h, &w);
+    while ((status = ucp_request_check_status (request)) == UCS_INPROGRESS) {
+        ucx_wait_step (h, &w);
+        if (time (NULL) >= deadline) {
+            ucp_request_cancel (h->ucx_worker, request);
+            while ((status = ucp_request_check_status (request)) == UCS_INPROGRESS)
+                ucx_wait_step (h, &w);
+            break;
+        }
+    }
+    ucx_wait_end (h, &w);
+    ucp_request_free (request);
+    return status;
+}
+
+// Expose a buffer to the consumer and send it where to pull the data from.
+// The producer's CPU does not move the data. If the caller set send_ack_id,
+// the consumer acknowledges the transfer to the module, and the worker does
+// not wait for it. Otherwise, wait for the consumer to be done.
+static dyad_rc_t ucx_rma_send (const dyad_ctx_t* ctx, void* buf, size_t buflen)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    const ucp_tag_t tag = dtl_handle->comm_tag | DYAD_UCX_RMA_TAG_BIT;
+    const struct ucx_reg* reg = NULL;
+    ucp_request_param_t params;
+    struct ucx_rma_desc* desc = NULL;
+    size_t desc_len = 0;
+    uint64_t ack = 0;
+    ucs_status_t status = UCS_OK;
+    time_t deadline = time (NULL) + DYAD_UCX_RMA_TIMEOUT_SECS;
+
+    rc = ucx_reg_get (ctx, buf, buflen, &reg);
+    if (DYAD_IS_ERROR (rc)) {
+        goto ucx_rma_send_done;
+    }
+    desc_len = sizeof (*desc) + reg->rkey_len + dtl_handle->local_addr_len;
+    desc = (struct ucx_rma_desc*)malloc (desc_len);
+    if (desc == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto ucx_rma_send_done;
+    }
+    desc->id = ++dtl_handle->rma_id;
+    desc->flags = 0u;
+    desc->reserved = 0u;
+    if (ctx->dtl_handle->send_ack_id != 0u) {
+        desc->id = ctx->dtl_handle->send_ack_id;
+        desc->flags |= DYAD_UCX_RMA_FLUX_ACK;
+    }
+    desc->addr = (uint64_t)(uintptr_t)buf;
+    desc->len = buflen;
+    desc->rkey_len = (uint32_t)reg->rkey_len;
+    desc->addr_len = (uint32_t)dtl_handle->local_addr_len;
+    memcpy (desc + 1, reg->rkey_buf, reg->rkey_len);
+    memcpy ((char*)(desc + 1) + reg->rkey_len, dtl_handle->local_address,
+            dtl_handle->local_addr_len);
+    DYAD_LOG_INFO (ctx, "Exposing %zu bytes to the consumer with RMA", buflen);
+    params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK;
+    params.cb.send = dyad_send_callback;
+    status = dyad_ucx_request_wait (ctx, ucp_tag_send_nbx (dtl_handle->ep, desc, desc_len, tag,
+                                                           &params));
     if (UCX_STATUS_FAIL (status)) {
-        rc = DYAD_RC_UCXMMAP_FAIL;
-        DYAD_LOG_ERROR (ctx, "ucx_mem_map failed");
-        goto ucx_allocate_done;
+        DYAD_LOG_ERROR (ctx, "Cannot send the RMA descriptor (status = %d)", (int)status);
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_rma_send_done;
+    }
+    if (desc->flags & DYAD_UCX_RMA_FLUX_ACK) {
+        ctx->dtl_handle->send_deferred = true;
+        rc = DYAD_RC_OK;
+        goto ucx_rma_send_done;
     }
-    attr.field_mask = UCP_MEM_ATTR_FIELD_ADDRESS;
-    status = ucp_mem_query (mem_handle, &attr);
+    // The consumer echoes the identifier once it pulled the data. A late
+    // answer to an earlier, timed out, transfer is skipped.
+    params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK;
+    params.cb.recv = dyad_recv_callback;
+    do {
+        status = dyad_ucx_request_wait_until (ctx,
+                                              ucp_tag_recv_nbx (dtl_handle->ucx_worker,
+                                                                &ack,
+                                                                sizeof (ack),
+                                                                tag,
+                                                                DYAD_UCX_TAG_MASK,
+                                                                &params),
+                                              deadline);
+    } while (status == UCS_OK && ack != desc->id);
     if (UCX_STATUS_FAIL (status)) {
-        ucp_mem_unmap (ucp_ctx, mem_handle);
-        rc = DYAD_RC_UCXMMAP_FAIL;
-        DYAD_LOG_ERROR (ctx, "Failed to get address to UCX allocated buffer");
-        goto ucx_allocate_done;
+        DYAD_LOG_ERROR (ctx, "The consumer did not pull the data (status = %d)", (int)status);
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_rma_send_done;
     }
-    *buf = attr.address;
     rc = DYAD_RC_OK;
 
-ucx_allocate_done:;
+ucx_rma_send_done:;
+    free (desc);
     DYAD_C_FUNCTION_END();
     return rc;
 }
 
-static dyad_rc_t ucx_free_buffer (const dyad_ctx_t *ctx,
-                                  ucp_context_h ucp_ctx,
-                                  ucp_mem_h mem_handle,
-                                  void** buf)
+// Pull the data a producer exposed with ucx_rma_send, then let it know
+static dyad_rc_t ucx_rma_get (const dyad_ctx_t* ctx,
+                              const struct ucx_rma_desc* desc,
+                              size_t desc_len,
+                              void** buf,
+                              size_t* buflen)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
-    if (ucp_ctx == NULL) {
-        rc = DYAD_RC_NOCTX;
-        DYAD_LOG_ERROR (ctx, "No UCX context provided");
-        goto ucx_free_buf_done;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    const ucp_tag_t tag = dtl_handle->comm_tag | DYAD_UCX_RMA_TAG_BIT;
+    const void* rkey_buf = (const void*)(desc + 1);
+    const ucp_address_t* addr = NULL;
+    ucp_request_param_t params;
+    ucp_rkey_h rkey = NULL;
+    ucp_ep_h ep = NULL;
+    flux_future_t* ack_f = NULL;
+    ucs_status_t status = UCS_OK;
+
+    if (desc_len < sizeof (*desc)
+        || desc_len != sizeof (*desc) + (size_t)desc->rkey_len + (size_t)desc->addr_len) {
+        DYAD_LOG_ERROR (ctx, "Received a malformed RMA descriptor");
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_rma_get_done;
     }
-    if (mem_handle == NULL) {
-        rc = DYAD_RC_UCXMMAP_FAIL;
-        DYAD_LOG_ERROR (ctx, "No UCX memory handle provided");
-        goto ucx_free_buf_done;
+    addr = (const ucp_address_t*)((const char*)rkey_buf + desc->rkey_len);
+    // Endpoints to producers are cached by worker address
+    dtl_handle->consumer_conn_key = ucx_addr_hash (addr, desc->addr_len);
+    if (DYAD_IS_ERROR (dyad_ucx_ep_cache_find (ctx, dtl_handle->ep_cache, addr, desc->addr_len,
+                                               &ep))) {
+        ep = NULL;
+        rc = dyad_ucx_ep_cache_insert (ctx, dtl_handle->ep_cache, addr, desc->addr_len,
+                                       dtl_handle->ucx_worker, &ep);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "Cannot connect to the producer to pull the data");
+            rc = DYAD_RC_UCXEP_FAIL;
+            goto ucx_rma_get_done;
+        }
     }
-    if (buf == NULL || *buf == NULL) {
-        rc = DYAD_RC_BADBUF;
-        DYAD_LOG_ERROR (ctx, "No memory buffer provided");
-        goto ucx_free_buf_done;
+    *buflen = (size_t)desc->len;
+    rc = ctx->dtl_handle->get_buffer (ctx, *buflen, buf);
+    if (DYAD_IS_ERROR (rc)) {
+        *buf = NULL;
+        *buflen = 0;
+    } else if (UCX_STATUS_FAIL (status = ucp_ep_rkey_unpack (ep, rkey_buf, &rkey))) {
+        DYAD_LOG_ERROR (ctx, "Cannot unpack the remote key (status = %d)", (int)status);
+        rc = DYAD_RC_UCXCOMM_FAIL;
+    } else {
+        DYAD_LOG_INFO (ctx, "Pulling %zu bytes from the producer with RMA", *buflen);
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_MEMORY_TYPE;
+        params.cb.send = dyad_send_callback;
+        params.memory_type = UCS_MEMORY_TYPE_HOST;
+        status = dyad_ucx_request_wait (ctx, ucp_get_nbx (ep, *buf, *buflen, desc->addr, rkey,
+                                                          &params));
+        ucp_rkey_destroy (rkey);
+        if (UCX_STATUS_FAIL (status)) {
+            DYAD_LOG_ERROR (ctx, "RMA get failed (status = %d)", (int)status);
+            rc = DYAD_RC_UCXCOMM_FAIL;
+        }
+    }
+    // Release the producer's buffer, whether the data could be pulled or not
+    if (desc->flags & DYAD_UCX_RMA_FLUX_ACK) {
+        ack_f = flux_rpc_pack (dtl_handle->h, DYAD_RMA_ACK_RPC_NAME,
+                               (uint32_t)(dtl_handle->comm_tag >> 32), FLUX_RPC_NORESPONSE,
+                               "{s:I}", "id", (json_int_t)desc->id);
+        if (ack_f == NULL) {
+            DYAD_LOG_ERROR (ctx, "Cannot release the producer's buffer");
+        }
+        flux_future_destroy (ack_f);
+    } else {
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK;
+        params.cb.send = dyad_send_callback;
+        status = dyad_ucx_request_wait (ctx, ucp_tag_send_nbx (ep, &desc->id, sizeof (desc->id),
+                                                               tag, &params));
+        if (UCX_STATUS_FAIL (status)) {
+            DYAD_LOG_ERROR (ctx, "Cannot release the producer's buffer (status = %d)",
+                            (int)status);
+        }
+    }
+    if (DYAD_IS_ERROR (rc) && *buf != NULL) {
+        ctx->dtl_handle->return_buffer (ctx, buf);
+        *buflen = 0;
+    }
+
+ucx_rma_get_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+// Release what is left of the active message that arrived last
+static void ucx_am_release (dyad_dtl_ucx_t* h)
+{
+    if (h->am_data != NULL) {
+        if (h->am_copied)
+            free (h->am_data);
+        else
+            ucp_am_data_release (h->ucx_worker, h->am_data);
+    }
+    h->am_data = NULL;
+    h->am_len = 0;
+    h->am_arrived = false;
+    h->am_rndv = false;
+    h->am_copied = false;
+}
+
+// Send a file to a consumer as an active message. UCX sends small files
+// eagerly along with the header, and large ones with a rendezvous, which the
+// consumer completes straight into its buffer.
+static dyad_rc_t ucx_am_send (const dyad_ctx_t* ctx, void* buf, size_t buflen)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    size_t upath_len = strlen (dtl_handle->am_upath);
+    size_t hdr_len = sizeof (struct ucx_am_hdr) + upath_len;
+    struct ucx_am_hdr* hdr = NULL;
+    ucp_request_param_t params;
+    ucs_status_t status = UCS_OK;
+    if (dtl_handle->ep == NULL) {
+        DYAD_LOG_ERROR (ctx, "UCP endpoint was not created prior to invoking send!");
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_am_send_done;
+    }
+    hdr = (struct ucx_am_hdr*)malloc (hdr_len);
+    if (hdr == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto ucx_am_send_done;
     }
-    DYAD_LOG_INFO (ctx, "Releasing UCX allocated memory");
-    ucp_mem_unmap (ucp_ctx, mem_handle);
+    hdr->id = dtl_handle->am_id;
+    hdr->len = buflen;
+    hdr->upath_len = (uint32_t)upath_len;
+    memcpy (hdr + 1, dtl_handle->am_upath, upath_len);
+    DYAD_LOG_INFO (ctx, "Sending %zu bytes to consumer with ucp_am_send_nbx", buflen);
+    params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_MEMORY_TYPE;
+    params.cb.send = dyad_send_callback;
+    params.memory_type = UCS_MEMORY_TYPE_HOST;
+    status = dyad_ucx_request_wait (ctx, ucp_am_send_nbx (dtl_handle->ep, DYAD_UCX_AM_ID, hdr,
+                                                          hdr_len, buf, buflen, &params));
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_ERROR (ctx, "UCP AM Send failed (status = %d)!", (int)status);
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_am_send_done;
+    }
+    rc = DYAD_RC_OK;
+
+ucx_am_send_done:;
+    free (hdr);
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+// Hand over the file that arrived as an active message
+static dyad_rc_t ucx_am_recv (const dyad_ctx_t* ctx, void** buf, size_t* buflen)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    ucp_request_param_t params;
+    ucs_status_t status = UCS_OK;
+    void* desc = NULL;
     *buf = NULL;
+    *buflen = 0;
+    if (dtl_handle->am_data == NULL) {
+        DYAD_LOG_ERROR (ctx, "Cannot keep the data of the active message");
+        rc = DYAD_RC_SYSFAIL;
+        goto ucx_am_recv_done;
+    }
+    rc = ctx->dtl_handle->get_buffer (ctx, dtl_handle->am_len, buf);
+    if (DYAD_IS_ERROR (rc)) {
+        *buf = NULL;
+        goto ucx_am_recv_done;
+    }
+    if (!dtl_handle->am_rndv) {
+        memcpy (*buf, dtl_handle->am_data, dtl_handle->am_len);
+    } else {
+        // UCX owns the descriptor from now on
+        desc = dtl_handle->am_data;
+        dtl_handle->am_data = NULL;
+        params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_MEMORY_TYPE;
+        params.cb.recv_am = dyad_am_recv_data_callback;
+        params.memory_type = UCS_MEMORY_TYPE_HOST;
+        status = dyad_ucx_request_wait (ctx, ucp_am_recv_data_nbx (dtl_handle->ucx_worker, desc,
+                                                                   *buf, dtl_handle->am_len,
+                                                                   &params));
+        if (UCX_STATUS_FAIL (status)) {
+            DYAD_LOG_ERROR (ctx, "UCP AM recv failed (status = %d)!", (int)status);
+            ctx->dtl_handle->return_buffer (ctx, buf);
+            rc = DYAD_RC_UCXCOMM_FAIL;
+            goto ucx_am_recv_done;
+        }
+    }
+    *buflen = dtl_handle->am_len;
     rc = DYAD_RC_OK;
 
-ucx_free_buf_done:;
+ucx_am_recv_done:;
+    ucx_am_release (dtl_handle);
     DYAD_C_FUNCTION_END();
     return rc;
 }
+#endif
+
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+// Send a large file in chunks, with several of them in flight, so that the
+// transfer does not stall on the completion of each one. With a rendezvous
+// per chunk, UCX also spreads the chunks in flight over the rails it uses
+// (see UCX_MAX_RNDV_RAILS).
+static dyad_rc_t ucx_chunked_send (const dyad_ctx_t* ctx, void* buf, size_t buflen)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    const ucp_tag_t hdr_tag = dtl_handle->comm_tag | DYAD_UCX_CHUNK_TAG_BIT;
+    ucp_tag_t tag = 0;
+    const size_t chunk = dtl_handle->chunk_size;
+    const size_t nchunks = (buflen + chunk - 1) / chunk;
+    const size_t window = dtl_handle->pipeline;
+    ucs_status_ptr_t reqs[DYAD_UCX_PIPELINE_MAX];
+    struct ucx_chunk_hdr hdr;
+    ucp_request_param_t params;
+    ucs_status_t status = UCS_OK;
+    size_t posted = 0;
+    size_t done = 0;
+    params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_MEMORY_TYPE;
+    params.cb.send = dyad_send_callback;
+    params.memory_type = UCS_MEMORY_TYPE_HOST;
+    dtl_handle->chunk_seq = (dtl_handle->chunk_seq % DYAD_UCX_CHUNK_SEQ_MAX) + 1u;
+    tag = hdr_tag | ((ucp_tag_t)dtl_handle->chunk_seq << DYAD_UCX_CHUNK_SEQ_SHIFT);
+    hdr.len = buflen;
+    hdr.chunk = chunk;
+    hdr.seq = dtl_handle->chunk_seq;
+    DYAD_LOG_INFO (ctx, "Sending %zu bytes to consumer in %zu chunks", buflen, nchunks);
+    status = dyad_ucx_request_wait (ctx, ucp_tag_send_nbx (dtl_handle->ep, &hdr, sizeof (hdr),
+                                                           hdr_tag, &params));
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_ERROR (ctx, "Cannot send the chunk header (status = %d)", (int)status);
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_chunked_send_done;
+    }
+    // The buffer must outlive the sends in flight, so a failure stops new
+    // sends but still waits for the posted ones
+    while (done < posted || (posted < nchunks && rc == DYAD_RC_OK)) {
+        while (posted < nchunks && posted - done < window && rc == DYAD_RC_OK) {
+            size_t off = posted * chunk;
+            size_t len = (buflen - off < chunk) ? buflen - off : chunk;
+            reqs[posted % window] =
+                ucp_tag_send_nbx (dtl_handle->ep, (char*)buf + off, len, tag, &params);
+            posted++;
+        }
+        status = dyad_ucx_request_wait (ctx, reqs[done % window]);
+        done++;
+        if (UCX_STATUS_FAIL (status) && rc == DYAD_RC_OK) {
+            DYAD_LOG_ERROR (ctx, "Cannot send chunk %zu (status = %d)", done - 1, (int)status);
+            rc = DYAD_RC_UCXCOMM_FAIL;
+        }
+    }
+
+ucx_chunked_send_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+// Receive the chunks of a file announced by hdr, posting the receives ahead
+// so that the chunks land straight in the buffer
+static dyad_rc_t ucx_chunked_recv (const dyad_ctx_t* ctx,
+                                   const struct ucx_chunk_hdr* hdr,
+                                   size_t hdr_len,
+                                   void** buf,
+                                   size_t* buflen)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    ucp_tag_t tag = 0;
+    const size_t window = dtl_handle->pipeline;
+    ucs_status_ptr_t reqs[DYAD_UCX_PIPELINE_MAX];
+    ucp_request_param_t params;
+    ucs_status_t status = UCS_OK;
+    time_t drain_until = 0;
+    bool stop = false;
+    size_t nchunks = 0;
+    size_t posted = 0;
+    size_t done = 0;
+    if (hdr_len != sizeof (*hdr) || hdr->chunk == 0 || hdr->seq == 0
+        || hdr->seq > DYAD_UCX_CHUNK_SEQ_MAX) {
+        DYAD_LOG_ERROR (ctx, "Received a malformed chunk header");
+        rc = DYAD_RC_UCXCOMM_FAIL;
+        goto ucx_chunked_recv_done;
+    }
+    tag = dtl_handle->comm_tag | DYAD_UCX_CHUNK_TAG_BIT
+          | ((ucp_tag_t)hdr->seq << DYAD_UCX_CHUNK_SEQ_SHIFT);
+    nchunks = (hdr->len + hdr->chunk - 1) / hdr->chunk;
+    *buflen = hdr->len;
+    rc = ctx->dtl_handle->get_buffer (ctx, *buflen, buf);
+    if (DYAD_IS_ERROR (rc)) {
+        *buf = NULL;
+        *buflen = 0;
+        goto ucx_chunked_recv_done;
+    }
+    DYAD_LOG_INFO (ctx, "Receiving %zu bytes from producer in %zu chunks", *buflen, nchunks);
+    params.op_attr_mask = UCP_OP_ATTR_FIELD_CALLBACK | UCP_OP_ATTR_FIELD_MEMORY_TYPE;
+    params.cb.recv = dyad_recv_callback;
+    params.memory_type = UCS_MEMORY_TYPE_HOST;
+    // Once a chunk failed, the later ones are still received, so that the
+    // sends of the producer complete, unless they do not come in time. The
+    // receives still posted then are canceled.
+    while (done < posted || (posted < nchunks && !stop)) {
+        while (posted < nchunks && posted - done < window && !stop) {
+            size_t off = posted * hdr->chunk;
+            size_t len = (*buflen - off < hdr->chunk) ? *buflen - off : hdr->chunk;
+            reqs[posted % window] = ucp_tag_recv_nbx (dtl_handle->ucx_worker, (char*)*buf + off, len,
+                                                      tag, DYAD_UCX_TAG_MASK, &params);
+            posted++;
+        }
+        if (rc == DYAD_RC_OK) {
+            status = dyad_ucx_request_wait (ctx, reqs[done % window]);
+        } else {
+            status = dyad_ucx_request_wait_until (ctx, reqs[done % window], drain_until);
+            stop = stop || (status == UCS_ERR_CANCELED);
+        }
+        done++;
+        if (UCX_STATUS_FAIL (status) && rc == DYAD_RC_OK) {
+            DYAD_LOG_ERROR (ctx, "Cannot receive chunk %zu (status = %d)", done - 1, (int)status);
+            rc = DYAD_RC_UCXCOMM_FAIL;
+            drain_until = time (NULL) + DYAD_UCX_CHUNK_DRAIN_SECS;
+        }
+    }
+    if (DYAD_IS_ERROR (rc)) {
+        ctx->dtl_handle->return_buffer (ctx, buf);
+        *buflen = 0;
+    }
+
+ucx_chunked_recv_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+#endif
 
 static inline ucs_status_ptr_t ucx_send_no_wait (const dyad_ctx_t* ctx, void* buf, size_t buflen)
 {
@@ -257,7 +991,8 @@ ucx_send_no_wait_done:;
 static inline ucs_status_ptr_t ucx_recv_no_wait (const dyad_ctx_t* ctx,
                                                  bool is_warmup,
                                                  void** buf,
-                                                 size_t* buflen)
+                                                 size_t* buflen,
+                                                 ucp_tag_t* sender_tag)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
@@ -265,66 +1000,37 @@ static inline ucs_status_ptr_t ucx_recv_no_wait (const dyad_ctx_t* ctx,
     ucp_tag_recv_info_t msg_info;
     ucs_status_ptr_t stat_ptr = NULL;
     dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    struct ucx_waiter w;
     DYAD_LOG_INFO (ctx, "Poll UCP for incoming data");
     // TODO: replace this loop with a resiliency response over RPC
     // TODO(Ian): explore whether removing probe makes the overall
     //            recv faster or not
-    do {
-        ucp_worker_progress (dtl_handle->ucx_worker);
+    // Spin for a little while in case the data arrives quickly, then sleep
+    // until the worker gets new events
+    ucx_wait_begin (dtl_handle, &w);
+    for (;;) {
+        // The producer may send the data itself or where to pull it from
         msg = ucp_tag_probe_nb (dtl_handle->ucx_worker,
                                 dtl_handle->comm_tag,
-                                DYAD_UCX_TAG_MASK,
+                                DYAD_UCX_TAG_MASK & ~(DYAD_UCX_RMA_TAG_BIT | DYAD_UCX_CHUNK_TAG_BIT),
                                 1,  // Remove the message from UCP tracking
                                 // Requires calling ucp_tag_msg_recv_nb
                                 // with the ucp_tag_message_h to retrieve message
                                 &msg_info);
-    } while (msg == NULL);
-    // TODO: This version of the polling code is not supposed to spin-lock,
-    // unlike the code above. Currently, it does not work. Once it starts
-    // working, we can replace the code above with a version of this code.
-    //
-    // while (true)
-    // {
-    //     // Probe the tag recv event at the top
-    //     // of the worker's queue
-    //     DYAD_LOG_INFO (ctx, "Probe UCP worker with tag %lu",
-    //     dtl_handle->comm_tag); msg = ucp_tag_probe_nb(
-    //         dtl_handle->ucx_worker,
-    //         dtl_handle->comm_tag,
-    //         DYAD_UCX_TAG_MASK,
-    //         1, // Remove the message from UCP tracking
-    //         // Requires calling ucp_tag_msg_recv_nb
-    //         // with the ucp_tag_message_h to retrieve message
-    //         &msg_info
-    //     );
-    //     // If data has arrived from the producer plugin,
-    //     // break the loop
-    //     if (msg != NULL)
-    //     {
-    //         DYAD_LOG_INFO (ctx, "Data has arrived, so end
-    //         polling"); break;
-    //     }
-    //     // If data has not arrived, check if there are
-    //     // any other events in the worker's queue.
-    //     // If so, start the loop over to handle the next event
-    //     else if (ucp_worker_progress(dtl_handle->ucx_worker))
-    //     {
-    //         DYAD_LOG_INFO (ctx, "Progressed UCP worker to check if
-    //         any other UCP events are available"); continue;
-    //     }
-    //     // No other events are queued. So, we will wait on new
-    //     // events to come in. By using 'ucp_worker_wait' for this,
-    //     // we let the OS do other work in the meantime (no spin locking).
-    //     DYAD_LOG_INFO (ctx, "Launch pre-emptable wait until UCP
-    //     worker gets new events\n"); status =
-    //     ucp_worker_wait(dtl_handle->ucx_worker);
-    //     // If the wait fails, log an error
-    //     if (UCX_STATUS_FAIL(status))
-    //     {
-    //         DYAD_LOG_INFO (ctx, "Could not wait on the message from
-    //         the producer plugin\n"); return DYAD_RC_UCXWAIT_FAIL;
-    //     }
-    // }
+        if (msg != NULL)
+            break;
+        // Or, if the consumer asked for it, as an active message
+        if (dtl_handle->am_arrived)
+            break;
+        ucx_wait_step (dtl_handle, &w);
+    }
+    ucx_wait_end (dtl_handle, &w);
+    if (msg == NULL) {
+        // dyad_dtl_ucx_recv takes the active message from here
+        *buf = NULL;
+        *buflen = 0;
+        goto ucx_recv_no_wait_done;
+    }
     // The metadata retrived from the probed tag recv event contains
     // the size of the data to be sent.
     // So, use that size to allocate a buffer
@@ -333,7 +1039,19 @@ static inline ucs_status_ptr_t ucx_recv_no_wait (const dyad_ctx_t* ctx,
                    msg_info.sender_tag,
                    msg_info.length);
     *buflen = msg_info.length;
-    if (is_warmup) {
+    if (sender_tag != NULL) {
+        *sender_tag = msg_info.sender_tag;
+    }
+    if (sender_tag != NULL
+        && (msg_info.sender_tag & (DYAD_UCX_RMA_TAG_BIT | DYAD_UCX_CHUNK_TAG_BIT)) != 0) {
+        // The RMA descriptor or chunk header is small and only used here
+        *buf = malloc (*buflen);
+        if (*buf == NULL) {
+            *buflen = 0;
+            stat_ptr = (ucs_status_ptr_t)UCS_ERR_NO_MEMORY;
+            goto ucx_recv_no_wait_done;
+        }
+    } else if (is_warmup) {
         if (*buflen > dtl_handle->max_transfer_size) {
             *buflen = 0;
             stat_ptr = (ucs_status_ptr_t)UCS_ERR_BUFFER_TOO_SMALL;
@@ -379,6 +1097,234 @@ ucx_recv_no_wait_done:;
     return stat_ptr;
 }
 
+// UCX context shared by the DTLs of the process. Each DTL, which is only used
+// by one thread at a time, has its own worker and transfer state, so threads
+// with their own DYAD context (e.g., the threads of the wrapper or the worker
+// threads of the module) drive transfers concurrently without locking.
+static pthread_mutex_t ucx_shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static ucp_context_h ucx_shared_ctx = NULL;
+static unsigned int ucx_shared_refs = 0u;
+
+// Addresses of the consumers that sent a request in full to the module, by
+// connection id. Compact requests only name the connection: the worker that
+// serves one connects from here when its endpoint cache misses. The table is
+// set-associative, and a new consumer takes the place of the least recently
+// used one of its set, which is asked to send its next request in full.
+struct ucx_conn {
+    uint64_t id;
+    uint64_t used;  // value of ucx_conn_clock when last used (0 if free)
+    void* addr;
+    size_t addr_len;
+};
+static pthread_mutex_t ucx_conn_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct ucx_conn* ucx_conns = NULL;
+static size_t ucx_conn_sets = 0u;  // a power of 2
+static uint64_t ucx_conn_clock = 0u;
+
+// Allocate the table on first use, with ucx_conn_lock held
+static bool ucx_conn_alloc (void)
+{
+    const char* e = NULL;
+    size_t n = DYAD_UCX_CONNS_DEFAULT;
+    if (ucx_conns != NULL)
+        return true;
+    if ((e = getenv (DYAD_UCX_CONNS_ENV)) != NULL && strtoul (e, NULL, 10) > 0ul)
+        n = (size_t)strtoul (e, NULL, 10);
+    ucx_conn_sets = 1u;
+    while (ucx_conn_sets * DYAD_UCX_CONN_WAYS < n)
+        ucx_conn_sets <<= 1;
+    ucx_conns = (struct ucx_conn*)calloc (ucx_conn_sets * DYAD_UCX_CONN_WAYS, sizeof (*ucx_conns));
+    if (ucx_conns == NULL)
+        ucx_conn_sets = 0u;
+    return (ucx_conns != NULL);
+}
+
+static inline struct ucx_conn* ucx_conn_set (uint64_t id)
+{
+    return &ucx_conns[(id & (ucx_conn_sets - 1u)) * DYAD_UCX_CONN_WAYS];
+}
+
+// Entry of a connection, marked as used, with ucx_conn_lock held
+static struct ucx_conn* ucx_conn_find (uint64_t id)
+{
+    struct ucx_conn* set = NULL;
+    unsigned int i = 0u;
+    if (id == 0u || ucx_conns == NULL)
+        return NULL;
+    set = ucx_conn_set (id);
+    for (i = 0u; i < DYAD_UCX_CONN_WAYS; i++) {
+        if (set[i].id == id) {
+            set[i].used = ++ucx_conn_clock;
+            return &set[i];
+        }
+    }
+    return NULL;
+}
+
+static void ucx_conn_register (uint64_t id, const void* addr, size_t addr_len)
+{
+    struct ucx_conn* c = NULL;
+    struct ucx_conn* set = NULL;
+    void* copy = NULL;
+    void* old = NULL;
+    unsigned int i = 0u;
+    if (id == 0u || (copy = malloc (addr_len)) == NULL)
+        return;
+    memcpy (copy, addr, addr_len);
+    pthread_mutex_lock (&ucx_conn_lock);
+    if (!ucx_conn_alloc ()) {
+        old = copy;
+        goto ucx_conn_register_done;
+    }
+    if ((c = ucx_conn_find (id)) != NULL && c->addr_len == addr_len
+        && memcmp (c->addr, addr, addr_len) == 0) {
+        old = copy;
+        goto ucx_conn_register_done;
+    }
+    if (c == NULL) {
+        // Evict the least recently used consumer of the set, if it is full
+        set = ucx_conn_set (id);
+        c = &set[0];
+        for (i = 1u; i < DYAD_UCX_CONN_WAYS; i++) {
+            if (set[i].used < c->used)
+                c = &set[i];
+        }
+    }
+    old = c->addr;
+    c->id = id;
+    c->used = ++ucx_conn_clock;
+    c->addr = copy;
+    c->addr_len = addr_len;
+
+ucx_conn_register_done:;
+    pthread_mutex_unlock (&ucx_conn_lock);
+    free (old);
+}
+
+static bool ucx_conn_known (uint64_t id)
+{
+    bool known = false;
+    pthread_mutex_lock (&ucx_conn_lock);
+    known = (ucx_conn_find (id) != NULL);
+    pthread_mutex_unlock (&ucx_conn_lock);
+    return known;
+}
+
+// Copy of the address of a consumer, to be freed by the caller
+static dyad_rc_t ucx_conn_address (uint64_t id, ucp_address_t** addr, size_t* addr_len)
+{
+    dyad_rc_t rc = DYAD_RC_NOTFOUND;
+    struct ucx_conn* c = NULL;
+    pthread_mutex_lock (&ucx_conn_lock);
+    if ((c = ucx_conn_find (id)) != NULL) {
+        *addr = (ucp_address_t*)malloc (c->addr_len);
+        if (*addr == NULL) {
+            rc = DYAD_RC_SYSFAIL;
+        } else {
+            memcpy (*addr, c->addr, c->addr_len);
+            *addr_len = c->addr_len;
+            rc = DYAD_RC_OK;
+        }
+    }
+    pthread_mutex_unlock (&ucx_conn_lock);
+    return rc;
+}
+
+static void ucx_conn_clear (void)
+{
+    size_t i = 0u;
+    pthread_mutex_lock (&ucx_conn_lock);
+    for (i = 0u; i < ucx_conn_sets * DYAD_UCX_CONN_WAYS; i++) {
+        free (ucx_conns[i].addr);
+    }
+    free (ucx_conns);
+    ucx_conns = NULL;
+    ucx_conn_sets = 0u;
+    ucx_conn_clock = 0u;
+    pthread_mutex_unlock (&ucx_conn_lock);
+}
+
+static ucs_status_t ucx_context_acquire (const dyad_ctx_t* ctx, bool debug, ucp_context_h* ucp_ctx)
+{
+    DYAD_C_FUNCTION_START();
+    ucp_params_t ucx_params;
+    ucp_config_t* config;
+    ucs_status_t status = UCS_OK;
+
+    pthread_mutex_lock (&ucx_shared_lock);
+    if (ucx_shared_ctx != NULL) {
+        ucx_shared_refs++;
+        *ucp_ctx = ucx_shared_ctx;
+        goto ucx_context_acquire_done;
+    }
+    // Read the UCX configuration
+    DYAD_LOG_INFO (ctx, "Reading UCP config\n");
+    status = ucp_config_read (NULL, NULL, &config);
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_ERROR (ctx, "Could not read the UCX config\n");
+        goto ucx_context_acquire_done;
+    }
+
+    // Define the settings, parameters, features, etc.
+    // for the UCX context. UCX will use this info internally
+    // when creating workers, endpoints, etc.
+    //
+    // The settings enabled are:
+    //   * Tag-matching send/recv
+    //   * Remote Memory Access communication
+    //   * Active messages
+    //   * Auto initialization of request objects
+    //   * Worker sleep, wakeup, poll, etc. features
+    //   * Workers of several threads sharing the context
+    ucx_params.field_mask = UCP_PARAM_FIELD_FEATURES | UCP_PARAM_FIELD_REQUEST_SIZE
+                            | UCP_PARAM_FIELD_REQUEST_INIT | UCP_PARAM_FIELD_MT_WORKERS_SHARED;
+    ucx_params.features = UCP_FEATURE_TAG |
+                          UCP_FEATURE_RMA |
+                          UCP_FEATURE_WAKEUP;
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    ucx_params.features |= UCP_FEATURE_AM;
+#endif
+    ucx_params.request_size = sizeof (struct ucx_request);
+    ucx_params.request_init = dyad_ucx_request_init;
+    ucx_params.mt_workers_shared = 1;
+
+    // Initialize UCX
+    DYAD_LOG_INFO (ctx, "Initializing UCP\n");
+    status = ucp_init (&ucx_params, config, &ucx_shared_ctx);
+
+    // If in debug mode, print the configuration of UCX to stderr
+    if (debug) {
+        ucp_config_print (config, stderr, "UCX Configuration", UCS_CONFIG_PRINT_CONFIG);
+    }
+    // Release the config
+    ucp_config_release (config);
+    // Log an error if UCX initialization failed
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_ERROR (ctx, "ucp_init failed (status = %d)\n", status);
+        ucx_shared_ctx = NULL;
+        goto ucx_context_acquire_done;
+    }
+    ucx_shared_refs = 1u;
+    *ucp_ctx = ucx_shared_ctx;
+
+ucx_context_acquire_done:;
+    pthread_mutex_unlock (&ucx_shared_lock);
+    DYAD_C_FUNCTION_END();
+    return status;
+}
+
+static void ucx_context_release (ucp_context_h ucp_ctx)
+{
+    pthread_mutex_lock (&ucx_shared_lock);
+    if (ucp_ctx == ucx_shared_ctx && --ucx_shared_refs == 0u) {
+        ucx_reg_clear ();
+        ucp_cleanup (ucx_shared_ctx);
+        ucx_shared_ctx = NULL;
+        ucx_conn_clear ();
+    }
+    pthread_mutex_unlock (&ucx_shared_lock);
+}
+
 static dyad_rc_t ucx_warmup (const dyad_ctx_t* ctx)
 {
     DYAD_C_FUNCTION_START();
@@ -424,7 +1370,7 @@ static dyad_rc_t ucx_warmup (const dyad_ctx_t* ctx)
         goto warmup_region_done;
     }
     DYAD_LOG_INFO (ctx, "Starting non-blocking recv for warmup");
-    recv_stat_ptr = ucx_recv_no_wait (ctx, true, &recv_buf, &recv_buf_len);
+    recv_stat_ptr = ucx_recv_no_wait (ctx, true, &recv_buf, &recv_buf_len, NULL);
     DYAD_LOG_INFO (ctx, "Waiting on warmup recv to finish");
     recv_status =
         dyad_ucx_request_wait (ctx, recv_stat_ptr);
@@ -435,6 +1381,7 @@ static dyad_rc_t ucx_warmup (const dyad_ctx_t* ctx)
     ucx_disconnect (ctx,
                     ctx->dtl_handle->private_dtl.ucx_dtl_handle->ucx_worker,
                     ctx->dtl_handle->private_dtl.ucx_dtl_handle->ep);
+    ctx->dtl_handle->private_dtl.ucx_dtl_handle->ep = NULL;
     dyad_dtl_ucx_return_buffer (ctx, &send_buf);
     if (UCX_STATUS_FAIL (recv_status) || UCX_STATUS_FAIL (send_status)) {
         rc = DYAD_RC_UCXCOMM_FAIL;
@@ -458,9 +1405,7 @@ dyad_rc_t dyad_dtl_ucx_init (const dyad_ctx_t* ctx,
                              bool debug)
 {
     DYAD_C_FUNCTION_START();
-    ucp_params_t ucx_params;
     ucp_worker_params_t worker_params;
-    ucp_config_t* config;
     ucs_status_t status;
     ucp_worker_attr_t worker_attrs;
     dyad_rc_t rc = DYAD_RC_OK;
@@ -480,8 +1425,7 @@ dyad_rc_t dyad_dtl_ucx_init (const dyad_ctx_t* ctx,
     dtl_handle->debug = debug;
     dtl_handle->ucx_ctx = NULL;
     dtl_handle->ucx_worker = NULL;
-    dtl_handle->mem_handle = NULL;
-    dtl_handle->net_buf = NULL;
+    dtl_handle->buf_pool = NULL;
     dtl_handle->max_transfer_size = UCX_MAX_TRANSFER_SIZE;
     dtl_handle->ep = NULL;
     dtl_handle->ep_cache = NULL;
@@ -490,57 +1434,86 @@ dyad_rc_t dyad_dtl_ucx_init (const dyad_ctx_t* ctx,
     dtl_handle->remote_address = NULL;
     dtl_handle->remote_addr_len = 0;
     dtl_handle->comm_tag = 0;
-
-    // Read the UCX configuration
-    DYAD_LOG_INFO (ctx, "Reading UCP config\n");
-    status = ucp_config_read (NULL, NULL, &config);
-    if (UCX_STATUS_FAIL (status)) {
-        DYAD_LOG_ERROR (ctx, "Could not read the UCX config\n");
-        goto error;
+    dtl_handle->consumer_conn_key = 0;
+    dtl_handle->conn_id = 0;
+    dtl_handle->rank_state = NULL;
+    dtl_handle->nranks = 0;
+    dtl_handle->raw_sent = false;
+    dtl_handle->raw_buf = NULL;
+    dtl_handle->raw_cap = 0;
+    dtl_handle->rma = false;
+    dtl_handle->rma_id = 0;
+    dtl_handle->chunks = false;
+    dtl_handle->chunk_size = DYAD_UCX_CHUNK_DEFAULT;
+    dtl_handle->chunk_seq = 0u;
+    dtl_handle->pipeline = DYAD_UCX_PIPELINE_DEFAULT;
+    dtl_handle->am = false;
+    dtl_handle->am_id = 0;
+    dtl_handle->am_upath = NULL;
+    dtl_handle->am_arrived = false;
+    dtl_handle->am_rndv = false;
+    dtl_handle->am_copied = false;
+    dtl_handle->am_data = NULL;
+    dtl_handle->am_len = 0;
+    dtl_handle->efd = -1;
+    dtl_handle->spin_max_us = DYAD_UCX_SPIN_DEFAULT_US;
+    dtl_handle->progress_thread_on = false;
+    dtl_handle->progress_stop = false;
+    const char* e = NULL;
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    if (comm_mode == DYAD_COMM_RECV) {
+        e = getenv (DYAD_UCX_RMA_ENV);
+        dtl_handle->rma = (e != NULL && strcmp (e, "0") != 0);
+        e = getenv (DYAD_UCX_AM_ENV);
+        dtl_handle->am = (e != NULL && strcmp (e, "0") != 0);
     }
-
-    // Define the settings, parameters, features, etc.
-    // for the UCX context. UCX will use this info internally
-    // when creating workers, endpoints, etc.
-    //
-    // The settings enabled are:
-    //   * Tag-matching send/recv
-    //   * Remote Memory Access communication
-    //   * Auto initialization of request objects
-    //   * Worker sleep, wakeup, poll, etc. features
-    ucx_params.field_mask =
-        UCP_PARAM_FIELD_FEATURES | UCP_PARAM_FIELD_REQUEST_SIZE | UCP_PARAM_FIELD_REQUEST_INIT;
-    ucx_params.features = UCP_FEATURE_TAG |
-                          // UCP_FEATURE_RMA |
-                          UCP_FEATURE_WAKEUP;
-    ucx_params.request_size = sizeof (struct ucx_request);
-    ucx_params.request_init = dyad_ucx_request_init;
-
-    // Initialize UCX
-    DYAD_LOG_INFO (ctx, "Initializing UCP\n");
-    status = ucp_init (&ucx_params, config, &dtl_handle->ucx_ctx);
-
-    // If in debug mode, print the configuration of UCX to stderr
-    if (debug) {
-        ucp_config_print (config, stderr, "UCX Configuration", UCS_CONFIG_PRINT_CONFIG);
+#endif
+    if ((e = getenv (DYAD_UCX_CHUNK_ENV))) {
+        dtl_handle->chunk_size = (size_t)strtoul (e, NULL, 10);
     }
-    // Release the config
-    ucp_config_release (config);
-    // Log an error if UCX initialization failed
+    if ((e = getenv (DYAD_UCX_PIPELINE_ENV))) {
+        dtl_handle->pipeline = (unsigned int)strtoul (e, NULL, 10);
+        if (dtl_handle->pipeline == 0u)
+            dtl_handle->pipeline = 1u;
+        else if (dtl_handle->pipeline > DYAD_UCX_PIPELINE_MAX)
+            dtl_handle->pipeline = DYAD_UCX_PIPELINE_MAX;
+    }
+    size_t ep_cache_capacity = DYAD_UCX_EP_CACHE_DEFAULT;
+    if ((e = getenv (DYAD_UCX_EP_CACHE_ENV))) {
+        ep_cache_capacity = (size_t)strtoul (e, NULL, 10);
+        if (ep_cache_capacity == 0 || ep_cache_capacity > DYAD_UCX_EP_CACHE_MAX) {
+            DYAD_LOG_INFO (ctx, "Ignoring invalid %s=%s\n", DYAD_UCX_EP_CACHE_ENV, e);
+            ep_cache_capacity = DYAD_UCX_EP_CACHE_DEFAULT;
+        }
+    }
+    if ((e = getenv (DYAD_UCX_SPIN_US_ENV))) {
+        dtl_handle->spin_max_us = (unsigned int)strtoul (e, NULL, 10);
+    }
+    dtl_handle->spin_us = dtl_handle->spin_max_us;
+    // Only consumers wait on their own. Module workers are threads already.
+    bool want_progress_thread = false;
+    if (comm_mode == DYAD_COMM_RECV && (e = getenv (DYAD_UCX_PROGRESS_ENV))) {
+        want_progress_thread = (strcmp (e, "0") != 0);
+    }
+
+    // Every thread has its own worker, on a context shared by the process
+    status = ucx_context_acquire (ctx, debug, &dtl_handle->ucx_ctx);
     if (UCX_STATUS_FAIL (status)) {
-        DYAD_LOG_ERROR (ctx, "ucp_init failed (status = %d)\n", status);
         goto error;
     }
 
     // Define the settings for the UCX worker (i.e., progress engine)
     //
     // The settings enabled are:
-    //   * Single-threaded mode (TODO look into multi-threading support)
-    //   * Restricting wakeup events to only include Tag-matching recv events
+    //   * Single-threaded mode, or serialized mode if a progress thread
+    //     shares the worker (all calls are made under the DTL's lock)
+    //   * Wakeup events for the completion of the operations DYAD waits on,
+    //     and for incoming active messages
     worker_params.field_mask = UCP_WORKER_PARAM_FIELD_THREAD_MODE | UCP_WORKER_PARAM_FIELD_EVENTS;
-    // TODO look into multi-threading support
-    worker_params.thread_mode = UCS_THREAD_MODE_SINGLE;
-    worker_params.events = UCP_WAKEUP_TAG_RECV;
+    worker_params.thread_mode =
+        want_progress_thread ? UCS_THREAD_MODE_SERIALIZED : UCS_THREAD_MODE_SINGLE;
+    worker_params.events =
+        UCP_WAKEUP_TAG_RECV | UCP_WAKEUP_TAG_SEND | UCP_WAKEUP_RMA | UCP_WAKEUP_RX;
 
     // Create the worker and log an error if that fails
     DYAD_LOG_INFO (ctx, "Creating UCP worker\n");
@@ -560,23 +1533,58 @@ dyad_rc_t dyad_dtl_ucx_init (const dyad_ctx_t* ctx,
     }
     dtl_handle->local_address = worker_attrs.address;
     dtl_handle->local_addr_len = worker_attrs.address_length;
+    // Modules know the connection of a consumer by this id once they have
+    // its address
+    if (comm_mode == DYAD_COMM_RECV) {
+        dtl_handle->conn_id = ucx_addr_hash (dtl_handle->local_address, dtl_handle->local_addr_len);
+        if (dtl_handle->conn_id == 0u)
+            dtl_handle->conn_id = 1u;
+    }
+
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    // Consumers asking for active messages handle them on their worker
+    if (dtl_handle->am) {
+        ucp_am_handler_param_t am_params;
+        am_params.field_mask = UCP_AM_HANDLER_PARAM_FIELD_ID | UCP_AM_HANDLER_PARAM_FIELD_FLAGS
+                               | UCP_AM_HANDLER_PARAM_FIELD_CB | UCP_AM_HANDLER_PARAM_FIELD_ARG;
+        am_params.id = DYAD_UCX_AM_ID;
+        am_params.flags = UCP_AM_FLAG_WHOLE_MSG;
+        am_params.cb = dyad_am_recv_callback;
+        am_params.arg = dtl_handle;
+        status = ucp_worker_set_am_recv_handler (dtl_handle->ucx_worker, &am_params);
+        if (UCX_STATUS_FAIL (status)) {
+            DYAD_LOG_INFO (ctx, "Cannot handle active messages, receiving with tags instead\n");
+            dtl_handle->am = false;
+        }
+    }
+#endif
+
+    // Waits block on the event fd of the worker once they are done spinning.
+    // Without it, they spin.
+    status = ucp_worker_get_efd (dtl_handle->ucx_worker, &dtl_handle->efd);
+    if (UCX_STATUS_FAIL (status)) {
+        DYAD_LOG_INFO (ctx, "Cannot get the event fd of the UCP worker, waits will spin\n");
+        dtl_handle->efd = -1;
+    }
 
     // Initialize endpoint cache
-    rc = dyad_ucx_ep_cache_init (ctx, &(dtl_handle->ep_cache));
+    rc = dyad_ucx_ep_cache_init (ctx, ep_cache_capacity, &(dtl_handle->ep_cache));
     if (DYAD_IS_ERROR (rc)) {
         DYAD_LOG_ERROR (ctx, "Cannot create endpoint cache (err code = %d)", (int)rc);
         goto error;
     }
 
-    // Allocate a buffer of max transfer size using UCX
-    ucx_allocate_buffer (ctx,
-                         dtl_handle->ucx_ctx,
-                         dtl_handle->max_transfer_size,
-                         dtl_handle->comm_mode,
-                         dtl_handle->mem_handle,
-                         &(dtl_handle->net_buf));
+    // Buffers are registered with UCX on demand and reused afterwards
+    rc = dyad_ucx_buf_pool_init (ctx, dtl_handle->ucx_ctx, dtl_handle->comm_mode,
+                                 &(dtl_handle->buf_pool));
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Cannot create UCX buffer pool (err code = %d)", (int)rc);
+        goto error;
+    }
 
     ctx->dtl_handle->rpc_pack = dyad_dtl_ucx_rpc_pack;
+    ctx->dtl_handle->rpc_pack_raw = dyad_dtl_ucx_rpc_pack_raw;
+    ctx->dtl_handle->rpc_unpack_size = dyad_dtl_ucx_rpc_unpack_size;
     ctx->dtl_handle->rpc_unpack = dyad_dtl_ucx_rpc_unpack;
     ctx->dtl_handle->rpc_respond = dyad_dtl_ucx_rpc_respond;
     ctx->dtl_handle->rpc_recv_response = dyad_dtl_ucx_rpc_recv_response;
@@ -584,6 +1592,7 @@ dyad_rc_t dyad_dtl_ucx_init (const dyad_ctx_t* ctx,
     ctx->dtl_handle->return_buffer = dyad_dtl_ucx_return_buffer;
     ctx->dtl_handle->establish_connection = dyad_dtl_ucx_establish_connection;
     ctx->dtl_handle->send = dyad_dtl_ucx_send;
+    ctx->dtl_handle->unregister_buffer = dyad_dtl_ucx_unregister_buffer;
     ctx->dtl_handle->recv = dyad_dtl_ucx_recv;
     ctx->dtl_handle->close_connection = dyad_dtl_ucx_close_connection;
 
@@ -594,6 +1603,19 @@ dyad_rc_t dyad_dtl_ucx_init (const dyad_ctx_t* ctx,
     }
     dtl_handle->ep = NULL;
 
+    if (want_progress_thread && dtl_handle->efd >= 0) {
+        pthread_mutex_init (&dtl_handle->lock, NULL);
+        pthread_cond_init (&dtl_handle->cond, NULL);
+        dtl_handle->progress_thread_on = true;
+        if (pthread_create (&dtl_handle->progress_thread, NULL, ucx_progress_thread, dtl_handle)
+            != 0) {
+            DYAD_LOG_INFO (ctx, "Cannot start the UCX progress thread");
+            dtl_handle->progress_thread_on = false;
+            pthread_cond_destroy (&dtl_handle->cond);
+            pthread_mutex_destroy (&dtl_handle->lock);
+        }
+    }
+
     DYAD_C_FUNCTION_END();
 
     return DYAD_RC_OK;
@@ -606,6 +1628,60 @@ error:;
     return DYAD_RC_UCXINIT_FAIL;
 }
 
+// Set up what the consumer needs to receive the answer to a request: the tag
+// of the transfer and, with active messages, the identifier of the request
+static dyad_rc_t ucx_request_prepare (const dyad_ctx_t* ctx,
+                                      const char* upath,
+                                      uint32_t producer_rank,
+                                      uint32_t* consumer_rank)
+{
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    DYAD_LOG_INFO (ctx, "Creating UCP tag for tag matching\n");
+    // Because we're using tag-matching send/recv for communication,
+    // there's no need to do any real connection establishment here.
+    // Instead, we use this function to create the tag that will be
+    // used for the upcoming communication.
+    if (flux_get_rank (dtl_handle->h, consumer_rank) < 0) {
+        DYAD_LOG_ERROR (ctx, "Cannot get consumer rank\n");
+        return DYAD_RC_FLUXFAIL;
+    }
+    // The tag is a 64 bit unsigned integer consisting of the
+    // 32-bit rank of the producer followed by the 32-bit rank
+    // of the consumer
+    dtl_handle->comm_tag = ((uint64_t)producer_rank << 32) | (uint64_t)*consumer_rank;
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    if (dtl_handle->am) {
+        ucx_lock (dtl_handle);
+        ucx_am_release (dtl_handle);
+        free (dtl_handle->am_upath);
+        dtl_handle->am_upath = strdup (upath);
+        dtl_handle->am_id++;
+        ucx_unlock (dtl_handle);
+        if (dtl_handle->am_upath == NULL) {
+            return DYAD_RC_SYSFAIL;
+        }
+    }
+#endif
+    return DYAD_RC_OK;
+}
+
+// What the consumer knows of the module of a rank
+static void ucx_rank_state_set (dyad_dtl_ucx_t* h, uint32_t rank, uint8_t state)
+{
+    uint32_t size = 0;
+    uint8_t* rank_state = NULL;
+    if (rank >= h->nranks) {
+        if (flux_get_size (h->h, &size) < 0 || size <= rank)
+            size = rank + 1u;
+        if ((rank_state = (uint8_t*)realloc (h->rank_state, size)) == NULL)
+            return;
+        memset (rank_state + h->nranks, DYAD_UCX_RANK_UNKNOWN, size - h->nranks);
+        h->rank_state = rank_state;
+        h->nranks = size;
+    }
+    h->rank_state[rank] = state;
+}
+
 dyad_rc_t dyad_dtl_ucx_rpc_pack (const dyad_ctx_t* ctx,
                                  const char* restrict upath,
                                  uint32_t producer_rank,
@@ -649,22 +1725,14 @@ dyad_rc_t dyad_dtl_ucx_rpc_pack (const dyad_ctx_t* ctx,
         rc = DYAD_RC_BADPACK;
         goto dtl_ucx_rpc_pack_region_finish;
     }
-    DYAD_LOG_INFO (ctx, "Creating UCP tag for tag matching\n");
-    // Because we're using tag-matching send/recv for communication,
-    // there's no need to do any real connection establishment here.
-    // Instead, we use this function to create the tag that will be
-    // used for the upcoming communication.
     uint32_t consumer_rank = 0;
-    if (flux_get_rank (dtl_handle->h, &consumer_rank) < 0) {
-        DYAD_LOG_ERROR (ctx, "Cannot get consumer rank\n");
-        rc = DYAD_RC_FLUXFAIL;
+    rc = ucx_request_prepare (ctx, upath, producer_rank, &consumer_rank);
+    if (DYAD_IS_ERROR (rc)) {
+        free (enc_buf);
         goto dtl_ucx_rpc_pack_region_finish;
     }
     DYAD_C_FUNCTION_UPDATE_INT ("consumer_rank", consumer_rank);
-    // The tag is a 64 bit unsigned integer consisting of the
-    // 32-bit rank of the producer followed by the 32-bit rank
-    // of the consumer
-    dtl_handle->comm_tag = ((uint64_t)producer_rank << 32) | (uint64_t)consumer_rank;
+    dtl_handle->raw_sent = false;
     // Use Jansson to pack the tag and UCX address into
     // the payload to be sent via RPC to the producer plugin
     DYAD_LOG_INFO (ctx, "Packing RPC payload for UCX DTL\n");
@@ -687,12 +1755,178 @@ dyad_rc_t dyad_dtl_ucx_rpc_pack (const dyad_ctx_t* ctx,
         rc = DYAD_RC_BADPACK;
         goto dtl_ucx_rpc_pack_region_finish;
     }
+    // Modules that do not know about RMA ignore this and send the data
+    if (dtl_handle->rma && json_object_set_new (*packed_obj, "rma", json_true ()) < 0) {
+        json_decref (*packed_obj);
+        *packed_obj = NULL;
+        rc = DYAD_RC_BADPACK;
+        goto dtl_ucx_rpc_pack_region_finish;
+    }
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    // Large files may be sent in chunks. Modules that do not know about
+    // chunks ignore this and send the data in one message.
+    if (json_object_set_new (*packed_obj, "chunks", json_true ()) < 0) {
+        json_decref (*packed_obj);
+        *packed_obj = NULL;
+        rc = DYAD_RC_BADPACK;
+        goto dtl_ucx_rpc_pack_region_finish;
+    }
+    // The data is awaited as an active message answering this request.
+    // Modules that do not know about active messages send it with tags.
+    if (dtl_handle->am
+        && json_object_set_new (*packed_obj, "am_id", json_integer ((json_int_t)dtl_handle->am_id))
+               < 0) {
+        json_decref (*packed_obj);
+        *packed_obj = NULL;
+        rc = DYAD_RC_BADPACK;
+        goto dtl_ucx_rpc_pack_region_finish;
+    }
+#endif
+    // Later requests to the module may only name the connection. Modules that
+    // do not know about compact requests ignore this.
+    if (dtl_handle->conn_id != 0u
+        && json_object_set_new (*packed_obj, "conn_id", json_integer ((json_int_t)dtl_handle->conn_id))
+               < 0) {
+        json_decref (*packed_obj);
+        *packed_obj = NULL;
+        rc = DYAD_RC_BADPACK;
+        goto dtl_ucx_rpc_pack_region_finish;
+    }
     rc = DYAD_RC_OK;
 dtl_ucx_rpc_pack_region_finish:;
     DYAD_C_FUNCTION_END();
     return rc;
 }
 
+dyad_rc_t dyad_dtl_ucx_rpc_pack_raw (const dyad_ctx_t* ctx,
+                                     const char* restrict upath,
+                                     uint32_t producer_rank,
+                                     int64_t size,
+                                     const void** restrict payload,
+                                     size_t* restrict payload_len)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    DYAD_C_FUNCTION_UPDATE_INT ("producer_rank", producer_rank);
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct ucx_raw_req req;
+    size_t upath_len = strlen (upath) + 1u;
+    size_t len = upath_len + sizeof (req);
+    uint32_t consumer_rank = 0;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    // Only a module that has the address of the consumer takes a compact request
+    if (dtl_handle->conn_id == 0u || producer_rank >= dtl_handle->nranks
+        || dtl_handle->rank_state[producer_rank] != DYAD_UCX_RANK_REGISTERED) {
+        rc = DYAD_RC_NOTFOUND;
+        goto dtl_ucx_rpc_pack_raw_region_finish;
+    }
+    if (len > dtl_handle->raw_cap) {
+        char* raw_buf = (char*)realloc (dtl_handle->raw_buf, len);
+        if (raw_buf == NULL) {
+            rc = DYAD_RC_SYSFAIL;
+            goto dtl_ucx_rpc_pack_raw_region_finish;
+        }
+        dtl_handle->raw_buf = raw_buf;
+        dtl_handle->raw_cap = len;
+    }
+    rc = ucx_request_prepare (ctx, upath, producer_rank, &consumer_rank);
+    if (DYAD_IS_ERROR (rc)) {
+        goto dtl_ucx_rpc_pack_raw_region_finish;
+    }
+    req.magic = DYAD_UCX_RAW_MAGIC;
+    req.flags = (dtl_handle->rma ? DYAD_UCX_RAW_RMA : 0u);
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    req.flags |= DYAD_UCX_RAW_CHUNKS;
+    req.am_id = dtl_handle->am ? dtl_handle->am_id : 0u;
+#else
+    req.am_id = 0u;
+#endif
+    req.tag_prod = producer_rank;
+    req.tag_cons = consumer_rank;
+    req.conn_id = dtl_handle->conn_id;
+    req.size = (size >= 0) ? (uint64_t)size : DYAD_UCX_RAW_NO_SIZE;
+    memcpy (dtl_handle->raw_buf, upath, upath_len);
+    memcpy (dtl_handle->raw_buf + upath_len, &req, sizeof (req));
+    dtl_handle->raw_sent = true;
+    *payload = dtl_handle->raw_buf;
+    *payload_len = len;
+    rc = DYAD_RC_OK;
+dtl_ucx_rpc_pack_raw_region_finish:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+static bool ucx_is_raw_request (const flux_msg_t* msg)
+{
+    const char* topic = NULL;
+    return (flux_msg_get_topic (msg, &topic) == 0 && strcmp (topic, DYAD_FETCH_RAW_RPC_NAME) == 0);
+}
+
+// Split the payload of a compact request into the path and what follows it
+static dyad_rc_t ucx_raw_decode (const flux_msg_t* msg, char** upath, struct ucx_raw_req* req)
+{
+    const void* data = NULL;
+    int len = 0;
+    const char* end = NULL;
+    if (flux_request_decode_raw (msg, NULL, &data, &len) < 0 || data == NULL || len <= 0)
+        return DYAD_RC_BADUNPACK;
+    end = (const char*)memchr (data, '\0', (size_t)len);
+    if (end == NULL || (size_t)((const char*)data + len - (end + 1)) != sizeof (*req))
+        return DYAD_RC_BADUNPACK;
+    memcpy (req, end + 1, sizeof (*req));
+    if (req->magic != DYAD_UCX_RAW_MAGIC || req->conn_id == 0u)
+        return DYAD_RC_BADUNPACK;
+    *upath = (char*)data;
+    return DYAD_RC_OK;
+}
+
+// Unpack a compact request. The endpoint to the consumer comes from the
+// cache or, failing that, from the address it sent in an earlier request.
+static dyad_rc_t ucx_rpc_unpack_raw (const dyad_ctx_t* ctx, const flux_msg_t* msg, char** upath)
+{
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct ucx_raw_req req;
+    ucp_ep_h cached_ep = NULL;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    dtl_handle->ep = NULL;
+    rc = ucx_raw_decode (msg, upath, &req);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Could not decode compact request from consumer!\n");
+        return rc;
+    }
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    dtl_handle->rma = ((req.flags & DYAD_UCX_RAW_RMA) != 0u);
+    dtl_handle->chunks = ((req.flags & DYAD_UCX_RAW_CHUNKS) != 0u);
+    free (dtl_handle->am_upath);
+    dtl_handle->am_upath = NULL;
+    dtl_handle->am = (req.am_id > 0u);
+    dtl_handle->am_id = req.am_id;
+    if (dtl_handle->am && (dtl_handle->am_upath = strdup (*upath)) == NULL) {
+        return DYAD_RC_SYSFAIL;
+    }
+#endif
+    dtl_handle->comm_tag = (uint64_t)req.tag_prod << 32 | (uint64_t)req.tag_cons;
+    dtl_handle->consumer_conn_key = req.conn_id;
+    DYAD_LOG_INFO (ctx, "Obtained upath from compact request: %s\n", *upath);
+    // A connection is only registered under the hash of the address of its
+    // consumer, so a cached endpoint under that key is connected to it
+    if (dtl_handle->ep_cache != NULL
+        && !DYAD_IS_ERROR (dyad_ucx_ep_cache_find (ctx, dtl_handle->ep_cache, NULL, 0,
+                                                   &cached_ep))) {
+        dtl_handle->ep = cached_ep;
+        dtl_handle->remote_address = NULL;
+        dtl_handle->remote_addr_len = 0;
+        return DYAD_RC_OK;
+    }
+    rc = ucx_conn_address (req.conn_id, &dtl_handle->remote_address, &dtl_handle->remote_addr_len);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "The address of the consumer of a compact request is gone\n");
+        dtl_handle->remote_address = NULL;
+        dtl_handle->remote_addr_len = 0;
+    }
+    return rc;
+}
+
 dyad_rc_t dyad_dtl_ucx_rpc_unpack (const dyad_ctx_t* ctx, const flux_msg_t* msg, char** upath)
 {
     DYAD_C_FUNCTION_START();
@@ -704,7 +1938,13 @@ dyad_rc_t dyad_dtl_ucx_rpc_unpack (const dyad_ctx_t* ctx, const flux_msg_t* msg,
     uint64_t tag_cons = 0;
     uint64_t pid = 0;
     ssize_t decoded_len = 0;
+    ucp_ep_h cached_ep = NULL;
+    json_int_t conn_id = 0;
     dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    if (ucx_is_raw_request (msg)) {
+        rc = ucx_rpc_unpack_raw (ctx, msg, upath);
+        goto dtl_ucx_rpc_unpack_region_finish;
+    }
     DYAD_LOG_INFO (ctx, "Unpacking RPC payload\n");
     errcode = flux_request_unpack (msg,
                                    NULL,
@@ -720,6 +1960,7 @@ dyad_rc_t dyad_dtl_ucx_rpc_unpack (const dyad_ctx_t* ctx, const flux_msg_t* msg,
                                    "ucx_addr",
                                    &enc_addr,
                                    &enc_addr_len);
+    dtl_handle->ep = NULL;
     if (errcode < 0) {
         DYAD_LOG_ERROR (ctx, "Could not unpack Flux message from consumer!\n");
         rc = DYAD_RC_BADUNPACK;
@@ -727,11 +1968,61 @@ dyad_rc_t dyad_dtl_ucx_rpc_unpack (const dyad_ctx_t* ctx, const flux_msg_t* msg,
     }
     DYAD_C_FUNCTION_UPDATE_INT ("pid", pid);
     DYAD_C_FUNCTION_UPDATE_INT ("tag_cons", tag_cons);
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    // The consumer asks to pull the data itself
+    int rma = 0;
+    if (flux_request_unpack (msg, NULL, "{s?b}", "rma", &rma) < 0) {
+        rma = 0;
+    }
+    dtl_handle->rma = (rma != 0);
+    // The consumer can take large files in chunks
+    int chunks = 0;
+    if (flux_request_unpack (msg, NULL, "{s?b}", "chunks", &chunks) < 0) {
+        chunks = 0;
+    }
+    dtl_handle->chunks = (chunks != 0);
+    // The consumer asks for the data as an active message
+    json_int_t am_id = 0;
+    if (flux_request_unpack (msg, NULL, "{s?I}", "am_id", &am_id) < 0) {
+        am_id = 0;
+    }
+    free (dtl_handle->am_upath);
+    dtl_handle->am_upath = NULL;
+    dtl_handle->am = (am_id > 0);
+    dtl_handle->am_id = (uint64_t)am_id;
+    if (dtl_handle->am && (dtl_handle->am_upath = strdup (*upath)) == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto dtl_ucx_rpc_unpack_region_finish;
+    }
+#endif
+    // Consumers that name their connection are known by it
+    if (flux_request_unpack (msg, NULL, "{s?I}", "conn_id", &conn_id) < 0) {
+        conn_id = 0;
+    }
     dtl_handle->comm_tag = tag_prod << 32 | tag_cons;
-    dtl_handle->consumer_conn_key = pid << 32 | tag_cons;
+    // Endpoints to consumers are cached by the hash of their worker address,
+    // which a consumer that names its connection sends as conn_id. The key
+    // of the others is known once their address is decoded.
+    dtl_handle->consumer_conn_key = (uint64_t)conn_id;
     DYAD_C_FUNCTION_UPDATE_INT ("cons_key", dtl_handle->consumer_conn_key);
     DYAD_LOG_INFO (ctx, "Obtained upath from RPC payload: %s\n", *upath);
     DYAD_LOG_INFO (ctx, "Obtained UCP tag from RPC payload: %lu\n", dtl_handle->comm_tag);
+    // A consumer that already has an endpoint (e.g., because it pre-connected)
+    // does not need its address decoded again. Its connection was registered
+    // only after checking that conn_id is the hash of its address, so that a
+    // restarted consumer, whose address differs, does not get a stale
+    // endpoint.
+    if (dtl_handle->comm_mode == DYAD_COMM_SEND && dtl_handle->ep_cache != NULL && conn_id != 0
+        && ucx_conn_known ((uint64_t)conn_id)
+        && !DYAD_IS_ERROR (dyad_ucx_ep_cache_find (ctx, dtl_handle->ep_cache, NULL, 0,
+                                                   &cached_ep))) {
+        DYAD_LOG_INFO (ctx, "Endpoint to the consumer is cached, skipping address decoding\n");
+        dtl_handle->ep = cached_ep;
+        dtl_handle->remote_address = NULL;
+        dtl_handle->remote_addr_len = 0;
+        rc = DYAD_RC_OK;
+        goto dtl_ucx_rpc_unpack_region_finish;
+    }
     DYAD_LOG_INFO (ctx, "Decoding consumer UCP address using base64\n");
     dtl_handle->remote_addr_len = base64_decoded_length (enc_addr_len);
     dtl_handle->remote_address = (ucp_address_t*)malloc (dtl_handle->remote_addr_len);
@@ -753,24 +2044,113 @@ dyad_rc_t dyad_dtl_ucx_rpc_unpack (const dyad_ctx_t* ctx, const flux_msg_t* msg,
         rc = DYAD_RC_BAD_B64DECODE;
         goto dtl_ucx_rpc_unpack_region_finish;
     }
+    dtl_handle->consumer_conn_key =
+        ucx_addr_hash (dtl_handle->remote_address, (size_t)decoded_len);
+    if (conn_id != 0 && (uint64_t)conn_id == dtl_handle->consumer_conn_key) {
+        ucx_conn_register ((uint64_t)conn_id, dtl_handle->remote_address, (size_t)decoded_len);
+    } else if (conn_id != 0) {
+        DYAD_LOG_ERROR (ctx, "Connection %lu of consumer %lu does not match its address\n",
+                        (unsigned long)conn_id, (unsigned long)pid);
+    }
     rc = DYAD_RC_OK;
 dtl_ucx_rpc_unpack_region_finish:;
     DYAD_C_FUNCTION_END();
     return rc;
 }
 
+dyad_rc_t dyad_dtl_ucx_rpc_unpack_size (const dyad_ctx_t* ctx, const flux_msg_t* msg, size_t* size)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_NOTFOUND;
+    char* upath = NULL;
+    struct ucx_raw_req req;
+    if (ucx_is_raw_request (msg) && !DYAD_IS_ERROR (ucx_raw_decode (msg, &upath, &req))
+        && req.size != DYAD_UCX_RAW_NO_SIZE) {
+        *size = (size_t)req.size;
+        rc = DYAD_RC_OK;
+    }
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
 dyad_rc_t dyad_dtl_ucx_rpc_respond (const dyad_ctx_t* ctx, const flux_msg_t* orig_msg)
 {
     DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    int errcode = 0;
+    char* upath = NULL;
+    struct ucx_raw_req req;
+    // The module answers a request once it admitted it, and the consumer
+    // waits for the data after that. A compact request is only answered if
+    // the module can connect to the consumer, which otherwise sends its
+    // request again in full instead of waiting for the data.
+    if (!ucx_is_raw_request (orig_msg)) {
+        goto dtl_ucx_rpc_respond_go_ahead;
+    }
+    if (DYAD_IS_ERROR (ucx_raw_decode (orig_msg, &upath, &req))) {
+        errcode = EPROTO;
+        rc = DYAD_RC_BADUNPACK;
+        goto dtl_ucx_rpc_respond_region_finish;
+    }
+    if (!ucx_conn_known (req.conn_id)) {
+        DYAD_LOG_INFO (ctx, "Unknown connection in compact request for %s\n", upath);
+        errcode = ENOTCONN;
+        rc = DYAD_RC_NOTFOUND;
+        goto dtl_ucx_rpc_respond_region_finish;
+    }
+dtl_ucx_rpc_respond_go_ahead:;
+    if (flux_respond_raw (ctx->h, orig_msg, NULL, 0) < 0) {
+        errcode = errno;
+        rc = DYAD_RC_FLUXFAIL;
+        goto dtl_ucx_rpc_respond_region_finish;
+    }
+    rc = DYAD_RC_OK;
+dtl_ucx_rpc_respond_region_finish:;
     DYAD_C_FUNCTION_END();
-    return DYAD_RC_OK;
+    if (DYAD_IS_ERROR (rc))
+        errno = errcode;
+    return rc;
 }
 
 dyad_rc_t dyad_dtl_ucx_rpc_recv_response (const dyad_ctx_t* ctx, flux_future_t* f)
 {
     DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
+    uint32_t producer_rank = (uint32_t)(dtl_handle->comm_tag >> 32);
+    bool raw_sent = dtl_handle->raw_sent;
+    dtl_handle->raw_sent = false;
+    // The module answers a request once it admitted it, before it sends the
+    // data, so a request it turned down is not waited for
+    if (flux_rpc_get_raw (f, NULL, NULL) < 0) {
+        if (errno == EAGAIN) {
+            // The caller reads when to try again from f
+            rc = DYAD_RC_BUSY;
+            goto dtl_ucx_rpc_recv_response_region_finish;
+        }
+        if (!raw_sent) {
+            DYAD_LOG_ERROR (ctx, "The module of broker %u turned down a request (errno = %d)\n",
+                            producer_rank, errno);
+            rc = DYAD_RC_BADRPC;
+            goto dtl_ucx_rpc_recv_response_region_finish;
+        }
+        // A module that does not take compact requests (or cannot read
+        // them) is only sent requests in full. Otherwise, the next request
+        // in full gives the module the address of the consumer again.
+        DYAD_LOG_INFO (ctx, "The module of broker %u turned down a compact request (errno = %d)\n",
+                       producer_rank, errno);
+        ucx_rank_state_set (dtl_handle,
+                            producer_rank,
+                            (errno == ENOSYS || errno == EPROTO) ? DYAD_UCX_RANK_FULL
+                                                                 : DYAD_UCX_RANK_UNKNOWN);
+        rc = DYAD_RC_NOTCONN;
+        goto dtl_ucx_rpc_recv_response_region_finish;
+    }
+    flux_future_reset (f);
+    rc = DYAD_RC_OK;
+dtl_ucx_rpc_recv_response_region_finish:;
     DYAD_C_FUNCTION_END();
-    return DYAD_RC_OK;
+    return rc;
 }
 
 dyad_rc_t dyad_dtl_ucx_get_buffer (const dyad_ctx_t* ctx, size_t data_size, void** data_buf)
@@ -790,15 +2170,16 @@ dyad_rc_t dyad_dtl_ucx_get_buffer (const dyad_ctx_t* ctx, size_t data_size, void
     //     rc = DYAD_RC_BADBUF;
     //     goto ucx_get_buffer_done;
     // }
-    DYAD_LOG_INFO (dtl_handle, "Validating data_size in get_buffer");
-    if (data_size > ctx->dtl_handle->private_dtl.ucx_dtl_handle->max_transfer_size) {
-        DYAD_LOG_ERROR (dtl_handle,
-                      "Requested a data size that's larger than the pre-allocated UCX buffer");
-        rc = DYAD_RC_BADBUF;
+    if (dyad_dtl_lend_user_buf (ctx->dtl_handle, data_size, data_buf)) {
+        rc = DYAD_RC_OK;
+        goto ucx_get_buffer_done;
+    }
+    DYAD_LOG_INFO (dtl_handle, "Getting a UCX-allocated buffer of %zu bytes", data_size);
+    rc = dyad_ucx_buf_pool_get (ctx, dtl_handle->buf_pool, data_size, data_buf);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (dtl_handle, "Cannot get a UCX-allocated buffer of %zu bytes", data_size);
         goto ucx_get_buffer_done;
     }
-    DYAD_LOG_INFO (dtl_handle, "Setting the data buffer pointer to the UCX-allocated buffer");
-    *data_buf = dtl_handle->net_buf;
     rc = DYAD_RC_OK;
 
 ucx_get_buffer_done:;
@@ -810,10 +2191,16 @@ dyad_rc_t dyad_dtl_ucx_return_buffer (const dyad_ctx_t* ctx, void** data_buf)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
+    dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
     if (data_buf == NULL || *data_buf == NULL) {
         rc = DYAD_RC_BADBUF;
         goto dtl_ucx_return_buffer_done;
     }
+    if (dyad_dtl_return_user_buf (ctx->dtl_handle, data_buf)) {
+        rc = DYAD_RC_OK;
+        goto dtl_ucx_return_buffer_done;
+    }
+    rc = dyad_ucx_buf_pool_put (ctx, dtl_handle->buf_pool, *data_buf);
     *data_buf = NULL;
 dtl_ucx_return_buffer_done:;
     DYAD_C_FUNCTION_END();
@@ -826,33 +2213,22 @@ dyad_rc_t dyad_dtl_ucx_establish_connection (const dyad_ctx_t* ctx)
     dyad_rc_t rc = DYAD_RC_OK;
     dyad_dtl_ucx_t* dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
     dyad_dtl_comm_mode_t comm_mode = dtl_handle->comm_mode;
+    ucx_lock (dtl_handle);
     if (comm_mode == DYAD_COMM_SEND) {
-        DYAD_LOG_INFO (ctx, "Create UCP endpoint for communication with consumer\n");
-        rc = dyad_ucx_ep_cache_find (ctx, dtl_handle->ep_cache,
-                                     dtl_handle->remote_address,
-                                     dtl_handle->remote_addr_len,
-                                     &(dtl_handle->ep));
-        if (DYAD_IS_ERROR (rc)) {
+        // The endpoint was found in the cache while unpacking the RPC.
+        // Otherwise, connect to the consumer and cache the new endpoint.
+        if (dtl_handle->ep == NULL) {
+            DYAD_LOG_INFO (ctx, "Create UCP endpoint for communication with consumer\n");
             rc = dyad_ucx_ep_cache_insert (ctx,
                                            dtl_handle->ep_cache,
                                            dtl_handle->remote_address,
                                            dtl_handle->remote_addr_len,
-                                           dtl_handle->ucx_worker);
+                                           dtl_handle->ucx_worker,
+                                           &(dtl_handle->ep));
             if (DYAD_IS_ERROR (rc)) {
                 DYAD_LOG_ERROR (ctx, "Failed to create UCP endpoint");
                 goto dtl_ucx_establish_connection_region_finish;
             }
-            rc = dyad_ucx_ep_cache_find (ctx, dtl_handle->ep_cache,
-                                         dtl_handle->remote_address,
-                                         dtl_handle->remote_addr_len,
-                                         &(dtl_handle->ep));
-            if (DYAD_IS_ERROR (rc)) {
-                DYAD_LOG_ERROR (ctx,
-                              "Successfully created UCP endpoint, but can't retrieve it from cache "
-                              "(return code = %d)",
-                              (int)rc);
-                goto dtl_ucx_establish_connection_region_finish;
-            }
         }
         // rc = ucx_connect (ctx,
         //                   dtl_handle->ucx_worker,
@@ -878,6 +2254,7 @@ dyad_rc_t dyad_dtl_ucx_establish_connection (const dyad_ctx_t* ctx)
         rc = DYAD_RC_BAD_COMM_MODE;
     }
 dtl_ucx_establish_connection_region_finish:;
+    ucx_unlock (dtl_handle);
     DYAD_C_FUNCTION_END();
     return rc;
 }
@@ -888,6 +2265,23 @@ dyad_rc_t dyad_dtl_ucx_send (const dyad_ctx_t* ctx, void* buf, size_t buflen)
     dyad_rc_t rc = DYAD_RC_OK;
     ucs_status_ptr_t stat_ptr;
     ucs_status_t status = UCS_OK;
+    ucx_lock (ctx->dtl_handle->private_dtl.ucx_dtl_handle);
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    if (ctx->dtl_handle->private_dtl.ucx_dtl_handle->rma) {
+        rc = ucx_rma_send (ctx, buf, buflen);
+        goto dtl_ucx_send_region_finish;
+    }
+    if (ctx->dtl_handle->private_dtl.ucx_dtl_handle->am) {
+        rc = ucx_am_send (ctx, buf, buflen);
+        goto dtl_ucx_send_region_finish;
+    }
+    if (ctx->dtl_handle->private_dtl.ucx_dtl_handle->chunks
+        && ctx->dtl_handle->private_dtl.ucx_dtl_handle->chunk_size > 0
+        && buflen > ctx->dtl_handle->private_dtl.ucx_dtl_handle->chunk_size) {
+        rc = ucx_chunked_send (ctx, buf, buflen);
+        goto dtl_ucx_send_region_finish;
+    }
+#endif
     stat_ptr = ucx_send_no_wait (ctx, buf, buflen);
     DYAD_LOG_INFO (ctx, "Processing UCP send request\n");
     status = dyad_ucx_request_wait (ctx, stat_ptr);
@@ -901,24 +2295,124 @@ dyad_rc_t dyad_dtl_ucx_send (const dyad_ctx_t* ctx, void* buf, size_t buflen)
     DYAD_LOG_INFO (ctx, "Data send with UCP succeeded\n");
     rc = DYAD_RC_OK;
 dtl_ucx_send_region_finish:;
+    ucx_unlock (ctx->dtl_handle->private_dtl.ucx_dtl_handle);
     DYAD_C_FUNCTION_END();
     return rc;
 }
 
+void dyad_dtl_ucx_unregister_buffer (const dyad_ctx_t* ctx, void* buf)
+{
+    struct ucx_reg** pp = &ucx_regs[ucx_reg_bucket (buf)];
+    struct ucx_reg* dropped = NULL;
+    struct ucx_reg* r = NULL;
+    pthread_mutex_lock (&ucx_reg_lock);
+    while ((r = *pp) != NULL) {
+        if (r->buf == buf) {
+            *pp = r->next;
+            r->next = dropped;
+            dropped = r;
+        } else {
+            pp = &r->next;
+        }
+    }
+    pthread_mutex_unlock (&ucx_reg_lock);
+    while ((r = dropped) != NULL) {
+        dropped = r->next;
+        ucx_reg_free (r);
+    }
+}
+
+// Once a module answered a request carrying the address of the consumer, it
+// takes compact requests
+static void ucx_recv_done (dyad_dtl_ucx_t* h, dyad_rc_t rc)
+{
+    uint32_t producer_rank = (uint32_t)(h->comm_tag >> 32);
+    if (DYAD_IS_ERROR (rc) || h->conn_id == 0u)
+        return;
+    if (producer_rank >= h->nranks || h->rank_state[producer_rank] == DYAD_UCX_RANK_UNKNOWN)
+        ucx_rank_state_set (h, producer_rank, DYAD_UCX_RANK_REGISTERED);
+}
+
 dyad_rc_t dyad_dtl_ucx_recv (const dyad_ctx_t* ctx, void** buf, size_t* buflen)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
     ucs_status_ptr_t stat_ptr = NULL;
     ucs_status_t status = UCS_OK;
+    ucp_tag_t sender_tag = 0;
+    ucx_lock (ctx->dtl_handle->private_dtl.ucx_dtl_handle);
     // Wait on the recv operation to complete
-    stat_ptr = ucx_recv_no_wait (ctx, false, buf, buflen);
+    stat_ptr = ucx_recv_no_wait (ctx, false, buf, buflen, &sender_tag);
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    if (ctx->dtl_handle->private_dtl.ucx_dtl_handle->am_arrived) {
+        rc = ucx_am_recv (ctx, buf, buflen);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "UCX AM recv failed!\n");
+            rc = DYAD_RC_UCXCOMM_FAIL;
+            goto dtl_ucx_recv_region_finish;
+        }
+        DYAD_LOG_INFO (ctx, "Received %lu bytes from producer as an active message\n", *buflen);
+        goto dtl_ucx_recv_region_finish;
+    }
+#endif
     DYAD_LOG_INFO (ctx, "Wait for UCP recv operation to complete\n");
     status = dyad_ucx_request_wait (ctx, stat_ptr);
+    if (sender_tag & DYAD_UCX_CHUNK_TAG_BIT) {
+        // What was received is the size of the chunks that follow
+        struct ucx_chunk_hdr* hdr = (struct ucx_chunk_hdr*)*buf;
+        size_t hdr_len = *buflen;
+        *buf = NULL;
+        *buflen = 0;
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+        if (!UCX_STATUS_FAIL (status)) {
+            rc = ucx_chunked_recv (ctx, hdr, hdr_len, buf, buflen);
+        }
+#else
+        (void)hdr_len;
+        status = UCS_ERR_UNSUPPORTED;
+#endif
+        free (hdr);
+        if (UCX_STATUS_FAIL (status) || DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "UCX chunked recv failed!\n");
+            rc = DYAD_RC_UCXCOMM_FAIL;
+            goto dtl_ucx_recv_region_finish;
+        }
+        DYAD_LOG_INFO (ctx, "Received %lu bytes from producer in chunks\n", *buflen);
+        rc = DYAD_RC_OK;
+        goto dtl_ucx_recv_region_finish;
+    }
+    if (sender_tag & DYAD_UCX_RMA_TAG_BIT) {
+        // What was received is where to pull the data from
+        struct ucx_rma_desc* desc = (struct ucx_rma_desc*)*buf;
+        size_t desc_len = *buflen;
+        *buf = NULL;
+        *buflen = 0;
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+        if (!UCX_STATUS_FAIL (status)) {
+            rc = ucx_rma_get (ctx, desc, desc_len, buf, buflen);
+        }
+#else
+        (void)desc_len;
+        status = UCS_ERR_UNSUPPORTED;
+#endif
+        free (desc);
+        if (UCX_STATUS_FAIL (status) || DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "UCX RMA recv failed!\n");
+            rc = DYAD_RC_UCXCOMM_FAIL;
+            goto dtl_ucx_recv_region_finish;
+        }
+        DYAD_LOG_INFO (ctx, "Pulled %lu bytes from producer\n", *buflen);
+        rc = DYAD_RC_OK;
+        goto dtl_ucx_recv_region_finish;
+    }
     // If the recv operation failed, log an error, free the data buffer,
     // and set the buffer pointer to NULL
     if (UCX_STATUS_FAIL (status)) {
         DYAD_LOG_ERROR (ctx, "UCX recv failed!\n");
+        if (*buf != NULL) {
+            dyad_dtl_ucx_return_buffer (ctx, buf);
+        }
+        *buflen = 0;
         rc = DYAD_RC_UCXCOMM_FAIL;
         goto dtl_ucx_recv_region_finish;
     }
@@ -926,6 +2420,8 @@ dyad_rc_t dyad_dtl_ucx_recv (const dyad_ctx_t* ctx, void** buf, size_t* buflen)
     DYAD_LOG_INFO (ctx, "Received %lu bytes from producer\n", *buflen);
     rc = DYAD_RC_OK;
 dtl_ucx_recv_region_finish:;
+    ucx_unlock (ctx->dtl_handle->private_dtl.ucx_dtl_handle);
+    ucx_recv_done (ctx->dtl_handle->private_dtl.ucx_dtl_handle, rc);
     DYAD_C_FUNCTION_END();
     return rc;
 }
@@ -938,24 +2434,16 @@ dyad_rc_t dyad_dtl_ucx_close_connection (const dyad_ctx_t* ctx)
     dyad_dtl_comm_mode_t comm_mode = dtl_handle->comm_mode;
     if (comm_mode == DYAD_COMM_SEND) {
         if (dtl_handle != NULL) {
-            // TODO replace this code (either here or elsewhere) with LRU eviction
-            // rc = ucx_disconnect (ctx, dtl_handle->ucx_worker, dtl_handle->ep);
-            // if (DYAD_IS_ERROR (rc)) {
-            //     DYAD_LOG_ERROR (ctx,
-            //                   "Could not successfully close Endpoint! However, endpoint was "
-            //                   "released.");
-            // }
+            // The endpoint stays in the cache, which disconnects it once
+            // evicted
             dtl_handle->ep = NULL;
-            // Sender doesn't have a consumer address at this time
-            // So, free the consumer address when closing the connection
-            // NOTE: currently removing the deallocation of the remote address
-            //       because it is still in use by the endpoint cache
-            // if (dtl_handle->remote_address != NULL) {
-            //     free (dtl_handle->remote_address);
+            // The cache keeps its own copy of the consumer address
+            free (dtl_handle->remote_address);
             dtl_handle->remote_address = NULL;
             dtl_handle->remote_addr_len = 0;
-            // }
             dtl_handle->comm_tag = 0;
+            free (dtl_handle->am_upath);
+            dtl_handle->am_upath = NULL;
         }
         DYAD_LOG_INFO (ctx, "UCP endpoint close successful\n");
         rc = DYAD_RC_OK;
@@ -989,10 +2477,33 @@ dyad_rc_t dyad_dtl_ucx_finalize (const dyad_ctx_t* ctx)
     }
     dtl_handle = ctx->dtl_handle->private_dtl.ucx_dtl_handle;
     DYAD_LOG_INFO (ctx, "Finalizing UCX DTL\n");
+    if (dtl_handle->progress_thread_on) {
+        pthread_mutex_lock (&dtl_handle->lock);
+        dtl_handle->progress_stop = true;
+        ucp_worker_signal (dtl_handle->ucx_worker);
+        pthread_mutex_unlock (&dtl_handle->lock);
+        pthread_join (dtl_handle->progress_thread, NULL);
+        pthread_cond_destroy (&dtl_handle->cond);
+        pthread_mutex_destroy (&dtl_handle->lock);
+        dtl_handle->progress_thread_on = false;
+    }
     if (dtl_handle->ep != NULL) {
         dyad_dtl_ucx_close_connection (ctx);
         dtl_handle->ep = NULL;
     }
+    free (dtl_handle->remote_address);
+    dtl_handle->remote_address = NULL;
+#if UCP_API_VERSION >= UCP_VERSION(1, 10)
+    if (dtl_handle->ucx_worker != NULL) {
+        ucx_am_release (dtl_handle);
+    }
+#endif
+    free (dtl_handle->am_upath);
+    dtl_handle->am_upath = NULL;
+    free (dtl_handle->rank_state);
+    dtl_handle->rank_state = NULL;
+    free (dtl_handle->raw_buf);
+    dtl_handle->raw_buf = NULL;
     if (dtl_handle->ep_cache != NULL) {
         dyad_ucx_ep_cache_finalize (ctx, &(dtl_handle->ep_cache), dtl_handle->ucx_worker);
         dtl_handle->ep_cache = NULL;
@@ -1002,12 +2513,9 @@ dyad_rc_t dyad_dtl_ucx_finalize (const dyad_ctx_t* ctx)
         ucp_worker_release_address (dtl_handle->ucx_worker, dtl_handle->local_address);
         dtl_handle->local_address = NULL;
     }
-    // Free memory buffer if not already freed
-    if (dtl_handle->mem_handle != NULL) {
-        ucx_free_buffer (ctx,
-                         dtl_handle->ucx_ctx,
-                         dtl_handle->mem_handle,
-                         &(dtl_handle->net_buf));
+    // Unmap the buffers before the context they are registered with goes away
+    if (dtl_handle->buf_pool != NULL) {
+        dyad_ucx_buf_pool_finalize (ctx, &(dtl_handle->buf_pool));
     }
     // Release worker if not already released
     if (dtl_handle->ucx_worker != NULL) {
@@ -1016,7 +2524,7 @@ dyad_rc_t dyad_dtl_ucx_finalize (const dyad_ctx_t* ctx)
     }
     // Release context if not already released
     if (dtl_handle->ucx_ctx != NULL) {
-        ucp_cleanup (dtl_handle->ucx_ctx);
+        ucx_context_release (dtl_handle->ucx_ctx);
         dtl_handle->ucx_ctx = NULL;
     }
     // Flux handle should be released by the
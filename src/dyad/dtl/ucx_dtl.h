@@ -8,18 +8,22 @@
 #endif
 
 #include <dyad/dtl/dyad_dtl_api.h>
+#include <dyad/dtl/ucx_buf_pool.h>
 #include <dyad/dtl/ucx_ep_cache.h>
 #include <ucp/api/ucp.h>
+#include <pthread.h>
 #include <stdlib.h>
 
+// State of the UCX DTL of a DYAD context. The UCP context is shared by the
+// process, while the worker and the state of the current transfer belong to
+// the thread using the DYAD context.
 struct dyad_dtl_ucx {
     flux_t* h;
     dyad_dtl_comm_mode_t comm_mode;
     bool debug;
     ucp_context_h ucx_ctx;
     ucp_worker_h ucx_worker;
-    ucp_mem_h mem_handle;
-    void* net_buf;
+    ucx_buf_pool_h buf_pool;
     size_t max_transfer_size;
     ucp_address_t* local_address;
     size_t local_addr_len;
@@ -29,6 +33,34 @@ struct dyad_dtl_ucx {
     ucp_tag_t comm_tag;
     ucx_ep_cache_h ep_cache;
     uint64_t consumer_conn_key;
+    uint64_t conn_id;  // identifier of the connection of a consumer, sent instead of its address
+    uint8_t* rank_state;  // what the consumer knows of the module of each rank
+    uint32_t nranks;
+    bool raw_sent;  // the last request was sent in compact form
+    char* raw_buf;  // payload of the compact requests
+    size_t raw_cap;
+    bool rma;  // the consumer pulls the data with RMA (DYAD_UCX_RMA)
+    uint64_t rma_id;  // identifier of the last buffer exposed with RMA
+    bool chunks;  // the consumer takes large files in chunks
+    size_t chunk_size;  // size of the chunks large files are sent in (DYAD_UCX_CHUNK)
+    unsigned int chunk_seq;  // sequence number of the last file sent in chunks
+    unsigned int pipeline;  // number of chunks in flight (DYAD_UCX_PIPELINE)
+    bool am;  // the data is sent as an active message (DYAD_UCX_AM)
+    uint64_t am_id;  // identifier of the request the active message answers
+    char* am_upath;  // path of the file the active message carries
+    bool am_arrived;  // the active message answering am_id arrived
+    bool am_rndv;  // am_data is the descriptor of a rendezvous, not the data
+    bool am_copied;  // am_data was copied out of UCX
+    void* am_data;
+    size_t am_len;
+    int efd;  // event fd of the worker (-1 if waits must spin)
+    unsigned int spin_us;  // time a wait spins before blocking
+    unsigned int spin_max_us;  // upper bound of spin_us (DYAD_UCX_SPIN_US)
+    bool progress_thread_on;  // a thread progresses the worker (DYAD_UCX_PROGRESS)
+    bool progress_stop;  // set when the progress thread must exit
+    pthread_t progress_thread;
+    pthread_mutex_t lock;  // serializes the use of the worker with the progress thread
+    pthread_cond_t cond;  // signaled by the progress thread when it made progress
 };
 
 typedef struct dyad_dtl_ucx dyad_dtl_ucx_t;
@@ -43,8 +75,17 @@ dyad_rc_t dyad_dtl_ucx_rpc_pack (const dyad_ctx_t* ctx,
                                  uint32_t producer_rank,
                                  json_t**  packed_obj);
 
+dyad_rc_t dyad_dtl_ucx_rpc_pack_raw (const dyad_ctx_t* ctx,
+                                     const char* upath,
+                                     uint32_t producer_rank,
+                                     int64_t size,
+                                     const void** payload,
+                                     size_t* payload_len);
+
 dyad_rc_t dyad_dtl_ucx_rpc_unpack (const dyad_ctx_t* ctx, const flux_msg_t* msg, char** upath);
 
+dyad_rc_t dyad_dtl_ucx_rpc_unpack_size (const dyad_ctx_t* ctx, const flux_msg_t* msg, size_t* size);
+
 dyad_rc_t dyad_dtl_ucx_rpc_respond (const dyad_ctx_t* ctx, const flux_msg_t* orig_msg);
 
 dyad_rc_t dyad_dtl_ucx_rpc_recv_response (const dyad_ctx_t* ctx, flux_future_t* f);
@@ -57,6 +98,8 @@ dyad_rc_t dyad_dtl_ucx_establish_connection (const dyad_ctx_t* ctx);
 
 dyad_rc_t dyad_dtl_ucx_send (const dyad_ctx_t* ctx, void* buf, size_t buflen);
 
+void dyad_dtl_ucx_unregister_buffer (const dyad_ctx_t* ctx, void* buf);
+
 dyad_rc_t dyad_dtl_ucx_recv (const dyad_ctx_t* ctx, void** buf, size_t* buflen);
 
 dyad_rc_t dyad_dtl_ucx_close_connection (const dyad_ctx_t* ctx);
@@ -9,13 +9,40 @@
 #include <dyad/dtl/ucx_ep_cache.h>
 #include <dyad/common/dyad_structures.h>
 
-#include <functional>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <new>
-#include <unordered_map>
-#include <utility>
 
-using key_type = uint64_t;
-using cache_type = std::unordered_map<key_type, ucp_ep_h>;
+// The cache is a flat open-addressing table (linear probing) of indices into
+// an array of entries, preallocated for its capacity. The entries are kept on
+// an intrusive list from the most to the least recently used, and the least
+// recently used one is evicted to make room for a new endpoint. The table has
+// at least twice as many slots as the capacity, so probe sequences stay short.
+// Entries are removed with backward-shift deletion, which needs no tombstones.
+
+static constexpr uint32_t EP_NIL = UINT32_MAX;
+
+struct ep_entry {
+    uint64_t key;
+    ucp_ep_h ep;
+    ucp_address_t* addr;  // copy of the remote address, owned by the cache
+    size_t addr_size;
+    uint32_t prev;  // more recently used entry
+    uint32_t next;  // less recently used entry, or next free entry
+};
+
+struct ep_cache {
+    uint32_t capacity;
+    uint32_t size;
+    size_t mask;  // number of slots - 1
+    uint32_t* slots;  // index of an entry, or EP_NIL if the slot is empty
+    ep_entry* entries;
+    uint32_t mru;
+    uint32_t lru;
+    uint32_t free_list;
+    dyad_ucx_ep_cache_stats_t stats;
+};
 
 static void dyad_ucx_ep_err_handler (void* arg, ucp_ep_h ep, ucs_status_t status)
 {
@@ -107,19 +134,142 @@ ucx_disconnect_region_finish:
     return rc;
 }
 
-dyad_rc_t dyad_ucx_ep_cache_init (const dyad_ctx_t *ctx, ucx_ep_cache_h* cache)
+static inline size_t ep_home_slot (const ep_cache* c, uint64_t key)
+{
+    // Keys are hashes of addresses. Mix the bits so that
+    // the low ones, which pick the slot, depend on the whole key.
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebull;
+    key ^= key >> 31;
+    return (size_t)key & c->mask;
+}
+
+// Slot holding the entry of key, or the empty slot where it would go
+static inline size_t ep_probe (const ep_cache* c, uint64_t key)
+{
+    size_t s = ep_home_slot (c, key);
+    while (c->slots[s] != EP_NIL && c->entries[c->slots[s]].key != key) {
+        s = (s + 1) & c->mask;
+    }
+    return s;
+}
+
+static inline void ep_lru_unlink (ep_cache* c, uint32_t i)
+{
+    ep_entry* e = &c->entries[i];
+    if (e->prev != EP_NIL)
+        c->entries[e->prev].next = e->next;
+    else
+        c->mru = e->next;
+    if (e->next != EP_NIL)
+        c->entries[e->next].prev = e->prev;
+    else
+        c->lru = e->prev;
+}
+
+static inline void ep_lru_push (ep_cache* c, uint32_t i)
+{
+    ep_entry* e = &c->entries[i];
+    e->prev = EP_NIL;
+    e->next = c->mru;
+    if (c->mru != EP_NIL)
+        c->entries[c->mru].prev = i;
+    else
+        c->lru = i;
+    c->mru = i;
+}
+
+static inline bool ep_same_addr (const ep_entry* e, const ucp_address_t* addr, size_t addr_size)
+{
+    // Without an address, the key alone identifies the peer
+    return addr == nullptr
+           || (e->addr_size == addr_size && memcmp (e->addr, addr, addr_size) == 0);
+}
+
+// Empty a slot, and move back the entries that follow it in their probe
+// sequence so that no lookup stops at the hole
+static void ep_slot_erase (ep_cache* c, size_t hole)
+{
+    size_t s = hole;
+    c->slots[hole] = EP_NIL;
+    for (;;) {
+        s = (s + 1) & c->mask;
+        if (c->slots[s] == EP_NIL)
+            break;
+        size_t home = ep_home_slot (c, c->entries[c->slots[s]].key);
+        // The entry may fill the hole only if its home slot is not between
+        // the hole (excluded) and its slot
+        if (((s - home) & c->mask) >= ((s - hole) & c->mask)) {
+            c->slots[hole] = c->slots[s];
+            c->slots[s] = EP_NIL;
+            hole = s;
+        }
+    }
+}
+
+// Disconnect the endpoint in a slot and release its entry
+static void ep_drop (const dyad_ctx_t* ctx, ep_cache* c, size_t s, ucp_worker_h worker)
+{
+    uint32_t i = c->slots[s];
+    ep_entry* e = &c->entries[i];
+    ep_slot_erase (c, s);
+    ep_lru_unlink (c, i);
+    ucx_disconnect (ctx, worker, e->ep);
+    free (e->addr);
+    e->ep = nullptr;
+    e->addr = nullptr;
+    e->addr_size = 0;
+    e->next = c->free_list;
+    c->free_list = i;
+    c->size--;
+}
+
+dyad_rc_t dyad_ucx_ep_cache_init (const dyad_ctx_t* ctx, size_t capacity, ucx_ep_cache_h* cache)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
+    ep_cache* c = nullptr;
+    size_t nslots = 2u;
+    uint32_t i = 0u;
     if (cache == nullptr || *cache != nullptr) {
         rc = DYAD_RC_BADBUF;
         goto ucx_ep_cache_init_done;
     }
-    *cache = reinterpret_cast<ucx_ep_cache_h> (new (std::nothrow) cache_type ());
-    if (*cache == nullptr) {
+    if (capacity == 0u || capacity > DYAD_UCX_EP_CACHE_MAX) {
+        DYAD_LOG_ERROR (ctx, "Invalid endpoint cache capacity %zu", capacity);
+        rc = DYAD_RC_BADBUF;
+        goto ucx_ep_cache_init_done;
+    }
+    while (nslots < 2u * capacity)
+        nslots <<= 1;
+    c = new (std::nothrow) ep_cache ();
+    if (c == nullptr) {
         rc = DYAD_RC_SYSFAIL;
         goto ucx_ep_cache_init_done;
     }
+    c->slots = (uint32_t*)malloc (nslots * sizeof (uint32_t));
+    c->entries = (ep_entry*)calloc (capacity, sizeof (ep_entry));
+    if (c->slots == nullptr || c->entries == nullptr) {
+        free (c->slots);
+        free (c->entries);
+        delete c;
+        rc = DYAD_RC_SYSFAIL;
+        goto ucx_ep_cache_init_done;
+    }
+    c->capacity = (uint32_t)capacity;
+    c->size = 0u;
+    c->mask = nslots - 1u;
+    for (size_t s = 0u; s < nslots; s++)
+        c->slots[s] = EP_NIL;
+    for (i = 0u; i < c->capacity; i++)
+        c->entries[i].next = (i + 1u < c->capacity) ? i + 1u : EP_NIL;
+    c->free_list = 0u;
+    c->mru = EP_NIL;
+    c->lru = EP_NIL;
+    c->stats.capacity = capacity;
+    *cache = reinterpret_cast<ucx_ep_cache_h> (c);
 ucx_ep_cache_init_done:;
     DYAD_C_FUNCTION_END();
     return rc;
@@ -133,25 +283,27 @@ dyad_rc_t dyad_ucx_ep_cache_find (const dyad_ctx_t *ctx,
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
-    if (ep == nullptr || *ep != nullptr) {
+    ep_cache* c = reinterpret_cast<ep_cache*> (cache);
+    uint64_t key = 0u;
+    uint32_t i = EP_NIL;
+    if (c == nullptr || ep == nullptr || *ep != nullptr) {
         rc = DYAD_RC_BADBUF;
         goto ucx_ep_cache_find_done;
     }
-    try {
-        const auto* cpp_cache = reinterpret_cast<const cache_type*> (cache);
-        auto key = ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key;
-        auto cache_it = cpp_cache->find (key);
-        if (cache_it == cpp_cache->cend ()) {
-            *ep = nullptr;
-            rc = DYAD_RC_NOTFOUND;
-        } else {
-            *ep = cache_it->second;
-            rc = DYAD_RC_OK;
-        }
-    } catch (...) {
-        *ep = nullptr;
-        rc = DYAD_RC_SYSFAIL;
+    key = ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key;
+    i = c->slots[ep_probe (c, key)];
+    // An entry with another address is stale (e.g., the hashes collide),
+    // and is replaced by the insertion that follows the miss
+    if (i == EP_NIL || !ep_same_addr (&c->entries[i], addr, addr_size)) {
+        c->stats.misses++;
+        rc = DYAD_RC_NOTFOUND;
+        goto ucx_ep_cache_find_done;
     }
+    c->stats.hits++;
+    ep_lru_unlink (c, i);
+    ep_lru_push (c, i);
+    *ep = c->entries[i].ep;
+    rc = DYAD_RC_OK;
 ucx_ep_cache_find_done:;
     DYAD_C_FUNCTION_END();
     return rc;
@@ -161,49 +313,71 @@ dyad_rc_t dyad_ucx_ep_cache_insert (const dyad_ctx_t *ctx,
                                     ucx_ep_cache_h cache,
                                     const ucp_address_t* addr,
                                     const size_t addr_size,
-                                    ucp_worker_h worker)
+                                    ucp_worker_h worker,
+                                    ucp_ep_h* ep)
 {
     DYAD_C_FUNCTION_START();
     dyad_rc_t rc = DYAD_RC_OK;
-    try {
-        cache_type* cpp_cache = reinterpret_cast<cache_type*> (cache);
-        uint64_t key = ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key;
-        DYAD_C_FUNCTION_UPDATE_INT("cons_key", ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key)
-        auto cache_it = cpp_cache->find (key);
-        if (cache_it != cpp_cache->end ()) {
+    ep_cache* c = reinterpret_cast<ep_cache*> (cache);
+    uint64_t key = 0u;
+    size_t s = 0u;
+    uint32_t i = EP_NIL;
+    ep_entry* e = nullptr;
+    ucp_address_t* addr_copy = nullptr;
+    ucp_ep_h new_ep = nullptr;
+    if (c == nullptr || addr == nullptr || addr_size == 0u || ep == nullptr) {
+        rc = DYAD_RC_BADBUF;
+        goto ucx_ep_cache_insert_done;
+    }
+    key = ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key;
+    DYAD_C_FUNCTION_UPDATE_INT ("cons_key", key);
+    s = ep_probe (c, key);
+    if (c->slots[s] != EP_NIL) {
+        i = c->slots[s];
+        if (ep_same_addr (&c->entries[i], addr, addr_size)) {
+            ep_lru_unlink (c, i);
+            ep_lru_push (c, i);
+            *ep = c->entries[i].ep;
             rc = DYAD_RC_OK;
-        } else {
-            ucp_ep_h ep;
-            rc = ucx_connect (ctx, worker, addr, &ep);
-            if (!DYAD_IS_ERROR (rc)) {
-                cpp_cache->insert_or_assign(key, ep);
-                rc = DYAD_RC_OK;
-            }
+            goto ucx_ep_cache_insert_done;
         }
-    } catch (...) {
+        DYAD_LOG_DEBUG (ctx, "Replacing the stale endpoint of key %lu", (unsigned long)key);
+        ep_drop (ctx, c, s, worker);
+    }
+    addr_copy = (ucp_address_t*)malloc (addr_size);
+    if (addr_copy == nullptr) {
         rc = DYAD_RC_SYSFAIL;
+        goto ucx_ep_cache_insert_done;
     }
-    DYAD_C_FUNCTION_END();
-    return rc;
-}
-
-static inline cache_type::iterator cache_remove_impl (const dyad_ctx_t *ctx,
-                                                      cache_type* cache,
-                                                      cache_type::iterator it,
-                                                      ucp_worker_h worker)
-{
-    DYAD_C_FUNCTION_START();
-    if (it != cache->end ()) {
-        ucx_disconnect (ctx, worker, it->second);
-        // The UCP address was allocated with 'malloc' while unpacking
-        // the RPC message. So, we extract it from the key and free
-        // it after erasing the iterator
-        auto next_it = cache->erase (it);
-        DYAD_C_FUNCTION_END();
-        return next_it;
+    memcpy (addr_copy, addr, addr_size);
+    rc = ucx_connect (ctx, worker, addr, &new_ep);
+    if (DYAD_IS_ERROR (rc)) {
+        free (addr_copy);
+        goto ucx_ep_cache_insert_done;
+    }
+    if (c->size == c->capacity) {
+        DYAD_LOG_DEBUG (ctx, "Evicting the endpoint of key %lu",
+                        (unsigned long)c->entries[c->lru].key);
+        ep_drop (ctx, c, ep_probe (c, c->entries[c->lru].key), worker);
+        c->stats.evictions++;
     }
+    // Deletions may have moved entries, so probe again
+    s = ep_probe (c, key);
+    i = c->free_list;
+    e = &c->entries[i];
+    c->free_list = e->next;
+    e->key = key;
+    e->ep = new_ep;
+    e->addr = addr_copy;
+    e->addr_size = addr_size;
+    c->slots[s] = i;
+    ep_lru_push (c, i);
+    c->size++;
+    *ep = new_ep;
+    rc = DYAD_RC_OK;
+ucx_ep_cache_insert_done:;
     DYAD_C_FUNCTION_END();
-    return cache->end ();
+    return rc;
 }
 
 dyad_rc_t dyad_ucx_ep_cache_remove (const dyad_ctx_t *ctx,
@@ -213,31 +387,44 @@ dyad_rc_t dyad_ucx_ep_cache_remove (const dyad_ctx_t *ctx,
                                     ucp_worker_h worker)
 {
     DYAD_C_FUNCTION_START();
-    dyad_rc_t rc = DYAD_RC_OK;
-    try {
-        cache_type* cpp_cache = reinterpret_cast<cache_type*> (cache);
-        auto key = ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key;
-        cache_type::iterator cache_it = cpp_cache->find (key);
-        cache_remove_impl (ctx, cpp_cache, cache_it, worker);
-        rc = DYAD_RC_OK;
-    } catch (...) {
-        rc = DYAD_RC_SYSFAIL;
+    ep_cache* c = reinterpret_cast<ep_cache*> (cache);
+    if (c != nullptr) {
+        size_t s = ep_probe (c, ctx->dtl_handle->private_dtl.ucx_dtl_handle->consumer_conn_key);
+        if (c->slots[s] != EP_NIL)
+            ep_drop (ctx, c, s, worker);
     }
     DYAD_C_FUNCTION_END();
-    return rc;
+    return DYAD_RC_OK;
+}
+
+dyad_rc_t dyad_ucx_ep_cache_stats (const ucx_ep_cache_h cache, dyad_ucx_ep_cache_stats_t* stats)
+{
+    const ep_cache* c = reinterpret_cast<const ep_cache*> (cache);
+    if (c == nullptr || stats == nullptr)
+        return DYAD_RC_BADBUF;
+    *stats = c->stats;
+    stats->size = c->size;
+    return DYAD_RC_OK;
 }
 
 dyad_rc_t dyad_ucx_ep_cache_finalize (const dyad_ctx_t *ctx, ucx_ep_cache_h* cache, ucp_worker_h worker)
 {
     DYAD_C_FUNCTION_START();
+    ep_cache* c = nullptr;
     if (cache == nullptr || *cache == nullptr) {
+        DYAD_C_FUNCTION_END();
         return DYAD_RC_OK;
     }
-    cache_type* cpp_cache = reinterpret_cast<cache_type*> (*cache);
-    for (cache_type::iterator it = cpp_cache->begin (); it != cpp_cache->end ();) {
-        it = cache_remove_impl (ctx, cpp_cache, it, worker);
-    }
-    delete cpp_cache;
+    c = reinterpret_cast<ep_cache*> (*cache);
+    DYAD_LOG_INFO (ctx,
+                   "Endpoint cache: %lu hits, %lu misses, %lu evictions, %u of %u entries used",
+                   (unsigned long)c->stats.hits, (unsigned long)c->stats.misses,
+                   (unsigned long)c->stats.evictions, c->size, c->capacity);
+    while (c->lru != EP_NIL)
+        ep_drop (ctx, c, ep_probe (c, c->entries[c->lru].key), worker);
+    free (c->slots);
+    free (c->entries);
+    delete c;
     *cache = nullptr;
     DYAD_C_FUNCTION_END();
     return DYAD_RC_OK;
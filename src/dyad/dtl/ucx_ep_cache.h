@@ -14,13 +14,30 @@
 #include <dyad/dtl/ucx_dtl.h>
 
 #ifdef __cplusplus
+#include <cstdint>
 extern "C" {
+#else
+#include <stdint.h>
 #endif
 
 // Macro function used to simplify checking the status
 // of UCX operations
 #define UCX_STATUS_FAIL(status) (status != UCS_OK)
 
+// Number of endpoints cached when DYAD_UCX_EP_CACHE is not set
+#define DYAD_UCX_EP_CACHE_DEFAULT 1024u
+#define DYAD_UCX_EP_CACHE_MAX (1u << 30)
+
+// Counters of an endpoint cache. Every lookup is either a hit or a miss, and
+// an eviction is counted whenever the least recently used endpoint is
+// disconnected to make room for a new one.
+typedef struct dyad_ucx_ep_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t size;
+    size_t capacity;
+} dyad_ucx_ep_cache_stats_t;
 
 
 dyad_rc_t ucx_connect (const dyad_ctx_t *ctx,
@@ -30,21 +47,27 @@ dyad_rc_t ucx_connect (const dyad_ctx_t *ctx,
 
 dyad_rc_t ucx_disconnect (const dyad_ctx_t *ctx, ucp_worker_h worker, ucp_ep_h ep);
 
-// NOTE: in future, add option to configure replacement strategy
-dyad_rc_t dyad_ucx_ep_cache_init (const dyad_ctx_t *ctx, ucx_ep_cache_h* cache);
+// Create a cache of at most capacity endpoints, keyed by the
+// consumer_conn_key of the DTL, the hash of the remote worker address. Once full, the least recently used endpoint
+// is disconnected to make room for a new one.
+dyad_rc_t dyad_ucx_ep_cache_init (const dyad_ctx_t *ctx, size_t capacity, ucx_ep_cache_h* cache);
 
-// NOTE: not positive if UCP addresses are 100% unique by worker
+// Look up the endpoint of the current key. If addr is not NULL, an entry
+// connected to another address does not match.
 dyad_rc_t dyad_ucx_ep_cache_find (const dyad_ctx_t *ctx,
                                   const ucx_ep_cache_h cache,
                                   const ucp_address_t* addr,
                                   const size_t addr_size,
                                   ucp_ep_h* ep);
 
+// Connect to addr and cache the endpoint under the current key, unless it is
+// cached already. The address is copied, so the caller keeps ownership of it.
 dyad_rc_t dyad_ucx_ep_cache_insert (const dyad_ctx_t *ctx,
                                     ucx_ep_cache_h cache,
                                     const ucp_address_t* addr,
                                     const size_t addr_size,
-                                    ucp_worker_h worker);
+                                    ucp_worker_h worker,
+                                    ucp_ep_h* ep);
 
 dyad_rc_t dyad_ucx_ep_cache_remove (const dyad_ctx_t *ctx,
                                     ucx_ep_cache_h cache,
@@ -52,6 +75,8 @@ dyad_rc_t dyad_ucx_ep_cache_remove (const dyad_ctx_t *ctx,
                                     const size_t addr_size,
                                     ucp_worker_h worker);
 
+dyad_rc_t dyad_ucx_ep_cache_stats (const ucx_ep_cache_h cache, dyad_ucx_ep_cache_stats_t* stats);
+
 dyad_rc_t dyad_ucx_ep_cache_finalize (const dyad_ctx_t *ctx,
                                       ucx_ep_cache_h* cache,
                                       ucp_worker_h worker);
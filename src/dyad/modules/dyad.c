@@ -8,6 +8,10 @@
  * SPDX-License-Identifier: LGPL-3.0
 \************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif  // _GNU_SOURCE
+
 #if defined(DYAD_HAS_CONFIG)
 #include <dyad/dyad_config.hpp>
 #else
@@ -21,6 +25,12 @@
 #include <dyad/core/dyad_core.h>
 #include <dyad/common/dyad_logging.h>
 #include <dyad/common/dyad_profiler.h>
+#include <dyad/modules/dyad_mod_cache.h>
+#include <dyad/modules/dyad_mod_fdcache.h>
+#include <dyad/modules/dyad_mod_publish.h>
+#include <dyad/modules/dyad_mod_sched.h>
+#include <dyad/modules/dyad_mod_stats.h>
+#include <dyad/modules/dyad_mod_workq.h>
 #include <dyad/utils/read_all.h>
 #include <dyad/utils/utils.h>
 
@@ -28,6 +38,7 @@
 
 #if defined(__cplusplus)
 #include <cerrno>
+#include <climits>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
@@ -35,6 +46,7 @@
 #include <ctime>
 #else
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -45,6 +57,8 @@
 
 #include <fcntl.h>
 #include <linux/limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -52,201 +66,1996 @@
     ((double)(1000000000L * ((Tend).tv_sec - (Tstart).tv_sec) + (Tend).tv_nsec - (Tstart).tv_nsec) \
      / 1000000000L)
 
+#define DYAD_PROXY_DEFAULT_CACHE_SIZE (1ul << 30)
+#define DYAD_PROXY_DEFAULT_THREADS 4u
+// Largest response message of the proxy. Larger files are sent in pieces.
+#define DYAD_PROXY_CHUNK_SIZE (4ul << 20)
+#define DYAD_FETCH_DEFAULT_THREADS 4u
+#define DYAD_HOT_CACHE_DEFAULT_SIZE 0ul
+#define DYAD_FD_CACHE_DEFAULT_SIZE 256u
+#define DYAD_SHM_CACHE_DEFAULT_SIZE (256ul << 20)
+#define DYAD_FETCH_DEFAULT_MAX_ACTIVE 16u
+#define DYAD_FETCH_DEFAULT_MAX_ACTIVE_BYTES (1ul << 30)
+#define DYAD_FETCH_DEFAULT_MAX_QUEUED 1024u
+// Initial estimate of the time to serve a fetch, in milliseconds
+#define DYAD_FETCH_DEFAULT_MS 10.0
+#define DYAD_FETCH_MAX_RETRY_AFTER_MS 10000u
+#define DYAD_FETCH_DEFAULT_INLINE_MAX (64ul * 1024ul)
+#define DYAD_STATS_DEFAULT_TOP 10
+// Acknowledgements kept for the transfers not yet done on the reactor
+#define DYAD_FETCH_EARLY_ACKS 64u
+
+struct dyad_proxy_job;
+struct dyad_fetch_job;
+
 struct dyad_mod_ctx {
     flux_msg_handler_t **handlers;
     dyad_ctx_t* ctx;
+    dyad_dtl_mode_t dtl_mode;                 // DTL mode of the module
+    char* local_uri;                          // URI used by worker threads to connect to the broker
+    dyad_mod_workq_t* fetch_q;                // threads serving fetches (NULL if served inline)
+    struct dyad_mod_cache* hot_cache;         // recently served files (NULL if disabled)
+    struct dyad_fetch_job* fetch_inflight;    // files being read for the fetches
+    struct dyad_mod_sched* fetch_sched;       // fetches waiting to be started
+    unsigned int fetch_active;                // fetches started and not done
+    size_t fetch_active_bytes;                // bytes transferred by the started fetches
+    unsigned int max_active;                  // limit on fetch_active
+    size_t max_active_bytes;                  // limit on fetch_active_bytes
+    unsigned int max_queued;                  // limit on the fetches waiting to be started
+    double fetch_ms;                          // moving average of the time to serve a fetch
+    bool fetch_pumping;                       // queued fetches are being started
+    struct dyad_mod_cache* proxy_cache;       // files fetched by the proxy (NULL if disabled)
+    dyad_mod_workq_t* proxy_q;                // threads fetching files for the proxy
+    struct dyad_proxy_job* proxy_inflight;    // fetches under way on behalf of local processes
+    struct dyad_mod_stats* stats;             // statistics reported by dyad.stats
+    size_t inline_max;                        // largest file served by dyad.fetch_inline
+    struct dyad_mod_fdcache* fd_cache;        // files kept open between fetches (NULL if disabled)
+    struct dyad_mod_publish* publisher;       // publishes the files written (NULL if disabled)
+    struct dyad_mod_cache* shm_cache;         // contents handed over by local producers (NULL if disabled)
+    struct dyad_fetch_job* acks;              // jobs whose data the consumers are pulling
+    flux_watcher_t* ack_timer;                // releases the jobs not acknowledged in time
+    uint64_t ack_seq;                         // last identifier given to a transfer
+    uint64_t early_acks[DYAD_FETCH_EARLY_ACKS];  // transfers acknowledged before their job was done
+    unsigned int early_next;                  // next slot of early_acks to overwrite
+    double fetch_bytes;                       // moving average of the size of the files served
+};
+
+const struct dyad_mod_ctx dyad_mod_ctx_default = {NULL, NULL, DYAD_DTL_DEFAULT, NULL, NULL, NULL, NULL, NULL,
+                                                  0u, 0ul, 0u, 0ul, 0u, 0.0, false, NULL, NULL, NULL, NULL,
+                                                  DYAD_FETCH_DEFAULT_INLINE_MAX, NULL, NULL, NULL,
+                                                  NULL, NULL, 0ul, {0ul}, 0u, 0.0};
+
+/* A file the proxy is fetching from its owner, with the local requests
+ * waiting for it */
+struct dyad_proxy_job {
+    struct dyad_proxy_job* next;
+    char* upath;
+    uint32_t owner_rank;
+    int64_t size;                            // size published in the KVS, -1 if unknown
+    bool has_version;                        // whether version is known
+    struct dyad_mod_cache_version version;   // version published in the KVS
+    const flux_msg_t** waiters;
+    size_t nwaiters;
+    size_t max_waiters;
+    void* data;
+    size_t len;
+    dyad_rc_t rc;
+};
+
+typedef struct dyad_mod_ctx dyad_mod_ctx_t;
+
+static void dyad_mod_fini (void) __attribute__ ((destructor));
+
+void dyad_mod_fini (void)
+{
+    flux_t *h = flux_open (NULL, 0);
+
+    if (h != NULL) {
+    }
+}
+
+static void dyad_fetch_acks_destroy (dyad_mod_ctx_t *mod_ctx);
+
+static void freectx (void *arg)
+{
+    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)arg;
+    flux_msg_handler_delvec (mod_ctx->handlers);
+    dyad_mod_publish_destroy (&mod_ctx->publisher);
+    // Answers the requests still waiting on the worker threads
+    dyad_mod_workq_destroy (&mod_ctx->fetch_q);
+    dyad_mod_sched_destroy (&mod_ctx->fetch_sched);
+    dyad_fetch_acks_destroy (mod_ctx);
+    dyad_mod_cache_destroy (&mod_ctx->hot_cache);
+    dyad_mod_fdcache_destroy (&mod_ctx->fd_cache);
+    dyad_mod_cache_destroy (&mod_ctx->shm_cache);
+    dyad_mod_workq_destroy (&mod_ctx->proxy_q);
+    dyad_mod_cache_destroy (&mod_ctx->proxy_cache);
+    free (mod_ctx->local_uri);
+    dyad_mod_stats_destroy (&mod_ctx->stats);
+    if (mod_ctx->ctx) {
+        if ( mod_ctx->ctx->dtl_handle ) dyad_dtl_finalize (mod_ctx->ctx);
+        mod_ctx->ctx->dtl_handle = NULL;
+        free(mod_ctx->ctx);
+        mod_ctx->ctx = NULL;
+    }
+    free (mod_ctx);
+}
+
+static dyad_mod_ctx_t *getctx (flux_t *h)
+{
+    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)flux_aux_get (h, "dyad");
+
+    if (!mod_ctx) {
+        mod_ctx = (dyad_mod_ctx_t *)malloc (sizeof (*mod_ctx));
+        if (mod_ctx == NULL) {
+            DYAD_LOG_STDERR("DYAD_MOD: could not allocate memory for context");
+            goto getctx_error;
+        }
+        *mod_ctx = dyad_mod_ctx_default;
+        mod_ctx->ctx = (dyad_ctx_t *)calloc (1, sizeof (dyad_ctx_t));
+        mod_ctx->ctx->h = h;
+        mod_ctx->ctx->debug = false;
+        mod_ctx->ctx->prod_managed_path = NULL;
+        if (flux_aux_set (h, "dyad", mod_ctx, freectx) < 0) {
+            DYAD_LOG_STDERR ("DYAD_MOD: flux_aux_set() failed!");
+            goto getctx_error;
+        }
+    }
+
+    goto getctx_done;
+
+getctx_error:;
+    return NULL;
+
+getctx_done:
+    return mod_ctx;
+}
+
+/* Each worker thread of the module has its own connection to the broker
+ * (Flux handles are not thread-safe) and its own DTL */
+static dyad_ctx_t *dyad_mod_thread_ctx_create (dyad_mod_ctx_t *mod_ctx,
+                                               dyad_dtl_comm_mode_t comm_mode)
+{
+    dyad_ctx_t *ctx = (dyad_ctx_t *)calloc (1, sizeof (dyad_ctx_t));
+    if (ctx == NULL) {
+        return NULL;
+    }
+    ctx->debug = mod_ctx->ctx->debug;
+    ctx->rank = mod_ctx->ctx->rank;
+    ctx->service_mux = 1u;
+    ctx->pid = getpid ();
+    ctx->reenter = true;
+    ctx->initialized = true;
+    ctx->prod_managed_path = mod_ctx->ctx->prod_managed_path;
+    ctx->h = flux_open (mod_ctx->local_uri, 0);
+    if (ctx->h == NULL) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: worker cannot connect to %s", mod_ctx->local_uri);
+        free (ctx);
+        return NULL;
+    }
+    if (DYAD_IS_ERROR (dyad_dtl_init (ctx, mod_ctx->dtl_mode, comm_mode, ctx->debug))) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: worker cannot initialize the DTL");
+        flux_close (ctx->h);
+        free (ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+static void dyad_mod_thread_ctx_destroy (void *tls, void *arg)
+{
+    dyad_ctx_t *ctx = (dyad_ctx_t *)tls;
+    if (ctx == NULL) {
+        return;
+    }
+    dyad_dtl_finalize (ctx);
+    flux_close (ctx->h);
+    free (ctx);
+}
+
+static void dyad_fetch_version (const struct stat *st, struct dyad_mod_cache_version *version)
+{
+    version->ino = (uint64_t)st->st_ino;
+    version->size = (uint64_t)st->st_size;
+    version->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+    version->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+}
+
+/* Read a file under the producer-managed path into a malloc'ed buffer, which
+ * can outlive the DTL of the thread that read it. The contents start headroom
+ * bytes into the buffer. The version of the file that was read is stored in
+ * version. On error, errno is set to the error to report to the consumer. */
+static dyad_rc_t dyad_fetch_read (const dyad_ctx_t *ctx,
+                                  const char *upath,
+                                  size_t headroom,
+                                  void **buf,
+                                  size_t *len,
+                                  struct dyad_mod_cache_version *version,
+                                  double *open_s,
+                                  double *read_s)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    char fullpath[PATH_MAX + 1] = {'\0'};
+    ssize_t file_size = 0;
+    ssize_t inlen = 0;
+    struct flock shared_lock;
+    struct stat st;
+    struct timespec t0, t1;
+    int fd = -1;
+
+    strncpy (fullpath, ctx->prod_managed_path, PATH_MAX - 1);
+    concat_str (fullpath, upath, "/", PATH_MAX);
+    DYAD_C_FUNCTION_UPDATE_STR ("fullpath", fullpath);
+
+#if DYAD_SPIN_WAIT
+    if (!get_stat (fullpath, 1000U, 1000L)) {
+        DYAD_LOG_ERROR (ctx, "DYAD_MOD: Failed to access info on \"%s\".", fullpath);
+        // goto error;
+    }
+#endif  // DYAD_SPIN_WAIT
+
+    DYAD_LOG_INFO (ctx, "Reading file %s for transfer", fullpath);
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    fd = open (fullpath, O_RDONLY);
+    if (fd < 0) {
+        // ENOENT tells the consumer the file is gone
+        const int saved_errno = errno;
+        DYAD_LOG_ERROR (ctx, "DYAD_MOD: Failed to open file \"%s\".", fullpath);
+        errno = saved_errno;
+        rc = DYAD_RC_BADFIO;
+        goto read_done;
+    }
+    rc = dyad_shared_flock (ctx, fd, &shared_lock);
+    if (DYAD_IS_ERROR (rc)) {
+        goto read_done;
+    }
+    if (fstat (fd, &st) < 0) {
+        rc = DYAD_RC_BADFIO;
+        goto read_unlock;
+    }
+    dyad_fetch_version (&st, version);
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    *open_s = TIME_DIFF (t0, t1);
+    file_size = (ssize_t)st.st_size;
+    DYAD_LOG_DEBUG (ctx, "file %s has size %zd", fullpath, file_size);
+    if (file_size > 0 || headroom > 0ul) {
+        *buf = malloc (headroom + (size_t)file_size);
+        if (*buf == NULL) {
+            errno = ENOMEM;
+            rc = DYAD_RC_SYSFAIL;
+            goto read_unlock;
+        }
+    }
+    if (file_size > 0) {
+        inlen = read (fd, (char *)*buf + headroom, file_size);
+        if (inlen != file_size) {
+            DYAD_LOG_ERROR (ctx,
+                            "DYAD_MOD: Failed to load file \"%s\" only read %zd of %zd.",
+                            fullpath,
+                            inlen,
+                            file_size);
+            free (*buf);
+            *buf = NULL;
+            errno = EIO;
+            rc = DYAD_RC_BADFIO;
+            goto read_unlock;
+        }
+        DYAD_C_FUNCTION_UPDATE_INT ("file_size", file_size);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    *read_s = TIME_DIFF (t1, t0);
+    *len = (file_size > 0) ? (size_t)file_size : 0ul;
+    rc = DYAD_RC_OK;
+
+read_unlock:;
+    dyad_release_flock (ctx, fd, &shared_lock);
+read_done:;
+    if (fd >= 0) {
+        int saved_errno = errno;
+        close (fd);
+        errno = saved_errno;
+    }
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/* Whether an open file is still at the given version */
+static bool dyad_fetch_same_version (int fd, const struct dyad_mod_cache_version *version)
+{
+    struct dyad_mod_cache_version current;
+    struct stat st;
+    if (fstat (fd, &st) < 0) {
+        return false;
+    }
+    dyad_fetch_version (&st, &current);
+    return memcmp (&current, version, sizeof (current)) == 0;
+}
+
+/* Read a file from a descriptor of the descriptor cache into a malloc'ed
+ * buffer. The descriptor is shared, so the file offset is left alone. The
+ * changes to the file are reported to the reactor asynchronously, so the
+ * file is read under a shared lock, and only if it is still at the version
+ * it had when it was opened, before and after the read. On error, errno is
+ * set to the error to report to the consumer, or to ESTALE if the file
+ * changed, in which case it must be opened again. */
+static dyad_rc_t dyad_fetch_pread (const dyad_ctx_t *ctx,
+                                   const char *upath,
+                                   int fd,
+                                   const struct dyad_mod_cache_version *version,
+                                   void **buf,
+                                   size_t *len,
+                                   double *read_s)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    const size_t size = (size_t)version->size;
+    DYAD_C_FUNCTION_UPDATE_INT ("file_size", size);
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct flock shared_lock;
+    struct timespec t0, t1;
+    size_t done = 0ul;
+    ssize_t n = 0;
+
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    rc = dyad_shared_flock (ctx, fd, &shared_lock);
+    if (DYAD_IS_ERROR (rc)) {
+        errno = ESTALE;
+        goto pread_done;
+    }
+    if (!dyad_fetch_same_version (fd, version)) {
+        DYAD_LOG_DEBUG (ctx, "DYAD_MOD: %s changed since it was opened", upath);
+        errno = ESTALE;
+        rc = DYAD_RC_BADFIO;
+        goto pread_unlock;
+    }
+    if (size > 0ul && (*buf = malloc (size)) == NULL) {
+        errno = ENOMEM;
+        rc = DYAD_RC_SYSFAIL;
+        goto pread_unlock;
+    }
+    while (done < size) {
+        n = pread (fd, (char *)*buf + done, size - done, (off_t)done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            // The file was truncated since it was opened
+            DYAD_LOG_ERROR (ctx, "DYAD_MOD: Failed to load file \"%s\" only read %zu of %zu.",
+                            upath, done, size);
+            free (*buf);
+            *buf = NULL;
+            errno = EIO;
+            rc = DYAD_RC_BADFIO;
+            goto pread_unlock;
+        }
+        done += (size_t)n;
+    }
+    // A process that does not take the lock may have written the file meanwhile
+    if (!dyad_fetch_same_version (fd, version)) {
+        DYAD_LOG_DEBUG (ctx, "DYAD_MOD: %s changed while it was read", upath);
+        free (*buf);
+        *buf = NULL;
+        errno = ESTALE;
+        rc = DYAD_RC_BADFIO;
+        goto pread_unlock;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    *read_s = TIME_DIFF (t0, t1);
+    *len = size;
+    rc = DYAD_RC_OK;
+
+pread_unlock:;
+    n = errno;
+    dyad_release_flock (ctx, fd, &shared_lock);
+    errno = (int)n;
+pread_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/* Send a buffer to the consumer whose request was last unpacked into ctx.
+ * On error, errno is set to the error to report to the consumer. */
+static dyad_rc_t dyad_fetch_send (const dyad_ctx_t *ctx, void *buf, size_t len)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_rc_t rc = DYAD_RC_OK;
+    DYAD_LOG_DEBUG (ctx, "Establish DTL connection with consumer");
+    rc = ctx->dtl_handle->establish_connection (ctx);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Could not establish DTL connection with client");
+        errno = ECONNREFUSED;
+        goto send_done;
+    }
+    DYAD_LOG_DEBUG (ctx, "Send file to consumer with DTL");
+    rc = ctx->dtl_handle->send (ctx, buf, len);
+    DYAD_LOG_DEBUG (ctx, "Close DTL connection with consumer");
+    ctx->dtl_handle->close_connection (ctx);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Could not send data to client via DTL\n");
+        errno = ECOMM;
+        goto send_done;
+    }
+send_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
+
+/* One file of a dyad.fetch_batch request */
+struct dyad_fetch_batch_file {
+    char *upath;                         // requested file
+    void *frame;                         // header followed by the contents of the file
+    size_t len;                          // size of the file
+    int errnum;                          // error reading the file (0 if none)
+};
+
+/* A dyad.fetch request, served by a worker thread or inline. Concurrent
+ * requests for a file that is being read wait for that read and send its
+ * buffer, which is released once the last of them is done.
+ * A dyad.fetch_batch request is a job that sends all its files over one DTL
+ * connection. It is neither coalesced nor served from the hot cache. */
+struct dyad_fetch_job {
+    const flux_msg_t *msg;               // the request
+    char *upath;                         // requested file
+    void *buf;                           // contents of the file
+    size_t len;                          // size of the file
+    bool have_data;                      // buf holds the contents of the file
+    bool sent;                           // buf was sent to the consumer
+    struct dyad_mod_cache_entry *pin;    // cache entry buf belongs to
+    struct dyad_mod_cache *pin_cache;    // cache holding pin
+    bool from_pin;                       // buf is the contents held by pin
+    bool verify_pin;                     // the worker checks the version of pin first
+    struct dyad_mod_fdcache_entry *fd_pin;  // descriptor cache entry fd belongs to
+    int fd;                              // open descriptor to the file (if fd_pin)
+    bool fd_open;                        // the worker opens the file for the descriptor cache
+    unsigned long fd_epoch;              // descriptor cache epoch before the file was opened
+    struct dyad_mod_fdcache_entry *fd_new;  // file the worker opened, inserted once released
+    struct dyad_fetch_job *src;          // job whose read buf comes from
+    struct dyad_fetch_job *followers;    // jobs waiting for the read of this one
+    struct dyad_fetch_job *next;         // next job in the in-flight or followers list
+    unsigned int refs;                   // jobs using buf, including this one
+    const char *consumer;                // identity of the sender of msg
+    size_t cost;                         // bytes the job transfers
+    bool started;                        // counted in the active fetches
+    struct timespec start;               // when the job was started
+    struct timespec arrival;             // when the request arrived
+    double phase_s[DYAD_MOD_STATS_NPHASES];  // time spent in each phase
+    unsigned int phases;                 // phases that ran (bit mask)
+    struct dyad_mod_cache_version version;
+    struct dyad_fetch_batch_file *batch;  // files of a dyad.fetch_batch request
+    unsigned int nbatch;                 // number of files in batch
+    bool inline_data;                    // respond with the contents (dyad.fetch_inline)
+    bool preconnect;                     // set up a connection to the consumer (dyad.register)
+    int errnum;                          // error to report to the consumer (0 if none)
+    uint64_t ack_id;                     // transfer the consumer acknowledges (0 if none)
+    bool ack_pending;                    // the consumer pulls buf once the job is done
+    struct timespec ack_since;           // when the job was done, if ack_pending
 };
 
-const struct dyad_mod_ctx dyad_mod_ctx_default = {NULL, NULL};
+/* Find the contents of the requested file in memory without touching the
+ * file system, which only the workers do. With a cached descriptor, the
+ * version of the file is known and the request is served from the producer
+ * memory or the hot cache right away. Otherwise, contents found there are
+ * pinned and the worker checks that they are current before sending them.
+ * The size of the file is known here in these cases, and replaces the cost
+ * the job was charged from the request (see dyad_fetch_request_cost). */
+static void dyad_fetch_job_prepare (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    struct dyad_mod_cache_version version;
+    const struct dyad_mod_cache_version *lookup_version = NULL;
+    const void *data = NULL;
+    size_t len = 0ul;
+
+    if (fj->batch != NULL) {
+        return;
+    }
+    // A cached descriptor gives the size and version of the file without a
+    // system call, and spares the worker from opening it. Otherwise the
+    // worker opens the file for the cache.
+    if (mod_ctx->fd_cache != NULL
+        && dyad_mod_fdcache_get (mod_ctx->fd_cache, fj->upath, &fj->fd, &version, &fj->fd_pin)) {
+        fj->version = version;
+        fj->cost = (size_t)version.size;
+        lookup_version = &version;
+    } else if (mod_ctx->fd_cache != NULL) {
+        fj->fd_open = true;
+        fj->fd_epoch = dyad_mod_fdcache_epoch (mod_ctx->fd_cache);
+    }
+    // Contents handed over by the producer are as good as the hot cache
+    if (mod_ctx->shm_cache != NULL
+        && dyad_mod_cache_lookup (mod_ctx->shm_cache, fj->upath, lookup_version, &data, &len,
+                                  &fj->pin)) {
+        DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: serving %s from producer memory", fj->upath);
+        fj->pin_cache = mod_ctx->shm_cache;
+    } else if (mod_ctx->hot_cache != NULL
+               && dyad_mod_cache_lookup (mod_ctx->hot_cache, fj->upath, lookup_version, &data,
+                                         &len, &fj->pin)) {
+        DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: serving %s from the hot cache", fj->upath);
+        fj->pin_cache = mod_ctx->hot_cache;
+    } else {
+        return;
+    }
+    fj->buf = (void *)data;
+    fj->len = len;
+    fj->from_pin = true;
+    if (lookup_version == NULL) {
+        fj->verify_pin = true;
+        fj->cost = len;
+        return;
+    }
+    fj->have_data = true;
+    dyad_mod_fdcache_release (mod_ctx->fd_cache, fj->fd_pin);
+    fj->fd_pin = NULL;
+}
+
+/* Open the requested file for the descriptor cache. The reactor inserts it
+ * once the job is released. */
+static void dyad_fetch_open (const dyad_ctx_t *ctx,
+                             dyad_mod_ctx_t *mod_ctx,
+                             struct dyad_fetch_job *fj)
+{
+    char fullpath[PATH_MAX + 1] = {'\0'};
+    struct timespec t0, t1;
+
+    fj->fd_open = false;
+    fj->fd = -1;
+    strncpy (fullpath, ctx->prod_managed_path, PATH_MAX - 1);
+    concat_str (fullpath, fj->upath, "/", PATH_MAX);
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    if (!dyad_mod_fdcache_open (mod_ctx->fd_cache, fj->upath, fullpath, &fj->fd, &fj->version,
+                                &fj->fd_new)) {
+        fj->fd = -1;  // read as usual
+        return;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    fj->phase_s[DYAD_MOD_STATS_OPEN] = TIME_DIFF (t0, t1);
+    fj->phases |= (1u << DYAD_MOD_STATS_OPEN);
+}
+
+/* Check that the contents a job found in memory are those of the current
+ * version of the file. If not, the worker reads the file. */
+static void dyad_fetch_verify_pin (const dyad_ctx_t *ctx, struct dyad_fetch_job *fj)
+{
+    char fullpath[PATH_MAX + 1] = {'\0'};
+    struct dyad_mod_cache_version pinned;
+    struct dyad_mod_cache_version current;
+    struct stat st;
+
+    fj->verify_pin = false;
+    strncpy (fullpath, ctx->prod_managed_path, PATH_MAX - 1);
+    concat_str (fullpath, fj->upath, "/", PATH_MAX);
+    if (dyad_mod_cache_pinned_version (fj->pin, &pinned) && stat (fullpath, &st) == 0) {
+        dyad_fetch_version (&st, &current);
+        if (memcmp (&pinned, &current, sizeof (current)) == 0) {
+            fj->version = current;
+            fj->have_data = true;
+            return;
+        }
+    }
+    DYAD_LOG_DEBUG (ctx, "DYAD_MOD: the copy of %s in memory is stale", fj->upath);
+    fj->buf = NULL;
+    fj->len = 0ul;
+    fj->from_pin = false;
+}
+
+/* Drop what the DTL of ctx may keep of a buffer that was sent, before the
+ * buffer is released */
+static void dyad_fetch_forget (const dyad_ctx_t *ctx, void *buf)
+{
+    if (buf != NULL && ctx->dtl_handle != NULL && ctx->dtl_handle->unregister_buffer != NULL) {
+        ctx->dtl_handle->unregister_buffer (ctx, buf);
+    }
+}
+
+/* Same as dyad_fetch_forget, for the contents of the files of the caches */
+static void dyad_fetch_cache_forget (void *arg, void *data)
+{
+    dyad_fetch_forget (((dyad_mod_ctx_t *)arg)->ctx, data);
+}
+
+static void dyad_fetch_batch_free (struct dyad_fetch_job *fj)
+{
+    unsigned int i = 0u;
+    if (fj->batch == NULL) {
+        return;
+    }
+    for (i = 0u; i < fj->nbatch; i++) {
+        free (fj->batch[i].upath);
+        free (fj->batch[i].frame);
+    }
+    free (fj->batch);
+    fj->batch = NULL;
+}
+
+static void dyad_fetch_job_unref (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    if (--fj->refs > 0u) {
+        return;
+    }
+    dyad_mod_fdcache_release (mod_ctx->fd_cache, fj->fd_pin);
+    dyad_mod_fdcache_insert (mod_ctx->fd_cache, fj->fd_new, fj->fd_epoch);
+    if (fj->src != NULL) {
+        dyad_fetch_job_unref (mod_ctx, fj->src);
+    } else {
+        if (fj->pin != NULL) {
+            dyad_mod_cache_release (fj->pin_cache, fj->pin);
+        }
+        // Insert the file into the hot cache once read if it is worth it
+        if (!fj->from_pin && fj->have_data && fj->batch == NULL && mod_ctx->hot_cache != NULL
+            && dyad_mod_cache_admit (mod_ctx->hot_cache, fj->upath, fj->len)
+            && !DYAD_IS_ERROR (dyad_mod_cache_insert (mod_ctx->hot_cache, fj->upath,
+                                                      &fj->version, fj->buf, fj->len))) {
+            fj->buf = NULL;  // now owned by the cache
+        }
+        if (!fj->from_pin && fj->buf != NULL) {
+            dyad_fetch_forget (mod_ctx->ctx, fj->buf);
+            free (fj->buf);
+        }
+    }
+    dyad_fetch_batch_free (fj);
+    free (fj->upath);
+    free (fj);
+}
+
+/* Send the contents of the file of a job to its consumer, whose request was
+ * last unpacked into ctx */
+static void dyad_fetch_timed_send (const dyad_ctx_t *ctx, struct dyad_fetch_job *fj)
+{
+    struct timespec t0, t1;
+    // With an identifier, the DTL may leave buf for the consumer to pull
+    // instead of waiting for it, and the job holds buf until acknowledged
+    ctx->dtl_handle->send_ack_id = fj->ack_id;
+    ctx->dtl_handle->send_deferred = false;
+    clock_gettime (CLOCK_MONOTONIC, &t0);
+    if (DYAD_IS_ERROR (dyad_fetch_send (ctx, fj->buf, fj->len))) {
+        fj->errnum = errno;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &t1);
+    fj->ack_pending = ctx->dtl_handle->send_deferred;
+    ctx->dtl_handle->send_ack_id = 0u;
+    ctx->dtl_handle->send_deferred = false;
+    fj->phase_s[DYAD_MOD_STATS_SEND] = TIME_DIFF (t0, t1);
+    fj->phases |= (1u << DYAD_MOD_STATS_SEND);
+    fj->sent = true;
+}
+
+/* Read the i-th file of a batch into a frame, or record why it cannot be
+ * read. Only a frame without an error holds the contents of the file. */
+static void dyad_fetch_batch_read (const dyad_ctx_t *ctx, struct dyad_fetch_job *fj, unsigned int i)
+{
+    struct dyad_fetch_batch_file *bf = &fj->batch[i];
+    struct dyad_batch_frame *hdr = NULL;
+    struct dyad_mod_cache_version version;
+    double open_s = 0.0, read_s = 0.0;
+
+    errno = 0;
+    if (DYAD_IS_ERROR (dyad_fetch_read (ctx, bf->upath, sizeof (*hdr), &bf->frame, &bf->len,
+                                        &version, &open_s, &read_s))) {
+        bf->errnum = (errno != 0) ? errno : EIO;
+        bf->len = 0ul;
+        bf->frame = calloc (1, sizeof (*hdr));
+        if (bf->frame == NULL) {
+            return;
+        }
+    } else {
+        fj->phase_s[DYAD_MOD_STATS_OPEN] += open_s;
+        fj->phase_s[DYAD_MOD_STATS_READ] += read_s;
+        fj->phases |= (1u << DYAD_MOD_STATS_OPEN) | (1u << DYAD_MOD_STATS_READ);
+    }
+    hdr = (struct dyad_batch_frame *)bf->frame;
+    hdr->index = i;
+    hdr->errnum = bf->errnum;
+    hdr->len = bf->len;
+}
+
+/* Send the frames of a batch over one DTL connection to the consumer whose
+ * request was last unpacked into ctx. If read is true, each file is read right
+ * before it is sent. Otherwise, the frames were read beforehand. */
+static dyad_rc_t dyad_fetch_batch_send (const dyad_ctx_t *ctx,
+                                        struct dyad_fetch_job *fj,
+                                        bool read)
+{
+    dyad_rc_t rc = DYAD_RC_OK;
+    struct timespec t0, t1;
+    unsigned int i = 0u;
+
+    rc = ctx->dtl_handle->establish_connection (ctx);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "Could not establish DTL connection with client");
+        fj->errnum = ECONNREFUSED;
+        return rc;
+    }
+    for (i = 0u; i < fj->nbatch; i++) {
+        if (read) {
+            dyad_fetch_batch_read (ctx, fj, i);
+        }
+        if (fj->batch[i].frame == NULL) {
+            fj->errnum = ENOMEM;
+            rc = DYAD_RC_SYSFAIL;
+            break;
+        }
+        clock_gettime (CLOCK_MONOTONIC, &t0);
+        rc = ctx->dtl_handle->send (ctx, fj->batch[i].frame,
+                                    sizeof (struct dyad_batch_frame) + fj->batch[i].len);
+        clock_gettime (CLOCK_MONOTONIC, &t1);
+        fj->phase_s[DYAD_MOD_STATS_SEND] += TIME_DIFF (t0, t1);
+        fj->phases |= (1u << DYAD_MOD_STATS_SEND);
+        dyad_fetch_forget (ctx, fj->batch[i].frame);
+        if (DYAD_IS_ERROR (rc)) {
+            DYAD_LOG_ERROR (ctx, "Could not send %s to client via DTL", fj->batch[i].upath);
+            fj->errnum = ECOMM;
+            break;
+        }
+        if (fj->batch[i].errnum == 0) {
+            fj->len += fj->batch[i].len;
+        }
+        // Frames are not needed once sent
+        free (fj->batch[i].frame);
+        fj->batch[i].frame = NULL;
+    }
+    ctx->dtl_handle->close_connection (ctx);
+    fj->sent = true;
+    return rc;
+}
+
+/* Create the endpoint to the consumer of a dyad.register request ahead of its
+ * first fetch, in the endpoint cache of the DTL of ctx */
+static void dyad_fetch_preconnect (const dyad_ctx_t *ctx, struct dyad_fetch_job *fj)
+{
+    char *upath = NULL;
+    int errnum = 0;
+    if (DYAD_IS_ERROR (ctx->dtl_handle->rpc_unpack (ctx, fj->msg, &upath))) {
+        errnum = EPROTO;
+    } else if (DYAD_IS_ERROR (ctx->dtl_handle->establish_connection (ctx))) {
+        errnum = ECONNREFUSED;
+    }
+    ctx->dtl_handle->close_connection (ctx);
+    // Every worker runs the same job
+    if (errnum != 0) {
+        __atomic_store_n (&fj->errnum, errnum, __ATOMIC_RELAXED);
+    }
+}
+
+/* Answer a dyad.register request once every worker has connected */
+static void dyad_fetch_preconnect_done (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    if (--fj->refs > 0u) {
+        return;
+    }
+    if (fj->errnum == 0) {
+        DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: consumer %s pre-connected", fj->consumer);
+        if (flux_respond (mod_ctx->ctx->h, fj->msg, NULL) < 0) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond", __func__);
+        }
+    } else if (flux_respond_error (mod_ctx->ctx->h, fj->msg, fj->errnum, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+    flux_msg_decref (fj->msg);
+    free (fj);
+}
+
+static void *dyad_fetch_thread_init (void *arg)
+{
+    return dyad_mod_thread_ctx_create ((dyad_mod_ctx_t *)arg, DYAD_COMM_SEND);
+}
+
+static void dyad_fetch_work (void *job, void *tls, void *arg)
+{
+    struct dyad_fetch_job *fj = (struct dyad_fetch_job *)job;
+    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)arg;
+    dyad_ctx_t *ctx = (dyad_ctx_t *)tls;
+    char *upath = NULL;
+    unsigned int i = 0u;
+    if (ctx == NULL) {
+        fj->errnum = ENOMEM;
+        return;
+    }
+    if (fj->preconnect) {
+        dyad_fetch_preconnect (ctx, fj);
+        return;
+    }
+    // An inline response carries the contents, so there is no DTL transfer
+    if (fj->inline_data) {
+        upath = fj->upath;
+    } else if (DYAD_IS_ERROR (ctx->dtl_handle->rpc_unpack (ctx, fj->msg, &upath))) {
+        fj->errnum = EPROTO;
+        return;
+    }
+    if (fj->batch != NULL) {
+        // Same as below: with the Flux RPC DTL, the reactor sends the frames
+        if (mod_ctx->dtl_mode == DYAD_DTL_FLUX_RPC) {
+            for (i = 0u; i < fj->nbatch; i++)
+                dyad_fetch_batch_read (ctx, fj, i);
+        } else {
+            dyad_fetch_batch_send (ctx, fj, true);
+        }
+        return;
+    }
+    if (fj->verify_pin) {
+        dyad_fetch_verify_pin (ctx, fj);
+    }
+    if (!fj->have_data && fj->fd_open) {
+        dyad_fetch_open (ctx, mod_ctx, fj);
+    }
+    if (!fj->have_data && (fj->fd_pin != NULL || fj->fd_new != NULL) && fj->fd >= 0) {
+        // The file is already open
+        if (!DYAD_IS_ERROR (dyad_fetch_pread (ctx, upath, fj->fd, &fj->version, &fj->buf,
+                                              &fj->len, &fj->phase_s[DYAD_MOD_STATS_READ]))) {
+            fj->phases |= (1u << DYAD_MOD_STATS_READ);
+            fj->have_data = true;
+        } else if (errno != ESTALE) {
+            fj->errnum = (errno != 0) ? errno : EIO;
+            return;
+        }
+    }
+    if (!fj->have_data) {
+        if (DYAD_IS_ERROR (dyad_fetch_read (ctx, upath, 0ul, &fj->buf, &fj->len, &fj->version,
+                                            &fj->phase_s[DYAD_MOD_STATS_OPEN],
+                                            &fj->phase_s[DYAD_MOD_STATS_READ]))) {
+            fj->errnum = (errno != 0) ? errno : EIO;
+            return;
+        }
+        fj->phases |= (1u << DYAD_MOD_STATS_OPEN) | (1u << DYAD_MOD_STATS_READ);
+        fj->have_data = true;
+    }
+    // The Flux RPC DTL sends through the module's own handle, which only the
+    // reactor thread may use. The other DTLs send from the worker.
+    if (mod_ctx->dtl_mode == DYAD_DTL_FLUX_RPC || fj->len == 0ul || fj->inline_data) {
+        return;
+    }
+    dyad_fetch_timed_send (ctx, fj);
+}
+
+static void dyad_fetch_dispatch (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj);
+static void dyad_fetch_pump (dyad_mod_ctx_t *mod_ctx);
+
+/* Count a job out of the active fetches and free it */
+static void dyad_fetch_release (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    struct timespec end;
+    if (fj->started) {
+        clock_gettime (CLOCK_MONOTONIC, &end);
+        mod_ctx->fetch_active--;
+        mod_ctx->fetch_active_bytes -= fj->cost;
+        mod_ctx->fetch_ms = 0.8 * mod_ctx->fetch_ms + 0.2 * 1000.0 * TIME_DIFF (fj->start, end);
+    }
+    dyad_fetch_job_unref (mod_ctx, fj);
+}
+
+/* Release the jobs whose consumer did not acknowledge the transfer in time */
+static void dyad_fetch_ack_timer_cb (flux_reactor_t *r, flux_watcher_t *w, int revents, void *arg)
+{
+    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)arg;
+    struct dyad_fetch_job **pp = &mod_ctx->acks;
+    struct dyad_fetch_job *fj = NULL;
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    while ((fj = *pp) != NULL) {
+        if (TIME_DIFF (fj->ack_since, now) < (double)DYAD_RMA_ACK_TIMEOUT_SECS) {
+            pp = &fj->next;
+            continue;
+        }
+        *pp = fj->next;
+        fj->next = NULL;
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: transfer %lu of %s not acknowledged",
+                        (unsigned long)fj->ack_id, fj->upath);
+        dyad_fetch_release (mod_ctx, fj);
+    }
+    if (mod_ctx->acks == NULL) {
+        flux_watcher_stop (w);
+    }
+    dyad_fetch_pump (mod_ctx);
+}
+
+/* Keep a job until its consumer acknowledges that it pulled the data, unless
+ * it already did */
+static void dyad_fetch_ack_wait (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    unsigned int i = 0u;
+    for (i = 0u; i < DYAD_FETCH_EARLY_ACKS; i++) {
+        if (mod_ctx->early_acks[i] == fj->ack_id) {
+            mod_ctx->early_acks[i] = 0u;
+            dyad_fetch_release (mod_ctx, fj);
+            return;
+        }
+    }
+    if (mod_ctx->ack_timer == NULL) {
+        mod_ctx->ack_timer = flux_timer_watcher_create (flux_get_reactor (mod_ctx->ctx->h), 1.0,
+                                                        1.0, dyad_fetch_ack_timer_cb, mod_ctx);
+    }
+    if (mod_ctx->ack_timer == NULL) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_timer_watcher_create", __func__);
+        dyad_fetch_release (mod_ctx, fj);
+        return;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &fj->ack_since);
+    fj->next = mod_ctx->acks;
+    mod_ctx->acks = fj;
+    flux_watcher_start (mod_ctx->ack_timer);
+}
+
+/* Release the buffers left for the consumers */
+static void dyad_fetch_acks_destroy (dyad_mod_ctx_t *mod_ctx)
+{
+    struct dyad_fetch_job *fj = NULL;
+    while ((fj = mod_ctx->acks) != NULL) {
+        mod_ctx->acks = fj->next;
+        dyad_fetch_job_unref (mod_ctx, fj);
+    }
+    flux_watcher_destroy (mod_ctx->ack_timer);
+    mod_ctx->ack_timer = NULL;
+}
+
+static void dyad_fetch_done (void *job, void *arg)
+{
+    struct dyad_fetch_job *fj = (struct dyad_fetch_job *)job;
+    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)arg;
+    dyad_ctx_t *ctx = mod_ctx->ctx;
+    struct dyad_fetch_job **pp = &mod_ctx->fetch_inflight;
+    struct dyad_fetch_job *follower = NULL;
+    char *upath = NULL;
+    struct timespec end;
+    unsigned int phase = 0u;
+    unsigned int i = 0u;
+
+    if (fj->preconnect) {
+        dyad_fetch_preconnect_done (mod_ctx, fj);
+        return;
+    }
+    while (*pp != NULL && *pp != fj)
+        pp = &((*pp)->next);
+    if (*pp == fj)
+        *pp = fj->next;
+    if (fj->from_pin) {
+        dyad_mod_stats_event (mod_ctx->stats, DYAD_MOD_STATS_CACHE_HIT);
+    }
+    // The size of the file is known once it is read. The consumer falls back
+    // to dyad.fetch.
+    if (fj->errnum == 0 && fj->inline_data && fj->len > mod_ctx->inline_max) {
+        fj->errnum = EFBIG;
+    }
+    // The job was charged the size its consumer read from the KVS, or an
+    // estimate, until the worker read the file
+    if (fj->have_data && fj->batch == NULL) {
+        if (fj->started) {
+            mod_ctx->fetch_active_bytes = mod_ctx->fetch_active_bytes - fj->cost + fj->len;
+        }
+        fj->cost = fj->len;
+        mod_ctx->fetch_bytes = 0.8 * mod_ctx->fetch_bytes + 0.2 * (double)fj->len;
+    }
+    // Hand the contents of the file to the requests that waited for them
+    while ((follower = fj->followers) != NULL) {
+        fj->followers = follower->next;
+        follower->next = NULL;
+        if (fj->have_data) {
+            follower->src = fj;
+            follower->buf = fj->buf;
+            follower->len = fj->len;
+            follower->have_data = true;
+            follower->cost = fj->len;
+            fj->refs++;
+            dyad_fetch_dispatch (mod_ctx, follower);
+        } else {
+            follower->errnum = fj->errnum;
+            dyad_fetch_done (follower, mod_ctx);
+        }
+    }
+    if (fj->errnum == 0 && !fj->sent && !fj->inline_data
+        && (fj->len > 0ul || fj->batch != NULL)) {
+        if (DYAD_IS_ERROR (ctx->dtl_handle->rpc_unpack (ctx, fj->msg, &upath))) {
+            fj->errnum = EPROTO;
+        } else if (fj->batch != NULL) {
+            dyad_fetch_batch_send (ctx, fj, false);
+        } else {
+            dyad_fetch_timed_send (ctx, fj);
+        }
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    fj->phase_s[DYAD_MOD_STATS_TOTAL] = TIME_DIFF (fj->arrival, end);
+    fj->phases |= (1u << DYAD_MOD_STATS_TOTAL);
+    for (phase = 0u; phase < DYAD_MOD_STATS_NPHASES; phase++) {
+        if (fj->phases & (1u << phase))
+            dyad_mod_stats_latency (mod_ctx->stats, (enum dyad_mod_stats_phase)phase,
+                                    fj->phase_s[phase]);
+    }
+    if (fj->batch != NULL) {
+        for (i = 0u; i < fj->nbatch; i++) {
+            const int errnum = (fj->errnum != 0) ? fj->errnum : fj->batch[i].errnum;
+            dyad_mod_stats_done (mod_ctx->stats, (errnum == 0) ? fj->batch[i].len : 0ul, errnum);
+        }
+    } else {
+        dyad_mod_stats_done (mod_ctx->stats, (fj->errnum == 0) ? fj->len : 0ul, fj->errnum);
+    }
+    if (fj->errnum == 0 && fj->inline_data) {
+        if (flux_respond_raw (ctx->h, fj->msg, fj->buf, (int)fj->len) < 0) {
+            DYAD_LOG_ERROR (ctx, "DYAD_MOD: %s: flux_respond_raw failed\n", __func__);
+        }
+        DYAD_LOG_INFO (ctx, "Finished %s module invocation\n", DYAD_INLINE_RPC_NAME);
+    } else if (fj->errnum == 0) {
+        DYAD_LOG_DEBUG (ctx, "Close RPC message stream with an ENODATA (%d) message", ENODATA);
+        if (flux_respond_error (ctx->h, fj->msg, ENODATA, NULL) < 0) {
+            DYAD_LOG_ERROR (ctx, "DYAD_MOD: %s: flux_respond_error with ENODATA failed\n", __func__);
+        }
+        DYAD_LOG_INFO (ctx, "Finished %s module invocation\n", DYAD_DTL_RPC_NAME);
+    } else {
+        DYAD_LOG_ERROR (ctx, "Close RPC message stream with an error (errno = %d)\n", fj->errnum);
+        if (flux_respond_error (ctx->h, fj->msg, fj->errnum, NULL) < 0) {
+            DYAD_LOG_ERROR (ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+        }
+    }
+    flux_msg_decref (fj->msg);
+    fj->msg = NULL;
+    if (fj->ack_pending) {
+        dyad_fetch_ack_wait (mod_ctx, fj);
+    } else {
+        dyad_fetch_release (mod_ctx, fj);
+    }
+    dyad_fetch_pump (mod_ctx);
+}
+
+/* Run a job on the worker threads, or inline if there are none */
+static void dyad_fetch_start (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    // A consumer pulling a single file over UCX acknowledges the transfer to
+    // the module, so that the worker sending it does not wait
+    if (mod_ctx->dtl_mode == DYAD_DTL_UCX && fj->batch == NULL && !fj->inline_data
+        && !fj->preconnect) {
+        if (++mod_ctx->ack_seq == 0u)
+            ++mod_ctx->ack_seq;
+        fj->ack_id = mod_ctx->ack_seq;
+    }
+    if (mod_ctx->fetch_q == NULL) {
+        dyad_fetch_work (fj, mod_ctx->ctx, mod_ctx);
+        dyad_fetch_done (fj, mod_ctx);
+        return;
+    }
+    fj->started = true;
+    mod_ctx->fetch_active++;
+    mod_ctx->fetch_active_bytes += fj->cost;
+    clock_gettime (CLOCK_MONOTONIC, &fj->start);
+    if (DYAD_IS_ERROR (dyad_mod_workq_submit (mod_ctx->fetch_q, fj))) {
+        fj->errnum = ENOMEM;
+        dyad_fetch_done (fj, mod_ctx);
+    }
+}
+
+/* Whether a job transferring size bytes can start without exceeding the
+ * limits. A job always can if no other job is active. */
+static bool dyad_fetch_can_start (const dyad_mod_ctx_t *mod_ctx, size_t size)
+{
+    return mod_ctx->fetch_active == 0u
+           || (mod_ctx->fetch_active < mod_ctx->max_active
+               && mod_ctx->fetch_active_bytes + size <= mod_ctx->max_active_bytes);
+}
+
+/* Start the queued jobs while the limits allow it */
+static void dyad_fetch_pump (dyad_mod_ctx_t *mod_ctx)
+{
+    size_t size = 0ul;
+    // A job that fails to start completes within the loop below
+    if (mod_ctx->fetch_sched == NULL || mod_ctx->fetch_pumping) {
+        return;
+    }
+    mod_ctx->fetch_pumping = true;
+    while (dyad_mod_sched_peek (mod_ctx->fetch_sched, &size)
+           && dyad_fetch_can_start (mod_ctx, size)) {
+        dyad_fetch_start (mod_ctx, (struct dyad_fetch_job *)dyad_mod_sched_pop (mod_ctx->fetch_sched));
+    }
+    mod_ctx->fetch_pumping = false;
+}
+
+/* Start a job if the limits allow it and no other job is waiting, or queue it */
+static void dyad_fetch_dispatch (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    if (mod_ctx->fetch_sched == NULL
+        || (dyad_mod_sched_count (mod_ctx->fetch_sched) == 0u
+            && dyad_fetch_can_start (mod_ctx, fj->cost))) {
+        dyad_fetch_start (mod_ctx, fj);
+        return;
+    }
+    if (DYAD_IS_ERROR (dyad_mod_sched_push (mod_ctx->fetch_sched, fj->consumer, fj->cost, fj))) {
+        fj->errnum = ENOMEM;
+        dyad_fetch_done (fj, mod_ctx);
+    }
+}
+
+/* Turn down a new request if the queue is full. The rejection is the first
+ * response to the request, which consumers check whatever their DTL. */
+static bool dyad_fetch_reject (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    char errstr[64] = {'\0'};
+    double retry_ms = 0.0;
+    unsigned int queued = dyad_mod_sched_count (mod_ctx->fetch_sched);
+    if (mod_ctx->fetch_sched == NULL || queued < mod_ctx->max_queued) {
+        return false;
+    }
+    // Time for the queued jobs to be served at the current pace
+    retry_ms = mod_ctx->fetch_ms * ((double)queued / (double)mod_ctx->max_active + 1.0);
+    if (retry_ms < 1.0)
+        retry_ms = 1.0;
+    if (retry_ms > (double)DYAD_FETCH_MAX_RETRY_AFTER_MS)
+        retry_ms = (double)DYAD_FETCH_MAX_RETRY_AFTER_MS;
+    snprintf (errstr, sizeof (errstr), DYAD_RETRY_AFTER_FMT, (unsigned int)retry_ms);
+    DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: %u fetches queued, turning down %s (%s)",
+                   queued, fj->upath, errstr);
+    dyad_mod_stats_event (mod_ctx->stats, DYAD_MOD_STATS_REJECTED);
+    if (flux_respond_error (mod_ctx->ctx->h, fj->msg, EAGAIN, errstr) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+    flux_msg_decref (fj->msg);
+    fj->msg = NULL;
+    dyad_fetch_job_unref (mod_ctx, fj);
+    return true;
+}
+
+/* Send the first response to a request the module serves, through the DTL. A
+ * UCX consumer only waits for the data once it gets it. A request the DTL
+ * cannot serve is completed with an error. */
+static bool dyad_fetch_answer (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    int err = 0;
+    if (fj->inline_data) {
+        return true;
+    }
+    errno = 0;
+    if (!DYAD_IS_ERROR (mod_ctx->ctx->dtl_handle->rpc_respond (mod_ctx->ctx, fj->msg))) {
+        return true;
+    }
+    err = (errno != 0) ? errno : EPROTO;
+    DYAD_LOG_ERROR (mod_ctx->ctx, "Could not send primary RPC response to client");
+    fj->errnum = err;
+    dyad_fetch_done (fj, mod_ctx);
+    return false;
+}
+
+/* Admit a new request, unless the queue is full */
+static bool dyad_fetch_admit (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    return !dyad_fetch_reject (mod_ctx, fj) && dyad_fetch_answer (mod_ctx, fj);
+}
+
+/* Size of the requested file as its consumer read it from the KVS, which the
+ * scheduler charges the job until a worker reads the file. Without it, the
+ * job is charged the average size of the files served. */
+static size_t dyad_fetch_request_cost (dyad_mod_ctx_t *mod_ctx, const flux_msg_t *msg)
+{
+    json_int_t size = -1;
+    size_t raw_size = 0ul;
+    if (flux_request_unpack (msg, NULL, "{s:I}", "size", &size) == 0 && size >= 0) {
+        return (size_t)size;
+    }
+    if (mod_ctx->ctx->dtl_handle->rpc_unpack_size != NULL
+        && !DYAD_IS_ERROR (mod_ctx->ctx->dtl_handle->rpc_unpack_size (mod_ctx->ctx, msg, &raw_size))) {
+        return raw_size;
+    }
+    return (size_t)mod_ctx->fetch_bytes;
+}
+
+/* Start serving a request, unless the file is already being read for another
+ * one, in which case the request waits for that read */
+static void dyad_fetch_submit (dyad_mod_ctx_t *mod_ctx, struct dyad_fetch_job *fj)
+{
+    struct dyad_fetch_job *lead = NULL;
+    dyad_fetch_job_prepare (mod_ctx, fj);
+    if (fj->inline_data && fj->have_data && fj->len > mod_ctx->inline_max) {
+        // The consumer falls back to dyad.fetch
+        fj->errnum = EFBIG;
+        dyad_fetch_done (fj, mod_ctx);
+        return;
+    }
+    // Contents found in memory are not shared with the other requests
+    if (fj->have_data || fj->from_pin || fj->batch != NULL) {
+        if (dyad_fetch_admit (mod_ctx, fj))
+            dyad_fetch_dispatch (mod_ctx, fj);
+        return;
+    }
+    for (lead = mod_ctx->fetch_inflight; lead != NULL; lead = lead->next) {
+        if (strcmp (lead->upath, fj->upath) == 0)
+            break;
+    }
+    if (lead != NULL) {
+        if (!dyad_fetch_answer (mod_ctx, fj)) {
+            return;
+        }
+        DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: %s is being read, waiting for it", fj->upath);
+        dyad_mod_stats_event (mod_ctx->stats, DYAD_MOD_STATS_COALESCED);
+        fj->next = lead->followers;
+        lead->followers = fj;
+        return;
+    }
+    if (!dyad_fetch_admit (mod_ctx, fj)) {
+        return;
+    }
+    if (mod_ctx->fetch_q != NULL) {
+        fj->next = mod_ctx->fetch_inflight;
+        mod_ctx->fetch_inflight = fj;
+    }
+    dyad_fetch_dispatch (mod_ctx, fj);
+}
+
+static const struct dyad_mod_workq_ops dyad_fetch_ops = {dyad_fetch_thread_init,
+                                                          dyad_mod_thread_ctx_destroy,
+                                                          dyad_fetch_work,
+                                                          dyad_fetch_done};
+
+/* request callback called when dyad.fetch or dyad.fetch_raw request is
+ * invoked */
+#if DYAD_PERFFLOW
+__attribute__ ((annotate ("@critical_path()")))
+#endif
+static void
+dyad_fetch_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    DYAD_LOG_INFO (mod_ctx->ctx, "Launched callback for %s", DYAD_DTL_RPC_NAME);
+    uint32_t userid = 0u;
+    const char *upath = NULL;
+    const char *topic = NULL;
+    int upath_len = 0;
+    int saved_errno = errno;
+    struct dyad_fetch_job *fj = NULL;
+    if (!flux_msg_is_streaming (msg)) {
+        errno = EPROTO;
+        goto fetch_error;
+    }
+
+    if (flux_msg_get_userid (msg, &userid) < 0)
+        goto fetch_error;
+
+    // The DTL unpacks the rest of the request where the file is sent from.
+    // A compact request starts with the path.
+    if (flux_msg_get_topic (msg, &topic) == 0 && strcmp (topic, DYAD_FETCH_RAW_RPC_NAME) == 0) {
+        if (mod_ctx->ctx->dtl_handle->rpc_pack_raw == NULL) {
+            errno = ENOSYS;
+            goto fetch_error;
+        }
+        if (flux_request_decode_raw (msg, NULL, (const void **)&upath, &upath_len) < 0
+            || upath == NULL || upath_len <= 0 || memchr (upath, '\0', (size_t)upath_len) == NULL) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "Could not decode message from client");
+            errno = EPROTO;
+            goto fetch_error;
+        }
+    } else if (flux_request_unpack (msg, NULL, "{s:s}", "upath", &upath) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "Could not unpack message from client");
+        errno = EPROTO;
+        goto fetch_error;
+    }
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: requested user_path: %s", upath);
+
+    // The initial response is sent once the request is admitted
+    fj = (struct dyad_fetch_job *)calloc (1, sizeof (*fj));
+    if (fj == NULL || (fj->upath = strdup (upath)) == NULL) {
+        free (fj);
+        errno = ENOMEM;
+        goto fetch_error;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &fj->arrival);
+    dyad_mod_stats_request (mod_ctx->stats, upath);
+    fj->msg = flux_msg_incref (msg);
+    fj->refs = 1u;
+    fj->consumer = flux_msg_route_first (msg);
+    fj->cost = dyad_fetch_request_cost (mod_ctx, msg);
+    dyad_fetch_submit (mod_ctx, fj);
+    goto end_fetch_cb;
+
+fetch_error:;
+    DYAD_LOG_ERROR (mod_ctx->ctx, "Close RPC message stream with an error (errno = %d)\n", errno);
+    if (flux_respond_error (h, msg, errno, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+    return;
+
+end_fetch_cb:;
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+    return;
+}
+
+/* request callback called when dyad.fetch_inline request is invoked. The
+ * contents of the file are the payload of the single response, so a small
+ * file takes one round trip and no DTL connection. */
+#if DYAD_PERFFLOW
+__attribute__ ((annotate ("@critical_path()")))
+#endif
+static void
+dyad_fetch_inline_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    const char *upath = NULL;
+    int saved_errno = errno;
+    struct dyad_fetch_job *fj = NULL;
+
+    if (mod_ctx->inline_max == 0ul) {
+        errno = ENOSYS;
+        goto inline_error;
+    }
+    if (flux_request_unpack (msg, NULL, "{s:s}", "upath", &upath) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "Could not unpack message from client");
+        errno = EPROTO;
+        goto inline_error;
+    }
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: requested inline user_path: %s", upath);
+    fj = (struct dyad_fetch_job *)calloc (1, sizeof (*fj));
+    if (fj == NULL || (fj->upath = strdup (upath)) == NULL) {
+        free (fj);
+        errno = ENOMEM;
+        goto inline_error;
+    }
+    clock_gettime (CLOCK_MONOTONIC, &fj->arrival);
+    dyad_mod_stats_request (mod_ctx->stats, upath);
+    fj->msg = flux_msg_incref (msg);
+    fj->refs = 1u;
+    fj->consumer = flux_msg_route_first (msg);
+    fj->inline_data = true;
+    dyad_fetch_submit (mod_ctx, fj);
+    goto inline_done;
+
+inline_error:;
+    if (flux_respond_error (h, msg, errno, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+inline_done:;
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+}
+
+/* request callback called when dyad.register request is invoked. A consumer
+ * registers ahead of its first fetch, so that the connections to it are set
+ * up by the time it fetches. With worker threads, each one connects, since
+ * each has its own DTL. */
+static void
+dyad_register_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    struct dyad_fetch_job *fj = NULL;
+    unsigned int count = 0u;
+    int saved_errno = errno;
+
+    // Only the UCX DTL has connections to set up
+    if (mod_ctx->dtl_mode != DYAD_DTL_UCX) {
+        if (flux_respond (h, msg, NULL) < 0) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond", __func__);
+        }
+        goto register_done;
+    }
+    fj = (struct dyad_fetch_job *)calloc (1, sizeof (*fj));
+    if (fj == NULL) {
+        errno = ENOMEM;
+        goto register_error;
+    }
+    fj->msg = flux_msg_incref (msg);
+    fj->consumer = flux_msg_route_first (msg);
+    fj->preconnect = true;
+    if (mod_ctx->fetch_q == NULL) {
+        fj->refs = 1u;
+        dyad_fetch_preconnect (mod_ctx->ctx, fj);
+        dyad_fetch_preconnect_done (mod_ctx, fj);
+        goto register_done;
+    }
+    if (DYAD_IS_ERROR (dyad_mod_workq_submit_all (mod_ctx->fetch_q, fj, &count))) {
+        flux_msg_decref (fj->msg);
+        free (fj);
+        errno = ENOMEM;
+        goto register_error;
+    }
+    // The completions run on this thread, after this callback returns
+    fj->refs = count;
+    goto register_done;
+
+register_error:;
+    if (flux_respond_error (h, msg, errno, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+register_done:;
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+}
+
+/* request callback called when dyad.fetch_batch request is invoked */
+#if DYAD_PERFFLOW
+__attribute__ ((annotate ("@critical_path()")))
+#endif
+static void
+dyad_fetch_batch_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    json_t *upaths = NULL;
+    json_t *value = NULL;
+    json_int_t bytes = 0;
+    size_t index = 0ul;
+    size_t nfiles = 0ul;
+    int saved_errno = errno;
+    struct dyad_fetch_job *fj = NULL;
+
+    if (!flux_msg_is_streaming (msg)) {
+        errno = EPROTO;
+        goto batch_error;
+    }
+    // The DTL unpacks the rest of the request, as for dyad.fetch
+    if (flux_request_unpack (msg, NULL, "{s:o, s?I}", "upaths", &upaths, "bytes", &bytes) < 0
+        || (nfiles = json_array_size (upaths)) == 0ul || nfiles > DYAD_BATCH_MAX_FILES) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "Could not unpack batch request from client");
+        errno = EPROTO;
+        goto batch_error;
+    }
+    DYAD_C_FUNCTION_UPDATE_INT ("nfiles", nfiles);
+    fj = (struct dyad_fetch_job *)calloc (1, sizeof (*fj));
+    if (fj == NULL
+        || (fj->batch = (struct dyad_fetch_batch_file *)calloc (nfiles, sizeof (*fj->batch)))
+               == NULL) {
+        free (fj);
+        errno = ENOMEM;
+        goto batch_error;
+    }
+    fj->nbatch = (unsigned int)nfiles;
+    // Total size of the files as published, which the scheduler charges the job
+    fj->cost = (bytes > 0) ? (size_t)bytes : 0ul;
+    json_array_foreach (upaths, index, value)
+    {
+        if (json_string_value (value) == NULL) {
+            errno = EPROTO;
+            goto batch_free;
+        }
+        if ((fj->batch[index].upath = strdup (json_string_value (value))) == NULL) {
+            errno = ENOMEM;
+            goto batch_free;
+        }
+    }
+    // The first file names the job in the logs
+    if ((fj->upath = strdup (fj->batch[0].upath)) == NULL) {
+        errno = ENOMEM;
+        goto batch_free;
+    }
+    DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: batch of %zu files starting with %s", nfiles,
+                    fj->upath);
+    clock_gettime (CLOCK_MONOTONIC, &fj->arrival);
+    for (index = 0ul; index < nfiles; index++)
+        dyad_mod_stats_request (mod_ctx->stats, fj->batch[index].upath);
+    fj->msg = flux_msg_incref (msg);
+    fj->refs = 1u;
+    fj->consumer = flux_msg_route_first (msg);
+    dyad_fetch_submit (mod_ctx, fj);
+    goto batch_done;
+
+batch_free:;
+    dyad_fetch_batch_free (fj);
+    free (fj->upath);
+    free (fj);
+batch_error:;
+    DYAD_LOG_ERROR (mod_ctx->ctx, "Close RPC message stream with an error (errno = %d)\n", errno);
+    if (flux_respond_error (h, msg, errno, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+batch_done:;
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+}
 
-typedef struct dyad_mod_ctx dyad_mod_ctx_t;
+/* Fetch a file from the module of its owner, in the same way a consumer does */
+static dyad_rc_t dyad_proxy_fetch (dyad_ctx_t *ctx,
+                                   const char *upath,
+                                   uint32_t owner_rank,
+                                   int64_t size,
+                                   void **data,
+                                   size_t *len)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    DYAD_C_FUNCTION_UPDATE_INT ("owner_rank", owner_rank);
+    dyad_rc_t rc = DYAD_RC_OK;
+    flux_future_t *f = NULL;
+    json_t *rpc_payload = NULL;
+    rc = ctx->dtl_handle->rpc_pack (ctx, upath, owner_rank, &rpc_payload);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (ctx, "DYAD_MOD: Cannot create the payload of the proxy fetch");
+        goto proxy_fetch_done;
+    }
+    if (size >= 0) {
+        json_object_set_new (rpc_payload, "size", json_integer ((json_int_t)size));
+    }
+    f = flux_rpc_pack (ctx->h, DYAD_DTL_RPC_NAME, owner_rank, FLUX_RPC_STREAMING, "o", rpc_payload);
+    if (f == NULL) {
+        DYAD_LOG_ERROR (ctx, "DYAD_MOD: Cannot send the proxy fetch to broker %u", owner_rank);
+        rc = DYAD_RC_BADRPC;
+        goto proxy_fetch_done;
+    }
+    rc = ctx->dtl_handle->rpc_recv_response (ctx, f);
+    if (DYAD_IS_ERROR (rc)) {
+        goto proxy_fetch_end;
+    }
+    rc = ctx->dtl_handle->establish_connection (ctx);
+    if (DYAD_IS_ERROR (rc)) {
+        goto proxy_fetch_end;
+    }
+    rc = ctx->dtl_handle->recv (ctx, data, len);
+    ctx->dtl_handle->close_connection (ctx);
 
-static void dyad_mod_fini (void) __attribute__ ((destructor));
+proxy_fetch_end:;
+    // See dyad_get_data in dyad_core.c for the handling of the end of stream
+    if (rc != DYAD_RC_RPC_FINISHED && rc != DYAD_RC_BADRPC && rc != DYAD_RC_BUSY) {
+        if (!(flux_rpc_get (f, NULL) < 0 && errno == ENODATA)) {
+            rc = DYAD_RC_BADRPC;
+        }
+    }
+    if (DYAD_IS_ERROR (rc) && *data != NULL) {
+        ctx->dtl_handle->return_buffer (ctx, data);
+    }
+    flux_future_destroy (f);
+proxy_fetch_done:;
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
 
-void dyad_mod_fini (void)
+/* The proxy thread uses its DTL in receive mode, on behalf of all the local
+ * processes */
+static void *dyad_proxy_thread_init (void *arg)
 {
-    flux_t *h = flux_open (NULL, 0);
+    return dyad_mod_thread_ctx_create ((dyad_mod_ctx_t *)arg, DYAD_COMM_RECV);
+}
 
-    if (h != NULL) {
+static void dyad_proxy_work (void *job, void *tls, void *arg)
+{
+    struct dyad_proxy_job *pj = (struct dyad_proxy_job *)job;
+    dyad_ctx_t *ctx = (dyad_ctx_t *)tls;
+    void *buf = NULL;
+    size_t len = 0ul;
+    if (ctx == NULL) {
+        pj->rc = DYAD_RC_NOCTX;
+        return;
+    }
+    // With the size from the KVS, the DTL receives into the buffer that ends
+    // up in the cache
+    if (pj->size > 0 && (pj->data = malloc ((size_t)pj->size)) != NULL) {
+        ctx->dtl_handle->user_buf = pj->data;
+        ctx->dtl_handle->user_buf_cap = (size_t)pj->size;
+        ctx->dtl_handle->user_buf_lent = false;
+    }
+    pj->rc = dyad_proxy_fetch (ctx, pj->upath, pj->owner_rank, pj->size, &buf, &len);
+    ctx->dtl_handle->user_buf = NULL;
+    ctx->dtl_handle->user_buf_lent = false;
+    if (!DYAD_IS_ERROR (pj->rc) && buf != NULL && buf == pj->data) {
+        pj->len = len;
+        return;
+    }
+    free (pj->data);
+    pj->data = NULL;
+    if (DYAD_IS_ERROR (pj->rc)) {
+        return;
+    }
+    // Keep a copy that outlives the DTL buffer for the cache
+    pj->data = malloc ((len > 0ul) ? len : 1ul);
+    if (pj->data == NULL) {
+        pj->rc = DYAD_RC_SYSFAIL;
+    } else {
+        if (len > 0ul)
+            memcpy (pj->data, buf, len);
+        pj->len = len;
     }
+    ctx->dtl_handle->return_buffer (ctx, &buf);
 }
 
-static void freectx (void *arg)
+/* Send the size of the file, then its contents in messages of at most
+ * DYAD_PROXY_CHUNK_SIZE bytes, so that the consumer copies one while the next
+ * is sent and files of any size fit */
+static void dyad_proxy_respond (dyad_mod_ctx_t *mod_ctx,
+                                const flux_msg_t *msg,
+                                const void *data,
+                                size_t len)
 {
-    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)arg;
-    flux_msg_handler_delvec (mod_ctx->handlers);
-    if (mod_ctx->ctx) {
-        if ( mod_ctx->ctx->dtl_handle ) dyad_dtl_finalize (mod_ctx->ctx);
-        mod_ctx->ctx->dtl_handle = NULL;
-        free(mod_ctx->ctx);
-        mod_ctx->ctx = NULL;
+    flux_t *h = mod_ctx->ctx->h;
+    size_t off = 0ul;
+    if (flux_respond_pack (h, msg, "{s:I}", "size", (json_int_t)len) < 0) {
+        goto proxy_respond_error;
     }
-    free (mod_ctx);
+    while (off < len) {
+        const size_t chunk = (len - off < DYAD_PROXY_CHUNK_SIZE) ? len - off
+                                                                 : DYAD_PROXY_CHUNK_SIZE;
+        if (flux_respond_raw (h, msg, (const char *)data + off, (int)chunk) < 0) {
+            goto proxy_respond_error;
+        }
+        off += chunk;
+    }
+    if (flux_respond_error (h, msg, ENODATA, NULL) == 0) {
+        return;
+    }
+proxy_respond_error:;
+    DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: cannot respond to a proxy request", __func__);
 }
 
-static dyad_mod_ctx_t *getctx (flux_t *h)
+static void dyad_proxy_done (void *job, void *arg)
 {
-    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)flux_aux_get (h, "dyad");
+    struct dyad_proxy_job *pj = (struct dyad_proxy_job *)job;
+    dyad_mod_ctx_t *mod_ctx = (dyad_mod_ctx_t *)arg;
+    struct dyad_proxy_job **pp = &mod_ctx->proxy_inflight;
+    size_t i = 0ul;
 
-    if (!mod_ctx) {
-        mod_ctx = (dyad_mod_ctx_t *)malloc (sizeof (*mod_ctx));
-        if (mod_ctx == NULL) {
-            DYAD_LOG_STDERR("DYAD_MOD: could not allocate memory for context");
-            goto getctx_error;
-        }
-        mod_ctx->handlers = NULL;
-        mod_ctx->ctx = (dyad_ctx_t *)malloc (sizeof (dyad_ctx_t));
-        mod_ctx->ctx->h = h;
-        mod_ctx->ctx->debug = false;
-        mod_ctx->ctx->prod_managed_path = NULL;
-        if (flux_aux_set (h, "dyad", mod_ctx, freectx) < 0) {
-            DYAD_LOG_STDERR ("DYAD_MOD: flux_aux_set() failed!");
-            goto getctx_error;
+    while (*pp != NULL && *pp != pj)
+        pp = &((*pp)->next);
+    if (*pp == pj)
+        *pp = pj->next;
+    for (i = 0ul; i < pj->nwaiters; i++) {
+        if (DYAD_IS_ERROR (pj->rc)) {
+            flux_respond_error (mod_ctx->ctx->h, pj->waiters[i], ECOMM, NULL);
+        } else {
+            dyad_proxy_respond (mod_ctx, pj->waiters[i], pj->data, pj->len);
         }
+        flux_msg_decref (pj->waiters[i]);
     }
-
-    goto getctx_done;
-
-getctx_error:;
-    return NULL;
-
-getctx_done:
-    return mod_ctx;
+    if (DYAD_IS_ERROR (pj->rc)) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: proxy failed to fetch %s (rc = %d)",
+                        pj->upath, pj->rc);
+    } else if (mod_ctx->proxy_cache != NULL
+               && !DYAD_IS_ERROR (dyad_mod_cache_insert (mod_ctx->proxy_cache, pj->upath,
+                                                         pj->has_version ? &pj->version : NULL,
+                                                         pj->data, pj->len))) {
+        pj->data = NULL;  // now owned by the cache
+    }
+    free (pj->data);
+    free (pj->waiters);
+    free (pj->upath);
+    free (pj);
 }
 
-/* request callback called when dyad.fetch request is invoked */
+static const struct dyad_mod_workq_ops dyad_proxy_ops = {dyad_proxy_thread_init,
+                                                          dyad_mod_thread_ctx_destroy,
+                                                          dyad_proxy_work,
+                                                          dyad_proxy_done};
+
+/* request callback called when dyad.proxy request is invoked */
 #if DYAD_PERFFLOW
 __attribute__ ((annotate ("@critical_path()")))
 #endif
 static void
-dyad_fetch_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+dyad_proxy_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
 {
     DYAD_C_FUNCTION_START();
     dyad_mod_ctx_t *mod_ctx = getctx (h);
-    DYAD_LOG_INFO(mod_ctx->ctx, "Launched callback for %s", DYAD_DTL_RPC_NAME);
-    ssize_t inlen = 0;
-    void *inbuf = NULL;
-    int fd = -1;
-    uint32_t userid = 0u;
-    char *upath = NULL;
-    char fullpath[PATH_MAX + 1] = {'\0'};
+    const char *upath = NULL;
+    int owner_rank = 0;
+    json_int_t size = -1;
+    json_int_t kvs_version = 0;
+    struct dyad_mod_cache_version version;
+    bool has_version = false;
+    const void *data = NULL;
+    size_t len = 0ul;
+    struct dyad_proxy_job *pj = NULL;
     int saved_errno = errno;
-    ssize_t file_size = 0;
-    dyad_rc_t rc = 0;
-    struct flock shared_lock;
+
     if (!flux_msg_is_streaming (msg)) {
         errno = EPROTO;
-        goto fetch_error_wo_flock;
+        goto proxy_error;
     }
-
-    if (flux_msg_get_userid (msg, &userid) < 0)
-        goto fetch_error_wo_flock;
-
-    DYAD_LOG_INFO(mod_ctx->ctx, "DYAD_MOD: unpacking RPC message");
-
-    rc = mod_ctx->ctx->dtl_handle->rpc_unpack (mod_ctx->ctx, msg, &upath);
-
-    if (DYAD_IS_ERROR (rc)) {
-        DYAD_LOG_ERROR(mod_ctx->ctx, "Could not unpack message from client");
+    if (mod_ctx->proxy_q == NULL) {
+        errno = ENOSYS;
+        goto proxy_error;
+    }
+    if (flux_request_unpack (msg, NULL, "{s:s, s:i, s?I, s?I}", "upath", &upath, "owner_rank",
+                             &owner_rank, "size", &size, "version", &kvs_version)
+        < 0) {
         errno = EPROTO;
-        goto fetch_error_wo_flock;
+        goto proxy_error;
     }
     DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
-    DYAD_LOG_DEBUG(mod_ctx, "DYAD_MOD: requested user_path: %s", upath);
-    DYAD_LOG_DEBUG(mod_ctx, "DYAD_MOD: sending initial response to consumer");
+    // The copies are told apart by the size and version in the KVS entry the
+    // consumer read. Without them, the file is fetched again.
+    memset (&version, 0, sizeof (version));
+    if (size >= 0 && kvs_version != 0) {
+        version.size = (uint64_t)size;
+        version.mtime_sec = (int64_t)((uint64_t)kvs_version / 1000000000ull);
+        version.mtime_nsec = (int64_t)((uint64_t)kvs_version % 1000000000ull);
+        has_version = true;
+    }
+    if (has_version
+        && dyad_mod_cache_lookup (mod_ctx->proxy_cache, upath, &version, &data, &len, NULL)) {
+        DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: proxy serves %s from its cache", upath);
+        dyad_proxy_respond (mod_ctx, msg, data, len);
+        goto proxy_done;
+    }
+    // Join a fetch of the same version of the file that is already under way
+    for (pj = mod_ctx->proxy_inflight; pj != NULL; pj = pj->next) {
+        if (strcmp (pj->upath, upath) == 0 && has_version && pj->has_version
+            && memcmp (&pj->version, &version, sizeof (version)) == 0)
+            break;
+    }
+    if (pj == NULL) {
+        pj = (struct dyad_proxy_job *)calloc (1, sizeof (*pj));
+        if (pj == NULL || (pj->upath = strdup (upath)) == NULL) {
+            free (pj);
+            errno = ENOMEM;
+            goto proxy_error;
+        }
+        pj->owner_rank = (uint32_t)owner_rank;
+        pj->size = (int64_t)size;
+        pj->has_version = has_version;
+        pj->version = version;
+        if (DYAD_IS_ERROR (dyad_mod_workq_submit (mod_ctx->proxy_q, pj))) {
+            free (pj->upath);
+            free (pj);
+            errno = ENOMEM;
+            goto proxy_error;
+        }
+        pj->next = mod_ctx->proxy_inflight;
+        mod_ctx->proxy_inflight = pj;
+        DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: proxy fetches %s from broker %d", upath, owner_rank);
+    }
+    if (pj->nwaiters == pj->max_waiters) {
+        size_t max_waiters = (pj->max_waiters == 0ul) ? 8ul : 2ul * pj->max_waiters;
+        const flux_msg_t **waiters =
+            (const flux_msg_t **)realloc (pj->waiters, max_waiters * sizeof (*waiters));
+        if (waiters == NULL) {
+            errno = ENOMEM;
+            goto proxy_error;
+        }
+        pj->waiters = waiters;
+        pj->max_waiters = max_waiters;
+    }
+    pj->waiters[pj->nwaiters++] = flux_msg_incref (msg);
+    goto proxy_done;
 
-    rc = mod_ctx->ctx->dtl_handle->rpc_respond (mod_ctx->ctx, msg);
-    if (DYAD_IS_ERROR (rc)) {
-        DYAD_LOG_ERROR(mod_ctx, "Could not send primary RPC response to client");
-        goto fetch_error_wo_flock;
+proxy_error:;
+    if (flux_respond_error (h, msg, errno, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
     }
+proxy_done:;
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+}
+
+static void dyad_shm_unmap (void *data, size_t size)
+{
+    munmap (data, size);
+}
+
+/* Map the memory file holding the contents of a file a local producer just
+ * wrote, so that fetches are served from it. The producer keeps the memory
+ * file open until this returns. On error, errno is set. */
+static dyad_rc_t dyad_shm_map (dyad_mod_ctx_t *mod_ctx, const char *upath, int pid, int fd)
+{
+    DYAD_C_FUNCTION_START();
+    DYAD_C_FUNCTION_UPDATE_STR ("upath", upath);
+    dyad_rc_t rc = DYAD_RC_OK;
+    char fullpath[PATH_MAX + 1] = {'\0'};
+    char procpath[64] = {'\0'};
+    const int seals = F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW;
+    struct dyad_mod_cache_version version;
+    struct stat st, mst;
+    void *data = MAP_FAILED;
+    int mfd = -1;
 
     strncpy (fullpath, mod_ctx->ctx->prod_managed_path, PATH_MAX - 1);
     concat_str (fullpath, upath, "/", PATH_MAX);
-    DYAD_C_FUNCTION_UPDATE_STR ("fullpath", fullpath);
+    snprintf (procpath, sizeof (procpath), "/proc/%d/fd/%d", pid, fd);
+    // Only sealed contents cannot change under the module
+    if ((mfd = open (procpath, O_RDONLY | O_CLOEXEC)) < 0 || fstat (mfd, &mst) < 0
+        || stat (fullpath, &st) < 0) {
+        rc = DYAD_RC_BADFIO;
+        goto shm_map_done;
+    }
+    if ((fcntl (mfd, F_GET_SEALS) & seals) != seals || mst.st_size != st.st_size) {
+        errno = EINVAL;
+        rc = DYAD_RC_BADFIO;
+        goto shm_map_done;
+    }
+    if (st.st_size == 0) {
+        rc = DYAD_RC_OK;  // nothing worth keeping
+        goto shm_map_done;
+    }
+    data = mmap (NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, mfd, 0);
+    if (data == MAP_FAILED) {
+        rc = DYAD_RC_SYSFAIL;
+        goto shm_map_done;
+    }
+    dyad_fetch_version (&st, &version);
+    if (DYAD_IS_ERROR (dyad_mod_cache_insert_with (mod_ctx->shm_cache, upath, &version, data,
+                                                   (size_t)st.st_size, dyad_shm_unmap))) {
+        munmap (data, (size_t)st.st_size);
+        errno = EFBIG;
+        rc = DYAD_RC_BADBUF;
+        goto shm_map_done;
+    }
+    // The hot cache may hold an older version
+    if (mod_ctx->hot_cache != NULL) {
+        dyad_mod_cache_remove (mod_ctx->hot_cache, upath);
+    }
+    DYAD_LOG_DEBUG (mod_ctx->ctx, "DYAD_MOD: %s handed over by process %d", upath, pid);
+    rc = DYAD_RC_OK;
 
-#if DYAD_SPIN_WAIT
-    if (!get_stat (fullpath, 1000U, 1000L)) {
-        DYAD_LOG_ERR(mod_ctx->ctx, "DYAD_MOD: Failed to access info on \"%s\".", fullpath);
-        // goto error;
+shm_map_done:;
+    if (mfd >= 0) {
+        int saved_errno = errno;
+        close (mfd);
+        errno = saved_errno;
     }
-#endif  // DYAD_SPIN_WAIT
+    DYAD_C_FUNCTION_END();
+    return rc;
+}
 
-    DYAD_LOG_INFO (mod_ctx->ctx, "Reading file %s for transfer", fullpath);
-    fd = open (fullpath, O_RDONLY);
+/* request callback called when dyad.register_shm request is invoked. A
+ * producer on this node hands over the contents of a file it wrote, in a
+ * sealed memory file it keeps open until the response. */
+static void
+dyad_register_shm_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    const char *upath = NULL;
+    int pid = -1, fd = -1;
+    int saved_errno = errno;
 
-    if (fd < 0) {
-        DYAD_LOG_ERROR(mod_ctx, "DYAD_MOD: Failed to open file \"%s\".", fullpath);
-        goto fetch_error_wo_flock;
+    if (flux_request_unpack (msg, NULL, "{s:s, s:i, s:i}", "upath", &upath, "pid", &pid, "fd", &fd)
+        < 0) {
+        errno = EPROTO;
+        goto register_shm_error;
     }
-    rc = dyad_shared_flock (mod_ctx->ctx, fd, &shared_lock);
-    if (DYAD_IS_ERROR (rc)) {
-        goto fetch_error;
+    if (mod_ctx->shm_cache == NULL) {
+        errno = ENOSYS;
+        goto register_shm_error;
     }
-    file_size = get_file_size (fd);
-    DYAD_LOG_DEBUG (mod_ctx->ctx, "file %s has size %u", fullpath, file_size);
-    if (file_size > 0) {
-        rc = mod_ctx->ctx->dtl_handle->get_buffer (mod_ctx->ctx, file_size, &inbuf);
-        inlen = read (fd, inbuf, file_size);
-        if (inlen != file_size) {
-            DYAD_LOG_ERROR (mod_ctx->ctx,
-                            "DYAD_MOD: Failed to load file \"%s\" only read %u of %u.",
-                            fullpath,
-                            inlen,
-                            file_size);
-            goto fetch_error;
-        }
-        DYAD_C_FUNCTION_UPDATE_INT ("file_size", file_size);
-        DYAD_LOG_DEBUG (mod_ctx->ctx, "Closing file pointer");
-        dyad_release_flock (mod_ctx->ctx, fd, &shared_lock);
-        close (fd);
-        DYAD_LOG_DEBUG (mod_ctx->ctx, "Is inbuf NULL? -> %i", (int)(inbuf == NULL));
+    errno = 0;
+    if (DYAD_IS_ERROR (dyad_shm_map (mod_ctx, upath, pid, fd))) {
+        if (errno == 0)
+            errno = EIO;
+        goto register_shm_error;
+    }
+    if (flux_respond (h, msg, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond", __func__);
+    }
+    goto register_shm_done;
 
-        DYAD_LOG_DEBUG (mod_ctx->ctx, "Establish DTL connection with consumer");
-        rc = mod_ctx->ctx->dtl_handle->establish_connection (mod_ctx->ctx);
-        if (DYAD_IS_ERROR (rc)) {
-            DYAD_LOG_ERROR (mod_ctx->ctx, "Could not establish DTL connection with client");
-            errno = ECONNREFUSED;
-            goto fetch_error_wo_flock;
-        }
-        DYAD_LOG_DEBUG (mod_ctx, "Send file to consumer with DTL");
-        rc = mod_ctx->ctx->dtl_handle->send (mod_ctx->ctx, inbuf, inlen);
-        DYAD_LOG_DEBUG (mod_ctx, "Close DTL connection with consumer");
-        mod_ctx->ctx->dtl_handle->close_connection (mod_ctx->ctx);
-        mod_ctx->ctx->dtl_handle->return_buffer (mod_ctx->ctx, &inbuf);
-        if (DYAD_IS_ERROR (rc)) {
-            DYAD_LOG_ERROR (mod_ctx->ctx, "Could not send data to client via DTL\n");
-            errno = ECOMM;
-            goto fetch_error_wo_flock;
-        }
-    } else {
-        dyad_release_flock (mod_ctx->ctx, fd, &shared_lock);
-        close (fd);
+register_shm_error:;
+    DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: cannot take over the contents of %s: %s",
+                   (upath != NULL) ? upath : "(null)", strerror (errno));
+    if (flux_respond_error (h, msg, errno, NULL) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+    }
+register_shm_done:;
+    errno = saved_errno;
+    DYAD_C_FUNCTION_END();
+}
+
+/* request callback called when dyad.rma_ack request is invoked. A consumer
+ * pulled the data of a transfer, whose buffer can be released. */
+static void
+dyad_rma_ack_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    struct dyad_fetch_job **pp = &mod_ctx->acks;
+    struct dyad_fetch_job *fj = NULL;
+    json_int_t id = 0;
+
+    if (flux_request_unpack (msg, NULL, "{s:I}", "id", &id) < 0 || id == 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: malformed acknowledgement", __func__);
+        return;
     }
-    DYAD_LOG_DEBUG(mod_ctx, "Close RPC message stream with an ENODATA (%d) message", ENODATA);
-    if (flux_respond_error (h, msg, ENODATA, NULL) < 0) {
-        DYAD_LOG_ERROR (mod_ctx, "DYAD_MOD: %s: flux_respond_error with ENODATA failed\n", __func__ );
+    while (*pp != NULL && (*pp)->ack_id != (uint64_t)id)
+        pp = &((*pp)->next);
+    if ((fj = *pp) == NULL) {
+        // The worker has not reported the job yet
+        mod_ctx->early_acks[mod_ctx->early_next] = (uint64_t)id;
+        mod_ctx->early_next = (mod_ctx->early_next + 1u) % DYAD_FETCH_EARLY_ACKS;
+        return;
     }
-    DYAD_LOG_INFO(mod_ctx, "Finished %s module invocation\n", DYAD_DTL_RPC_NAME);
-    goto end_fetch_cb;
+    *pp = fj->next;
+    fj->next = NULL;
+    if (mod_ctx->acks == NULL) {
+        flux_watcher_stop (mod_ctx->ack_timer);
+    }
+    dyad_fetch_release (mod_ctx, fj);
+    dyad_fetch_pump (mod_ctx);
+}
 
-fetch_error:;
-    dyad_release_flock (mod_ctx->ctx, fd, &shared_lock);
-    close (fd);
+/* request callback called when dyad.stats request is invoked */
+static void
+dyad_stats_request_cb (flux_t *h, flux_msg_handler_t *w, const flux_msg_t *msg, void *arg)
+{
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    int top = DYAD_STATS_DEFAULT_TOP;
+    uint32_t rank = 0u;
+    unsigned int queued = 0u;
+    json_t *obj = NULL;
+    int saved_errno = errno;
+
+    if (flux_request_unpack (msg, NULL, "{s?i}", "top", &top) < 0) {
+        errno = EPROTO;
+        goto stats_error;
+    }
+    if (flux_get_rank (h, &rank) < 0) {
+        goto stats_error;
+    }
+    if (mod_ctx->fetch_sched != NULL) {
+        queued = dyad_mod_sched_count (mod_ctx->fetch_sched);
+    }
+    // Transfers in flight and waiting are not part of the cumulative counters
+    obj = dyad_mod_stats_pack (mod_ctx->stats, (top > 0) ? (unsigned int)top : 0u);
+    if (obj == NULL || json_object_set_new (obj, "rank", json_integer (rank)) < 0
+        || json_object_set_new (obj, "active", json_integer (mod_ctx->fetch_active)) < 0
+        || json_object_set_new (obj, "active_bytes", json_integer (mod_ctx->fetch_active_bytes)) < 0
+        || json_object_set_new (obj, "queued", json_integer (queued)) < 0) {
+        errno = ENOMEM;
+        goto stats_error;
+    }
+    // "o" steals the reference to obj
+    if (flux_respond_pack (h, msg, "o", obj) < 0) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_pack", __func__);
+    }
+    goto stats_done;
 
-fetch_error_wo_flock:;
-    DYAD_LOG_ERROR(mod_ctx, "Close RPC message stream with an error (errno = %d)\n", errno);
+stats_error:;
+    json_decref (obj);
     if (flux_respond_error (h, msg, errno, NULL) < 0) {
-        DYAD_LOG_ERROR (mod_ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: %s: flux_respond_error", __func__);
     }
+stats_done:;
     errno = saved_errno;
+}
+
+/* Start serving the fetches of the local processes from nthreads threads,
+ * with a cache of up to cache_size bytes of file contents */
+static dyad_rc_t dyad_proxy_open (flux_t *h, unsigned int nthreads, size_t cache_size)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    dyad_rc_t rc = DYAD_RC_OK;
+    rc = dyad_mod_cache_create (cache_size, &mod_ctx->proxy_cache);
+    if (DYAD_IS_ERROR (rc)) {
+        goto proxy_open_done;
+    }
+    // Every thread has a DTL of its own, so the owners tell their transfers
+    // apart
+    rc = dyad_mod_workq_create (h, (nthreads > 0u) ? nthreads : 1u, &dyad_proxy_ops, mod_ctx,
+                                &mod_ctx->proxy_q);
+    if (DYAD_IS_ERROR (rc)) {
+        dyad_mod_cache_destroy (&mod_ctx->proxy_cache);
+        goto proxy_open_done;
+    }
+    DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: fetch proxy enabled with %u threads and a %zu-byte cache",
+                   (nthreads > 0u) ? nthreads : 1u, cache_size);
+
+proxy_open_done:;
     DYAD_C_FUNCTION_END();
-    return;
+    return rc;
+}
 
-end_fetch_cb:;
-    errno = saved_errno;
+/* Serve the fetches from nthreads worker threads. The reactor thread only
+ * dispatches the requests and completes them. */
+static dyad_rc_t dyad_fetch_pool_open (flux_t *h,
+                                       unsigned int nthreads,
+                                       unsigned int max_active,
+                                       size_t max_active_bytes,
+                                       unsigned int max_queued)
+{
+    DYAD_C_FUNCTION_START();
+    dyad_mod_ctx_t *mod_ctx = getctx (h);
+    dyad_rc_t rc = DYAD_RC_OK;
+    mod_ctx->max_active = (max_active > 0u) ? max_active : 1u;
+    mod_ctx->max_active_bytes = max_active_bytes;
+    mod_ctx->max_queued = max_queued;
+    mod_ctx->fetch_ms = DYAD_FETCH_DEFAULT_MS;
+    rc = dyad_mod_sched_create (&mod_ctx->fetch_sched);
+    if (DYAD_IS_ERROR (rc)) {
+        goto fetch_pool_open_done;
+    }
+    rc = dyad_mod_workq_create (h, nthreads, &dyad_fetch_ops, mod_ctx, &mod_ctx->fetch_q);
+    if (DYAD_IS_ERROR (rc)) {
+        dyad_mod_sched_destroy (&mod_ctx->fetch_sched);
+        goto fetch_pool_open_done;
+    }
+    DYAD_LOG_INFO (mod_ctx->ctx,
+                   "DYAD_MOD: serving fetches with %u threads, up to %u (%zu bytes) at once",
+                   nthreads, mod_ctx->max_active, max_active_bytes);
+
+fetch_pool_open_done:;
     DYAD_C_FUNCTION_END();
-    return;
+    return rc;
 }
 
 static dyad_rc_t dyad_open (flux_t *h, dyad_dtl_mode_t dtl_mode, bool debug, optparse_t *opts)
@@ -254,14 +2063,40 @@ static dyad_rc_t dyad_open (flux_t *h, dyad_dtl_mode_t dtl_mode, bool debug, opt
     DYAD_C_FUNCTION_START();
     dyad_mod_ctx_t *mod_ctx = getctx (h);
     dyad_rc_t rc = DYAD_RC_OK;
+    const char *uri = NULL;
     mod_ctx->ctx->debug = debug;
+    mod_ctx->dtl_mode = dtl_mode;
     rc = dyad_dtl_init (mod_ctx->ctx, dtl_mode, DYAD_COMM_SEND, mod_ctx->ctx->debug);
+    if (DYAD_IS_ERROR (rc)) {
+        goto open_done;
+    }
+    uri = flux_attr_get (h, "local-uri");
+    if (uri == NULL || (mod_ctx->local_uri = strdup (uri)) == NULL) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: cannot get the local URI of the broker");
+        rc = DYAD_RC_FLUXFAIL;
+        goto open_done;
+    }
+    rc = dyad_mod_stats_create (&mod_ctx->stats);
+    if (DYAD_IS_ERROR (rc)) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "DYAD_MOD: cannot allocate the statistics");
+        goto open_done;
+    }
+
+open_done:;
     DYAD_C_FUNCTION_END();
     return rc;
 }
 
 static const struct flux_msg_handler_spec htab[] =
     {{FLUX_MSGTYPE_REQUEST, DYAD_DTL_RPC_NAME, dyad_fetch_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_FETCH_RAW_RPC_NAME, dyad_fetch_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_BATCH_RPC_NAME, dyad_fetch_batch_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_INLINE_RPC_NAME, dyad_fetch_inline_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_REGISTER_RPC_NAME, dyad_register_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_SHM_RPC_NAME, dyad_register_shm_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_PROXY_RPC_NAME, dyad_proxy_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_STATS_RPC_NAME, dyad_stats_request_cb, 0},
+     {FLUX_MSGTYPE_REQUEST, DYAD_RMA_ACK_RPC_NAME, dyad_rma_ack_request_cb, 0},
      FLUX_MSGHANDLER_TABLE_END};
 
 static struct optparse_option cmdline_opts[] =
@@ -298,8 +2133,98 @@ static struct optparse_option cmdline_opts[] =
                "error logging. Does nothing if DYAD was "
                "not configured with "
                "'-DDYAD_LOGGER=PRINTF'"},
+     {.name = "proxy",
+      .key = 'p',
+      .has_arg = 0,
+      .usage = "If provided, fetch remote files on behalf "
+               "of the processes on this node, once per file"},
+     {.name = "proxy_cache",
+      .key = 'c',
+      .has_arg = 1,
+      .arginfo = "BYTES",
+      .usage = "Specify the number of bytes of file contents "
+               "the fetch proxy keeps in memory "
+               "(default: 1 GiB)"},
+     {.name = "proxy_threads",
+      .key = 'x',
+      .has_arg = 1,
+      .arginfo = "N",
+      .usage = "Specify the number of threads fetching files "
+               "for the fetch proxy (default: 4)"},
+     {.name = "hot_cache",
+      .key = 'H',
+      .has_arg = 1,
+      .arginfo = "BYTES",
+      .usage = "Specify the number of bytes of frequently "
+               "fetched files the module keeps in memory "
+               "(default: 0, disabled)"},
+     {.name = "threads",
+      .key = 'n',
+      .has_arg = 1,
+      .arginfo = "N",
+      .usage = "Specify the number of threads reading and "
+               "sending files. 0 serves the fetches on the "
+               "reactor thread (default: 4)"},
+     {.name = "max_transfers",
+      .key = 'T',
+      .has_arg = 1,
+      .arginfo = "N",
+      .usage = "Specify the number of fetches served at "
+               "once. Others wait in a queue (default: 16)"},
+     {.name = "max_transfer_bytes",
+      .key = 'B',
+      .has_arg = 1,
+      .arginfo = "BYTES",
+      .usage = "Specify the number of bytes of the fetches "
+               "served at once (default: 1 GiB)"},
+     {.name = "max_queued",
+      .key = 'Q',
+      .has_arg = 1,
+      .arginfo = "N",
+      .usage = "Specify the number of queued fetches beyond "
+               "which consumers are asked to retry later "
+               "(default: 1024)"},
+     {.name = "inline_max",
+      .key = 'I',
+      .has_arg = 1,
+      .arginfo = "BYTES",
+      .usage = "Specify the size of the largest file returned "
+               "in the response to the request, without a DTL "
+               "transfer. 0 disables it (default: 64 KiB)"},
+     {.name = "fd_cache",
+      .key = 'F',
+      .has_arg = 1,
+      .arginfo = "N",
+      .usage = "Specify the number of served files kept "
+               "open between fetches. 0 disables it "
+               "(default: 256)"},
+     {.name = "shm_cache",
+      .key = 'S',
+      .has_arg = 1,
+      .arginfo = "BYTES",
+      .usage = "Specify the number of bytes of file contents "
+               "handed over in memory by local producers "
+               "the module keeps. 0 disables it "
+               "(default: 256 MiB)"},
+     {.name = "auto_publish",
+      .key = 'P',
+      .has_arg = 1,
+      .arginfo = "KVS_NAMESPACE",
+      .usage = "Publish the files written under the managed "
+               "directory in the given KVS namespace as soon "
+               "as they are closed, so that producers need "
+               "not call DYAD. The keys use DYAD_KEY_DEPTH "
+               "and DYAD_KEY_BINS"},
      OPTPARSE_TABLE_END};
 
+/* Get the layout of the KVS keys the producers and consumers use */
+static void get_key_layout_env (unsigned int *key_depth, unsigned int *key_bins)
+{
+    char *e = NULL;
+    *key_depth = ((e = getenv (DYAD_KEY_DEPTH_ENV))) ? (unsigned int)atoi (e) : 3u;
+    *key_bins = ((e = getenv (DYAD_KEY_BINS_ENV))) ? (unsigned int)atoi (e) : 1024u;
+}
+
 /** This is a temporary measure until environment variable based initialization
  *  is implemented */
 static dyad_dtl_mode_t get_dtl_mode_env ()
@@ -355,6 +2280,7 @@ DYAD_DLL_EXPORTED int mod_main (flux_t *h, int argc, char **argv)
     }
     uint32_t broker_rank;
     flux_get_rank (h, &broker_rank);
+    mod_ctx->ctx->rank = broker_rank;
 #ifdef DYAD_PROFILER_DLIO_PROFILER
     int pid = broker_rank;
     DLIO_PROFILER_C_INIT (NULL, NULL, &pid);
@@ -413,6 +2339,93 @@ DYAD_DLL_EXPORTED int mod_main (flux_t *h, int argc, char **argv)
         sprintf (err_file_name, "dyad_core_%d.err", broker_rank);
         DYAD_LOG_STDERR_REDIRECT (err_file_name);
     }
+    size_t hot_cache_size = DYAD_HOT_CACHE_DEFAULT_SIZE;
+    if (optparse_getopt (opts, "hot_cache", &optargp) > 0) {
+        hot_cache_size = strtoull (optargp, NULL, 10);
+    }
+    if (hot_cache_size > 0ul) {
+        if (DYAD_IS_ERROR (dyad_mod_cache_create (hot_cache_size, &mod_ctx->hot_cache))) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "Cannot create the hot file cache");
+            goto mod_error;
+        }
+        dyad_mod_cache_set_forget (mod_ctx->hot_cache, dyad_fetch_cache_forget, mod_ctx);
+        DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: hot file cache of %zu bytes", hot_cache_size);
+    }
+    unsigned int fd_cache_size = DYAD_FD_CACHE_DEFAULT_SIZE;
+    if (optparse_getopt (opts, "fd_cache", &optargp) > 0) {
+        fd_cache_size = (unsigned int)strtoul (optargp, NULL, 10);
+    }
+    if (fd_cache_size > 0u) {
+        // Without inotify, files are opened on every fetch as before
+        if (DYAD_IS_ERROR (dyad_mod_fdcache_create (h, fd_cache_size, &mod_ctx->fd_cache))) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "Cannot create the descriptor cache. Continuing without it");
+        } else {
+            DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: descriptor cache of %u files", fd_cache_size);
+        }
+    }
+    size_t shm_cache_size = DYAD_SHM_CACHE_DEFAULT_SIZE;
+    if (optparse_getopt (opts, "shm_cache", &optargp) > 0) {
+        shm_cache_size = strtoull (optargp, NULL, 10);
+    }
+    if (shm_cache_size > 0ul) {
+        if (DYAD_IS_ERROR (dyad_mod_cache_create (shm_cache_size, &mod_ctx->shm_cache))) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "Cannot create the producer memory cache");
+            goto mod_error;
+        }
+        dyad_mod_cache_set_forget (mod_ctx->shm_cache, dyad_fetch_cache_forget, mod_ctx);
+    }
+    unsigned int nthreads = DYAD_FETCH_DEFAULT_THREADS;
+    if (optparse_getopt (opts, "threads", &optargp) > 0) {
+        nthreads = (unsigned int)strtoul (optargp, NULL, 10);
+    }
+    unsigned int max_active = DYAD_FETCH_DEFAULT_MAX_ACTIVE;
+    if (optparse_getopt (opts, "max_transfers", &optargp) > 0) {
+        max_active = (unsigned int)strtoul (optargp, NULL, 10);
+    }
+    size_t max_active_bytes = DYAD_FETCH_DEFAULT_MAX_ACTIVE_BYTES;
+    if (optparse_getopt (opts, "max_transfer_bytes", &optargp) > 0) {
+        max_active_bytes = strtoull (optargp, NULL, 10);
+    }
+    unsigned int max_queued = DYAD_FETCH_DEFAULT_MAX_QUEUED;
+    if (optparse_getopt (opts, "max_queued", &optargp) > 0) {
+        max_queued = (unsigned int)strtoul (optargp, NULL, 10);
+    }
+    if (optparse_getopt (opts, "inline_max", &optargp) > 0) {
+        mod_ctx->inline_max = strtoull (optargp, NULL, 10);
+    }
+    if (nthreads > 0u
+        && DYAD_IS_ERROR (
+            dyad_fetch_pool_open (h, nthreads, max_active, max_active_bytes, max_queued))) {
+        DYAD_LOG_ERROR (mod_ctx->ctx, "Cannot start the fetch threads");
+        goto mod_error;
+    }
+    if (optparse_hasopt (opts, "proxy")) {
+        size_t proxy_cache_size = DYAD_PROXY_DEFAULT_CACHE_SIZE;
+        if (optparse_getopt (opts, "proxy_cache", &optargp) > 0) {
+            proxy_cache_size = strtoull (optargp, NULL, 10);
+        }
+        unsigned int proxy_threads = DYAD_PROXY_DEFAULT_THREADS;
+        if (optparse_getopt (opts, "proxy_threads", &optargp) > 0) {
+            proxy_threads = (unsigned int)strtoul (optargp, NULL, 10);
+        }
+        if (DYAD_IS_ERROR (dyad_proxy_open (h, proxy_threads, proxy_cache_size))) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "Cannot start the fetch proxy");
+            goto mod_error;
+        }
+    }
+    if (optparse_getopt (opts, "auto_publish", &optargp) > 0) {
+        unsigned int key_depth = 0u, key_bins = 0u;
+        get_key_layout_env (&key_depth, &key_bins);
+        if (DYAD_IS_ERROR (dyad_mod_publish_create (h, mod_ctx->ctx->prod_managed_path, optargp,
+                                                    broker_rank, key_depth, key_bins,
+                                                    &mod_ctx->publisher))) {
+            DYAD_LOG_ERROR (mod_ctx->ctx, "Cannot watch %s for files to publish",
+                            mod_ctx->ctx->prod_managed_path);
+            goto mod_error;
+        }
+        DYAD_LOG_INFO (mod_ctx->ctx, "DYAD_MOD: publishing the files written under %s in %s",
+                       mod_ctx->ctx->prod_managed_path, optargp);
+    }
     optparse_destroy (opts);
 
     DYAD_LOG_DEBUG (mod_ctx->ctx, "dyad module begins using \"%s\"\n", argv[optindex]);
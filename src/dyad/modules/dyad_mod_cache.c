@@ -0,0 +1,331 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/modules/dyad_mod_cache.h>
+#include <dyad/utils/murmur3.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+#include <cstring>
+#else
+#include <string.h>
+#endif
+
+#define DYAD_MOD_CACHE_NBUCKETS 4096ul
+
+// Frequency sketch used for admission: a count-min sketch of 8-bit counters
+// that are halved every DYAD_MOD_CACHE_SKETCH_PERIOD accesses, so that the
+// estimates favor recent accesses
+#define DYAD_MOD_CACHE_SKETCH_DEPTH 4u
+#define DYAD_MOD_CACHE_SKETCH_WIDTH 16384u
+#define DYAD_MOD_CACHE_SKETCH_PERIOD (10u * DYAD_MOD_CACHE_SKETCH_WIDTH)
+
+struct dyad_mod_cache_entry {
+    struct dyad_mod_cache_entry* prev;   // more recently used neighbor
+    struct dyad_mod_cache_entry* next;   // less recently used neighbor
+    struct dyad_mod_cache_entry* hnext;  // next entry in the hash bucket
+    uint32_t hash;                       // hash of upath
+    void* data;                          // contents of the file
+    void (*release) (void*, size_t);     // releases data (free if NULL)
+    void (*forget) (void*, void*);       // called on data before it is released
+    void* forget_arg;
+    size_t size;                         // size of the file in bytes
+    bool has_version;                    // whether version is known
+    struct dyad_mod_cache_version version;
+    unsigned int pins;                   // number of users of data
+    bool evicted;                        // freed once the last pin is released
+    char upath[];                        // path relative to the managed directory
+};
+
+struct dyad_mod_cache {
+    size_t capacity;                         // maximum number of bytes cached
+    size_t used;                             // bytes currently cached
+    struct dyad_mod_cache_entry** buckets;   // lookup by upath
+    struct dyad_mod_cache_entry* head;       // most recently used
+    struct dyad_mod_cache_entry* tail;       // least recently used
+    uint8_t* sketch;                         // access frequencies of the files looked up
+    uint32_t samples;                        // accesses since the last aging of the sketch
+    void (*forget) (void*, void*);           // given to the entries inserted
+    void* forget_arg;
+};
+
+static uint32_t mod_cache_hash (const char* upath)
+{
+    uint32_t hash = 0u;
+    MurmurHash3_x86_32 (upath, strlen (upath), 57u, &hash);
+    return hash;
+}
+
+static struct dyad_mod_cache_entry* mod_cache_find (const struct dyad_mod_cache* cache,
+                                                    const char* upath,
+                                                    uint32_t hash)
+{
+    struct dyad_mod_cache_entry* e = cache->buckets[hash % DYAD_MOD_CACHE_NBUCKETS];
+    for (; e != NULL; e = e->hnext) {
+        if (e->hash == hash && strcmp (e->upath, upath) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void mod_cache_lru_unlink (struct dyad_mod_cache* cache, struct dyad_mod_cache_entry* e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void mod_cache_lru_push (struct dyad_mod_cache* cache, struct dyad_mod_cache_entry* e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = e;
+    cache->head = e;
+    if (cache->tail == NULL)
+        cache->tail = e;
+}
+
+static void mod_cache_free (struct dyad_mod_cache_entry* e)
+{
+    if (e->forget != NULL)
+        e->forget (e->forget_arg, e->data);
+    if (e->release != NULL)
+        e->release (e->data, e->size);
+    else
+        free (e->data);
+    free (e);
+}
+
+static void mod_cache_evict (struct dyad_mod_cache* cache, struct dyad_mod_cache_entry* e)
+{
+    struct dyad_mod_cache_entry** pp = &(cache->buckets[e->hash % DYAD_MOD_CACHE_NBUCKETS]);
+    while (*pp != NULL && *pp != e)
+        pp = &((*pp)->hnext);
+    if (*pp == e)
+        *pp = e->hnext;
+    mod_cache_lru_unlink (cache, e);
+    cache->used -= e->size;
+    if (e->pins > 0u) {
+        // Still in use: the last release frees it
+        e->evicted = true;
+        return;
+    }
+    mod_cache_free (e);
+}
+
+static bool mod_cache_version_eq (const struct dyad_mod_cache_version* a,
+                                  const struct dyad_mod_cache_version* b)
+{
+    return a->ino == b->ino && a->size == b->size && a->mtime_sec == b->mtime_sec
+           && a->mtime_nsec == b->mtime_nsec;
+}
+
+static uint32_t mod_cache_sketch_index (uint32_t hash, unsigned int row)
+{
+    const uint32_t h2 = (hash * 0x9E3779B1u) | 1u;
+    return row * DYAD_MOD_CACHE_SKETCH_WIDTH + (hash + row * h2) % DYAD_MOD_CACHE_SKETCH_WIDTH;
+}
+
+static unsigned int mod_cache_sketch_estimate (const struct dyad_mod_cache* cache, uint32_t hash)
+{
+    unsigned int r = 0u;
+    unsigned int freq = UINT8_MAX;
+    for (r = 0u; r < DYAD_MOD_CACHE_SKETCH_DEPTH; r++) {
+        const unsigned int c = cache->sketch[mod_cache_sketch_index (hash, r)];
+        if (c < freq)
+            freq = c;
+    }
+    return freq;
+}
+
+static void mod_cache_sketch_increment (struct dyad_mod_cache* cache, uint32_t hash)
+{
+    unsigned int r = 0u;
+    uint32_t i = 0u;
+    const unsigned int freq = mod_cache_sketch_estimate (cache, hash);
+    // Conservative update: only the counters at the minimum are incremented
+    for (r = 0u; r < DYAD_MOD_CACHE_SKETCH_DEPTH && freq < UINT8_MAX; r++) {
+        i = mod_cache_sketch_index (hash, r);
+        if (cache->sketch[i] == freq)
+            cache->sketch[i]++;
+    }
+    if (++cache->samples >= DYAD_MOD_CACHE_SKETCH_PERIOD) {
+        for (i = 0u; i < DYAD_MOD_CACHE_SKETCH_DEPTH * DYAD_MOD_CACHE_SKETCH_WIDTH; i++)
+            cache->sketch[i] >>= 1;
+        cache->samples /= 2u;
+    }
+}
+
+dyad_rc_t dyad_mod_cache_create (size_t capacity, struct dyad_mod_cache** cache)
+{
+    if (cache == NULL)
+        return DYAD_RC_BADBUF;
+    *cache = (struct dyad_mod_cache*)calloc (1, sizeof (struct dyad_mod_cache));
+    if (*cache == NULL)
+        return DYAD_RC_SYSFAIL;
+    (*cache)->buckets = (struct dyad_mod_cache_entry**)calloc (DYAD_MOD_CACHE_NBUCKETS,
+                                                               sizeof (struct dyad_mod_cache_entry*));
+    (*cache)->sketch = (uint8_t*)calloc (DYAD_MOD_CACHE_SKETCH_DEPTH * DYAD_MOD_CACHE_SKETCH_WIDTH,
+                                         sizeof (uint8_t));
+    if ((*cache)->buckets == NULL || (*cache)->sketch == NULL) {
+        free ((*cache)->buckets);
+        free ((*cache)->sketch);
+        free (*cache);
+        *cache = NULL;
+        return DYAD_RC_SYSFAIL;
+    }
+    (*cache)->capacity = capacity;
+    return DYAD_RC_OK;
+}
+
+void dyad_mod_cache_destroy (struct dyad_mod_cache** cache)
+{
+    if (cache == NULL || *cache == NULL)
+        return;
+    while ((*cache)->tail != NULL)
+        mod_cache_evict (*cache, (*cache)->tail);
+    free ((*cache)->buckets);
+    free ((*cache)->sketch);
+    free (*cache);
+    *cache = NULL;
+}
+
+void dyad_mod_cache_set_forget (struct dyad_mod_cache* cache,
+                                void (*forget) (void* arg, void* data),
+                                void* arg)
+{
+    cache->forget = forget;
+    cache->forget_arg = arg;
+}
+
+bool dyad_mod_cache_lookup (struct dyad_mod_cache* cache,
+                            const char* upath,
+                            const struct dyad_mod_cache_version* version,
+                            const void** data,
+                            size_t* size,
+                            struct dyad_mod_cache_entry** pin)
+{
+    const uint32_t hash = mod_cache_hash (upath);
+    struct dyad_mod_cache_entry* e = mod_cache_find (cache, upath, hash);
+    mod_cache_sketch_increment (cache, hash);
+    if (e == NULL)
+        return false;
+    if (version != NULL && (!e->has_version || !mod_cache_version_eq (&e->version, version))) {
+        // The file changed since it was cached
+        mod_cache_evict (cache, e);
+        return false;
+    }
+    if (e != cache->head) {
+        mod_cache_lru_unlink (cache, e);
+        mod_cache_lru_push (cache, e);
+    }
+    *data = e->data;
+    *size = e->size;
+    if (pin != NULL) {
+        e->pins++;
+        *pin = e;
+    }
+    return true;
+}
+
+void dyad_mod_cache_release (struct dyad_mod_cache* cache, struct dyad_mod_cache_entry* pin)
+{
+    if (pin == NULL || pin->pins == 0u)
+        return;
+    if (--pin->pins == 0u && pin->evicted) {
+        mod_cache_free (pin);
+    }
+}
+
+bool dyad_mod_cache_pinned_version (const struct dyad_mod_cache_entry* pin,
+                                    struct dyad_mod_cache_version* version)
+{
+    // The version of an entry does not change while it is pinned
+    if (pin == NULL || !pin->has_version)
+        return false;
+    *version = pin->version;
+    return true;
+}
+
+bool dyad_mod_cache_admit (struct dyad_mod_cache* cache, const char* upath, size_t size)
+{
+    const uint32_t hash = mod_cache_hash (upath);
+    const struct dyad_mod_cache_entry* e = NULL;
+    unsigned int freq = 0u;
+    size_t freed = 0ul;
+
+    if (size > cache->capacity)
+        return false;
+    freq = mod_cache_sketch_estimate (cache, hash);
+    for (e = cache->tail; e != NULL && cache->used - freed + size > cache->capacity; e = e->prev) {
+        if (mod_cache_sketch_estimate (cache, e->hash) >= freq)
+            return false;
+        freed += e->size;
+    }
+    return true;
+}
+
+dyad_rc_t dyad_mod_cache_insert (struct dyad_mod_cache* cache,
+                                 const char* upath,
+                                 const struct dyad_mod_cache_version* version,
+                                 void* data,
+                                 size_t size)
+{
+    return dyad_mod_cache_insert_with (cache, upath, version, data, size, NULL);
+}
+
+dyad_rc_t dyad_mod_cache_insert_with (struct dyad_mod_cache* cache,
+                                      const char* upath,
+                                      const struct dyad_mod_cache_version* version,
+                                      void* data,
+                                      size_t size,
+                                      void (*release) (void* data, size_t size))
+{
+    const uint32_t hash = mod_cache_hash (upath);
+    const size_t upath_len = strlen (upath);
+    struct dyad_mod_cache_entry* e = NULL;
+
+    if (size > cache->capacity)
+        return DYAD_RC_BADBUF;
+    if ((e = mod_cache_find (cache, upath, hash)) != NULL)
+        mod_cache_evict (cache, e);
+    e = (struct dyad_mod_cache_entry*)calloc (1, sizeof (*e) + upath_len + 1);
+    if (e == NULL)
+        return DYAD_RC_SYSFAIL;
+    memcpy (e->upath, upath, upath_len + 1);
+    e->hash = hash;
+    e->data = data;
+    e->release = release;
+    e->forget = cache->forget;
+    e->forget_arg = cache->forget_arg;
+    e->size = size;
+    if (version != NULL) {
+        e->has_version = true;
+        e->version = *version;
+    }
+    while (cache->used + size > cache->capacity && cache->tail != NULL)
+        mod_cache_evict (cache, cache->tail);
+    e->hnext = cache->buckets[hash % DYAD_MOD_CACHE_NBUCKETS];
+    cache->buckets[hash % DYAD_MOD_CACHE_NBUCKETS] = e;
+    mod_cache_lru_push (cache, e);
+    cache->used += size;
+    return DYAD_RC_OK;
+}
+
+void dyad_mod_cache_remove (struct dyad_mod_cache* cache, const char* upath)
+{
+    struct dyad_mod_cache_entry* e = mod_cache_find (cache, upath, mod_cache_hash (upath));
+    if (e != NULL)
+        mod_cache_evict (cache, e);
+}
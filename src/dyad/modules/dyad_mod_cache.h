@@ -0,0 +1,158 @@
+#ifndef DYAD_MODULES_DYAD_MOD_CACHE_H
+#define DYAD_MODULES_DYAD_MOD_CACHE_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+#include <cstdint>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#endif
+
+/**
+ * In-memory cache of file contents held by the DYAD module, keyed by the path
+ * of a file relative to the managed directory. The cache owns the buffers
+ * inserted into it and evicts the least recently used ones once the total
+ * size exceeds its capacity. It is only accessed from the reactor thread.
+ */
+struct dyad_mod_cache;
+struct dyad_mod_cache_entry;
+
+/**
+ * Identifies the version of a file whose contents are cached. A lookup with a
+ * different version drops the stale contents.
+ */
+struct dyad_mod_cache_version {
+    uint64_t ino;        // inode number
+    uint64_t size;       // size in bytes
+    int64_t mtime_sec;   // last modification time
+    int64_t mtime_nsec;
+};
+
+/**
+ * @brief Create an empty cache
+ * @param[in]  capacity  maximum number of bytes of file contents kept
+ * @param[out] cache     the newly created cache
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mod_cache_create (size_t capacity, struct dyad_mod_cache** cache);
+
+/**
+ * @brief Release the cache and every buffer it holds
+ */
+void dyad_mod_cache_destroy (struct dyad_mod_cache** cache);
+
+/**
+ * @brief Have forget called with arg on the contents of the files inserted
+ *        from now on, right before they are released (e.g., to drop the DTL
+ *        registration of a buffer that was sent)
+ */
+void dyad_mod_cache_set_forget (struct dyad_mod_cache* cache,
+                                void (*forget) (void* arg, void* data),
+                                void* arg);
+
+/**
+ * @brief Look up a file and mark it as recently used
+ * @param[in]  cache    the cache
+ * @param[in]  upath    path of the file relative to the managed directory
+ * @param[in]  version  current version of the file, or NULL to accept any
+ *                      cached version
+ * @param[out] data     contents of the file, valid until the next insertion
+ *                      unless pinned
+ * @param[out] size     size of the file in bytes
+ * @param[out] pin      if not NULL, the entry is pinned: its contents stay
+ *                      valid, even once evicted, until dyad_mod_cache_release
+ *
+ * @return true if the file is in the cache
+ */
+bool dyad_mod_cache_lookup (struct dyad_mod_cache* cache,
+                            const char* upath,
+                            const struct dyad_mod_cache_version* version,
+                            const void** data,
+                            size_t* size,
+                            struct dyad_mod_cache_entry** pin);
+
+/**
+ * @brief Unpin an entry returned by dyad_mod_cache_lookup
+ */
+void dyad_mod_cache_release (struct dyad_mod_cache* cache, struct dyad_mod_cache_entry* pin);
+
+/**
+ * @brief Get the version of the file whose contents a pinned entry holds.
+ *        Unlike the other functions, it may be called from any thread.
+ * @param[in]  pin      entry returned by dyad_mod_cache_lookup
+ * @param[out] version  version the contents were read from
+ *
+ * @return true if the version is known
+ */
+bool dyad_mod_cache_pinned_version (const struct dyad_mod_cache_entry* pin,
+                                    struct dyad_mod_cache_version* version);
+
+/**
+ * @brief Decide whether a file that missed the cache is worth caching, based
+ *        on the accesses counted by dyad_mod_cache_lookup. A file is admitted if it fits in the free
+ *        space, or if it is accessed more often than every file it would
+ *        evict, so that files read once do not flush the frequently read
+ *        ones.
+ * @param[in] cache  the cache
+ * @param[in] upath  path of the file relative to the managed directory
+ * @param[in] size   size of the file in bytes
+ *
+ * @return true if the file should be inserted once read
+ */
+bool dyad_mod_cache_admit (struct dyad_mod_cache* cache, const char* upath, size_t size);
+
+/**
+ * @brief Insert (or replace) a file, evicting the least recently used files
+ *        as needed
+ * @param[in] cache  the cache
+ * @param[in] upath    path of the file relative to the managed directory
+ * @param[in] version  version of the file the contents were read from, or NULL
+ * @param[in] data     malloc'ed contents of the file. On success, the cache
+ *                     takes ownership of the buffer.
+ * @param[in] size     size of the file in bytes
+ *
+ * @return An error code from dyad_rc.h. DYAD_RC_BADBUF if the file is larger
+ *         than the capacity of the cache.
+ */
+dyad_rc_t dyad_mod_cache_insert (struct dyad_mod_cache* cache,
+                                 const char* upath,
+                                 const struct dyad_mod_cache_version* version,
+                                 void* data,
+                                 size_t size);
+
+/**
+ * @brief Same as dyad_mod_cache_insert, for contents that are not malloc'ed
+ *        (e.g., mapped memory)
+ * @param[in] release  called instead of free to release data once it is
+ *                     evicted and unpinned. On error, data is left to the
+ *                     caller.
+ */
+dyad_rc_t dyad_mod_cache_insert_with (struct dyad_mod_cache* cache,
+                                      const char* upath,
+                                      const struct dyad_mod_cache_version* version,
+                                      void* data,
+                                      size_t size,
+                                      void (*release) (void* data, size_t size));
+
+/**
+ * @brief Drop a file from the cache if it is there
+ */
+void dyad_mod_cache_remove (struct dyad_mod_cache* cache, const char* upath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_MODULES_DYAD_MOD_CACHE_H */
@@ -0,0 +1,355 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/modules/dyad_mod_fdcache.h>
+#include <dyad/utils/murmur3.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+#include <cerrno>
+#include <cstring>
+#else
+#include <errno.h>
+#include <string.h>
+#endif
+
+#define DYAD_MOD_FDCACHE_NBUCKETS 1024ul
+
+// Changes after which the cached descriptor no longer refers to the current
+// contents of the file. Unlinking or renaming over the file changes its link
+// count, which raises IN_ATTRIB.
+#define DYAD_MOD_FDCACHE_EVENTS                                                                    \
+    (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVE_SELF | IN_DELETE_SELF)
+
+struct dyad_mod_fdcache_entry {
+    struct dyad_mod_fdcache_entry* prev;   // more recently used neighbor
+    struct dyad_mod_fdcache_entry* next;   // less recently used neighbor
+    struct dyad_mod_fdcache_entry* hnext;  // next entry in the upath bucket
+    struct dyad_mod_fdcache_entry* wnext;  // next entry in the watch bucket
+    uint32_t hash;                         // hash of upath
+    int wd;                                // inotify watch of the file
+    int fd;                                // descriptor open for reading
+    struct dyad_mod_cache_version version;
+    unsigned int pins;                     // number of users of fd
+    bool evicted;                          // closed once the last pin is released
+    bool stale;                            // the version is unknown, never inserted
+    char upath[];                          // path relative to the managed directory
+};
+
+struct dyad_mod_fdcache {
+    unsigned int capacity;                       // maximum number of open files
+    unsigned int count;                          // files currently cached
+    struct dyad_mod_fdcache_entry** buckets;     // lookup by upath
+    struct dyad_mod_fdcache_entry** wbuckets;    // lookup by inotify watch
+    struct dyad_mod_fdcache_entry* head;         // most recently used
+    struct dyad_mod_fdcache_entry* tail;         // least recently used
+    unsigned long epoch;                         // changes reported so far
+    int ifd;                                     // inotify descriptor
+    flux_watcher_t* w;
+};
+
+static uint32_t fdcache_hash (const char* upath)
+{
+    uint32_t hash = 0u;
+    MurmurHash3_x86_32 (upath, strlen (upath), 57u, &hash);
+    return hash;
+}
+
+static void fdcache_lru_unlink (struct dyad_mod_fdcache* cache, struct dyad_mod_fdcache_entry* e)
+{
+    if (e->prev != NULL)
+        e->prev->next = e->next;
+    else
+        cache->head = e->next;
+    if (e->next != NULL)
+        e->next->prev = e->prev;
+    else
+        cache->tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static void fdcache_lru_push (struct dyad_mod_fdcache* cache, struct dyad_mod_fdcache_entry* e)
+{
+    e->prev = NULL;
+    e->next = cache->head;
+    if (cache->head != NULL)
+        cache->head->prev = e;
+    cache->head = e;
+    if (cache->tail == NULL)
+        cache->tail = e;
+}
+
+/// Whether a cached file uses a watch. Hard links to a file share its watch.
+static bool fdcache_watched (const struct dyad_mod_fdcache* cache, int wd)
+{
+    const struct dyad_mod_fdcache_entry* e =
+        cache->wbuckets[(unsigned int)wd % DYAD_MOD_FDCACHE_NBUCKETS];
+    for (; e != NULL; e = e->wnext) {
+        if (e->wd == wd)
+            return true;
+    }
+    return false;
+}
+
+/// Remove a watch no cached file uses. A file being opened by a worker may
+/// share it, so that file must not be inserted.
+static void fdcache_unwatch (struct dyad_mod_fdcache* cache, int wd)
+{
+    if (wd < 0 || fdcache_watched (cache, wd))
+        return;
+    inotify_rm_watch (cache->ifd, wd);
+    cache->epoch++;
+}
+
+static void fdcache_close (struct dyad_mod_fdcache_entry* e)
+{
+    close (e->fd);
+    free (e);
+}
+
+/// Drop an entry from the cache. Its descriptor is closed once unpinned.
+static void fdcache_evict (struct dyad_mod_fdcache* cache, struct dyad_mod_fdcache_entry* e)
+{
+    struct dyad_mod_fdcache_entry** pp = &(cache->buckets[e->hash % DYAD_MOD_FDCACHE_NBUCKETS]);
+
+    while (*pp != NULL && *pp != e)
+        pp = &((*pp)->hnext);
+    if (*pp == e)
+        *pp = e->hnext;
+    pp = &(cache->wbuckets[(unsigned int)e->wd % DYAD_MOD_FDCACHE_NBUCKETS]);
+    while (*pp != NULL && *pp != e)
+        pp = &((*pp)->wnext);
+    if (*pp == e)
+        *pp = e->wnext;
+    fdcache_unwatch (cache, e->wd);
+    fdcache_lru_unlink (cache, e);
+    cache->count--;
+    if (e->pins > 0u) {
+        e->evicted = true;
+        return;
+    }
+    fdcache_close (e);
+}
+
+/// Drop the files a watch refers to
+static void fdcache_invalidate (struct dyad_mod_fdcache* cache, int wd)
+{
+    struct dyad_mod_fdcache_entry* e = cache->wbuckets[(unsigned int)wd % DYAD_MOD_FDCACHE_NBUCKETS];
+    while (e != NULL) {
+        if (e->wd == wd) {
+            fdcache_evict (cache, e);
+            e = cache->wbuckets[(unsigned int)wd % DYAD_MOD_FDCACHE_NBUCKETS];
+        } else {
+            e = e->wnext;
+        }
+    }
+}
+
+/// Drop the files the pending inotify events are about
+static void fdcache_read_events (struct dyad_mod_fdcache* cache)
+{
+    char buf[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    const struct inotify_event* ev = NULL;
+    ssize_t len = 0;
+    char* p = NULL;
+
+    while ((len = read (cache->ifd, buf, sizeof (buf))) > 0) {
+        for (p = buf; p < buf + len; p += sizeof (struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event*)p;
+            // IN_IGNORED follows the removal of a watch, which was dropped then
+            if (!(ev->mask & IN_IGNORED)) {
+                cache->epoch++;
+                fdcache_invalidate (cache, ev->wd);
+            }
+        }
+    }
+}
+
+static void fdcache_inotify_cb (flux_reactor_t* r, flux_watcher_t* w, int revents, void* arg)
+{
+    fdcache_read_events ((struct dyad_mod_fdcache*)arg);
+}
+
+dyad_rc_t dyad_mod_fdcache_create (flux_t* h, unsigned int capacity, struct dyad_mod_fdcache** cache)
+{
+    if (cache == NULL || capacity == 0u)
+        return DYAD_RC_BADBUF;
+    *cache = (struct dyad_mod_fdcache*)calloc (1, sizeof (struct dyad_mod_fdcache));
+    if (*cache == NULL)
+        return DYAD_RC_SYSFAIL;
+    (*cache)->capacity = capacity;
+    (*cache)->ifd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    (*cache)->buckets = (struct dyad_mod_fdcache_entry**)calloc (
+        DYAD_MOD_FDCACHE_NBUCKETS, sizeof (struct dyad_mod_fdcache_entry*));
+    (*cache)->wbuckets = (struct dyad_mod_fdcache_entry**)calloc (
+        DYAD_MOD_FDCACHE_NBUCKETS, sizeof (struct dyad_mod_fdcache_entry*));
+    if ((*cache)->ifd < 0 || (*cache)->buckets == NULL || (*cache)->wbuckets == NULL)
+        goto fdcache_create_error;
+    (*cache)->w = flux_fd_watcher_create (flux_get_reactor (h), (*cache)->ifd, FLUX_POLLIN,
+                                          fdcache_inotify_cb, *cache);
+    if ((*cache)->w == NULL)
+        goto fdcache_create_error;
+    flux_watcher_start ((*cache)->w);
+    return DYAD_RC_OK;
+
+fdcache_create_error:;
+    if ((*cache)->ifd >= 0)
+        close ((*cache)->ifd);
+    free ((*cache)->buckets);
+    free ((*cache)->wbuckets);
+    free (*cache);
+    *cache = NULL;
+    return DYAD_RC_SYSFAIL;
+}
+
+void dyad_mod_fdcache_destroy (struct dyad_mod_fdcache** cache)
+{
+    if (cache == NULL || *cache == NULL)
+        return;
+    while ((*cache)->tail != NULL)
+        fdcache_evict (*cache, (*cache)->tail);
+    flux_watcher_destroy ((*cache)->w);
+    close ((*cache)->ifd);
+    free ((*cache)->buckets);
+    free ((*cache)->wbuckets);
+    free (*cache);
+    *cache = NULL;
+}
+
+/// Find a cached file
+static struct dyad_mod_fdcache_entry* fdcache_find (const struct dyad_mod_fdcache* cache,
+                                                    const char* upath,
+                                                    uint32_t hash)
+{
+    struct dyad_mod_fdcache_entry* e = cache->buckets[hash % DYAD_MOD_FDCACHE_NBUCKETS];
+    for (; e != NULL; e = e->hnext) {
+        if (e->hash == hash && strcmp (e->upath, upath) == 0)
+            break;
+    }
+    return e;
+}
+
+bool dyad_mod_fdcache_get (struct dyad_mod_fdcache* cache,
+                           const char* upath,
+                           int* fd,
+                           struct dyad_mod_cache_version* version,
+                           struct dyad_mod_fdcache_entry** pin)
+{
+    struct dyad_mod_fdcache_entry* e = NULL;
+
+    // A file changed before this call is dropped even if the reactor has not
+    // run the inotify watcher yet
+    fdcache_read_events (cache);
+    if ((e = fdcache_find (cache, upath, fdcache_hash (upath))) == NULL)
+        return false;
+    if (e != cache->head) {
+        fdcache_lru_unlink (cache, e);
+        fdcache_lru_push (cache, e);
+    }
+    e->pins++;
+    *fd = e->fd;
+    *version = e->version;
+    *pin = e;
+    return true;
+}
+
+unsigned long dyad_mod_fdcache_epoch (const struct dyad_mod_fdcache* cache)
+{
+    return cache->epoch;
+}
+
+bool dyad_mod_fdcache_open (struct dyad_mod_fdcache* cache,
+                            const char* upath,
+                            const char* fullpath,
+                            int* fd,
+                            struct dyad_mod_cache_version* version,
+                            struct dyad_mod_fdcache_entry** entry)
+{
+    const size_t upath_len = strlen (upath);
+    struct dyad_mod_fdcache_entry* e = NULL;
+    struct flock lock;
+    struct stat st;
+
+    *entry = NULL;
+    e = (struct dyad_mod_fdcache_entry*)calloc (1, sizeof (*e) + upath_len + 1);
+    if (e == NULL)
+        return false;
+    if ((e->fd = open (fullpath, O_RDONLY | O_CLOEXEC)) < 0) {
+        free (e);
+        return false;
+    }
+    memcpy (e->upath, upath, upath_len + 1);
+    e->hash = fdcache_hash (upath);
+    e->wd = -1;
+    e->stale = true;
+    *entry = e;
+    // Wait for the producer to release its write lock
+    memset (&lock, 0, sizeof (lock));
+    lock.l_type = F_RDLCK;
+    lock.l_whence = SEEK_SET;
+    while (fcntl (e->fd, F_SETLKW, &lock) < 0) {
+        if (errno != EINTR)
+            return false;
+    }
+    // Watch before stat'ing, so that no change goes unnoticed. Only the
+    // reactor knows whether another cached file shares the watch, so a watch
+    // that is not used in the end is removed by dyad_mod_fdcache_insert.
+    e->wd = inotify_add_watch (cache->ifd, fullpath, DYAD_MOD_FDCACHE_EVENTS);
+    if (e->wd >= 0 && fstat (e->fd, &st) == 0) {
+        e->version.ino = (uint64_t)st.st_ino;
+        e->version.size = (uint64_t)st.st_size;
+        e->version.mtime_sec = (int64_t)st.st_mtim.tv_sec;
+        e->version.mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+        e->stale = false;
+    }
+    lock.l_type = F_UNLCK;
+    fcntl (e->fd, F_SETLK, &lock);
+    if (e->stale)
+        return false;
+    // Warm the page cache before the data is first sent
+    posix_fadvise (e->fd, 0, 0, POSIX_FADV_WILLNEED);
+    *fd = e->fd;
+    *version = e->version;
+    return true;
+}
+
+void dyad_mod_fdcache_insert (struct dyad_mod_fdcache* cache,
+                              struct dyad_mod_fdcache_entry* entry,
+                              unsigned long epoch)
+{
+    struct dyad_mod_fdcache_entry* e = entry;
+
+    if (e == NULL)
+        return;
+    // Apply the changes reported while the file was being opened
+    fdcache_read_events (cache);
+    if (e->stale || cache->epoch != epoch || fdcache_find (cache, e->upath, e->hash) != NULL) {
+        fdcache_unwatch (cache, e->wd);
+        fdcache_close (e);
+        return;
+    }
+    e->hnext = cache->buckets[e->hash % DYAD_MOD_FDCACHE_NBUCKETS];
+    cache->buckets[e->hash % DYAD_MOD_FDCACHE_NBUCKETS] = e;
+    e->wnext = cache->wbuckets[(unsigned int)e->wd % DYAD_MOD_FDCACHE_NBUCKETS];
+    cache->wbuckets[(unsigned int)e->wd % DYAD_MOD_FDCACHE_NBUCKETS] = e;
+    fdcache_lru_push (cache, e);
+    cache->count++;
+    while (cache->count > cache->capacity && cache->tail != e)
+        fdcache_evict (cache, cache->tail);
+}
+
+void dyad_mod_fdcache_release (struct dyad_mod_fdcache* cache, struct dyad_mod_fdcache_entry* pin)
+{
+    if (pin == NULL || pin->pins == 0u)
+        return;
+    if (--pin->pins == 0u && pin->evicted)
+        fdcache_close (pin);
+}
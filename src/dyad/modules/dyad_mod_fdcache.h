@@ -0,0 +1,122 @@
+#ifndef DYAD_MODULES_DYAD_MOD_FDCACHE_H
+#define DYAD_MODULES_DYAD_MOD_FDCACHE_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <dyad/modules/dyad_mod_cache.h>
+#include <flux/core.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+/**
+ * Cache of open file descriptors to the files served by the DYAD module,
+ * keyed by the path of a file relative to the managed directory, so that
+ * fetches of a file after the first one skip opening, locking and stat'ing
+ * it. Each cached file is watched with inotify and dropped as soon as it is
+ * modified, truncated, renamed or unlinked. Once the capacity is reached,
+ * the least recently used file is closed. The cache is only accessed from the
+ * reactor thread, except for dyad_mod_fdcache_open, which opens files for it
+ * from the worker threads. The descriptors it hands out may be read from any
+ * thread while pinned, under a shared lock on the file.
+ */
+struct dyad_mod_fdcache;
+struct dyad_mod_fdcache_entry;
+
+/**
+ * @brief Create an empty cache and watch its inotify descriptor on the reactor
+ *        of h
+ * @param[in]  h         the Flux handle of the module
+ * @param[in]  capacity  maximum number of open files kept
+ * @param[out] cache     the newly created cache
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mod_fdcache_create (flux_t* h, unsigned int capacity, struct dyad_mod_fdcache** cache);
+
+/**
+ * @brief Close every file of the cache and release it. The files still
+ *        pinned are closed by their last release.
+ */
+void dyad_mod_fdcache_destroy (struct dyad_mod_fdcache** cache);
+
+/**
+ * @brief Get an open descriptor to a cached file and pin it. The changes to
+ *        the files reported so far are applied first, so that the version
+ *        is current.
+ * @param[in]  cache     the cache
+ * @param[in]  upath     path of the file relative to the managed directory
+ * @param[out] fd        descriptor open for reading, valid until released
+ * @param[out] version   version of the file the descriptor refers to
+ * @param[out] pin       the entry to pass to dyad_mod_fdcache_release
+ *
+ * @return true if fd is valid. Otherwise the file is not cached, and the
+ *         caller can open it with dyad_mod_fdcache_open.
+ */
+bool dyad_mod_fdcache_get (struct dyad_mod_fdcache* cache,
+                           const char* upath,
+                           int* fd,
+                           struct dyad_mod_cache_version* version,
+                           struct dyad_mod_fdcache_entry** pin);
+
+/**
+ * @brief Number of changes to the cached files reported so far. A file
+ *        opened with dyad_mod_fdcache_open after reading this number is only
+ *        inserted if no change is reported in the meantime.
+ */
+unsigned long dyad_mod_fdcache_epoch (const struct dyad_mod_fdcache* cache);
+
+/**
+ * @brief Open a file for the cache and watch it, waiting for its producer to
+ *        be done writing it. The kernel is asked to read the file ahead. Can
+ *        be called from any thread.
+ * @param[in]  cache     the cache
+ * @param[in]  upath     path of the file relative to the managed directory
+ * @param[in]  fullpath  path of the file
+ * @param[out] fd        descriptor open for reading, valid until inserted
+ * @param[out] version   version of the file the descriptor refers to
+ * @param[out] entry     the entry to pass to dyad_mod_fdcache_insert, or
+ *                       NULL if there is none
+ *
+ * @return true if fd is valid
+ */
+bool dyad_mod_fdcache_open (struct dyad_mod_fdcache* cache,
+                            const char* upath,
+                            const char* fullpath,
+                            int* fd,
+                            struct dyad_mod_cache_version* version,
+                            struct dyad_mod_fdcache_entry** entry);
+
+/**
+ * @brief Insert a file opened by dyad_mod_fdcache_open, once its descriptor
+ *        is no longer used. The file is closed instead if a change to the
+ *        cached files was reported since epoch, as it may be about this one,
+ *        or if it is already cached.
+ * @param[in]  cache  the cache
+ * @param[in]  entry  the entry returned by dyad_mod_fdcache_open
+ * @param[in]  epoch  dyad_mod_fdcache_epoch before the file was opened
+ */
+void dyad_mod_fdcache_insert (struct dyad_mod_fdcache* cache,
+                              struct dyad_mod_fdcache_entry* entry,
+                              unsigned long epoch);
+
+/**
+ * @brief Unpin an entry returned by dyad_mod_fdcache_get
+ */
+void dyad_mod_fdcache_release (struct dyad_mod_fdcache* cache, struct dyad_mod_fdcache_entry* pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_MODULES_DYAD_MOD_FDCACHE_H */
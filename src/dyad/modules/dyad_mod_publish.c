@@ -0,0 +1,332 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif  // _GNU_SOURCE
+#include <dyad/common/dyad_logging.h>
+#include <dyad/modules/dyad_mod_publish.h>
+#include <dyad/utils/utils.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <jansson.h>
+#include <stdlib.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#else
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#endif
+
+#define DYAD_MOD_PUBLISH_NBUCKETS 1024ul
+// Largest number of files published by one transaction
+#define DYAD_MOD_PUBLISH_MAX_BATCH 1024u
+
+// Events of a watched directory: a file closed after being written, or moved
+// in, is complete. Subdirectories are watched as soon as they appear.
+#define DYAD_MOD_PUBLISH_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR)
+
+/* A watched directory */
+struct dyad_mod_publish_dir {
+    struct dyad_mod_publish_dir* next;  // next directory in the bucket
+    int wd;                             // inotify watch of the directory
+    char rel[];                         // path relative to the root ("" for the root)
+};
+
+struct dyad_mod_publish {
+    flux_t* h;
+    char* root;                                // producer-managed directory
+    char* ns;                                  // KVS namespace
+    uint32_t rank;                             // owner of the published files
+    unsigned int key_depth;
+    unsigned int key_bins;
+    int ifd;                                   // inotify descriptor
+    flux_watcher_t* w;
+    struct dyad_mod_publish_dir** buckets;     // watched directories by watch
+    flux_kvs_txn_t* txn;                       // files waiting to be published
+    unsigned int batched;                      // number of files in txn
+};
+
+static struct dyad_mod_publish_dir* publish_dir_find (const struct dyad_mod_publish* pub, int wd)
+{
+    struct dyad_mod_publish_dir* d = pub->buckets[(unsigned int)wd % DYAD_MOD_PUBLISH_NBUCKETS];
+    for (; d != NULL; d = d->next) {
+        if (d->wd == wd)
+            return d;
+    }
+    return NULL;
+}
+
+static void publish_dir_remove (struct dyad_mod_publish* pub, int wd)
+{
+    struct dyad_mod_publish_dir** pp = &(pub->buckets[(unsigned int)wd % DYAD_MOD_PUBLISH_NBUCKETS]);
+    struct dyad_mod_publish_dir* d = NULL;
+    while (*pp != NULL && (*pp)->wd != wd)
+        pp = &((*pp)->next);
+    if ((d = *pp) != NULL) {
+        *pp = d->next;
+        free (d);
+    }
+}
+
+/// Join a path relative to the root and a name
+static bool publish_join (const char* rel, const char* name, char* path, size_t len)
+{
+    int n = (rel[0] == '\0') ? snprintf (path, len, "%s", name)
+                             : snprintf (path, len, "%s" DYAD_PATH_DELIM "%s", rel, name);
+    return (n >= 0 && (size_t)n < len);
+}
+
+static void publish_commit_cb (flux_future_t* f, void* arg)
+{
+    struct dyad_mod_publish* pub = (struct dyad_mod_publish*)arg;
+    if (flux_future_get (f, NULL) < 0) {
+        DYAD_LOG_ERROR (pub, "DYAD_MOD: cannot publish files: %s", flux_future_error_string (f));
+    }
+    flux_future_destroy (f);
+}
+
+/// Commit the files batched so far, without waiting for the KVS
+static void publish_flush (struct dyad_mod_publish* pub)
+{
+    flux_future_t* f = NULL;
+    if (pub->txn == NULL) {
+        return;
+    }
+    if ((f = flux_kvs_commit (pub->h, pub->ns, 0, pub->txn)) == NULL
+        || flux_future_then (f, -1.0, publish_commit_cb, pub) < 0) {
+        DYAD_LOG_ERROR (pub, "DYAD_MOD: cannot commit %u files to the KVS", pub->batched);
+        flux_future_destroy (f);
+    }
+    flux_kvs_txn_destroy (pub->txn);
+    pub->txn = NULL;
+    pub->batched = 0u;
+}
+
+/// Add a file to the current transaction, as dyad_produce would publish it
+static void publish_file (struct dyad_mod_publish* pub, const char* upath, const struct stat* st)
+{
+    char key[PATH_MAX + 1] = {'\0'};
+    if (gen_path_key (upath, key, PATH_MAX, pub->key_depth, pub->key_bins) < 0) {
+        return;
+    }
+    if (pub->txn == NULL && (pub->txn = flux_kvs_txn_create ()) == NULL) {
+        return;
+    }
+    if (flux_kvs_txn_pack (pub->txn, 0, key, "{s:i, s:I, s:I}", "rank", (int)pub->rank, "size",
+                           (json_int_t)st->st_size, "version",
+                           (json_int_t)get_file_version (st))
+        < 0) {
+        DYAD_LOG_ERROR (pub, "DYAD_MOD: cannot publish %s", upath);
+        return;
+    }
+    DYAD_LOG_DEBUG (pub, "DYAD_MOD: publishing %s", upath);
+    if (++pub->batched >= DYAD_MOD_PUBLISH_MAX_BATCH) {
+        publish_flush (pub);
+    }
+}
+
+/// Whether a file is still open for writing by some process: a read lease
+/// cannot be taken on it then. If leases are not permitted, the file is
+/// assumed to be complete.
+static bool publish_file_busy (const char* path)
+{
+    bool busy = false;
+    int fd = open (path, O_RDONLY | O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0) {
+        return true;
+    }
+    if (fcntl (fd, F_SETLEASE, F_RDLCK) == 0) {
+        fcntl (fd, F_SETLEASE, F_UNLCK);
+    } else if (errno == EAGAIN) {
+        busy = true;
+    }
+    close (fd);
+    return busy;
+}
+
+/// Watch a directory and, recursively, its subdirectories. With scan set,
+/// the files already in them are published too, unless they are still being
+/// written, in which case their watch reports them once closed. Returns
+/// whether the directory itself is watched.
+static bool publish_watch_tree (struct dyad_mod_publish* pub, const char* rel, bool scan)
+{
+    char path[PATH_MAX + 1] = {'\0'};
+    char child[PATH_MAX + 1] = {'\0'};
+    char full[PATH_MAX + 1] = {'\0'};
+    struct dyad_mod_publish_dir* d = NULL;
+    struct dirent* ent = NULL;
+    struct stat st;
+    DIR* dir = NULL;
+    int wd = -1;
+
+    if (!publish_join (pub->root, rel, path, sizeof (path))) {
+        return false;
+    }
+    if ((wd = inotify_add_watch (pub->ifd, path, DYAD_MOD_PUBLISH_EVENTS)) < 0) {
+        DYAD_LOG_ERROR (pub, "DYAD_MOD: cannot watch %s: %s", path, strerror (errno));
+        return false;
+    }
+    if (publish_dir_find (pub, wd) == NULL) {
+        d = (struct dyad_mod_publish_dir*)calloc (1, sizeof (*d) + strlen (rel) + 1);
+        if (d == NULL) {
+            inotify_rm_watch (pub->ifd, wd);
+            return false;
+        }
+        d->wd = wd;
+        strcpy (d->rel, rel);
+        d->next = pub->buckets[(unsigned int)wd % DYAD_MOD_PUBLISH_NBUCKETS];
+        pub->buckets[(unsigned int)wd % DYAD_MOD_PUBLISH_NBUCKETS] = d;
+    }
+    // Look for the entries created before the watch
+    if ((dir = opendir (path)) == NULL) {
+        return true;
+    }
+    while ((ent = readdir (dir)) != NULL) {
+        if (strcmp (ent->d_name, ".") == 0 || strcmp (ent->d_name, "..") == 0)
+            continue;
+        if (!publish_join (rel, ent->d_name, child, sizeof (child))
+            || fstatat (dirfd (dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0)
+            continue;
+        if (S_ISDIR (st.st_mode)) {
+            publish_watch_tree (pub, child, scan);
+        } else if (scan && S_ISREG (st.st_mode)) {
+            if (publish_join (pub->root, child, full, sizeof (full)) && !publish_file_busy (full))
+                publish_file (pub, child, &st);
+        }
+    }
+    closedir (dir);
+    return true;
+}
+
+static void publish_event (struct dyad_mod_publish* pub, const struct inotify_event* ev)
+{
+    char upath[PATH_MAX + 1] = {'\0'};
+    char path[PATH_MAX + 1] = {'\0'};
+    const struct dyad_mod_publish_dir* d = NULL;
+    struct stat st;
+
+    if (ev->mask & IN_Q_OVERFLOW) {
+        DYAD_LOG_ERROR (pub, "DYAD_MOD: inotify queue overflow, some files were not published");
+        return;
+    }
+    if (ev->mask & IN_IGNORED) {
+        // The directory is gone
+        publish_dir_remove (pub, ev->wd);
+        return;
+    }
+    if ((d = publish_dir_find (pub, ev->wd)) == NULL || ev->len == 0u
+        || !publish_join (d->rel, ev->name, upath, sizeof (upath))) {
+        return;
+    }
+    if (ev->mask & IN_ISDIR) {
+        // Files may have been written into the directory before its watch
+        if (ev->mask & (IN_CREATE | IN_MOVED_TO))
+            publish_watch_tree (pub, upath, true);
+        return;
+    }
+    if (!(ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))) {
+        return;
+    }
+    if (!publish_join (pub->root, upath, path, sizeof (path)) || stat (path, &st) < 0
+        || !S_ISREG (st.st_mode)) {
+        return;
+    }
+    publish_file (pub, upath, &st);
+}
+
+static void publish_inotify_cb (flux_reactor_t* r, flux_watcher_t* w, int revents, void* arg)
+{
+    struct dyad_mod_publish* pub = (struct dyad_mod_publish*)arg;
+    char buf[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    const struct inotify_event* ev = NULL;
+    ssize_t len = 0;
+    char* p = NULL;
+
+    while ((len = read (pub->ifd, buf, sizeof (buf))) > 0) {
+        for (p = buf; p < buf + len; p += sizeof (struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event*)p;
+            publish_event (pub, ev);
+        }
+    }
+    // Publish everything found in this wakeup at once
+    publish_flush (pub);
+}
+
+dyad_rc_t dyad_mod_publish_create (flux_t* h,
+                                   const char* root,
+                                   const char* ns,
+                                   uint32_t rank,
+                                   unsigned int key_depth,
+                                   unsigned int key_bins,
+                                   struct dyad_mod_publish** pub)
+{
+    if (pub == NULL || root == NULL || ns == NULL || key_bins == 0u)
+        return DYAD_RC_BADBUF;
+    *pub = (struct dyad_mod_publish*)calloc (1, sizeof (struct dyad_mod_publish));
+    if (*pub == NULL)
+        return DYAD_RC_SYSFAIL;
+    (*pub)->h = h;
+    (*pub)->rank = rank;
+    (*pub)->key_depth = key_depth;
+    (*pub)->key_bins = key_bins;
+    (*pub)->root = strdup (root);
+    (*pub)->ns = strdup (ns);
+    (*pub)->ifd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    (*pub)->buckets = (struct dyad_mod_publish_dir**)calloc (DYAD_MOD_PUBLISH_NBUCKETS,
+                                                             sizeof (struct dyad_mod_publish_dir*));
+    if ((*pub)->root == NULL || (*pub)->ns == NULL || (*pub)->ifd < 0 || (*pub)->buckets == NULL) {
+        dyad_mod_publish_destroy (pub);
+        return DYAD_RC_SYSFAIL;
+    }
+    // Files written before the module was loaded are left to their producer
+    if (!publish_watch_tree (*pub, "", false)) {
+        dyad_mod_publish_destroy (pub);
+        return DYAD_RC_BADMANAGEDPATH;
+    }
+    (*pub)->w = flux_fd_watcher_create (flux_get_reactor (h), (*pub)->ifd, FLUX_POLLIN,
+                                        publish_inotify_cb, *pub);
+    if ((*pub)->w == NULL) {
+        dyad_mod_publish_destroy (pub);
+        return DYAD_RC_FLUXFAIL;
+    }
+    flux_watcher_start ((*pub)->w);
+    return DYAD_RC_OK;
+}
+
+void dyad_mod_publish_destroy (struct dyad_mod_publish** pub)
+{
+    struct dyad_mod_publish_dir* d = NULL;
+    size_t b = 0ul;
+    if (pub == NULL || *pub == NULL)
+        return;
+    flux_watcher_destroy ((*pub)->w);
+    if ((*pub)->txn != NULL)
+        flux_kvs_txn_destroy ((*pub)->txn);
+    if ((*pub)->ifd >= 0)
+        close ((*pub)->ifd);
+    if ((*pub)->buckets != NULL) {
+        for (b = 0ul; b < DYAD_MOD_PUBLISH_NBUCKETS; b++) {
+            while ((d = (*pub)->buckets[b]) != NULL) {
+                (*pub)->buckets[b] = d->next;
+                free (d);
+            }
+        }
+        free ((*pub)->buckets);
+    }
+    free ((*pub)->root);
+    free ((*pub)->ns);
+    free (*pub);
+    *pub = NULL;
+}
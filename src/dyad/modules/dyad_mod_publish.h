@@ -0,0 +1,61 @@
+#ifndef DYAD_MODULES_DYAD_MOD_PUBLISH_H
+#define DYAD_MODULES_DYAD_MOD_PUBLISH_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <flux/core.h>
+
+#ifdef __cplusplus
+#include <cstdint>
+extern "C" {
+#else
+#include <stdint.h>
+#endif
+
+/**
+ * Publication of the files written under the producer-managed directory by
+ * the DYAD module itself, so that producers need neither the interposition
+ * library nor calls to dyad_produce. The directory is watched recursively
+ * with inotify, and every file closed after being written, or moved into the
+ * directory, is published in the KVS the same way dyad_produce does. The
+ * files found in one wakeup of the reactor are published by a single KVS
+ * transaction.
+ */
+struct dyad_mod_publish;
+
+/**
+ * @brief Start watching a directory and its subdirectories
+ * @param[in]  h          the Flux handle of the module
+ * @param[in]  root       the producer-managed directory
+ * @param[in]  ns         the KVS namespace the files are published in
+ * @param[in]  rank       the rank published as the owner of the files
+ * @param[in]  key_depth  the number of levels of the KVS keys
+ * @param[in]  key_bins   the number of bins of each level of the KVS keys
+ * @param[out] pub        the newly created publisher
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mod_publish_create (flux_t* h,
+                                   const char* root,
+                                   const char* ns,
+                                   uint32_t rank,
+                                   unsigned int key_depth,
+                                   unsigned int key_bins,
+                                   struct dyad_mod_publish** pub);
+
+/**
+ * @brief Stop watching and release the publisher. Transactions under way
+ *        are left to complete on their own.
+ */
+void dyad_mod_publish_destroy (struct dyad_mod_publish** pub);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_MODULES_DYAD_MOD_PUBLISH_H */
@@ -0,0 +1,201 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/modules/dyad_mod_sched.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+#include <cstring>
+#else
+#include <string.h>
+#endif
+
+// Upper bounds of the size classes. Larger jobs go to the last class.
+static const size_t dyad_mod_sched_class_max[] = {64ul << 10, 1ul << 20, 16ul << 20};
+#define DYAD_MOD_SCHED_NCLASSES 4u
+// Number of times in a row a non-empty class can be passed over
+#define DYAD_MOD_SCHED_MAX_SKIPS 8u
+
+struct dyad_mod_sched_item {
+    struct dyad_mod_sched_item* next;
+    size_t size;
+    void* job;
+};
+
+/* The jobs of one consumer in one class */
+struct dyad_mod_sched_consumer {
+    struct dyad_mod_sched_consumer* next;  // next consumer in turn
+    struct dyad_mod_sched_item* head;
+    struct dyad_mod_sched_item* tail;
+    char id[];
+};
+
+struct dyad_mod_sched_class {
+    struct dyad_mod_sched_consumer* head;  // consumer served next
+    struct dyad_mod_sched_consumer* tail;
+    unsigned int skips;                    // times passed over in a row
+};
+
+struct dyad_mod_sched {
+    struct dyad_mod_sched_class classes[DYAD_MOD_SCHED_NCLASSES];
+    unsigned int count;
+};
+
+static unsigned int sched_class_of (size_t size)
+{
+    unsigned int c = 0u;
+    while (c < DYAD_MOD_SCHED_NCLASSES - 1u && size > dyad_mod_sched_class_max[c])
+        c++;
+    return c;
+}
+
+/// Pick the class to serve next, or -1 if the queue is empty
+static int sched_select (const struct dyad_mod_sched* sched)
+{
+    int first = -1;
+    int c = 0;
+    for (c = DYAD_MOD_SCHED_NCLASSES - 1; c >= 0; c--) {
+        if (sched->classes[c].head == NULL)
+            continue;
+        if (sched->classes[c].skips >= DYAD_MOD_SCHED_MAX_SKIPS)
+            return c;
+        first = c;
+    }
+    return first;
+}
+
+dyad_rc_t dyad_mod_sched_create (struct dyad_mod_sched** sched)
+{
+    if (sched == NULL)
+        return DYAD_RC_BADBUF;
+    *sched = (struct dyad_mod_sched*)calloc (1, sizeof (struct dyad_mod_sched));
+    if (*sched == NULL)
+        return DYAD_RC_SYSFAIL;
+    return DYAD_RC_OK;
+}
+
+void dyad_mod_sched_destroy (struct dyad_mod_sched** sched)
+{
+    struct dyad_mod_sched_consumer* cons = NULL;
+    struct dyad_mod_sched_item* it = NULL;
+    unsigned int c = 0u;
+    if (sched == NULL || *sched == NULL)
+        return;
+    for (c = 0u; c < DYAD_MOD_SCHED_NCLASSES; c++) {
+        while ((cons = (*sched)->classes[c].head) != NULL) {
+            (*sched)->classes[c].head = cons->next;
+            while ((it = cons->head) != NULL) {
+                cons->head = it->next;
+                free (it);
+            }
+            free (cons);
+        }
+    }
+    free (*sched);
+    *sched = NULL;
+}
+
+dyad_rc_t dyad_mod_sched_push (struct dyad_mod_sched* sched,
+                               const char* consumer,
+                               size_t size,
+                               void* job)
+{
+    struct dyad_mod_sched_class* cl = &(sched->classes[sched_class_of (size)]);
+    struct dyad_mod_sched_consumer* cons = NULL;
+    struct dyad_mod_sched_item* it = NULL;
+    size_t id_len = 0ul;
+
+    if (consumer == NULL)
+        consumer = "";
+    for (cons = cl->head; cons != NULL; cons = cons->next) {
+        if (strcmp (cons->id, consumer) == 0)
+            break;
+    }
+    it = (struct dyad_mod_sched_item*)malloc (sizeof (*it));
+    if (it == NULL)
+        return DYAD_RC_SYSFAIL;
+    it->next = NULL;
+    it->size = size;
+    it->job = job;
+    if (cons == NULL) {
+        // The consumer has no job in this class: it is served last
+        id_len = strlen (consumer);
+        cons = (struct dyad_mod_sched_consumer*)calloc (1, sizeof (*cons) + id_len + 1);
+        if (cons == NULL) {
+            free (it);
+            return DYAD_RC_SYSFAIL;
+        }
+        memcpy (cons->id, consumer, id_len + 1);
+        if (cl->tail != NULL)
+            cl->tail->next = cons;
+        else
+            cl->head = cons;
+        cl->tail = cons;
+    }
+    if (cons->tail != NULL)
+        cons->tail->next = it;
+    else
+        cons->head = it;
+    cons->tail = it;
+    sched->count++;
+    return DYAD_RC_OK;
+}
+
+bool dyad_mod_sched_peek (const struct dyad_mod_sched* sched, size_t* size)
+{
+    const int c = sched_select (sched);
+    if (c < 0)
+        return false;
+    *size = sched->classes[c].head->head->size;
+    return true;
+}
+
+void* dyad_mod_sched_pop (struct dyad_mod_sched* sched)
+{
+    const int c = sched_select (sched);
+    struct dyad_mod_sched_class* cl = NULL;
+    struct dyad_mod_sched_consumer* cons = NULL;
+    struct dyad_mod_sched_item* it = NULL;
+    void* job = NULL;
+    unsigned int i = 0u;
+
+    if (c < 0)
+        return NULL;
+    for (i = 0u; i < DYAD_MOD_SCHED_NCLASSES; i++) {
+        if (sched->classes[i].head != NULL)
+            sched->classes[i].skips++;
+    }
+    cl = &(sched->classes[c]);
+    cl->skips = 0u;
+    cons = cl->head;
+    it = cons->head;
+    cons->head = it->next;
+    if (cons->head == NULL)
+        cons->tail = NULL;
+    // The consumer goes to the back of the line, or leaves it
+    cl->head = cons->next;
+    if (cl->head == NULL)
+        cl->tail = NULL;
+    cons->next = NULL;
+    if (cons->head != NULL) {
+        if (cl->tail != NULL)
+            cl->tail->next = cons;
+        else
+            cl->head = cons;
+        cl->tail = cons;
+    } else {
+        free (cons);
+    }
+    job = it->job;
+    free (it);
+    sched->count--;
+    return job;
+}
+
+unsigned int dyad_mod_sched_count (const struct dyad_mod_sched* sched)
+{
+    return (sched == NULL) ? 0u : sched->count;
+}
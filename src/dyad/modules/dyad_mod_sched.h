@@ -0,0 +1,79 @@
+#ifndef DYAD_MODULES_DYAD_MOD_SCHED_H
+#define DYAD_MODULES_DYAD_MOD_SCHED_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stdbool.h>
+#include <stddef.h>
+#endif
+
+/**
+ * Queue of the jobs the DYAD module has accepted but not started yet.
+ *
+ * Jobs are grouped by size class, and the smallest class is served first so
+ * that small transfers are not stuck behind large ones. A class that has been
+ * passed over too many times in a row is served next, so that large jobs are
+ * not starved. Within a class, the consumers are served in turn, one job
+ * each, so that a consumer with many requests does not hold up the others.
+ * It is only accessed from the reactor thread.
+ */
+struct dyad_mod_sched;
+
+/**
+ * @brief Create an empty queue
+ */
+dyad_rc_t dyad_mod_sched_create (struct dyad_mod_sched** sched);
+
+/**
+ * @brief Release the queue. The jobs still queued are not released.
+ */
+void dyad_mod_sched_destroy (struct dyad_mod_sched** sched);
+
+/**
+ * @brief Queue a job
+ * @param[in] sched     the queue
+ * @param[in] consumer  identity of the consumer the job serves
+ * @param[in] size      number of bytes the job transfers
+ * @param[in] job       the job
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mod_sched_push (struct dyad_mod_sched* sched,
+                               const char* consumer,
+                               size_t size,
+                               void* job);
+
+/**
+ * @brief Get the size of the job dyad_mod_sched_pop would return next
+ *
+ * @return false if the queue is empty
+ */
+bool dyad_mod_sched_peek (const struct dyad_mod_sched* sched, size_t* size);
+
+/**
+ * @brief Dequeue the next job to start
+ *
+ * @return the job, or NULL if the queue is empty
+ */
+void* dyad_mod_sched_pop (struct dyad_mod_sched* sched);
+
+/**
+ * @brief Return the number of jobs queued
+ */
+unsigned int dyad_mod_sched_count (const struct dyad_mod_sched* sched);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_MODULES_DYAD_MOD_SCHED_H */
@@ -0,0 +1,198 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/modules/dyad_mod_stats.h>
+#include <dyad/utils/murmur3.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+#include <cstring>
+#else
+#include <string.h>
+#endif
+
+// Number of files tracked to find the hottest ones. The counts are estimated
+// with the Space-Saving algorithm: a file that is not tracked replaces the
+// least requested one and inherits its count.
+#define DYAD_MOD_STATS_NHOT 64u
+
+static const char* dyad_mod_stats_phase_name[DYAD_MOD_STATS_NPHASES] = {"open",
+                                                                        "read",
+                                                                        "send",
+                                                                        "total"};
+static const char* dyad_mod_stats_event_name[DYAD_MOD_STATS_NEVENTS] = {"rejected",
+                                                                        "cache_hits",
+                                                                        "coalesced"};
+
+struct dyad_mod_stats_hot {
+    char* upath;
+    uint32_t hash;
+    uint64_t count;
+};
+
+struct dyad_mod_stats {
+    uint64_t requests;                        // requests received
+    uint64_t served;                          // requests completed successfully
+    uint64_t failed;                          // requests completed with an error
+    uint64_t bytes_sent;                      // bytes sent to the consumers
+    uint64_t events[DYAD_MOD_STATS_NEVENTS];
+    uint64_t latency[DYAD_MOD_STATS_NPHASES][DYAD_MOD_STATS_NBINS];
+    unsigned int nhot;
+    struct dyad_mod_stats_hot hot[DYAD_MOD_STATS_NHOT];
+};
+
+static uint32_t stats_hash (const char* upath)
+{
+    uint32_t hash = 0u;
+    MurmurHash3_x86_32 (upath, strlen (upath), 57u, &hash);
+    return hash;
+}
+
+static int stats_hot_cmp (const void* a, const void* b)
+{
+    const struct dyad_mod_stats_hot* ha = *(const struct dyad_mod_stats_hot* const*)a;
+    const struct dyad_mod_stats_hot* hb = *(const struct dyad_mod_stats_hot* const*)b;
+    return (ha->count < hb->count) - (ha->count > hb->count);
+}
+
+dyad_rc_t dyad_mod_stats_create (struct dyad_mod_stats** stats)
+{
+    if (stats == NULL)
+        return DYAD_RC_BADBUF;
+    *stats = (struct dyad_mod_stats*)calloc (1, sizeof (struct dyad_mod_stats));
+    if (*stats == NULL)
+        return DYAD_RC_SYSFAIL;
+    return DYAD_RC_OK;
+}
+
+void dyad_mod_stats_destroy (struct dyad_mod_stats** stats)
+{
+    unsigned int i = 0u;
+    if (stats == NULL || *stats == NULL)
+        return;
+    for (i = 0u; i < (*stats)->nhot; i++)
+        free ((*stats)->hot[i].upath);
+    free (*stats);
+    *stats = NULL;
+}
+
+void dyad_mod_stats_request (struct dyad_mod_stats* stats, const char* upath)
+{
+    const uint32_t hash = stats_hash (upath);
+    struct dyad_mod_stats_hot* h = NULL;
+    char* copy = NULL;
+    unsigned int i = 0u;
+
+    stats->requests++;
+    for (i = 0u; i < stats->nhot; i++) {
+        if (stats->hot[i].hash == hash && strcmp (stats->hot[i].upath, upath) == 0) {
+            stats->hot[i].count++;
+            return;
+        }
+    }
+    if ((copy = strdup (upath)) == NULL)
+        return;
+    if (stats->nhot < DYAD_MOD_STATS_NHOT) {
+        h = &(stats->hot[stats->nhot++]);
+        h->count = 0u;
+    } else {
+        h = &(stats->hot[0]);
+        for (i = 1u; i < stats->nhot; i++) {
+            if (stats->hot[i].count < h->count)
+                h = &(stats->hot[i]);
+        }
+        free (h->upath);
+    }
+    h->upath = copy;
+    h->hash = hash;
+    h->count++;
+}
+
+void dyad_mod_stats_done (struct dyad_mod_stats* stats, size_t bytes, int errnum)
+{
+    if (errnum == 0)
+        stats->served++;
+    else
+        stats->failed++;
+    stats->bytes_sent += bytes;
+}
+
+void dyad_mod_stats_event (struct dyad_mod_stats* stats, enum dyad_mod_stats_event event)
+{
+    stats->events[event]++;
+}
+
+void dyad_mod_stats_latency (struct dyad_mod_stats* stats,
+                             enum dyad_mod_stats_phase phase,
+                             double seconds)
+{
+    uint64_t usec = (seconds > 0.0) ? (uint64_t)(seconds * 1000000.0) : 0u;
+    unsigned int bin = 0u;
+    while (usec > 0u && bin < DYAD_MOD_STATS_NBINS - 1u) {
+        usec >>= 1;
+        bin++;
+    }
+    stats->latency[phase][bin]++;
+}
+
+json_t* dyad_mod_stats_pack (const struct dyad_mod_stats* stats, unsigned int top)
+{
+    const struct dyad_mod_stats_hot* sorted[DYAD_MOD_STATS_NHOT];
+    json_t* obj = NULL;
+    json_t* latency = NULL;
+    json_t* hot = NULL;
+    json_t* bins = NULL;
+    unsigned int i = 0u;
+    unsigned int b = 0u;
+
+    if ((obj = json_pack ("{s:I, s:I, s:I, s:I}",
+                          "requests", (json_int_t)stats->requests,
+                          "served", (json_int_t)stats->served,
+                          "failed", (json_int_t)stats->failed,
+                          "bytes_sent", (json_int_t)stats->bytes_sent))
+            == NULL
+        || (latency = json_object ()) == NULL || (hot = json_array ()) == NULL) {
+        goto pack_error;
+    }
+    for (i = 0u; i < DYAD_MOD_STATS_NEVENTS; i++) {
+        if (json_object_set_new (obj, dyad_mod_stats_event_name[i],
+                                 json_integer ((json_int_t)stats->events[i]))
+            < 0)
+            goto pack_error;
+    }
+    for (i = 0u; i < DYAD_MOD_STATS_NPHASES; i++) {
+        if ((bins = json_array ()) == NULL)
+            goto pack_error;
+        for (b = 0u; b < DYAD_MOD_STATS_NBINS; b++)
+            json_array_append_new (bins, json_integer ((json_int_t)stats->latency[i][b]));
+        if (json_object_set_new (latency, dyad_mod_stats_phase_name[i], bins) < 0)
+            goto pack_error;
+    }
+    for (i = 0u; i < stats->nhot; i++)
+        sorted[i] = &(stats->hot[i]);
+    qsort (sorted, stats->nhot, sizeof (sorted[0]), stats_hot_cmp);
+    for (i = 0u; i < stats->nhot && i < top; i++) {
+        json_array_append_new (hot, json_pack ("{s:s, s:I}", "upath", sorted[i]->upath,
+                                               "count", (json_int_t)sorted[i]->count));
+    }
+    if (json_object_set_new (obj, "latency_usec_log2", latency) < 0) {
+        latency = NULL;
+        goto pack_error;
+    }
+    latency = NULL;
+    if (json_object_set_new (obj, "hot_files", hot) < 0) {
+        hot = NULL;
+        goto pack_error;
+    }
+    return obj;
+
+pack_error:;
+    json_decref (hot);
+    json_decref (latency);
+    json_decref (obj);
+    return NULL;
+}
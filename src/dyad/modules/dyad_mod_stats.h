@@ -0,0 +1,84 @@
+#ifndef DYAD_MODULES_DYAD_MOD_STATS_H
+#define DYAD_MODULES_DYAD_MOD_STATS_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <jansson.h>
+
+#ifdef __cplusplus
+#include <cstddef>
+extern "C" {
+#else
+#include <stddef.h>
+#endif
+
+/**
+ * Statistics of the requests served by the DYAD module, reported by the
+ * dyad.stats RPC. It is only accessed from the reactor thread.
+ */
+struct dyad_mod_stats;
+
+enum dyad_mod_stats_phase {
+    DYAD_MOD_STATS_OPEN = 0,   // open, lock and stat of the file
+    DYAD_MOD_STATS_READ = 1,   // read of the file
+    DYAD_MOD_STATS_SEND = 2,   // transfer to the consumer
+    DYAD_MOD_STATS_TOTAL = 3,  // from the arrival of the request to its response
+    DYAD_MOD_STATS_NPHASES = 4
+};
+
+enum dyad_mod_stats_event {
+    DYAD_MOD_STATS_REJECTED = 0,   // request turned down because the module is saturated
+    DYAD_MOD_STATS_CACHE_HIT = 1,  // request served from the hot cache
+    DYAD_MOD_STATS_COALESCED = 2,  // request served by the read of another one
+    DYAD_MOD_STATS_NEVENTS = 3
+};
+
+// Latencies are counted in power-of-two bins of microseconds: bin i holds the
+// latencies in [2^(i-1), 2^i) us, and bin 0 those under 1 us
+#define DYAD_MOD_STATS_NBINS 32u
+
+dyad_rc_t dyad_mod_stats_create (struct dyad_mod_stats** stats);
+
+void dyad_mod_stats_destroy (struct dyad_mod_stats** stats);
+
+/**
+ * @brief Count a request for a file, for the request totals and the hottest files
+ */
+void dyad_mod_stats_request (struct dyad_mod_stats* stats, const char* upath);
+
+/**
+ * @brief Count the completion of a request
+ * @param[in] stats   the statistics
+ * @param[in] bytes   number of bytes sent to the consumer
+ * @param[in] errnum  error reported to the consumer (0 if none)
+ */
+void dyad_mod_stats_done (struct dyad_mod_stats* stats, size_t bytes, int errnum);
+
+void dyad_mod_stats_event (struct dyad_mod_stats* stats, enum dyad_mod_stats_event event);
+
+/**
+ * @brief Count the time spent in a phase of a request, in seconds
+ */
+void dyad_mod_stats_latency (struct dyad_mod_stats* stats,
+                             enum dyad_mod_stats_phase phase,
+                             double seconds);
+
+/**
+ * @brief Describe the statistics as a JSON object
+ * @param[in] stats  the statistics
+ * @param[in] top    number of hottest files to include
+ *
+ * @return a new reference to the object, or NULL on allocation failure
+ */
+json_t* dyad_mod_stats_pack (const struct dyad_mod_stats* stats, unsigned int top);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_MODULES_DYAD_MOD_STATS_H */
@@ -0,0 +1,275 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/modules/dyad_mod_workq.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+#include <cerrno>
+#else
+#include <errno.h>
+#include <stdbool.h>
+#endif
+
+struct dyad_mod_workq_item {
+    struct dyad_mod_workq_item* next;
+    void* job;
+};
+
+struct dyad_mod_workq_list {
+    struct dyad_mod_workq_item* head;
+    struct dyad_mod_workq_item* tail;
+};
+
+struct dyad_mod_workq_thread {
+    dyad_mod_workq_t* q;
+    struct dyad_mod_workq_list own;    // jobs for this worker only
+};
+
+struct dyad_mod_workq {
+    struct dyad_mod_workq_ops ops;
+    void* arg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;               // signaled when a job is queued or on stop
+    struct dyad_mod_workq_list todo;   // jobs waiting for a worker
+    struct dyad_mod_workq_list done;   // jobs waiting for their completion callback
+    bool stop;                         // set when the workers must exit
+    unsigned int pending;              // submitted and not yet completed (reactor only)
+    unsigned int nthreads;
+    pthread_t* threads;
+    struct dyad_mod_workq_thread* workers;  // per-thread state, one per thread
+    int efd;                           // eventfd signaling completions to the reactor
+    flux_watcher_t* w;
+};
+
+static void workq_list_push (struct dyad_mod_workq_list* l, struct dyad_mod_workq_item* it)
+{
+    it->next = NULL;
+    if (l->tail != NULL)
+        l->tail->next = it;
+    else
+        l->head = it;
+    l->tail = it;
+}
+
+static struct dyad_mod_workq_item* workq_list_pop (struct dyad_mod_workq_list* l)
+{
+    struct dyad_mod_workq_item* it = l->head;
+    if (it != NULL) {
+        l->head = it->next;
+        if (l->head == NULL)
+            l->tail = NULL;
+        it->next = NULL;
+    }
+    return it;
+}
+
+static void* workq_thread (void* data)
+{
+    struct dyad_mod_workq_thread* self = (struct dyad_mod_workq_thread*)data;
+    dyad_mod_workq_t* q = self->q;
+    struct dyad_mod_workq_item* it = NULL;
+    const uint64_t one = 1u;
+    void* tls = NULL;
+
+    if (q->ops.thread_init != NULL)
+        tls = q->ops.thread_init (q->arg);
+    pthread_mutex_lock (&q->lock);
+    for (;;) {
+        while (q->todo.head == NULL && self->own.head == NULL && !q->stop)
+            pthread_cond_wait (&q->cond, &q->lock);
+        // Drain the queues before honoring a stop request
+        if ((it = workq_list_pop (&self->own)) == NULL
+            && (it = workq_list_pop (&q->todo)) == NULL)
+            break;
+        pthread_mutex_unlock (&q->lock);
+        q->ops.work (it->job, tls, q->arg);
+        pthread_mutex_lock (&q->lock);
+        workq_list_push (&q->done, it);
+        if (write (q->efd, &one, sizeof (one)) < 0) {
+            // The counter only overflows if the reactor stopped reading it.
+            // The job is picked up with the next completion anyway.
+        }
+    }
+    pthread_mutex_unlock (&q->lock);
+    if (q->ops.thread_fini != NULL)
+        q->ops.thread_fini (tls, q->arg);
+    return NULL;
+}
+
+/// Run the completion callbacks of the jobs finished so far
+static void workq_complete (dyad_mod_workq_t* q)
+{
+    struct dyad_mod_workq_list done = {NULL, NULL};
+    struct dyad_mod_workq_item* it = NULL;
+    pthread_mutex_lock (&q->lock);
+    done = q->done;
+    q->done.head = q->done.tail = NULL;
+    pthread_mutex_unlock (&q->lock);
+    while ((it = workq_list_pop (&done)) != NULL) {
+        q->pending--;
+        q->ops.done (it->job, q->arg);
+        free (it);
+    }
+}
+
+static void workq_efd_cb (flux_reactor_t* r, flux_watcher_t* w, int revents, void* arg)
+{
+    dyad_mod_workq_t* q = (dyad_mod_workq_t*)arg;
+    uint64_t count = 0u;
+    if (read (q->efd, &count, sizeof (count)) < 0 && errno != EAGAIN)
+        return;
+    workq_complete (q);
+}
+
+dyad_rc_t dyad_mod_workq_create (flux_t* h,
+                                 unsigned int nthreads,
+                                 const struct dyad_mod_workq_ops* ops,
+                                 void* arg,
+                                 dyad_mod_workq_t** q)
+{
+    dyad_rc_t rc = DYAD_RC_OK;
+    dyad_mod_workq_t* wq = NULL;
+    unsigned int i = 0u;
+
+    if (q == NULL || ops == NULL || ops->work == NULL || ops->done == NULL || nthreads == 0u) {
+        rc = DYAD_RC_BADBUF;
+        goto workq_create_done;
+    }
+    wq = (dyad_mod_workq_t*)calloc (1, sizeof (*wq));
+    if (wq == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto workq_create_done;
+    }
+    wq->ops = *ops;
+    wq->arg = arg;
+    wq->efd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    wq->threads = (pthread_t*)calloc (nthreads, sizeof (pthread_t));
+    wq->workers =
+        (struct dyad_mod_workq_thread*)calloc (nthreads, sizeof (struct dyad_mod_workq_thread));
+    if (wq->efd < 0 || wq->threads == NULL || wq->workers == NULL) {
+        rc = DYAD_RC_SYSFAIL;
+        goto workq_create_error;
+    }
+    pthread_mutex_init (&wq->lock, NULL);
+    pthread_cond_init (&wq->cond, NULL);
+    wq->w = flux_fd_watcher_create (flux_get_reactor (h), wq->efd, FLUX_POLLIN, workq_efd_cb, wq);
+    if (wq->w == NULL) {
+        rc = DYAD_RC_FLUXFAIL;
+        goto workq_create_error;
+    }
+    flux_watcher_start (wq->w);
+    for (i = 0u; i < nthreads; i++) {
+        wq->workers[i].q = wq;
+        if (pthread_create (&wq->threads[i], NULL, workq_thread, &wq->workers[i]) != 0)
+            break;
+    }
+    wq->nthreads = i;
+    if (i < nthreads) {
+        dyad_mod_workq_destroy (&wq);
+        rc = DYAD_RC_SYSFAIL;
+        goto workq_create_done;
+    }
+    *q = wq;
+    rc = DYAD_RC_OK;
+    goto workq_create_done;
+
+workq_create_error:;
+    if (wq->efd >= 0)
+        close (wq->efd);
+    free (wq->threads);
+    free (wq->workers);
+    free (wq);
+workq_create_done:;
+    return rc;
+}
+
+dyad_rc_t dyad_mod_workq_submit (dyad_mod_workq_t* q, void* job)
+{
+    struct dyad_mod_workq_item* it = NULL;
+    it = (struct dyad_mod_workq_item*)malloc (sizeof (*it));
+    if (it == NULL)
+        return DYAD_RC_SYSFAIL;
+    it->job = job;
+    pthread_mutex_lock (&q->lock);
+    if (q->stop) {
+        // The workers are gone or leaving
+        pthread_mutex_unlock (&q->lock);
+        free (it);
+        return DYAD_RC_SYSFAIL;
+    }
+    workq_list_push (&q->todo, it);
+    q->pending++;
+    pthread_cond_signal (&q->cond);
+    pthread_mutex_unlock (&q->lock);
+    return DYAD_RC_OK;
+}
+
+dyad_rc_t dyad_mod_workq_submit_all (dyad_mod_workq_t* q, void* job, unsigned int* count)
+{
+    struct dyad_mod_workq_item** its = NULL;
+    unsigned int i = 0u;
+    its = (struct dyad_mod_workq_item**)calloc (q->nthreads, sizeof (*its));
+    if (its == NULL)
+        return DYAD_RC_SYSFAIL;
+    // Allocate every item first, so that the job is queued for all the
+    // workers or for none
+    for (i = 0u; i < q->nthreads; i++) {
+        if ((its[i] = (struct dyad_mod_workq_item*)malloc (sizeof (**its))) == NULL)
+            goto submit_all_error;
+        its[i]->job = job;
+    }
+    pthread_mutex_lock (&q->lock);
+    if (q->stop) {
+        pthread_mutex_unlock (&q->lock);
+        goto submit_all_error;
+    }
+    for (i = 0u; i < q->nthreads; i++)
+        workq_list_push (&q->workers[i].own, its[i]);
+    q->pending += q->nthreads;
+    pthread_cond_broadcast (&q->cond);
+    pthread_mutex_unlock (&q->lock);
+    *count = q->nthreads;
+    free (its);
+    return DYAD_RC_OK;
+
+submit_all_error:;
+    for (i = 0u; i < q->nthreads; i++)
+        free (its[i]);
+    free (its);
+    return DYAD_RC_SYSFAIL;
+}
+
+unsigned int dyad_mod_workq_pending (const dyad_mod_workq_t* q)
+{
+    return (q == NULL) ? 0u : q->pending;
+}
+
+void dyad_mod_workq_destroy (dyad_mod_workq_t** q)
+{
+    unsigned int i = 0u;
+    if (q == NULL || *q == NULL)
+        return;
+    pthread_mutex_lock (&(*q)->lock);
+    (*q)->stop = true;
+    pthread_cond_broadcast (&(*q)->cond);
+    pthread_mutex_unlock (&(*q)->lock);
+    for (i = 0u; i < (*q)->nthreads; i++)
+        pthread_join ((*q)->threads[i], NULL);
+    workq_complete (*q);
+    flux_watcher_destroy ((*q)->w);
+    close ((*q)->efd);
+    pthread_cond_destroy (&(*q)->cond);
+    pthread_mutex_destroy (&(*q)->lock);
+    free ((*q)->threads);
+    free ((*q)->workers);
+    free (*q);
+    *q = NULL;
+}
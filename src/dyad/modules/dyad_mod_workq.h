@@ -0,0 +1,90 @@
+#ifndef DYAD_MODULES_DYAD_MOD_WORKQ_H
+#define DYAD_MODULES_DYAD_MOD_WORKQ_H
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_rc.h>
+#include <flux/core.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A pool of worker threads owned by the DYAD module.
+ *
+ * Jobs submitted from the reactor thread are run by the workers. Once a job
+ * is done, its completion callback is invoked back on the reactor thread, so
+ * that the callback may use the module's Flux handle (e.g., to respond to a
+ * request) without any locking.
+ */
+struct dyad_mod_workq;
+typedef struct dyad_mod_workq dyad_mod_workq_t;
+
+struct dyad_mod_workq_ops {
+    // Called once by each worker when it starts. Returns the per-thread state
+    // handed to the work callback (may be NULL).
+    void* (*thread_init) (void* arg);
+    // Called once by each worker before it exits
+    void (*thread_fini) (void* tls, void* arg);
+    // Called on a worker thread for each job
+    void (*work) (void* job, void* tls, void* arg);
+    // Called on the reactor thread once the work on a job is done
+    void (*done) (void* job, void* arg);
+};
+
+/**
+ * @brief Start the worker threads and watch for completions on the reactor of h
+ * @param[in]  h         the Flux handle of the module
+ * @param[in]  nthreads  the number of worker threads
+ * @param[in]  ops       the callbacks run for each job (copied)
+ * @param[in]  arg       the argument passed to every callback
+ * @param[out] q         the newly created work queue
+ *
+ * @return An error code from dyad_rc.h
+ */
+dyad_rc_t dyad_mod_workq_create (flux_t* h,
+                                 unsigned int nthreads,
+                                 const struct dyad_mod_workq_ops* ops,
+                                 void* arg,
+                                 dyad_mod_workq_t** q);
+
+/**
+ * @brief Queue a job for the worker threads. Call from the reactor thread only.
+ *        Fails once the queue is being destroyed, including from the
+ *        completion callbacks it runs.
+ */
+dyad_rc_t dyad_mod_workq_submit (dyad_mod_workq_t* q, void* job);
+
+/**
+ * @brief Queue a job once for every worker thread, e.g., to set up the
+ *        per-thread state of each worker. Call from the reactor thread only.
+ *        The completion callback is invoked once per worker.
+ * @param[in]  q      the work queue
+ * @param[in]  job    the job
+ * @param[out] count  the number of workers the job was queued for
+ *
+ * @return An error code from dyad_rc.h. On error, the job was not queued.
+ */
+dyad_rc_t dyad_mod_workq_submit_all (dyad_mod_workq_t* q, void* job, unsigned int* count);
+
+/**
+ * @brief Return the number of jobs submitted but not yet completed
+ */
+unsigned int dyad_mod_workq_pending (const dyad_mod_workq_t* q);
+
+/**
+ * @brief Finish the queued jobs, join the workers and release the queue.
+ *        The completion callback is invoked for every outstanding job.
+ */
+void dyad_mod_workq_destroy (dyad_mod_workq_t** q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DYAD_MODULES_DYAD_MOD_WORKQ_H */
@@ -0,0 +1,307 @@
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_dtl.h>
+#include <dyad/modules/dyad_mod_stats.h>
+#include <errno.h>
+#include <flux/core.h>
+#include <jansson.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * dyad_stats: poll the dyad.stats service of the DYAD module on every broker
+ * of the instance and print a summary of the whole cluster.
+ */
+
+#define DYAD_STATS_DEFAULT_TOP 10
+
+static const char* phase_names[DYAD_MOD_STATS_NPHASES] = {"open", "read", "send", "total"};
+
+struct hot_file {
+    char* upath;
+    json_int_t count;
+};
+
+struct summary {
+    json_int_t requests;
+    json_int_t served;
+    json_int_t failed;
+    json_int_t bytes_sent;
+    json_int_t rejected;
+    json_int_t cache_hits;
+    json_int_t coalesced;
+    json_int_t active;
+    json_int_t active_bytes;
+    json_int_t queued;
+    json_int_t bins[DYAD_MOD_STATS_NPHASES][DYAD_MOD_STATS_NBINS];
+    struct hot_file* hot;
+    size_t nhot;
+    size_t max_hot;
+    unsigned int nranks;  // ranks that answered
+};
+
+static void usage (const char* prog)
+{
+    fprintf (stderr,
+             "Usage: %s [-i SECONDS] [-n TOP] [-r]\n"
+             "  -i SECONDS  poll every SECONDS seconds instead of once\n"
+             "  -n TOP      number of hottest files to show (default %d)\n"
+             "  -r          also print a line per rank\n",
+             prog, DYAD_STATS_DEFAULT_TOP);
+}
+
+static void summary_reset (struct summary* s)
+{
+    size_t i = 0ul;
+    for (i = 0ul; i < s->nhot; i++)
+        free (s->hot[i].upath);
+    free (s->hot);
+    memset (s, 0, sizeof (*s));
+}
+
+static int summary_add_hot (struct summary* s, const char* upath, json_int_t count)
+{
+    size_t i = 0ul;
+    struct hot_file* hot = NULL;
+    for (i = 0ul; i < s->nhot; i++) {
+        if (strcmp (s->hot[i].upath, upath) == 0) {
+            s->hot[i].count += count;
+            return 0;
+        }
+    }
+    if (s->nhot == s->max_hot) {
+        size_t max_hot = (s->max_hot == 0ul) ? 64ul : 2ul * s->max_hot;
+        if ((hot = (struct hot_file*)realloc (s->hot, max_hot * sizeof (*hot))) == NULL)
+            return -1;
+        s->hot = hot;
+        s->max_hot = max_hot;
+    }
+    if ((s->hot[s->nhot].upath = strdup (upath)) == NULL)
+        return -1;
+    s->hot[s->nhot++].count = count;
+    return 0;
+}
+
+static int hot_file_cmp (const void* a, const void* b)
+{
+    const struct hot_file* x = (const struct hot_file*)a;
+    const struct hot_file* y = (const struct hot_file*)b;
+    return (x->count < y->count) ? 1 : ((x->count > y->count) ? -1 : 0);
+}
+
+/// Add the reply of one rank to the summary
+static int summary_add (struct summary* s, json_t* reply, int per_rank)
+{
+    json_int_t rank = 0, requests = 0, served = 0, failed = 0, bytes_sent = 0;
+    json_int_t rejected = 0, cache_hits = 0, coalesced = 0;
+    json_int_t active = 0, active_bytes = 0, queued = 0;
+    json_t* latency = NULL;
+    json_t* hot = NULL;
+    json_t* bins = NULL;
+    json_t* value = NULL;
+    const char* upath = NULL;
+    json_int_t count = 0;
+    size_t index = 0ul;
+    unsigned int p = 0u;
+
+    if (json_unpack (reply, "{s:I, s:I, s:I, s:I, s:I, s:I, s:I, s:I, s:I, s:I, s:I, s:o, s:o}",
+                     "rank", &rank, "requests", &requests, "served", &served, "failed", &failed,
+                     "bytes_sent", &bytes_sent, "rejected", &rejected, "cache_hits",
+                     &cache_hits, "coalesced", &coalesced, "active", &active, "active_bytes",
+                     &active_bytes, "queued", &queued, "latency_usec_log2", &latency,
+                     "hot_files", &hot)
+        < 0)
+        return -1;
+    if (per_rank) {
+        printf ("%6lld %10lld %10lld %8lld %8lld %8lld %9lld %12.1f %6lld %6lld\n",
+                (long long)rank, (long long)requests, (long long)served, (long long)failed,
+                (long long)rejected, (long long)cache_hits, (long long)coalesced,
+                (double)bytes_sent / (1024.0 * 1024.0), (long long)active, (long long)queued);
+    }
+    s->requests += requests;
+    s->served += served;
+    s->failed += failed;
+    s->bytes_sent += bytes_sent;
+    s->rejected += rejected;
+    s->cache_hits += cache_hits;
+    s->coalesced += coalesced;
+    s->active += active;
+    s->active_bytes += active_bytes;
+    s->queued += queued;
+    for (p = 0u; p < DYAD_MOD_STATS_NPHASES; p++) {
+        if (json_unpack (latency, "{s:o}", phase_names[p], &bins) < 0)
+            continue;
+        json_array_foreach (bins, index, value)
+        {
+            if (index < DYAD_MOD_STATS_NBINS)
+                s->bins[p][index] += json_integer_value (value);
+        }
+    }
+    json_array_foreach (hot, index, value)
+    {
+        if (json_unpack (value, "{s:s, s:I}", "upath", &upath, "count", &count) < 0)
+            continue;
+        if (summary_add_hot (s, upath, count) < 0)
+            return -1;
+    }
+    s->nranks++;
+    return 0;
+}
+
+/// Upper bound, in microseconds, of the bin holding the q-quantile of a
+/// histogram, or 0 if it is empty
+static unsigned long long quantile_usec (const json_int_t* bins, double q)
+{
+    json_int_t total = 0, seen = 0;
+    unsigned int b = 0u;
+    for (b = 0u; b < DYAD_MOD_STATS_NBINS; b++)
+        total += bins[b];
+    if (total == 0)
+        return 0ull;
+    for (b = 0u; b < DYAD_MOD_STATS_NBINS; b++) {
+        seen += bins[b];
+        if ((double)seen >= q * (double)total)
+            break;
+    }
+    return 1ull << ((b < DYAD_MOD_STATS_NBINS) ? b : DYAD_MOD_STATS_NBINS - 1u);
+}
+
+static void summary_print (struct summary* s, unsigned int top)
+{
+    unsigned int p = 0u;
+    size_t i = 0ul;
+    json_int_t count = 0;
+    unsigned int b = 0u;
+
+    printf ("%6s %10lld %10lld %8lld %8lld %8lld %9lld %12.1f %6lld %6lld\n", "all",
+            (long long)s->requests, (long long)s->served, (long long)s->failed,
+            (long long)s->rejected, (long long)s->cache_hits, (long long)s->coalesced,
+            (double)s->bytes_sent / (1024.0 * 1024.0), (long long)s->active,
+            (long long)s->queued);
+    printf ("%u rank(s) reporting, %.1f MiB in flight\n", s->nranks,
+            (double)s->active_bytes / (1024.0 * 1024.0));
+    printf ("\n%-6s %10s %12s %12s\n", "phase", "count", "p50 (us) <", "p99 (us) <");
+    for (p = 0u; p < DYAD_MOD_STATS_NPHASES; p++) {
+        for (b = 0u, count = 0; b < DYAD_MOD_STATS_NBINS; b++)
+            count += s->bins[p][b];
+        printf ("%-6s %10lld %12llu %12llu\n", phase_names[p], (long long)count,
+                quantile_usec (s->bins[p], 0.5), quantile_usec (s->bins[p], 0.99));
+    }
+    if (top > 0u && s->nhot > 0ul) {
+        // The counts of a rank are approximate when it tracks more files than it
+        // can hold, so the cluster ranking is too
+        qsort (s->hot, s->nhot, sizeof (*s->hot), hot_file_cmp);
+        printf ("\nhottest files:\n");
+        for (i = 0ul; i < s->nhot && i < top; i++)
+            printf ("%10lld  %s\n", (long long)s->hot[i].count, s->hot[i].upath);
+    }
+}
+
+/// Query every rank and print the summary. Ranks where the module is not
+/// loaded are skipped.
+static int poll_ranks (flux_t* h, uint32_t size, unsigned int top, int per_rank)
+{
+    flux_future_t** futures = NULL;
+    struct summary s;
+    json_t* reply = NULL;
+    uint32_t r = 0u;
+    int rc = -1;
+
+    memset (&s, 0, sizeof (s));
+    if ((futures = (flux_future_t**)calloc (size, sizeof (flux_future_t*))) == NULL) {
+        perror ("dyad_stats");
+        return -1;
+    }
+    // Send all the requests before waiting for any reply
+    for (r = 0u; r < size; r++) {
+        futures[r] = flux_rpc_pack (h, DYAD_STATS_RPC_NAME, r, 0, "{s:i}", "top", (int)top);
+        if (futures[r] == NULL)
+            fprintf (stderr, "dyad_stats: cannot query rank %u: %s\n", r, strerror (errno));
+    }
+    if (per_rank) {
+        printf ("%6s %10s %10s %8s %8s %8s %9s %12s %6s %6s\n", "rank", "requests", "served",
+                "failed", "rejected", "hits", "coalesced", "MiB sent", "active", "queued");
+    }
+    for (r = 0u; r < size; r++) {
+        if (futures[r] == NULL)
+            continue;
+        if (flux_rpc_get_unpack (futures[r], "o", &reply) < 0) {
+            if (errno != ENOSYS)
+                fprintf (stderr, "dyad_stats: rank %u: %s\n", r,
+                         flux_future_error_string (futures[r]));
+            continue;
+        }
+        if (summary_add (&s, reply, per_rank) < 0)
+            fprintf (stderr, "dyad_stats: rank %u: malformed reply\n", r);
+    }
+    if (s.nranks == 0u) {
+        fprintf (stderr, "dyad_stats: no rank runs the DYAD module\n");
+        goto poll_done;
+    }
+    summary_print (&s, top);
+    rc = 0;
+
+poll_done:;
+    for (r = 0u; r < size; r++)
+        flux_future_destroy (futures[r]);
+    free (futures);
+    summary_reset (&s);
+    return rc;
+}
+
+int main (int argc, char** argv)
+{
+    flux_t* h = NULL;
+    uint32_t size = 1u;
+    unsigned int interval = 0u;
+    int top = DYAD_STATS_DEFAULT_TOP;
+    int per_rank = 0;
+    int opt = 0;
+    int rc = EXIT_SUCCESS;
+
+    while ((opt = getopt (argc, argv, "i:n:rh")) != -1) {
+        switch (opt) {
+            case 'i':
+                interval = (unsigned int)strtoul (optarg, NULL, 10);
+                break;
+            case 'n':
+                top = atoi (optarg);
+                break;
+            case 'r':
+                per_rank = 1;
+                break;
+            default:
+                usage (argv[0]);
+                return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (top < 0)
+        top = 0;
+    if (!(h = flux_open (NULL, 0))) {
+        fprintf (stderr, "dyad_stats: cannot open flux: %s\n", strerror (errno));
+        return EXIT_FAILURE;
+    }
+    if (flux_get_size (h, &size) < 0) {
+        fprintf (stderr, "dyad_stats: flux_get_size() failed\n");
+        flux_close (h);
+        return EXIT_FAILURE;
+    }
+    for (;;) {
+        if (poll_ranks (h, size, (unsigned int)top, per_rank) < 0)
+            rc = EXIT_FAILURE;
+        if (interval == 0u)
+            break;
+        printf ("\n");
+        fflush (stdout);
+        sleep (interval);
+    }
+    flux_close (h);
+    return rc;
+}
@@ -104,22 +104,18 @@ void MurmurHash3_x86_32 (const void *key, int len, uint32_t seed, void *out)
     uint32_t k1 = 0;
 
     switch (len & 3) {
-        case 3: {
+        case 3:
             k1 ^= tail[2] << 16;
-            break;
-        }
-        case 2: {
+            /* fall through */
+        case 2:
             k1 ^= tail[1] << 8;
-            break;
-        }
-        case 1: {
+            /* fall through */
+        case 1:
             k1 ^= tail[0];
             k1 *= c1;
             k1 = ROTL32 (k1, 15);
             k1 *= c2;
             h1 ^= k1;
-            break;
-        }
     };
 
     //----------
@@ -209,85 +205,66 @@ void MurmurHash3_x86_128 (const void *key, const int len, uint32_t seed, void *o
     uint32_t k4 = 0;
 
     switch (len & 15) {
-        case 15: {
+        case 15:
             k4 ^= tail[14] << 16;
-            break;
-        }
-        case 14: {
+            /* fall through */
+        case 14:
             k4 ^= tail[13] << 8;
-            break;
-        }
-        case 13: {
+            /* fall through */
+        case 13:
             k4 ^= tail[12] << 0;
             k4 *= c4;
             k4 = ROTL32 (k4, 18);
             k4 *= c1;
             h4 ^= k4;
-            break;
-        }
-
-        case 12: {
+            /* fall through */
+        case 12:
             k3 ^= tail[11] << 24;
-            break;
-        }
-        case 11: {
+            /* fall through */
+        case 11:
             k3 ^= tail[10] << 16;
-            break;
-        }
-        case 10: {
+            /* fall through */
+        case 10:
             k3 ^= tail[9] << 8;
-            break;
-        }
-        case 9: {
+            /* fall through */
+        case 9:
             k3 ^= tail[8] << 0;
             k3 *= c3;
             k3 = ROTL32 (k3, 17);
             k3 *= c4;
             h3 ^= k3;
-            break;
-        }
-
-        case 8: {
+            /* fall through */
+        case 8:
             k2 ^= tail[7] << 24;
-            break;
-        }
-        case 7: {
+            /* fall through */
+        case 7:
             k2 ^= tail[6] << 16;
-            break;
-        }
-        case 6: {
+            /* fall through */
+        case 6:
             k2 ^= tail[5] << 8;
-            break;
-        }
-        case 5: {
+            /* fall through */
+        case 5:
             k2 ^= tail[4] << 0;
             k2 *= c2;
             k2 = ROTL32 (k2, 16);
             k2 *= c3;
             h2 ^= k2;
-            break;
-        }
-
-        case 4: {
+            /* fall through */
+        case 4:
             k1 ^= tail[3] << 24;
-            break;
-        }
-        case 3: {
+            /* fall through */
+        case 3:
             k1 ^= tail[2] << 16;
-            break;
-        }
-        case 2: {
+            /* fall through */
+        case 2:
             k1 ^= tail[1] << 8;
-            break;
-        }
-        case 1: {
+            /* fall through */
+        case 1:
             k1 ^= tail[0] << 0;
             k1 *= c1;
             k1 = ROTL32 (k1, 15);
             k1 *= c2;
             h1 ^= k1;
-            break;
-        }
     };
 
     //----------
@@ -373,6 +350,201 @@ void MurmurHash3_x64_128 (const void *key, const int len, const uint32_t seed, v
     uint64_t k1 = 0;
     uint64_t k2 = 0;
 
+    switch (len & 15) {
+        case 15:
+            k2 ^= (uint64_t)(tail[14]) << 48;
+            /* fall through */
+        case 14:
+            k2 ^= (uint64_t)(tail[13]) << 40;
+            /* fall through */
+        case 13:
+            k2 ^= (uint64_t)(tail[12]) << 32;
+            /* fall through */
+        case 12:
+            k2 ^= (uint64_t)(tail[11]) << 24;
+            /* fall through */
+        case 11:
+            k2 ^= (uint64_t)(tail[10]) << 16;
+            /* fall through */
+        case 10:
+            k2 ^= (uint64_t)(tail[9]) << 8;
+            /* fall through */
+        case 9:
+            k2 ^= (uint64_t)(tail[8]) << 0;
+            k2 *= c2;
+            k2 = ROTL64 (k2, 33);
+            k2 *= c1;
+            h2 ^= k2;
+            /* fall through */
+        case 8:
+            k1 ^= (uint64_t)(tail[7]) << 56;
+            /* fall through */
+        case 7:
+            k1 ^= (uint64_t)(tail[6]) << 48;
+            /* fall through */
+        case 6:
+            k1 ^= (uint64_t)(tail[5]) << 40;
+            /* fall through */
+        case 5:
+            k1 ^= (uint64_t)(tail[4]) << 32;
+            /* fall through */
+        case 4:
+            k1 ^= (uint64_t)(tail[3]) << 24;
+            /* fall through */
+        case 3:
+            k1 ^= (uint64_t)(tail[2]) << 16;
+            /* fall through */
+        case 2:
+            k1 ^= (uint64_t)(tail[1]) << 8;
+            /* fall through */
+        case 1:
+            k1 ^= (uint64_t)(tail[0]) << 0;
+            k1 *= c1;
+            k1 = ROTL64 (k1, 31);
+            k1 *= c2;
+            h1 ^= k1;
+    };
+
+    //----------
+    // finalization
+
+    h1 ^= len;
+    h2 ^= len;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64 (h1);
+    h2 = fmix64 (h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    ((uint64_t *)out)[0] = h1;
+    ((uint64_t *)out)[1] = h2;
+}
+
+//-----------------------------------------------------------------------------
+// Legacy variants. DYAD shipped these with a break after every case of the
+// tail switch, so only one tail byte is mixed in. They are kept bit for bit
+// because their output is shared between builds: the KVS keys derived from
+// the managed paths and the stripe a consumed file is placed in. New users
+// should call the functions above.
+
+void MurmurHash3_x86_32_legacy (const void *key, int len, uint32_t seed, void *out)
+{
+    const uint8_t *data = (const uint8_t *)key;
+    const int nblocks = len / 4;
+    int i;
+
+    uint32_t h1 = seed;
+
+    uint32_t c1 = 0xcc9e2d51;
+    uint32_t c2 = 0x1b873593;
+
+    //----------
+    // body
+
+    const uint32_t *blocks = (const uint32_t *)(data + nblocks * 4);
+
+    for (i = -nblocks; i; i++) {
+        uint32_t k1 = getblock (blocks, i);
+
+        k1 *= c1;
+        k1 = ROTL32 (k1, 15);
+        k1 *= c2;
+
+        h1 ^= k1;
+        h1 = ROTL32 (h1, 13);
+        h1 = h1 * 5 + 0xe6546b64;
+    }
+
+    //----------
+    // tail
+
+    const uint8_t *tail = (const uint8_t *)(data + nblocks * 4);
+
+    uint32_t k1 = 0;
+
+    switch (len & 3) {
+        case 3: {
+            k1 ^= tail[2] << 16;
+            break;
+        }
+        case 2: {
+            k1 ^= tail[1] << 8;
+            break;
+        }
+        case 1: {
+            k1 ^= tail[0];
+            k1 *= c1;
+            k1 = ROTL32 (k1, 15);
+            k1 *= c2;
+            h1 ^= k1;
+            break;
+        }
+    };
+
+    //----------
+    // finalization
+
+    h1 ^= len;
+
+    h1 = fmix32 (h1);
+
+    *(uint32_t *)out = h1;
+}
+
+//-----------------------------------------------------------------------------
+
+void MurmurHash3_x64_128_legacy (const void *key, const int len, const uint32_t seed, void *out)
+{
+    const uint8_t *data = (const uint8_t *)key;
+    const int nblocks = len / 16;
+    int i;
+
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    uint64_t c1 = BIG_CONSTANT (0x87c37b91114253d5);
+    uint64_t c2 = BIG_CONSTANT (0x4cf5ad432745937f);
+
+    //----------
+    // body
+
+    const uint64_t *blocks = (const uint64_t *)(data);
+
+    for (i = 0; i < nblocks; i++) {
+        uint64_t k1 = getblock (blocks, i * 2 + 0);
+        uint64_t k2 = getblock (blocks, i * 2 + 1);
+
+        k1 *= c1;
+        k1 = ROTL64 (k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+
+        h1 = ROTL64 (h1, 27);
+        h1 += h2;
+        h1 = h1 * 5 + 0x52dce729;
+
+        k2 *= c2;
+        k2 = ROTL64 (k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+
+        h2 = ROTL64 (h2, 31);
+        h2 += h1;
+        h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    //----------
+    // tail
+
+    const uint8_t *tail = (const uint8_t *)(data + nblocks * 16);
+
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+
     switch (len & 15) {
         case 15: {
             k2 ^= (uint64_t)(tail[14]) << 48;
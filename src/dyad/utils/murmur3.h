@@ -20,6 +20,12 @@ void MurmurHash3_x86_128 (const void *key, int len, uint32_t seed, void *out);
 
 void MurmurHash3_x64_128 (const void *key, int len, uint32_t seed, void *out);
 
+// Variants that mix in only one tail byte, kept for the hashes shared
+// between builds (KVS keys and stripe placement)
+void MurmurHash3_x86_32_legacy (const void *key, int len, uint32_t seed, void *out);
+
+void MurmurHash3_x64_128_legacy (const void *key, int len, uint32_t seed, void *out);
+
 //-----------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -21,6 +21,7 @@
 
 #include <dyad/common/dyad_logging.h>
 #include <dyad/common/dyad_profiler.h>
+#include <dyad/utils/murmur3.h>
 
 #include <fcntl.h>      // open
 #include <libgen.h>     // basename dirname
@@ -421,6 +422,49 @@ bool get_stat (const char* path, unsigned int max_retry, long ns_sleep)
 }
 #endif  // DYAD_SPIN_WAIT
 
+int gen_path_key (const char* str,
+                  char* path_key,
+                  const size_t len,
+                  const uint32_t depth,
+                  const uint32_t width)
+{
+    DYAD_C_FUNCTION_START();
+    static const uint32_t seeds[10] =
+        {104677u, 104681u, 104683u, 104693u, 104701u, 104707u, 104711u, 104717u, 104723u, 104729u};
+
+    uint32_t seed = 57u;
+    uint32_t hash[4] = {0u};  // Output for the hash
+    size_t cx = 0ul;
+    int n = 0;
+
+    if (path_key == NULL || len == 0ul) {
+        DYAD_C_FUNCTION_END();
+        return -1;
+    }
+    path_key[0] = '\0';
+
+    for (uint32_t d = 0u; d < depth; d++) {
+        seed += seeds[d % 10];
+        // TODO add assert that str is not NULL
+        MurmurHash3_x64_128_legacy (str, strlen (str), seed, hash);
+        uint32_t bin = (hash[0] ^ hash[1] ^ hash[2] ^ hash[3]) % width;
+        n = snprintf (path_key + cx, len - cx, "%x.", bin);
+        cx += n;
+        if (cx >= len || n < 0) {
+            DYAD_C_FUNCTION_END();
+            return -1;
+        }
+    }
+    n = snprintf (path_key + cx, len - cx, "%s", str);
+    if (cx + n >= len || n < 0) {
+        DYAD_C_FUNCTION_END();
+        return -1;
+    }
+    DYAD_C_FUNCTION_UPDATE_STR ("path_key", path_key);
+    DYAD_C_FUNCTION_END();
+    return 0;
+}
+
 ssize_t get_file_size (int fd)
 {
     const ssize_t file_size = lseek (fd, 0, SEEK_END);
@@ -436,6 +480,13 @@ ssize_t get_file_size (int fd)
     return file_size;
 }
 
+uint64_t get_file_version (const struct stat* st)
+{
+    const uint64_t version =
+        (uint64_t)st->st_mtim.tv_sec * 1000000000ull + (uint64_t)st->st_mtim.tv_nsec;
+    return (version == 0ull) ? 1ull : version;
+}
+
 dyad_rc_t dyad_excl_flock (const dyad_ctx_t* ctx, int fd, struct flock* lock)
 {
     dyad_rc_t rc = DYAD_RC_OK;
@@ -26,10 +26,12 @@
 #if defined(__cplusplus)
 // #include <cstdbool> // c++11
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #else
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #endif  // defined(__cplusplus)
 #include <sys/file.h>
@@ -87,6 +89,18 @@ bool get_stat (const char* path, unsigned int max_retry, long ns_sleep);
 
 ssize_t get_file_size (int fd);
 
+/// Version of a file published along with its size: the modification time in
+/// nanoseconds, never 0, which stands for an unknown version
+uint64_t get_file_version (const struct stat* st);
+
+/// Generate the KVS key of a file from its path relative to the managed
+/// directory: depth levels of width bins each, followed by the path
+int gen_path_key (const char* str,
+                  char* path_key,
+                  const size_t len,
+                  const uint32_t depth,
+                  const uint32_t width);
+
 dyad_rc_t dyad_excl_flock (const dyad_ctx_t* ctx, int fd, struct flock* lock);
 dyad_rc_t dyad_shared_flock (const dyad_ctx_t* ctx, int fd, struct flock* lock);
 dyad_rc_t dyad_release_flock (const dyad_ctx_t* ctx, int fd, struct flock* lock);
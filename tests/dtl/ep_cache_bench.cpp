@@ -0,0 +1,174 @@
+/************************************************************\
+ * Microbenchmark of the endpoint cache of the UCX DTL.
+ *
+ * Consumers are simulated by keys drawn from a skewed distribution: a
+ * fraction of the lookups go to a small set of hot consumers, the rest are
+ * spread over all of them. Every key connects to the worker of the benchmark
+ * itself, so misses pay for a real ucp_ep_create and evictions for a real
+ * endpoint close.
+ *
+ * Built with the tree by configuring with -DDYAD_ENABLE_UCX_DATA=ON
+ * -DDYAD_BUILD_BENCHMARKS=ON, or against an installed DYAD, e.g.:
+ *   g++ -std=c++17 -DDYAD_HAS_CONFIG -I<dyad>/include ep_cache_bench.cpp \
+ *       -L<dyad>/lib -ldyad_dtl -lucp -lucs -lflux-core -ljansson
+\************************************************************/
+
+#if defined(DYAD_HAS_CONFIG)
+#include <dyad/dyad_config.hpp>
+#else
+#error "no config"
+#endif
+
+#include <dyad/common/dyad_structures.h>
+#include <dyad/dtl/dyad_dtl_api.h>
+#include <dyad/dtl/ucx_dtl.h>
+#include <dyad/dtl/ucx_ep_cache.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// 64-bit FNV-1a hash, as the DTL computes the key of a consumer from the
+// address of its worker
+static uint64_t fnv1a (const void *data, size_t len, uint64_t h = 14695981039346656037ull)
+{
+    const unsigned char *p = static_cast<const unsigned char *> (data);
+    for (size_t i = 0u; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+int main (int argc, char **argv)
+{
+    if ((argc < 4) || (argc > 5)) {
+        std::cout << "Usage: " << argv[0]
+                  << " capacity num_consumers num_lookups [hot_percent(default 80)]"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    size_t capacity = strtoul (argv[1], nullptr, 10);
+    uint64_t num_consumers = strtoull (argv[2], nullptr, 10);
+    uint64_t num_lookups = strtoull (argv[3], nullptr, 10);
+    unsigned hot_percent = (argc == 5) ? static_cast<unsigned> (atoi (argv[4])) : 80u;
+    if (capacity == 0u || num_consumers == 0u || hot_percent > 100u) {
+        std::cerr << "Invalid arguments" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // The hot consumers fit in half of the cache
+    uint64_t num_hot = std::max<uint64_t> (1u, std::min<uint64_t> (capacity / 2u, num_consumers));
+
+    ucp_config_t *config = nullptr;
+    ucp_params_t ucp_params;
+    ucp_worker_params_t worker_params;
+    ucp_worker_attr_t worker_attrs;
+    ucp_context_h ucp_ctx = nullptr;
+    ucp_worker_h worker = nullptr;
+
+    if (ucp_config_read (nullptr, nullptr, &config) != UCS_OK) {
+        std::cerr << "Cannot read the UCX configuration" << std::endl;
+        return EXIT_FAILURE;
+    }
+    memset (&ucp_params, 0, sizeof (ucp_params));
+    ucp_params.field_mask = UCP_PARAM_FIELD_FEATURES;
+    ucp_params.features = UCP_FEATURE_TAG;
+    if (ucp_init (&ucp_params, config, &ucp_ctx) != UCS_OK) {
+        ucp_config_release (config);
+        std::cerr << "Cannot initialize UCX" << std::endl;
+        return EXIT_FAILURE;
+    }
+    ucp_config_release (config);
+    memset (&worker_params, 0, sizeof (worker_params));
+    worker_params.field_mask = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+    worker_params.thread_mode = UCS_THREAD_MODE_SINGLE;
+    if (ucp_worker_create (ucp_ctx, &worker_params, &worker) != UCS_OK) {
+        ucp_cleanup (ucp_ctx);
+        std::cerr << "Cannot create a UCP worker" << std::endl;
+        return EXIT_FAILURE;
+    }
+    worker_attrs.field_mask = UCP_WORKER_ATTR_FIELD_ADDRESS;
+    if (ucp_worker_query (worker, &worker_attrs) != UCS_OK) {
+        ucp_worker_destroy (worker);
+        ucp_cleanup (ucp_ctx);
+        std::cerr << "Cannot get the address of the UCP worker" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The cache only reads the key of the current consumer from the context
+    dyad_dtl_ucx_t ucx_handle;
+    dyad_dtl_t dtl;
+    dyad_ctx_t ctx;
+    memset (&ucx_handle, 0, sizeof (ucx_handle));
+    memset (&dtl, 0, sizeof (dtl));
+    memset (&ctx, 0, sizeof (ctx));
+    dtl.private_dtl.ucx_dtl_handle = &ucx_handle;
+    ctx.dtl_handle = &dtl;
+
+    ucx_ep_cache_h cache = nullptr;
+    if (DYAD_IS_ERROR (dyad_ucx_ep_cache_init (&ctx, capacity, &cache))) {
+        std::cerr << "Cannot create the endpoint cache" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Keys of the DTL are hashes of the worker addresses of the consumers.
+    // Consumer c is given the address of the benchmark worker followed by c,
+    // so that the keys spread over the table as they do in production.
+    std::vector<uint64_t> keys (num_consumers);
+    const uint64_t addr_hash = fnv1a (worker_attrs.address, worker_attrs.address_length);
+    for (uint64_t c = 0u; c < num_consumers; c++)
+        keys[c] = fnv1a (&c, sizeof (c), addr_hash);
+
+    std::mt19937_64 gen (42u);
+    std::uniform_int_distribution<unsigned> pct (0u, 99u);
+    std::uniform_int_distribution<uint64_t> hot (0u, num_hot - 1u);
+    std::uniform_int_distribution<uint64_t> any (0u, num_consumers - 1u);
+    uint64_t failures = 0u;
+
+    auto start = std::chrono::steady_clock::now ();
+    for (uint64_t i = 0u; i < num_lookups; i++) {
+        uint64_t c = (pct (gen) < hot_percent) ? hot (gen) : any (gen);
+        ucx_handle.consumer_conn_key = keys[c];
+        ucp_ep_h ep = nullptr;
+        if (DYAD_IS_ERROR (dyad_ucx_ep_cache_find (&ctx, cache, worker_attrs.address,
+                                                   worker_attrs.address_length, &ep))) {
+            ep = nullptr;
+            if (DYAD_IS_ERROR (dyad_ucx_ep_cache_insert (&ctx, cache, worker_attrs.address,
+                                                         worker_attrs.address_length, worker,
+                                                         &ep))) {
+                failures++;
+            }
+        }
+    }
+    auto end = std::chrono::steady_clock::now ();
+    double elapsed = std::chrono::duration<double> (end - start).count ();
+
+    dyad_ucx_ep_cache_stats_t stats;
+    dyad_ucx_ep_cache_stats (cache, &stats);
+    std::cout << "capacity:       " << stats.capacity << std::endl;
+    std::cout << "consumers:      " << num_consumers << " (" << num_hot << " hot, "
+              << hot_percent << "% of the lookups)" << std::endl;
+    std::cout << "lookups:        " << num_lookups << std::endl;
+    std::cout << "hits:           " << stats.hits << std::endl;
+    std::cout << "misses:         " << stats.misses << std::endl;
+    std::cout << "evictions:      " << stats.evictions << std::endl;
+    std::cout << "entries in use: " << stats.size << std::endl;
+    std::cout << "failed inserts: " << failures << std::endl;
+    std::cout << "hit ratio:      "
+              << ((num_lookups > 0u) ? 100.0 * stats.hits / num_lookups : 0.0) << " %"
+              << std::endl;
+    std::cout << "time per lookup: "
+              << ((num_lookups > 0u) ? 1e9 * elapsed / num_lookups : 0.0) << " ns" << std::endl;
+
+    dyad_ucx_ep_cache_finalize (&ctx, &cache, worker);
+    ucp_worker_release_address (worker, worker_attrs.address);
+    ucp_worker_destroy (worker);
+    ucp_cleanup (ucp_ctx);
+    return (failures == 0u) ? EXIT_SUCCESS : EXIT_FAILURE;
+}